@@ -0,0 +1 @@
+#define HAVE_MALLOC_H 1
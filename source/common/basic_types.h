@@ -74,10 +74,13 @@ typedef struct xavs2_frame_buffer_t xavs2_frame_buffer_t;
 typedef struct ratectrl_t       ratectrl_t;
 typedef struct cu_size_ctrl_t   cu_size_ctrl_t;
 typedef struct td_rdo_t         td_rdo_t;
+typedef struct ladder_t         ladder_t;
+typedef struct ladder_hint_t    ladder_hint_t;
 typedef struct aec_t            aec_t;
 typedef struct cu_t             cu_t;
 typedef union  mv_t             mv_t;
 typedef struct cu_info_t        cu_info_t;
+typedef struct slice_row_index_t slice_row_index_t;
 
 typedef struct outputframe_t    outputframe_t;
 
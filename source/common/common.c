@@ -50,6 +50,9 @@
 #if HAVE_MALLOC_H
 #include <malloc.h>
 #endif
+#if HAVE_MMAP
+#include <sys/mman.h>
+#endif
 
 /**
  * ===========================================================================
@@ -235,20 +238,99 @@ void xavs2_log(void *p, int i_log_level, const char *psz_fmt, ...)
     }
 }
 
-/* xavs2_malloc : will do or emulate a memalign
- * you have to use xavs2_free for buffers allocated with xavs2_malloc */
-void *xavs2_malloc(size_t i_size)
+/**
+ * ===========================================================================
+ * memory alloc
+ * ===========================================================================
+ */
+
+#define HUGE_PAGE_SIZE          (2 << 20)
+#define HUGE_PAGE_THRESHOLD     (HUGE_PAGE_SIZE * 7 / 8)  /* blocks smaller than this stay on normal pages */
+
+/* ---------------------------------------------------------------------------
+ * header stored right before every aligned buffer returned by xavs2_malloc()
+ */
+typedef struct mem_block_t {
+    void       *p_base;         /* address returned by the system allocator */
+    size_t      i_size;         /* size of the whole system block */
+    int         i_mode;         /* backend serving this block, see mem_alloc_mode_e */
+} mem_block_t;
+
+#define MEM_BLOCK_OFFSET        ((sizeof(mem_block_t) + CACHE_LINE_SIZE - 1) & ~(size_t)(CACHE_LINE_SIZE - 1))
+
+/* ---------------------------------------------------------------------------
+ * allocate a large block backed by 2MB pages, return NULL when the system
+ * could not provide huge pages so that the caller falls back to malloc
+ */
+static uint8_t *mem_alloc_huge(size_t i_size, int mode, mem_block_t *blk)
+{
+    size_t size_huge = (i_size + MEM_BLOCK_OFFSET + HUGE_PAGE_SIZE - 1) & ~(size_t)(HUGE_PAGE_SIZE - 1);
+    uint8_t *buf = NULL;
+
+#if HAVE_MMAP && defined(MAP_HUGETLB)
+    if (mode == XAVS2_MEM_HUGETLB) {
+        /* explicit hugetlb pages, requires pages reserved in /proc/sys/vm/nr_hugepages */
+        buf = (uint8_t *)mmap(NULL, size_huge, PROT_READ | PROT_WRITE,
+                              MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (buf != (uint8_t *)MAP_FAILED) {
+            blk->p_base = buf;
+            blk->i_size = size_huge;
+            blk->i_mode = XAVS2_MEM_HUGETLB;
+            return buf;
+        }
+        buf = NULL;
+    }
+#endif
+
+#if HAVE_THP
+    /* transparent huge pages: 2MB aligned block advised to the kernel */
+    if (posix_memalign((void **)&buf, HUGE_PAGE_SIZE, size_huge) == 0) {
+        madvise(buf, size_huge, MADV_HUGEPAGE);
+        blk->p_base = buf;
+        blk->i_size = size_huge;
+        blk->i_mode = XAVS2_MEM_THP;
+        return buf;
+    }
+    buf = NULL;
+#endif
+
+    UNUSED_PARAMETER(size_huge);
+    UNUSED_PARAMETER(mode);
+    UNUSED_PARAMETER(blk);
+    return buf;
+}
+
+/* ---------------------------------------------------------------------------
+ * xavs2_malloc_mode : xavs2_malloc() served by the given backend (see
+ * mem_alloc_mode_e), which is passed by the encoder owning the block.
+ * the block records its backend, xavs2_free() releases it accordingly
+ */
+void *xavs2_malloc_mode(size_t i_size, int mode)
 {
     intptr_t mask = CACHE_LINE_SIZE - 1;
     uint8_t *align_buf = NULL;
-    size_t size_malloc = i_size + mask + sizeof(void **);
-    uint8_t *buf = (uint8_t *)malloc(size_malloc);
+    uint8_t *buf = NULL;
+    mem_block_t blk;
+
+    if (mode != XAVS2_MEM_SYSTEM && i_size >= HUGE_PAGE_THRESHOLD) {
+        if ((buf = mem_alloc_huge(i_size, mode, &blk)) != NULL) {
+            align_buf = buf + MEM_BLOCK_OFFSET;
+        }
+    }
+
+    if (buf == NULL) {
+        blk.i_size = i_size + mask + MEM_BLOCK_OFFSET;
+        blk.i_mode = XAVS2_MEM_SYSTEM;
+        blk.p_base = buf = (uint8_t *)malloc(blk.i_size);
+        if (buf != NULL) {
+            align_buf = buf + mask + MEM_BLOCK_OFFSET;
+            align_buf -= (intptr_t)align_buf & mask;
+        }
+    }
 
     if (buf != NULL) {
-        g_xavs2_size_mem_alloc += size_malloc;
-        align_buf = buf + mask + sizeof(void **);
-        align_buf -= (intptr_t)align_buf & mask;
-        *(((void **)align_buf) - 1) = buf;
+        g_xavs2_size_mem_alloc += blk.i_size;
+        memcpy(align_buf - sizeof(mem_block_t), &blk, sizeof(mem_block_t));
     } else {
         fprintf(stderr, "malloc of size %zu failed\n", i_size);
     }
@@ -256,6 +338,13 @@ void *xavs2_malloc(size_t i_size)
     return align_buf;
 }
 
+/* xavs2_malloc : will do or emulate a memalign
+ * you have to use xavs2_free for buffers allocated with xavs2_malloc */
+void *xavs2_malloc(size_t i_size)
+{
+    return xavs2_malloc_mode(i_size, XAVS2_MEM_SYSTEM);
+}
+
 void *xavs2_calloc(size_t count, size_t size)
 {
     void *p = xavs2_malloc(count * size);
@@ -268,7 +357,15 @@ void *xavs2_calloc(size_t count, size_t size)
 void xavs2_free(void *ptr)
 {
     if (ptr != NULL) {
-        free(*(((void **)ptr) - 1));
+        mem_block_t blk;
+        memcpy(&blk, (uint8_t *)ptr - sizeof(mem_block_t), sizeof(mem_block_t));
+#if HAVE_MMAP && defined(MAP_HUGETLB)
+        if (blk.i_mode == XAVS2_MEM_HUGETLB) {
+            munmap(blk.p_base, blk.i_size);
+            return;
+        }
+#endif
+        free(blk.p_base);
     }
 }
 
@@ -114,6 +114,14 @@
     }\
     MULTI_LINE_MACRO_END
 
+#define CHECKED_MALLOC_MODE(var, type, size, mode) \
+    MULTI_LINE_MACRO_BEGIN\
+    (var) = (type)xavs2_malloc_mode(size, mode);\
+    if ((var) == NULL) {\
+        goto fail;\
+    }\
+    MULTI_LINE_MACRO_END
+
 #define CHECKED_MALLOCZERO(var, type, size) \
     MULTI_LINE_MACRO_BEGIN\
     size_t new_size = ((size + 31) >> 5) << 5; /* align the size to 32 bytes */ \
@@ -151,6 +159,16 @@ enum me_mothod_e {
 };
 
 
+/* ---------------------------------------------------------------------------
+ * memory allocation backends of xavs2_malloc()
+ */
+enum mem_alloc_mode_e {
+    XAVS2_MEM_SYSTEM  = 0,      /* aligned malloc (default) */
+    XAVS2_MEM_THP     = 1,      /* transparent huge pages (madvise) for large blocks */
+    XAVS2_MEM_HUGETLB = 2       /* explicit hugetlb pages for large blocks, fall back to THP */
+};
+
+
 /* ---------------------------------------------------------------------------
  * slice types
  */
@@ -298,7 +316,8 @@ enum xavs2_signal_e {
     SIG_FRM_DELIVERED         = 4,    /* one frame is outputted */
     SIG_FRM_BUFFER_RELEASED   = 5,    /* one frame buffer is available */
     SIG_ROW_CONTEXT_RELEASED  = 6,    /* one row context is released */
-    SIG_COUNT                 = 7
+    SIG_ENCODER_RESET         = 7,    /* all frames are finished before a reset */
+    SIG_COUNT                 = 8
 };
 
 
@@ -539,6 +558,7 @@ typedef struct xavs2_param_t {
 
     /* --- stream structure ------------------------------------- */
     int     intra_period;
+    int     intra_refresh;            /* number of frames of one gradual intra refresh cycle (0: disabled) */
     int     b_open_gop;               /* open GOP? 1: open, 0: close */
     int     enable_f_frame;           /* enable F-frame */
     int     successive_Bframe;        /* number of B frames that will be used */
@@ -552,7 +572,8 @@ typedef struct xavs2_param_t {
     int     fixed_picture_qp;         /* fixed picture qp */
 
     /* --- slice ------------------------------------------------ */
-    int     slice_num;                /* slice number */
+    int     slice_num;                /* slice number (max number of slices when b_slice_auto is set) */
+    int     b_slice_auto;             /* decide the slices of each frame by the AEC threads and the bitrate (slice_num = 0) */
 
     /* --- analysis options ------------------------------------- */
     int     enable_hadamard;          /* 0: 'normal' SAD in 1/4 pixel search.  1: use 4x4 Haphazard transform and
@@ -561,6 +582,8 @@ typedef struct xavs2_param_t {
     int     search_range;             /* search range - integer pel search and 16x16 blocks.  The search window is
                                        * generally around the predicted vector. Max vector is 2xmcrange.  For 8x8
                                        * and 4x4 block sizes the search range is 1/2 of that for 16x16 blocks. */
+    int     enable_hash_me;           /* search the exact block matches found in hash tables of the reference
+                                       * frames before the regular motion search (screen content) */
     int     num_max_ref;              /* 1: prediction from the last frame only. 2: prediction from the last or
                                        * second last frame etc.  Maximum 5 frames (number of reference frames) */
     int     inter_2pu;                /* enable inter 2NxN or Nx2N or AMP mode */
@@ -635,12 +658,37 @@ typedef struct xavs2_param_t {
     int     i_initial_qp;             /* initial QP */
     int     i_min_qp;                 /* min QP */
     int     i_max_qp;                 /* max QP */
+    int     enable_lookahead_stats;   /* estimate the complexity of frames in lookahead, see encoder_lookahead_stats() */
 
     /* --- parallel --------------------------------------------- */
     int     num_parallel_gop;         /* number of parallel GOP */
+    int     b_gop_continued;          /* a GOP of parallel encoding after the first one, which continues the sequence */
     int     i_frame_threads;          /* number of thread in frame   level parallel */
     int     i_lcurow_threads;         /* number of thread in LCU-row level parallel */
     int     enable_aec_thread;        /* enable AEC threadpool or not */
+    int     i_lf_threads;             /* number of threads of the in-loop filter stage (0: filtered by the row encoders) */
+    int     thread_affinity;          /* pinning of worker threads: 0: none, 1: compact, 2: scatter */
+    char    psz_affinity_cpus[AFFINITY_CPUS_LEN];  /* CPUs worker threads are pinned to in turn, overrides thread_affinity */
+
+    /* --- segment encoding ------------------------------------- */
+    int     b_segment;                /* segment (chunk) encoding, bitstreams of consecutive segments can be concatenated */
+    int     segment_start_frame;      /* index of the first frame of this segment in the whole video (COI offset) */
+    int     b_segment_last;           /* is this the last segment (the sequence end code is written) */
+    int     segment_rc_qp;            /* base QP handed over from the rate control of previous segment (0: none) */
+    int     segment_rc_buffer;        /* buffer error (bits) handed over from the rate control of previous segment */
+    int     segment_refs;             /* frames of previous segment still referenced, bit (k-1) for COI (segment_start_frame - k) */
+
+    /* --- ladder encoding -------------------------------------- */
+    int     num_ladder;               /* number of lower renditions encoded with the analysis of this one (0: disabled) */
+    int     i_rendition;              /* index of the rendition, 0 for the top one */
+    int     ladder_width  [MAX_LADDER_RENDITIONS];  /* image width  of each rendition, [0] is the top one */
+    int     ladder_height [MAX_LADDER_RENDITIONS];  /* image height of each rendition, [0] is the top one */
+    int     ladder_bitrate[MAX_LADDER_RENDITIONS];  /* target bitrate of each lower rendition (0: scaled by area) */
+
+    /* --- memory ----------------------------------------------- */
+    int     mem_alloc_mode;           /* memory allocation backend, see mem_alloc_mode_e */
+    int     enable_frame_pool;        /* allocate all reference frames from one pooled arena */
+    int     mem_budget;               /* memory budget in MB, fewer threads are used to fit in (0: unlimited) */
 
     /* --- log -------------------------------------------------- */
     int     i_log_level;              /* log level */
@@ -718,7 +766,7 @@ struct aec_t {
     /* bitstream */
     uint8_t    *p;                    /* pointer to byte written currently */
     uint8_t    *p_end;                /* end of actual buffer for written bytes */
-    uint32_t    reg_flush_bits;       /* register: flushing bits (not written into byte buffer) */
+    uint64_t    reg_flush_bits;       /* register: flushing bits (not written into byte buffer) */
     uint32_t    num_left_flush_bits;  /* number of bits in \ref{reg_flush_bits} could be used */
 
     /* AEC codec */
@@ -744,7 +792,7 @@ struct aec_t {
 typedef struct slice_t {
     bs_t        bs;                   /* bitstream controller */
 
-    /* bitstream buffer */
+    /* bitstream buffer, allocated separately and enlarged when running short of space */
     int         len_slice_bs_buf;     /* length  of bitstream buffer */
     uint8_t    *p_slice_bs_buf;       /* pointer of bitstream buffer (start address) */
 
@@ -752,6 +800,8 @@ typedef struct slice_t {
     pel_t      *slice_intra_border[3];    /* buffer for store decoded bottom pixels of the top lcu row (before filter) */
     uint8_t    *slice_deblock_flag[2];    /* buffer for edge filter flag (of one LCU row), [dir][(scu_y, scu_x)] */
     int8_t     *slice_ipredmode;          /* [(i_height_in_minpu + 1) * (i_width_in_minpu + 16)], prediction intra mode */
+    runlevel_t  run_level_write;          /* run-level buffer for encoding, slices may be entropy coded in parallel */
+    xavs2_t    *h;                        /* frame context the slice belongs to */
 
     /* slice properties */
     int         i_first_lcu_xy;       /* first LCU index (in scan order) */
@@ -762,6 +812,7 @@ typedef struct slice_t {
     int         i_first_scu_y;        /* first SCU position y in this slice */
     int         i_qp;                 /* slice qp */
     int         index_slice;          /* index of current Slice */
+    int         i_header_bits;        /* number of bits of the slice header (byte aligned) */
 } slice_t;
 
 
@@ -984,7 +1035,7 @@ typedef struct complex_t {
     int         i_sum_intras;         /* number of intra blocks in frame */
     int         i_sum_blocks;         /* number of total blocks in frame */
     int         i_slice_type;         /* slice type of frame, or -1 for uncertain */
-    int         b_valid;              /* indicates whether complexity estimation has conducted */
+    int         b_valid;              /* indicates whether complexity estimation has been conducted */
 } complex_t;
 
 #if XAVS2_ADAPT_LAYER
@@ -1028,6 +1079,8 @@ struct xavs2_frame_t {
     int         i_frm_coi;            /* COI (coding  order index) */
     int         i_frm_poc;            /* POC (picture order count), used for MV scaling */
     int         i_gop_idr_coi;        /* COI of IDR frame in this gop */
+    int         i_refresh_cycle;      /* index of the gradual intra refresh cycle */
+    int         i_refresh_rows;       /* number of luma rows refreshed so far in this cycle */
     int         ref_dpoc[MAX_REFS];   /* POC difference of its reference frames */
     int         ref_dpoc_multi[MAX_REFS];   /* MULTI / ref_dpoc[x] */
 
@@ -1054,6 +1107,7 @@ struct xavs2_frame_t {
 
     /* bit stream buffer */
     uint8_t    *p_bs_buf;             /* bit stream buffer for encoding this frame */
+    uint8_t    *p_bs_buf_ext;         /* enlarged bit stream buffer, used when the preallocated one is too small */
     int         i_bs_buf;             /* length of bit stream buffer */
     int         i_bs_len;             /* length of bit stream data */
 
@@ -1062,17 +1116,25 @@ struct xavs2_frame_t {
     /* encoding parameters */
     int8_t     *pu_ref;               /* pu reference index (store in 16x16 block) */
     mv_t       *pu_mv;                /* pu motion vector   (store in 16x16 block) */
+    uint32_t   *hash_key;             /* hash keys of the 8x8 luma blocks at all positions (hash-based ME) */
+    int32_t    *hash_next;            /* next position in the same bucket, -1 for the end of the bucket */
+    int32_t    *hash_head;            /* [i_height_in_lcu][1 << HASH_ME_TABLE_BITS], first position of the buckets */
 #if SAVE_CU_INFO
     int8_t     *cu_mode;              /* cu type        (store in SCU) */
     int8_t     *cu_cbp;               /* cu cbp         (store in SCU) */
     int8_t     *cu_level;             /* cu size in bit (store in SCU) */
 #endif
+    float      *tdrdo_ratio;          /* lambda ratio of 64x64 blocks, decided by TDRDO in lookahead */
+    int         b_tdrdo_ratio;        /* are the lambda ratios of TDRDO available? */
+    complex_t   frm_complex;          /* complexity estimated on the lowres frame in lookahead */
 
     int         num_lcu_sao_off[NUM_SAO_COMPONENTS];
+    int8_t     *sao_mode;             /* [i_height_in_lcu][i_width_in_lcu][NUM_SAO_COMPONENTS], SAO modes chosen */
 
     /* */
     int         removed;              /* none zero : can not be used as reference frame */
     uint32_t    cnt_refered;          /* reference count for FT_DEC */
+    int         idx_in_buf;           /* index in the frame buffer, bit of its idle mask */
 
     int        *num_lcu_coded_in_row; /* 0, not ready, 1, ready */
 
@@ -1263,8 +1325,12 @@ typedef struct row_info_t {
     int             b_top_slice_border;   /* whether top  slice border should be processed */
     int             b_down_slice_border;  /* whether down slice border should be processed */
     volatile int    coded;            /* position of latest coded LCU. [0, xavs2_t::i_width_in_lcu) */
+    volatile int    filtered;         /* position of latest in-loop filtered LCU (filter stage only) */
+    int             i_aec_bits;       /* number of bits of the row written by AEC */
+    int64_t         i_time_cost;      /* time (us) of coding the LCUs of the row, waiting excluded */
 
     xavs2_t         *h;               /* context for the row */
+    xavs2_t         *h_frame;         /* frame context of the row, for the filter stage */
     lcu_info_t      *lcus;            /* [LCUs] */
 
     xavs2_thread_cond_t  cond;       /* lcu cond */
@@ -1356,13 +1422,14 @@ typedef struct cu_layer_t {
 #define FDEC_BUF_SIZE  (FDEC_STRIDE * (MAX_CU_SIZE + MAX_CU_SIZE / 2))
 #define LCU_BUF_SIZE   (MAX_CU_SIZE * MAX_CU_SIZE)
 
-    ALIGN32(pel_t   rec_buf_y     [3][LCU_BUF_SIZE]);       /* luma   reconstruction buffer     [cur/tmp/best][] */
-    ALIGN32(coeff_t coef_buf_y    [3][LCU_BUF_SIZE]);       /* luma   coefficient    buffer     [cur/tmp/best][] */
-    ALIGN32(pel_t   rec_buf_uv [2][3][LCU_BUF_SIZE >> 2]);  /* chroma reconstruction buffer [uv][cur/tmp/best][] */
-    ALIGN32(coeff_t coef_buf_uv[2][3][LCU_BUF_SIZE >> 2]);  /* chroma coefficient    buffer [uv][cur/tmp/best][] */
+    /* buffers below are sized for the CU size of this layer (see encoder_get_lcu_buffer_size()) */
+    pel_t   *rec_buf_y     [3];     /* luma   reconstruction buffer     [cur/tmp/best][] */
+    coeff_t *coef_buf_y    [3];     /* luma   coefficient    buffer     [cur/tmp/best][] */
+    pel_t   *rec_buf_uv [2][3];     /* chroma reconstruction buffer [uv][cur/tmp/best][] */
+    coeff_t *coef_buf_uv[2][3];     /* chroma coefficient    buffer [uv][cur/tmp/best][] */
 
     /* inter prediction buffer */
-    ALIGN32(pel_t   buf_pred_inter_luma[2][LCU_BUF_SIZE]);  /* temporary decoding buffer for inter prediction (luma) */
+    pel_t   *buf_pred_inter_luma[2];/* temporary decoding buffer for inter prediction (luma) */
     /* Ping-pong buffer for inter prediction */
     pel_t   *buf_pred_inter;        /* current inter prediction buffer */
     pel_t   *buf_pred_inter_best;   /* backup of best inter prediction */
@@ -1380,9 +1447,9 @@ typedef struct cu_parallel_t {
     ALIGN32(pel_t   buf_pred_inter_c[LCU_BUF_SIZE >> 1]);   /* temporary decoding buffer for inter prediction (chroma) */
     ALIGN32(pel_t   buf_pixel_temp  [LCU_BUF_SIZE]);        /* temporary pixel buffer, used for bi/dual-prediction */
 
-    /* predication buffers for all intra modes */
-    ALIGN32(pel_t   intra_pred  [NUM_INTRA_MODE       ][LCU_BUF_SIZE]);         /* for all 33 luma prediction modes */
-    ALIGN32(pel_t   intra_pred_c[NUM_INTRA_MODE_CHROMA][LCU_BUF_SIZE >> 1]);    /* for all chroma intra prediction modes */
+    /* predication buffers for all intra modes, sized for the LCU size */
+    pel_t   *intra_pred  [NUM_INTRA_MODE       ];   /* for all 33 luma prediction modes */
+    pel_t   *intra_pred_c[NUM_INTRA_MODE_CHROMA];   /* for all chroma intra prediction modes */
     ALIGN32(pel_t   buf_edge_pixels[MAX_CU_SIZE << 3]);     /* reference pixels for intra luma/chroma prediction */
 
     runlevel_t       runlevel;         /* run level buffer for RDO */
@@ -1512,11 +1579,16 @@ struct xavs2_t {
     int             i_ref;            /* current number of reference frames */
     xavs2_frame_t  *fref[MAX_REFS];   /* reference frame list */
     mct_t          *img4Y_tmp[3];     /* temporary buffer for 1/4 interpolation: a,1,b */
-    xavs2_frame_t  *img_luma_pre;     /* buffer used for TDRDO, only luma */
+    const ladder_hint_t *ladder_hint; /* analysis of the top rendition for current frame (ladder encoding) */
+    int             i_refresh_row_start;  /* first LCU row of the intra refresh band */
+    int             i_refresh_row_end;    /* LCU row next to the intra refresh band */
+    int             refresh_ref_bottom[MAX_REFS]; /* refreshed luma rows usable in each reference frame */
 
     /* slices */
     slice_t    *slices[MAX_SLICES];   /* all slices */
+    int         i_slice_num;          /* number of slices in current frame */
     int         i_slice_index;        /* slice index for the current thread */
+    slice_row_index_t *lcu_row_order; /* [i_height_in_lcu], coding order of LCU rows in current frame */
 
     /* ͬSliceͬbuffer */
     pel_t      *intra_border[3];      /* buffer for store decoded bottom pixels of the top lcu row (before filter) */
@@ -1556,6 +1628,16 @@ struct xavs2_t {
 
     cu_info_t  *cu_info;              /* pointer to buffer of all SCUs in frame */
 
+    /* per-SCU planes of the CU data read by neighbor checks and deblocking,
+     * so that these lookups touch one byte per SCU instead of a cu_info_t */
+    int8_t     *scu_level;            /* [i_height_in_mincu][i_width_in_mincu], CU level */
+    int8_t     *scu_mode;             /* [i_height_in_mincu][i_width_in_mincu], CU type */
+    int8_t     *scu_cbp;              /* [i_height_in_mincu][i_width_in_mincu], CBP */
+    int8_t     *scu_tu_split;         /* [i_height_in_mincu][i_width_in_mincu], TU split type */
+#if ENABLE_RATE_CONTROL_CU
+    int8_t     *scu_qp;               /* [i_height_in_mincu][i_width_in_mincu], CU QP */
+#endif
+
     SYNC_VARS_2(row_vars_2);
     /* === END ===================================================== */
 
@@ -1566,9 +1648,8 @@ struct xavs2_t {
 
     bs_t        header_bs;            /* bitstream controller for main thread */
     uint8_t    *p_bs_buf_header;      /* pointer to bitstream buffer for headers */
-    uint8_t    *p_bs_buf_slice;       /* pointer to bitstream buffer for slices */
     int         i_bs_buf_header;      /* size    of bitstream buffer for headers */
-    int         i_bs_buf_slice;       /* size    of bitstream buffer for slices */
+    int         i_bs_buf_slice;       /* size    of bitstream buffers of all slices (grows on demand) */
 
     xavs2_me_t  me_state;             /* used for motion estimation */
 
@@ -1633,9 +1714,6 @@ struct xavs2_t {
         /* buffer for the coding tree units */
         ALIGN16(cu_t    all_cu[85]);                /* all cu: 1(64x64) + 4(32x32) + 16(16x16) + 64(8x8) = 85 */
         ALIGN16(cu_t   *p_cu_l[4][8][8]);           /* all CU pointers */
-
-        /* only used for AEC */
-        runlevel_t      run_level_write;            /* run-level buffer for encoding */
     } lcu;
 
     /* coding states in RDO, independent for each thread */
@@ -1695,6 +1773,8 @@ void xavs2_log(void *p, int i_log_level, const char *psz_fmt, ...);
  * you have to use xavs2_free for buffers allocated with xavs2_malloc */
 #define xavs2_malloc FPFX(malloc)
 void *xavs2_malloc(size_t i_size);
+#define xavs2_malloc_mode FPFX(malloc_mode)
+void *xavs2_malloc_mode(size_t i_size, int mode);
 #define xavs2_calloc FPFX(calloc)
 void *xavs2_calloc(size_t count, size_t size);
 #define xavs2_free FPFX(free)
@@ -99,6 +99,39 @@ static ALWAYS_INLINE int cu_get_qp(xavs2_t *h, cu_info_t *p_cu_info)
 #endif
 }
 
+/* ---------------------------------------------------------------------------
+ * accessors of the per-SCU planes of coded CU data in current frame
+ */
+static ALWAYS_INLINE int cu_get_scu_level(xavs2_t *h, int scu_xy)
+{
+    return h->scu_level[scu_xy];
+}
+
+static ALWAYS_INLINE int cu_get_scu_mode(xavs2_t *h, int scu_xy)
+{
+    return h->scu_mode[scu_xy];
+}
+
+static ALWAYS_INLINE int cu_get_scu_cbp(xavs2_t *h, int scu_xy)
+{
+    return h->scu_cbp[scu_xy];
+}
+
+static ALWAYS_INLINE int cu_get_scu_tu_split(xavs2_t *h, int scu_xy)
+{
+    return h->scu_tu_split[scu_xy];
+}
+
+static ALWAYS_INLINE int cu_get_scu_qp(xavs2_t *h, int scu_xy)
+{
+#if ENABLE_RATE_CONTROL_CU
+    return h->scu_qp[scu_xy];
+#else
+    UNUSED_PARAMETER(scu_xy);
+    return h->i_qp;
+#endif
+}
+
 
 /* ---------------------------------------------------------------------------
  * 
@@ -117,6 +117,7 @@ enum xavs2_fast_algorithms_e {
     OPT_FAST_SAO             ,        /* SAO㷨ڶB֡֡οSAO */
     OPT_SUBCU_SPLIT          ,        /* ݻӿĿ߸ǷԷSKIPģʽRDO */
     OPT_PU_RMS               ,        /* رС飨8x8,16x16)ֵԤⵥԪ2Nx2N֡ڣ֡ԼSKIPģʽ*/
+    OPT_ET_SAO               ,        /* SAO decision with early termination: off for LCUs without residual, modes tried from the co-located one of the reference and pruned by their bound of distortion reduction */
     NUM_FAST_ALGS                     /* ܵĿ㷨 */
 };
 
@@ -209,6 +210,13 @@ enum xavs2_fast_algorithms_e {
 #define B64X64_IN_BIT           6     /* unit level: 6 */
 
 
+/* ---------------------------------------------------------------------------
+ * hash-based motion search
+ */
+#define HASH_ME_BLOCK           8     /* size of the hashed blocks */
+#define HASH_ME_TABLE_BITS      14    /* number of buckets in the hash table of one LCU row (in bit) */
+
+
 /* ---------------------------------------------------------------------------
  * parameters for scale mv
  */
@@ -301,6 +309,8 @@ enum xavs2_fast_algorithms_e {
 #define MAX_REFS     XAVS2_MAX_REFS   /* max number of reference frames */
 #define MAX_SLICES                8   /* max number of slices in one picture */
 #define MAX_PARALLEL_FRAMES       8   /* max number of parallel encoding frames */
+#define MAX_PARALLEL_GOPS         8   /* max number of closed GOPs encoded in parallel */
+#define MAX_LADDER_RENDITIONS (XAVS2_MAX_LADDER + 1)  /* max number of renditions in ladder encoding, the top one included */
 #define MAX_COI_VALUE   ((1<<8) - 1)  /* max COI value (unsigned char) */
 #define PIXEL_MAX ((1<<BIT_DEPTH)-1)  /* max value of a pixel */
 
@@ -316,6 +326,11 @@ enum xavs2_fast_algorithms_e {
  * reserved memory space for check pseudo code */
 #define PSEUDO_CODE_SIZE        1024  /* size of reserved memory space */
 
+/* ---------------------------------------------------------------------------
+ * free space kept in a slice bitstream buffer before writing one LCU:
+ * 4 bytes for each luma/chroma sample (4:2:0) of the LCU */
+#define LCU_BS_RESERVE(lcu_level)   (6 << ((lcu_level) << 1))
+
 /* ---------------------------------------------------------------------------
  * transform
  */
@@ -354,6 +369,7 @@ enum frame_alloc_type_e {
  * flag
  */
 #define XAVS2_EXIT_THREAD     (-1)  /* flag to terminate thread */
+#define XAVS2_RESET           (-2)  /* flag to finish all frames before the encoder is reset */
 
 
 
@@ -375,4 +391,7 @@ enum frame_alloc_type_e {
 /* qp */
 #define XAVS2_QP_AUTO          0     /* get qp automatically */
 
+/* thread affinity */
+#define AFFINITY_CPUS_LEN    128     /* max length of the CPU list worker threads are pinned to */
+
 #endif /* #if XAVS2_DEFINES_H */
@@ -151,12 +151,12 @@ static void lf_set_edge_filter_param(xavs2_t *h, int i_level, int scu_x, int scu
 static
 void lf_lcu_set_edge_filter(xavs2_t *h, int i_level, int scu_x, int scu_y, int scu_xy)
 {
-    cu_info_t *p_cu_info = &h->cu_info[scu_xy];
+    int cu_level = cu_get_scu_level(h, scu_xy);
     int i;
 
-    assert(p_cu_info->i_level >= MIN_CU_SIZE_IN_BIT);
+    assert(cu_level >= MIN_CU_SIZE_IN_BIT);
 
-    if (p_cu_info->i_level < i_level) {
+    if (cu_level < i_level) {
         const int w_in_scu = h->i_width_in_mincu;
         const int h_in_scu = h->i_height_in_mincu;
         // 4 sub-cu
@@ -178,10 +178,12 @@ void lf_lcu_set_edge_filter(xavs2_t *h, int i_level, int scu_x, int scu_y, int s
         lf_set_edge_filter_param(h, i_level, scu_x, scu_y, EDGE_HOR, EDGE_TYPE_BOTH);  // top  edge
 
         // set other edge filter parameters
-        if (p_cu_info->i_level > MIN_CU_SIZE_IN_BIT) {
+        if (cu_level > MIN_CU_SIZE_IN_BIT) {
+            int cu_mode = cu_get_scu_mode(h, scu_xy);
+
             /* set prediction boundary */
             i = i_level - MIN_CU_SIZE_IN_BIT - 1;
-            switch (p_cu_info->i_mode) {
+            switch (cu_mode) {
                 case PRED_2NxN:
                     lf_set_edge_filter_param(h, i_level, scu_x, scu_y + (1 << i), EDGE_HOR, EDGE_TYPE_BOTH);
                     break;
@@ -236,17 +238,17 @@ void lf_lcu_set_edge_filter(xavs2_t *h, int i_level, int scu_x, int scu_y, int s
             }
 
             /* set transform block boundary */
-            if (p_cu_info->i_mode != PRED_I_NxN && p_cu_info->i_tu_split && p_cu_info->i_cbp != 0) {
-                if (h->param->enable_nsqt && IS_HOR_PU_PART(p_cu_info->i_mode)) {
-                    if (p_cu_info->i_level == B16X16_IN_BIT) {
+            if (cu_mode != PRED_I_NxN && cu_get_scu_tu_split(h, scu_xy) && cu_get_scu_cbp(h, scu_xy) != 0) {
+                if (h->param->enable_nsqt && IS_HOR_PU_PART(cu_mode)) {
+                    if (cu_level == B16X16_IN_BIT) {
                         lf_set_edge_filter_param(h, i_level, scu_x, scu_y + (1 << (i    )),                  EDGE_HOR, EDGE_TYPE_ONLY_LUMA);
                     } else {
                         lf_set_edge_filter_param(h, i_level, scu_x, scu_y + (1 << (i - 1)),                  EDGE_HOR, EDGE_TYPE_ONLY_LUMA);
                         lf_set_edge_filter_param(h, i_level, scu_x, scu_y + (1 << (i    )),                  EDGE_HOR, EDGE_TYPE_ONLY_LUMA);
                         lf_set_edge_filter_param(h, i_level, scu_x, scu_y + (1 << (i    )) + (1 << (i - 1)), EDGE_HOR, EDGE_TYPE_ONLY_LUMA);
                     }
-                } else if (h->param->enable_nsqt && IS_VER_PU_PART(p_cu_info->i_mode)) {
-                    if (p_cu_info->i_level == B16X16_IN_BIT) {
+                } else if (h->param->enable_nsqt && IS_VER_PU_PART(cu_mode)) {
+                    if (cu_level == B16X16_IN_BIT) {
                         lf_set_edge_filter_param(h, i_level, scu_x + (1 << (i    )),                  scu_y, EDGE_VER, EDGE_TYPE_ONLY_LUMA);
                     } else {
                         lf_set_edge_filter_param(h, i_level, scu_x + (1 << (i - 1)),                  scu_y, EDGE_VER, EDGE_TYPE_ONLY_LUMA);
@@ -266,9 +268,10 @@ void lf_lcu_set_edge_filter(xavs2_t *h, int i_level, int scu_x, int scu_y, int s
  * Return 1 if skip filtering is needed
  */
 static INLINE
-uint8_t lf_skip_filter(xavs2_t *h, cu_info_t *MbP, cu_info_t *MbQ, int dir, int block_x, int block_y)
+uint8_t lf_skip_filter(xavs2_t *h, int scu_p, int scu_q, int dir, int block_x, int block_y)
 {
-    if (h->i_type == SLICE_TYPE_P || h->i_type == SLICE_TYPE_F) {
+    if ((h->i_type == SLICE_TYPE_P || h->i_type == SLICE_TYPE_F) &&
+        cu_get_scu_cbp(h, scu_p) == 0 && cu_get_scu_cbp(h, scu_q) == 0) {
         const mv_t *p_mv_buf = h->fwd_1st_mv;
         const int8_t *p_ref_buf = h->fwd_1st_ref;
         int w_in_4x4 = h->i_width_in_minpu;
@@ -277,8 +280,7 @@ uint8_t lf_skip_filter(xavs2_t *h, cu_info_t *MbP, cu_info_t *MbQ, int dir, int
         int pos1 = block_y  * w_in_4x4 + block_x;
         int pos2 = block_y2 * w_in_4x4 + block_x2;
 
-        if ((MbP->i_cbp == 0) && (MbQ->i_cbp == 0) &&
-            (XAVS2_ABS(p_mv_buf[pos1].x - p_mv_buf[pos2].x) < 4) &&
+        if ((XAVS2_ABS(p_mv_buf[pos1].x - p_mv_buf[pos2].x) < 4) &&
             (XAVS2_ABS(p_mv_buf[pos1].y - p_mv_buf[pos2].y) < 4) &&
             (p_ref_buf[pos1] != INVALID_REF && p_ref_buf[pos1] == p_ref_buf[pos2])) {
             return 0;
@@ -414,20 +416,20 @@ static
 void lf_scu_deblock(xavs2_t *h, pel_t *p_rec[3], int i_stride, int i_stride_c, int scu_x, int scu_y, int dir)
 {
     static const int max_qp_deblock = 63;
-    cu_info_t *MbQ = &h->cu_info[scu_y * h->i_width_in_mincu + scu_x];  /* current SCU */
+    int scu_q = scu_y * h->i_width_in_mincu + scu_x;                     /* current SCU */
     int edge_type = h->p_deblock_flag[dir][(scu_y - h->lcu.i_scu_y) * h->i_width_in_mincu + scu_x];
 
     if (edge_type != EDGE_TYPE_NOFILTER) {
         pel_t *src_y = p_rec[0] + (scu_y << MIN_CU_SIZE_IN_BIT) * i_stride + (scu_x << MIN_CU_SIZE_IN_BIT);
-        cu_info_t *MbP = dir ? (MbQ - h->i_width_in_mincu) : (MbQ - 1); /* MbP = Mb of the remote 4x4 block */
-        int QP = (cu_get_qp(h, MbP) + cu_get_qp(h, MbQ) + 1) >> 1;                /* average QP of the two blocks */
+        int scu_p = dir ? (scu_q - h->i_width_in_mincu) : (scu_q - 1); /* MbP = Mb of the remote 4x4 block */
+        int QP = (cu_get_scu_qp(h, scu_p) + cu_get_scu_qp(h, scu_q) + 1) >> 1;   /* average QP of the two blocks */
         int shift = h->param->sample_bit_depth - 8;
         int offset = shift << 3;  /* coded as 10/12 bit, QP is added by (8 * (h->param->sample_bit_depth - 8)) in config file */
         int alpha, beta;
         uint8_t b_filter_edge[2];
 
-        b_filter_edge[0] = lf_skip_filter(h, MbP, MbQ, dir, (scu_x << 1), (scu_y << 1));
-        b_filter_edge[1] = lf_skip_filter(h, MbP, MbQ, dir, (scu_x << 1) + dir, (scu_y << 1) + !dir);
+        b_filter_edge[0] = lf_skip_filter(h, scu_p, scu_q, dir, (scu_x << 1), (scu_y << 1));
+        b_filter_edge[1] = lf_skip_filter(h, scu_p, scu_q, dir, (scu_x << 1) + dir, (scu_y << 1) + !dir);
 
         if (b_filter_edge[0] == 0 && b_filter_edge[1] == 0) {
             return;
@@ -459,12 +461,12 @@ static void lf_scu_deblock_flag_fix_qp(xavs2_t *h, int scu_x, int scu_y, int dir
 {
     const int scu_xy = scu_y * h->i_width_in_mincu + scu_x;
 
-    cu_info_t *scuQ = &h->cu_info[scu_xy];  /* current SCU */
+    int scuQ = scu_xy;  /* current SCU */
     int edge_condition = h->p_deblock_flag[dir][(scu_y - h->lcu.i_scu_y) * h->i_width_in_mincu + scu_x];
 
     /* deblock edges */
     if (edge_condition != EDGE_TYPE_NOFILTER) {
-        cu_info_t *scuP = dir ? (scuQ - h->i_width_in_mincu) : (scuQ - 1); /* MbP = Mb of the remote 4x4 block */
+        int scuP = dir ? (scuQ - h->i_width_in_mincu) : (scuQ - 1); /* MbP = Mb of the remote 4x4 block */
         //luma
         b_filter_flag[0] = lf_skip_filter(h, scuP, scuQ, dir, (scu_x << 1), (scu_y << 1));
         b_filter_flag[1] = lf_skip_filter(h, scuP, scuQ, dir, (scu_x << 1) + dir, (scu_y << 1) + !dir);
@@ -101,10 +101,14 @@ size_t xavs2_frame_buffer_size(const xavs2_param_t *param, int alloc_type)
     int bs_size  = 0;           /* reuse the YUV plane space */
     int cmp_size = 0;           /* size of frame complexity buffer */
     int cmp_buf_size = 0;       /* complexity buffer size */
+    int tdrdo_size   = 0;       /* size of TDRDO lambda ratios */
 #if SAVE_CU_INFO
     int frame_size_in_mincu = 0;
 #endif
     int frame_size_in_mvstore = 0;  /* reference information size */
+    int frame_size_in_lcu     = 0;  /* size of the per-LCU SAO modes */
+    int hash_pos_size         = 0;  /* number of positions in the hash tables of ME */
+    int hash_head_size        = 0;  /* number of buckets in the hash tables of ME */
 
     /* compute stride and the plane size */
     switch (alloc_type) {
@@ -118,9 +122,16 @@ size_t xavs2_frame_buffer_size(const xavs2_param_t *param, int alloc_type)
         frame_size_in_mincu = (img_w_l >> MIN_CU_SIZE_IN_BIT) * (img_h_l >> MIN_CU_SIZE_IN_BIT);
 #endif
         frame_size_in_mvstore = (((img_w_l >> MIN_PU_SIZE_IN_BIT) + 3) >> 2) * (((img_h_l >> MIN_PU_SIZE_IN_BIT) + 3) >> 2);
+        frame_size_in_lcu     = ((img_w_l + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level) *
+                                ((img_h_l + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level);
+        if (param->enable_hash_me) {
+            hash_pos_size     = img_w_l * img_h_l;
+            hash_head_size    = ((img_h_l + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level) << HASH_ME_TABLE_BITS;
+        }
         planes_size = size_l + size_c * 2;
 #if ENABLE_FRAME_SUBPEL_INTPL
-        planes_size += size_l * 15;
+        /* interpolated planes, same as 'use_fractional_me' in encoder_set_fast_algorithms() */
+        planes_size += size_l * (param->preset_level < 2 ? 3 : 15);
 #endif
         break;
     case FT_TEMP:
@@ -145,12 +156,16 @@ size_t xavs2_frame_buffer_size(const xavs2_param_t *param, int alloc_type)
 #endif
         bs_size         = size_l * sizeof(uint8_t);    /* let the PSNR compute correctly */
     }
+    if (alloc_type == FT_ENC && param->enable_tdrdo) {
+        tdrdo_size      = ((img_w_l + 63) >> 6) * ((img_h_l + 63) >> 6) * sizeof(float);
+    }
 
     /* compute space size and alloc memory */
     mem_size = sizeof(xavs2_frame_t)                + /* M0, size of frame handle */
         i_nal_info_size                             + /* M1, size of nal_info buffer */
         cmp_size + cmp_buf_size                     + /* M2, size of frame complexity buffer */
         bs_size                                     + /* M3, size of bitstream buffer */
+        tdrdo_size                                  + /* M3, size of TDRDO lambda ratios */
         planes_size * sizeof(pel_t)                 + /* M4, size of planes buffer: Y+U+V */
         frame_size_in_mvstore * sizeof(int8_t)      + /* M5, size of pu reference index buffer */
         frame_size_in_mvstore * sizeof(mv_t)        + /* M6, size of pu motion vector buffer */
@@ -158,6 +173,9 @@ size_t xavs2_frame_buffer_size(const xavs2_param_t *param, int alloc_type)
         frame_size_in_mincu * sizeof(int8_t) * 3    + /* M7, size of cu mode/cbp/level buffers */
 #endif
         (img_h_l >> MIN_CU_SIZE_IN_BIT) * sizeof(int)+ /* M8, line status array */
+        frame_size_in_lcu * NUM_SAO_COMPONENTS      + /* M9, SAO modes of LCUs */
+        hash_pos_size * (sizeof(uint32_t) + sizeof(int32_t)) + /* M10, hash keys and bucket links of ME */
+        hash_head_size * sizeof(int32_t)            + /* M11, hash buckets of ME */
         CACHE_LINE_SIZE * 10;
 
     /* align to CACHE_LINE_SIZE */
@@ -185,10 +203,14 @@ xavs2_frame_t *xavs2_frame_new(xavs2_t *h, uint8_t **mem_base, int alloc_type)
     int bs_size  = 0;           /* reuse the YUV plane space */
     int cmp_size = 0;           /* size of frame complexity buffer */
     int cmp_buf_size = 0;       /* complexity buffer size */
+    int tdrdo_size   = 0;       /* size of TDRDO lambda ratios */
 #if SAVE_CU_INFO
     int frame_size_in_mincu = 0;
 #endif
     int frame_size_in_mvstore = 0;  /* reference information size */
+    int frame_size_in_lcu     = 0;  /* size of the per-LCU SAO modes */
+    int hash_pos_size         = 0;  /* number of positions in the hash tables of ME */
+    int hash_head_size        = 0;  /* number of buckets in the hash tables of ME */
     uint8_t *mem_ptr;
 
     /* compute stride and the plane size */
@@ -203,6 +225,11 @@ xavs2_frame_t *xavs2_frame_new(xavs2_t *h, uint8_t **mem_base, int alloc_type)
         frame_size_in_mincu = h->i_width_in_mincu * h->i_height_in_mincu;
 #endif
         frame_size_in_mvstore = ((h->i_width_in_minpu + 3) >> 2) * ((h->i_height_in_minpu + 3) >> 2);
+        frame_size_in_lcu     = h->i_width_in_lcu * h->i_height_in_lcu;
+        if (h->param->enable_hash_me) {
+            hash_pos_size     = img_w_l * img_h_l;
+            hash_head_size    = h->i_height_in_lcu << HASH_ME_TABLE_BITS;
+        }
         planes_size = size_l + size_c * 2;
 #if ENABLE_FRAME_SUBPEL_INTPL
         if (h->use_fractional_me == 1) {
@@ -234,12 +261,16 @@ xavs2_frame_t *xavs2_frame_new(xavs2_t *h, uint8_t **mem_base, int alloc_type)
 #endif
         bs_size         = size_l * sizeof(uint8_t);    /* let the PSNR compute correctly */
     }
+    if (alloc_type == FT_ENC && h->param->enable_tdrdo) {
+        tdrdo_size      = ((img_w_l + 63) >> 6) * ((img_h_l + 63) >> 6) * sizeof(float);
+    }
 
     /* compute space size and alloc memory */
     mem_size = sizeof(xavs2_frame_t)                + /* M0, size of frame handle */
         i_nal_info_size                             + /* M1, size of nal_info buffer */
         cmp_size + cmp_buf_size                     + /* M2, size of frame complexity buffer */
         bs_size                                     + /* M3, size of bitstream buffer */
+        tdrdo_size                                  + /* M3, size of TDRDO lambda ratios */
         planes_size * sizeof(pel_t)                 + /* M4, size of planes buffer: Y+U+V */
         frame_size_in_mvstore * sizeof(int8_t)      + /* M5, size of pu reference index buffer */
         frame_size_in_mvstore * sizeof(mv_t)        + /* M6, size of pu motion vector buffer */
@@ -247,13 +278,16 @@ xavs2_frame_t *xavs2_frame_new(xavs2_t *h, uint8_t **mem_base, int alloc_type)
         frame_size_in_mincu * sizeof(int8_t) * 3    + /* M7, size of cu mode/cbp/level buffers */
 #endif
         h->i_height_in_lcu * sizeof(int)            + /* M8, line status array */
+        frame_size_in_lcu * NUM_SAO_COMPONENTS      + /* M9, SAO modes of LCUs */
+        hash_pos_size * (sizeof(uint32_t) + sizeof(int32_t)) + /* M10, hash keys and bucket links of ME */
+        hash_head_size * sizeof(int32_t)            + /* M11, hash buckets of ME */
         CACHE_LINE_SIZE * 10;
 
     /* align to CACHE_LINE_SIZE */
     mem_size = (mem_size + CACHE_LINE_SIZE - 1) & (~(uint32_t)(CACHE_LINE_SIZE - 1));
 
     if (mem_base == NULL) {
-        CHECKED_MALLOC(mem_ptr, uint8_t *, mem_size);
+        CHECKED_MALLOC_MODE(mem_ptr, uint8_t *, mem_size, h->param->mem_alloc_mode);
     } else {
         mem_ptr = *mem_base;
     }
@@ -285,6 +319,13 @@ xavs2_frame_t *xavs2_frame_new(xavs2_t *h, uint8_t **mem_base, int alloc_type)
     frame->i_pts  = -1;
     frame->i_dts  = -1;
     frame->b_enable_intra = (h->param->enable_intra);
+    frame->p_bs_buf_ext   = NULL;
+    frame->tdrdo_ratio    = NULL;
+    frame->b_tdrdo_ratio  = 0;
+    frame->sao_mode       = NULL;
+    frame->hash_key       = NULL;
+    frame->hash_next      = NULL;
+    frame->hash_head      = NULL;
 
     /* buffer for fenc */
     if (alloc_type == FT_ENC) {
@@ -297,11 +338,18 @@ xavs2_frame_t *xavs2_frame_new(xavs2_t *h, uint8_t **mem_base, int alloc_type)
 #endif
 
         /* M2, set the bit stream buffer pointer and length
-         * NOTE: the size of bitstream buffer is big enough, no need to reallocate
-         *       memory in function encoder_encapsulate_nals */
+         * NOTE: the buffer is enough for most frames, it is enlarged in function
+         *       encoder_encapsulate_nals when a frame is coded with more bytes */
         frame->p_bs_buf = mem_ptr;
-        frame->i_bs_buf = bs_size;     /* the length is long enough */
+        frame->i_bs_buf = bs_size;
         mem_ptr        += bs_size;
+
+        /* M2, lambda ratios decided by TDRDO in lookahead */
+        if (tdrdo_size > 0) {
+            frame->tdrdo_ratio = (float *)mem_ptr;
+            mem_ptr           += tdrdo_size;
+            ALIGN_POINTER(mem_ptr);
+        }
     }
 
     /* M3, buffer for planes: Y+U+V */
@@ -395,6 +443,25 @@ xavs2_frame_t *xavs2_frame_new(xavs2_t *h, uint8_t **mem_base, int alloc_type)
         mem_ptr                    += h->i_height_in_lcu * sizeof(int);
         ALIGN_POINTER(mem_ptr);
 
+        /* M8, SAO modes of LCUs */
+        frame->sao_mode = (int8_t *)mem_ptr;
+        mem_ptr        += frame_size_in_lcu * NUM_SAO_COMPONENTS;
+        ALIGN_POINTER(mem_ptr);
+        memset(frame->sao_mode, SAO_TYPE_OFF, frame_size_in_lcu * NUM_SAO_COMPONENTS);
+
+        /* M9, hash tables of the hash-based ME, built row by row when reconstructed */
+        if (hash_pos_size > 0) {
+            frame->hash_key  = (uint32_t *)mem_ptr;
+            mem_ptr         += hash_pos_size * sizeof(uint32_t);
+            ALIGN_POINTER(mem_ptr);
+            frame->hash_next = (int32_t *)mem_ptr;
+            mem_ptr         += hash_pos_size * sizeof(int32_t);
+            ALIGN_POINTER(mem_ptr);
+            frame->hash_head = (int32_t *)mem_ptr;
+            mem_ptr         += hash_head_size * sizeof(int32_t);
+            ALIGN_POINTER(mem_ptr);
+        }
+
         memset(frame->num_lcu_sao_off, 0, sizeof(frame->num_lcu_sao_off));
     }
 
@@ -442,6 +509,9 @@ void xavs2_frame_delete(xavs2_handler_t *h_mgr, xavs2_frame_t *frame)
 
     xavs2_thread_mutex_destroy(&frame->mutex);
 
+    /* free the enlarged bitstream buffer */
+    xavs2_free(frame->p_bs_buf_ext);
+
     /* free the frame itself */
     xavs2_free(frame);
 }
@@ -458,6 +528,8 @@ void xavs2_frame_destroy_objects(xavs2_handler_t *h_mgr, xavs2_frame_t *frame)
 
     xavs2_thread_cond_destroy(&frame->cond);
     xavs2_thread_mutex_destroy(&frame->mutex);
+    xavs2_free(frame->p_bs_buf_ext);
+    frame->p_bs_buf_ext = NULL;
 }
 
 /**
@@ -143,8 +143,22 @@ intptr_t encoder_encapsulate_nals(xavs2_t *h, xavs2_frame_t *frm, int start)
         nal_size += h->p_nal[i].i_payload;
     }
 
-    /* NOTE: frame->i_bs_buf is big enough, no need to reallocate memory */
-    // assert(previous_nal_size + nal_size <= frame->i_bs_buf);
+    /* enlarge the bitstream buffer of the frame if it is too small */
+    if (previous_nal_size + nal_size > frm->i_bs_buf) {
+        int i_bs_buf = (previous_nal_size + nal_size) * 3 / 2;
+        uint8_t *p_bs_buf = (uint8_t *)xavs2_malloc(i_bs_buf);
+
+        if (p_bs_buf == NULL) {
+            xavs2_log(h, XAVS2_LOG_ERROR, "failed to enlarge the frame bitstream buffer to %d bytes\n", i_bs_buf);
+            return 0;
+        }
+
+        memcpy(p_bs_buf, frm->p_bs_buf, previous_nal_size);
+        xavs2_free(frm->p_bs_buf_ext);
+        frm->p_bs_buf_ext = p_bs_buf;
+        frm->p_bs_buf     = p_bs_buf;
+        frm->i_bs_buf     = i_bs_buf;
+    }
 
     /* copy new nals */
     nal_buffer = frm->p_bs_buf + previous_nal_size;
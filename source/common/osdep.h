@@ -384,6 +384,24 @@ static int ALWAYS_INLINE xavs2_ctz(uint32_t x)
 }
 #endif
 
+/* ---------------------------------------------------------------------------
+ * byte order: converts a native 64-bit word to big-endian and vice versa
+ */
+#if WORDS_BIGENDIAN
+#define xavs2_endian_fix64(x)   (x)
+#elif defined(__GNUC__) && (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ > 2)
+#define xavs2_endian_fix64(x)   __builtin_bswap64(x)
+#elif defined(_MSC_VER)
+#define xavs2_endian_fix64(x)   _byteswap_uint64(x)
+#else
+static uint64_t ALWAYS_INLINE xavs2_endian_fix64(uint64_t x)
+{
+    x = ((x << 8) & 0xff00ff00ff00ff00ULL) | ((x >> 8) & 0x00ff00ff00ff00ffULL);
+    x = ((x << 16) & 0xffff0000ffff0000ULL) | ((x >> 16) & 0x0000ffff0000ffffULL);
+    return (x << 32) | (x >> 32);
+}
+#endif
+
 
 /* ---------------------------------------------------------------------------
  * prefetch
@@ -59,6 +59,20 @@ static const int REF_BITS[32] = {
  */
 
 
+/* ---------------------------------------------------------------------------
+* determine whether the reference block of a PU above the intra refresh band
+* lies in the refreshed rows of the reference frame
+* Return: 0: referring to unrefreshed rows; 1: ok
+*/
+static ALWAYS_INLINE
+int check_mv_refresh(xavs2_t *h, const mv_t *mv, int ref_idx, int pix_y, int bsy)
+{
+    int limit = h->refresh_ref_bottom[ref_idx];
+
+    return pix_y >= (h->i_refresh_row_start << h->i_lcu_level) ||
+           (limit > 0 && pix_y + bsy + (mv->y >> 2) + 4 <= limit);
+}
+
 /* ---------------------------------------------------------------------------
 * determine the mv value (1/4 pixel) is legal or not
 * Return: 0: out of the legal mv range; 
@@ -92,6 +106,21 @@ int check_mv_range(xavs2_t *h, const mv_t *mv, int ref_idx, int pix_x, int pix_y
     return dep_lcu_row_avail && (mv->x <= max_x && mv->x >= min_x && mv->y <= max_y && mv->y >= min_y);
 }
 
+/* ---------------------------------------------------------------------------
+ * determine the MVD value (1/4 pixel) is legal or not
+ * Return: 0: out of the legal mv range; 1: in the legal mv range
+ */
+static ALWAYS_INLINE
+int check_mvd(xavs2_t *h, int mvd_x, int mvd_y)
+{
+    if (h->param->i_frame_threads > 1) {
+        return (mvd_x < 4096 && mvd_x >= -4096 &&
+                mvd_y < ((1 << h->i_lcu_level) << 2) && mvd_y >= -((1 << h->i_lcu_level) << 2));
+    }
+
+    return (mvd_x < 4096 && mvd_x >= -4096 && mvd_y < 4096 && mvd_y >= -4096);
+}
+
 /* ---------------------------------------------------------------------------
  * get distance for a reference frame
  */
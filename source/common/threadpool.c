@@ -73,6 +73,8 @@ typedef struct xavs2_sync_job_list_t {
 struct xavs2_threadpool_t {
     int                   i_exit;       /* exit flag */
     int                   i_threads;    /* thread number in pool */
+    int                   i_threads_created;  /* threads started so far, they are started on demand */
+    int                   i_threads_idle;     /* threads waiting for a job */
     xavs2_tfunc_t         init_func;
     void                 *init_arg;
 
@@ -84,7 +86,6 @@ struct xavs2_threadpool_t {
 
     /* handler of threads */
     xavs2_thread_t       thread_handle[XAVS2_THREAD_MAX];
-    uint8_t               cpu_core_used[64];
 };
 
 /**
@@ -104,7 +105,7 @@ int  xavs2_thread_set_cpu(int idx_core)
 
     CPU_SET(idx_core, &mask);
 
-    if (-1 == pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask)) {
+    if (pthread_setaffinity_np(pthread_self(), sizeof(mask), &mask) != 0) {
         return -1;
     }
     return 0;
@@ -131,6 +132,257 @@ int  xavs2_thread_is_on_cpu(int idx_core)
 #endif
 }
 
+/**
+ * ===========================================================================
+ * thread affinity
+ * ===========================================================================
+ */
+
+/* ---------------------------------------------------------------------------
+ * topology of a CPU for ordering, threads of the same core are not told apart
+ * from each other when the topology is unknown
+ */
+typedef struct cpu_topology_t {
+    int         cpu;                  /* index of the CPU */
+    int         package;              /* physical package (socket) */
+    int         core;                 /* core in the package */
+    int         smt;                  /* index among the hardware threads of the core */
+} cpu_topology_t;
+
+/* ---------------------------------------------------------------------------
+ */
+static int affinity_read_topology(int cpu, const char *name)
+{
+    int value = -1;
+#if SYS_LINUX
+    char path[128];
+    FILE *fp;
+
+    sprintf(path, "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+    if ((fp = fopen(path, "r")) != NULL) {
+        if (fscanf(fp, "%d", &value) != 1) {
+            value = -1;
+        }
+        fclose(fp);
+    }
+#else
+    UNUSED_PARAMETER(cpu);
+    UNUSED_PARAMETER(name);
+#endif
+    return value;
+}
+
+/* ---------------------------------------------------------------------------
+ * compact: every hardware thread of a core, then the next core of the same
+ * package, so that row workers of one frame share the caches of a package
+ */
+static int affinity_compare_compact(const void *p1, const void *p2)
+{
+    const cpu_topology_t *a = (const cpu_topology_t *)p1;
+    const cpu_topology_t *b = (const cpu_topology_t *)p2;
+
+    if (a->package != b->package) {
+        return a->package - b->package;
+    } else if (a->core != b->core) {
+        return a->core - b->core;
+    } else if (a->smt != b->smt) {
+        return a->smt - b->smt;
+    }
+    return a->cpu - b->cpu;
+}
+
+/* ---------------------------------------------------------------------------
+ * scatter: threads are spread over packages in turn, and over cores before the
+ * other hardware threads of a core are used
+ */
+static int affinity_compare_scatter(const void *p1, const void *p2)
+{
+    const cpu_topology_t *a = (const cpu_topology_t *)p1;
+    const cpu_topology_t *b = (const cpu_topology_t *)p2;
+
+    if (a->smt != b->smt) {
+        return a->smt - b->smt;
+    } else if (a->core != b->core) {
+        return a->core - b->core;
+    } else if (a->package != b->package) {
+        return a->package - b->package;
+    }
+    return a->cpu - b->cpu;
+}
+
+/* ---------------------------------------------------------------------------
+ * get the CPUs the process is allowed to run on, returns the number of them
+ */
+static int affinity_get_allowed_cpus(uint8_t *allowed)
+{
+    int num_cpus = 0;
+    int i;
+
+    memset(allowed, 0, XAVS2_AFFINITY_MAX_CPUS);
+#if HAVE_POSIXTHREAD && SYS_LINUX
+    {
+        cpu_set_t mask;
+
+        CPU_ZERO(&mask);
+        if (sched_getaffinity(0, sizeof(mask), &mask) == 0) {
+            for (i = 0; i < XAVS2_MIN(CPU_SETSIZE, XAVS2_AFFINITY_MAX_CPUS); i++) {
+                if (CPU_ISSET(i, &mask)) {
+                    allowed[i] = 1;
+                    num_cpus++;
+                }
+            }
+        }
+    }
+#endif
+    if (num_cpus == 0) {
+        num_cpus = XAVS2_MIN(xavs2_cpu_num_processors(), XAVS2_AFFINITY_MAX_CPUS);
+        for (i = 0; i < num_cpus; i++) {
+            allowed[i] = 1;
+        }
+    }
+
+    return num_cpus;
+}
+
+/* ---------------------------------------------------------------------------
+ * parse a CPU list as "0-3,8,10-11", CPUs are kept in the listed order and the
+ * ones the process is not allowed to run on are skipped.
+ * returns the number of CPUs, -1 for a syntax error
+ */
+static int affinity_parse_cpus(xavs2_affinity_t *affinity, const char *psz_cpus, const uint8_t *allowed)
+{
+    const char *p = psz_cpus;
+    int num_cpus = 0;
+
+    while (*p != '\0') {
+        char *end;
+        int first = (int)strtol(p, &end, 10);
+        int last  = first;
+        int cpu;
+
+        if (end == p || first < 0) {
+            return -1;
+        }
+        p = end;
+        if (*p == '-') {
+            p++;
+            last = (int)strtol(p, &end, 10);
+            if (end == p || last < first) {
+                return -1;
+            }
+            p = end;
+        }
+        if (*p == ',') {
+            p++;
+        } else if (*p != '\0') {
+            return -1;
+        }
+
+        for (cpu = first; cpu <= last && cpu < XAVS2_AFFINITY_MAX_CPUS; cpu++) {
+            if (allowed[cpu]) {
+                affinity->cpus[num_cpus++] = (int16_t)cpu;
+            } else {
+                xavs2_log(NULL, XAVS2_LOG_WARNING, "CPU %d is not allowed for the process, skipped\n", cpu);
+            }
+        }
+    }
+
+    return num_cpus;
+}
+
+/* ---------------------------------------------------------------------------
+ * decide the CPUs worker threads are pinned to in turn.
+ * policy: 0: none, 1: compact, 2: scatter.
+ * psz_cpus: CPU list in the order of pinning, overrides the policy if not empty.
+ * returns 0 for success, -1 for failure; threads are not pinned for an error CPU list
+ */
+int xavs2_affinity_init(xavs2_affinity_t *affinity, int policy, const char *psz_cpus)
+{
+    uint8_t allowed[XAVS2_AFFINITY_MAX_CPUS];
+    int num_allowed;
+    int i;
+
+    memset(affinity, 0, sizeof(xavs2_affinity_t));
+    if (xavs2_thread_mutex_init(&affinity->mutex, NULL)) {
+        return -1;
+    }
+
+    if (policy == 0 && (psz_cpus == NULL || psz_cpus[0] == '\0')) {
+        return 0;                     /* threads are not pinned */
+    }
+
+    num_allowed = affinity_get_allowed_cpus(allowed);
+    if (psz_cpus != NULL && psz_cpus[0] != '\0') {
+        if ((affinity->num_cpus = affinity_parse_cpus(affinity, psz_cpus, allowed)) < 0) {
+            xavs2_log(NULL, XAVS2_LOG_WARNING, "Error CPU list for thread affinity: %s, threads are not pinned\n", psz_cpus);
+            affinity->num_cpus = 0;
+        }
+    } else if (num_allowed > 1) {
+        cpu_topology_t topo[XAVS2_AFFINITY_MAX_CPUS];
+        int num_cpus = 0;
+
+        for (i = 0; i < XAVS2_AFFINITY_MAX_CPUS; i++) {
+            cpu_topology_t *p_topo = &topo[num_cpus];
+            int k;
+
+            if (!allowed[i]) {
+                continue;
+            }
+            p_topo->cpu     = i;
+            p_topo->package = XAVS2_MAX(0, affinity_read_topology(i, "physical_package_id"));
+            p_topo->core    = affinity_read_topology(i, "core_id");
+            p_topo->core    = p_topo->core < 0 ? i : p_topo->core;
+            p_topo->smt     = 0;
+            for (k = 0; k < num_cpus; k++) {
+                if (topo[k].package == p_topo->package && topo[k].core == p_topo->core) {
+                    p_topo->smt++;
+                }
+            }
+            num_cpus++;
+        }
+
+        qsort(topo, num_cpus, sizeof(cpu_topology_t),
+              policy == 2 ? affinity_compare_scatter : affinity_compare_compact);
+        for (i = 0; i < num_cpus; i++) {
+            affinity->cpus[i] = (int16_t)topo[i].cpu;
+        }
+        affinity->num_cpus = num_cpus;
+    }
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * pin the calling thread to the next CPU, used as the init function of the
+ * thread pools
+ */
+void *xavs2_affinity_pin(xavs2_affinity_t *affinity)
+{
+    int cpu;
+
+    if (affinity == NULL || affinity->num_cpus == 0) {
+        return NULL;
+    }
+
+    xavs2_thread_mutex_lock(&affinity->mutex);   /* lock */
+    cpu = affinity->cpus[affinity->idx_next % affinity->num_cpus];
+    affinity->idx_next++;
+    xavs2_thread_mutex_unlock(&affinity->mutex); /* unlock */
+
+    if (xavs2_thread_set_cpu(cpu) < 0) {
+        xavs2_log(NULL, XAVS2_LOG_WARNING, "Failed to pin a thread to CPU %d\n", cpu);
+    }
+
+    return NULL;
+}
+
+/* ---------------------------------------------------------------------------
+ */
+void xavs2_affinity_destroy(xavs2_affinity_t *affinity)
+{
+    xavs2_thread_mutex_destroy(&affinity->mutex);
+}
+
 /**
  * ===========================================================================
  * list operators
@@ -226,42 +478,10 @@ static threadpool_job_t *xavs2_sync_job_list_pop(xavs2_sync_job_list_t *slist)
  * ===========================================================================
  */
 
-/* ---------------------------------------------------------------------------
- */
-static
-void set_thread_running_cpu(xavs2_threadpool_t *pool)
-{
-    int num_cores = xavs2_cpu_num_processors();
-    int cpu_idx = 0;
-    int i;
-
-    xavs2_thread_mutex_lock(&pool->run.mutex);   /* lock */
-    for (i = num_cores; i != 0; i--) {
-        int cpu_used = 0;
-        cpu_idx = rand() % num_cores;
-        cpu_used = pool->cpu_core_used[cpu_idx >> 8];
-        cpu_used = (cpu_used >> (cpu_idx & 7)) & 1;
-        if (!cpu_used) {
-            break;
-        }
-    }
-
-    /* ߳4ʱŽCPU˵İ */
-    if (i != 0 && pool->i_threads > 4) {
-        xavs2_thread_set_cpu(cpu_idx);
-        pool->cpu_core_used[cpu_idx >> 8] |= (1 << (cpu_idx & 7));
-    } else {
-        xavs2_thread_set_cpu(num_cores);
-    }
-    xavs2_thread_mutex_unlock(&pool->run.mutex); /* unlock */
-}
-
 /* ---------------------------------------------------------------------------
  */
 static void *proc_xavs2_threadpool_thread(xavs2_threadpool_t *pool)
 {
-    // set_thread_running_cpu(pool);
-
     /* init */
     if (pool->init_func) {
         pool->init_func(pool->init_arg);
@@ -274,7 +494,9 @@ static void *proc_xavs2_threadpool_thread(xavs2_threadpool_t *pool)
         /* fetch a job */
         xavs2_thread_mutex_lock(&pool->run.mutex);   /* lock */
         while (pool->i_exit != XAVS2_EXIT_THREAD && !pool->run.i_size) {
+            pool->i_threads_idle++;
             xavs2_thread_cond_wait(&pool->run.cv_fill, &pool->run.mutex);
+            pool->i_threads_idle--;
         }
         if (pool->run.i_size) {
             job = xavs2_job_shift(pool->run.list);
@@ -342,11 +564,12 @@ int xavs2_threadpool_init(xavs2_threadpool_t **p_pool, int threads, xavs2_tfunc_
         xavs2_sync_job_list_push(&pool->uninit, job);
     }
 
-    for (i = 0; i < pool->i_threads; i++) {
-        if (xavs2_create_thread(pool->thread_handle + i, (xavs2_tfunc_t)proc_xavs2_threadpool_thread, pool)) {
-            goto fail;
-        }
+    /* one thread is started here and the others in xavs2_threadpool_run() when
+     * no idle one is left, so that an encoder does not wait for all of them */
+    if (xavs2_create_thread(pool->thread_handle, (xavs2_tfunc_t)proc_xavs2_threadpool_thread, pool)) {
+        goto fail;
     }
+    pool->i_threads_created = 1;
 
     return 0;
 
@@ -364,6 +587,16 @@ void xavs2_threadpool_run(xavs2_threadpool_t *pool, void *(*func)(void *), void
     job->arg  = arg;
     job->wait = wait_sign;
     xavs2_sync_job_list_push(&pool->run, job);
+
+    /* start one more thread if the queued jobs outnumber the idle threads */
+    xavs2_thread_mutex_lock(&pool->run.mutex);   /* lock */
+    if (pool->run.i_size > pool->i_threads_idle && pool->i_threads_created < pool->i_threads) {
+        if (xavs2_create_thread(pool->thread_handle + pool->i_threads_created,
+                                (xavs2_tfunc_t)proc_xavs2_threadpool_thread, pool) == 0) {
+            pool->i_threads_created++;
+        }
+    }
+    xavs2_thread_mutex_unlock(&pool->run.mutex); /* unlock */
 }
 
 /* ---------------------------------------------------------------------------
@@ -407,7 +640,7 @@ void xavs2_threadpool_delete(xavs2_threadpool_t *pool)
     xavs2_thread_cond_broadcast(&pool->run.cv_fill);
     xavs2_thread_mutex_unlock(&pool->run.mutex); /* unlock */
 
-    for (i = 0; i < pool->i_threads; i++) {
+    for (i = 0; i < pool->i_threads_created; i++) {
         xavs2_thread_join(pool->thread_handle[i], NULL);
     }
 
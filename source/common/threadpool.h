@@ -39,6 +39,19 @@
 
 typedef struct xavs2_threadpool_t xavs2_threadpool_t;
 
+#define XAVS2_AFFINITY_MAX_CPUS  1024   /* max number of CPUs for pinning threads */
+
+/* ---------------------------------------------------------------------------
+ * pinning of worker threads, shared by all threads of an encoder (and of the
+ * encoders in GOP parallel and ladder encoding)
+ */
+typedef struct xavs2_affinity_t {
+    xavs2_thread_mutex_t mutex;
+    int         num_cpus;             /* number of CPUs in cpus[], 0: threads are not pinned */
+    int         idx_next;             /* the next thread is pinned to cpus[idx_next % num_cpus] */
+    int16_t     cpus[XAVS2_AFFINITY_MAX_CPUS];  /* CPUs in the order threads are pinned to */
+} xavs2_affinity_t;
+
 #define xavs2_threadpool_init FPFX(threadpool_init)
 int   xavs2_threadpool_init  (xavs2_threadpool_t **p_pool, int threads,
                               xavs2_tfunc_t init_func, void *init_arg);
@@ -49,4 +62,11 @@ void *xavs2_threadpool_wait  (xavs2_threadpool_t *pool, void *arg);
 #define xavs2_threadpool_delete FPFX(threadpool_delete)
 void  xavs2_threadpool_delete(xavs2_threadpool_t *pool);
 
+#define xavs2_affinity_init FPFX(affinity_init)
+int   xavs2_affinity_init    (xavs2_affinity_t *affinity, int policy, const char *psz_cpus);
+#define xavs2_affinity_pin FPFX(affinity_pin)
+void *xavs2_affinity_pin     (xavs2_affinity_t *affinity);
+#define xavs2_affinity_destroy FPFX(affinity_destroy)
+void  xavs2_affinity_destroy (xavs2_affinity_t *affinity);
+
 #endif  // XAVS2_THREADPOOL_H
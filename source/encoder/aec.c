@@ -57,51 +57,6 @@ static const int tab_b8xy_to_zigzag[8][8] = {
     { 42, 43, 46, 47, 58, 59, 62, 63 }
 };
 
-/* ---------------------------------------------------------------------------
- * ļone bitʣλ
- */
-static INLINE
-void bitstt_put_one_bit_and_remainder(aec_t *p_aec, const int b)
-{
-    uint32_t N = 1 + p_aec->i_bits_to_follow;   // ܹı
-
-    if (N > p_aec->num_left_flush_bits) {   /* ıǰֽʣı */
-        int header_bits = p_aec->num_left_flush_bits;   // ǰһֽʣλ
-        uint32_t header_byte = (1 << (header_bits - 1)) - (!b);  // ʣλֵ
-        int num_left_bytes = (N - header_bits) >> 3;            // ǰֽ⣬ʣӦֽ
-        int num_left_bits = N - header_bits - (num_left_bytes << 3);   // ı
-
-        p_aec->reg_flush_bits |= header_byte;
-        bitstr_flush_bits(p_aec);
-        p_aec->num_left_flush_bits = NUM_FLUSH_BITS - num_left_bits;
-
-        if (b == 0) {
-            /* b Ϊʱмbitsȫ 1 */
-            while (num_left_bytes != 0) {
-                *(p_aec->p) = 0xff;
-                p_aec->p++;
-                num_left_bytes--;
-            }
-            /*  num_left_bits λ reg_flush_bits λ */
-            p_aec->reg_flush_bits = 0xffu >> (8 - num_left_bits) << p_aec->num_left_flush_bits;
-        } else {
-            p_aec->p += num_left_bytes;
-        }
-    } else  {  /* ǰҪbitСдֽʣbit */
-        uint32_t bits = (1 << p_aec->i_bits_to_follow) - (!b);  // ıɵĶֵ
-
-        p_aec->reg_flush_bits |= bits << (p_aec->num_left_flush_bits - N);
-        p_aec->num_left_flush_bits -= N;
-        if (p_aec->num_left_flush_bits == 0) {
-            bitstr_flush_bits(p_aec);
-            p_aec->reg_flush_bits      = 0;
-            p_aec->num_left_flush_bits = NUM_FLUSH_BITS;
-        }
-    }
-    p_aec->i_bits_to_follow = 0;
-
-}
-
 
 /**
  * ===========================================================================
@@ -109,28 +64,6 @@ void bitstt_put_one_bit_and_remainder(aec_t *p_aec, const int b)
  * ===========================================================================
  */
 
-/* ---------------------------------------------------------------------------
- */
-static ALWAYS_INLINE int aec_get_shift(uint32_t v)
-{
-#if SYS_WINDOWS && !ARCH_X86_64
-    __asm {
-        bsr     eax, v
-        mov     v, eax
-    }
-
-    return 8 - v;
-#else
-    int i;
-
-    for (i = 0; !(v & 0x100); i++) {
-        v <<= 1;
-    }
-
-    return i;
-#endif
-}
-
 /* ---------------------------------------------------------------------------
  * logarithm arithmetic coder
  */
@@ -2088,6 +2021,8 @@ void xavs2_cu_write(xavs2_t *h, aec_t *p_aec, lcu_info_t *lcu_info, cu_info_t *p
     int scu_y = (img_y >> MIN_CU_SIZE_IN_BIT);
     int slice_index_cur_cu = cu_get_slice_index(h, scu_x, scu_y);
     int scu_xy = scu_y * h->i_width_in_mincu + scu_x;
+    runlevel_t *p_runlevel = &h->slices[lcu_info->slice_index]->run_level_write;
+
     /* write CU header */
     write_cu_header(h, p_aec, p_cu_info, scu_xy);
 
@@ -2121,7 +2056,7 @@ void xavs2_cu_write(xavs2_t *h, aec_t *p_aec, lcu_info_t *lcu_info, cu_info_t *p
 
                 write_luma_block_coeff(h, p_aec, p_cu_info, 
                                        lcu_info->coeffs_y + (idx_zorder << 6) + (block_idx << ((i_level - 1) << 1)),
-                                       &h->lcu.run_level_write, i_tu_level, xavs2_log2u(tb.w) - use_wavelet,
+                                       p_runlevel, i_tu_level, xavs2_log2u(tb.w) - use_wavelet,
                                        IS_INTRA_MODE(mode), p_cu_info->real_intra_modes[block_idx]);
             }
 
@@ -2136,7 +2071,7 @@ void xavs2_cu_write(xavs2_t *h, aec_t *p_aec, lcu_info_t *lcu_info, cu_info_t *p
                 if (p_cu_info->i_cbp & (1 << block_idx)) {
                     write_chroma_block_coeff(h, p_aec, p_cu_info, 
                                              lcu_info->coeffs_uv[block_idx - 4] + (idx_zorder << 4),
-                                             &h->lcu.run_level_write, i_level - 1);
+                                             p_runlevel, i_level - 1);
                 }
             }
         }
@@ -59,7 +59,7 @@ extern context_t g_tab_ctx_lps[1025 * 4 * 2];    /* [8 * lg_pmps + 4 * mps + cyc
 /* ---------------------------------------------------------------------------
  * number of maximum flush bits in p_aec->reg_flush_bits
  */
-static const uint32_t NUM_FLUSH_BITS = 24;
+static const uint32_t NUM_FLUSH_BITS = 64;
 
 /* ---------------------------------------------------------------------------
  * AC ENGINE PARAMETERS
@@ -146,33 +146,30 @@ int arienco_bits_written(aec_t *p_aec)
 
 
 /* ---------------------------------------------------------------------------
- * ļflush bits
+ * number of bits to renormalize the interval (t < 0x100) back to 9 bits
+ */
+static ALWAYS_INLINE int aec_get_shift(uint32_t v)
+{
+    return xavs2_clz(v) - 23;
+}
+
+/* ---------------------------------------------------------------------------
+ * v << n for 0 <= n <= 64 (the bits shifted out of the register are dropped),
+ * a single shift by 64 is undefined in C and a no-op on x86
+ */
+static ALWAYS_INLINE uint64_t aec_shl64(uint64_t v, uint32_t n)
+{
+    return (v << (n >> 1)) << (n - (n >> 1));
+}
+
+/* ---------------------------------------------------------------------------
+ * ļflush bits64λĴԴһд
  */
 static INLINE
 void bitstr_flush_bits(aec_t *p_aec)
 {
-    switch (NUM_FLUSH_BITS) {
-    case 24:
-        p_aec->p[0] = (uint8_t)(p_aec->reg_flush_bits >> 16);
-        p_aec->p[1] = (uint8_t)(p_aec->reg_flush_bits >> 8);
-        p_aec->p[2] = (uint8_t)(p_aec->reg_flush_bits);
-        p_aec->p += 3;
-        break;
-    case 16:
-        p_aec->p[0] = (uint8_t)(p_aec->reg_flush_bits >> 8);
-        p_aec->p[1] = (uint8_t)(p_aec->reg_flush_bits);
-        p_aec->p += 2;
-        break;
-    case 8:
-        p_aec->p[0] = (uint8_t)p_aec->reg_flush_bits;
-        p_aec->p += 1;
-        break;
-    default:
-        fprintf(stderr, "Unsupported number of flush bits %d\n", NUM_FLUSH_BITS);
-        assert(0);
-        break;
-    }
-
+    M64(p_aec->p) = xavs2_endian_fix64(p_aec->reg_flush_bits);
+    p_aec->p += 8;
     p_aec->reg_flush_bits = 0;
 }
 
@@ -183,13 +180,55 @@ void bitstr_flush_bits(aec_t *p_aec)
 static INLINE
 void bitstr_put_one_bit(aec_t *p_aec, uint32_t b)
 {
-    p_aec->reg_flush_bits |= ((b) << --p_aec->num_left_flush_bits);
+    p_aec->reg_flush_bits |= ((uint64_t)b << --p_aec->num_left_flush_bits);
     if (!p_aec->num_left_flush_bits) {
         bitstr_flush_bits(p_aec);
         p_aec->num_left_flush_bits = NUM_FLUSH_BITS;
     }
 }
 
+/* ---------------------------------------------------------------------------
+ * ļone bitʣλ
+ * NOTE: the first bit of a slice is swallowed by starting with one more bit
+ *       left in the register than it holds, hence the shifts by up to 64
+ */
+static INLINE
+void bitstt_put_one_bit_and_remainder(aec_t *p_aec, const int b)
+{
+    uint32_t N = 1 + p_aec->i_bits_to_follow;   // ܹı
+
+    if (N > p_aec->num_left_flush_bits) {   /* ıǰĴʣı */
+        int header_bits = p_aec->num_left_flush_bits;   // ǰĴʣλ
+        uint64_t header_byte = aec_shl64(1, header_bits - 1) - (!b);  // ʣλֵ
+        int num_left_bytes = (N - header_bits) >> 3;            // ǰĴ⣬ʣӦֽ
+        int num_left_bits = N - header_bits - (num_left_bytes << 3);   // ı
+
+        p_aec->reg_flush_bits |= header_byte;
+        bitstr_flush_bits(p_aec);
+        p_aec->num_left_flush_bits = NUM_FLUSH_BITS - num_left_bits;
+
+        if (b == 0) {
+            /* b Ϊʱмbitsȫ 1 */
+            memset(p_aec->p, 0xff, num_left_bytes);
+            p_aec->p += num_left_bytes;
+            /*  num_left_bits λ reg_flush_bits λ */
+            p_aec->reg_flush_bits = aec_shl64(0xffu >> (8 - num_left_bits), p_aec->num_left_flush_bits);
+        } else {
+            p_aec->p += num_left_bytes;
+        }
+    } else  {  /* ǰҪbitСڼĴʣbit */
+        uint64_t bits = aec_shl64(1, p_aec->i_bits_to_follow) - (!b);  // ıɵĶֵ
+
+        p_aec->reg_flush_bits |= aec_shl64(bits, p_aec->num_left_flush_bits - N);
+        p_aec->num_left_flush_bits -= N;
+        if (p_aec->num_left_flush_bits == 0) {
+            bitstr_flush_bits(p_aec);
+            p_aec->num_left_flush_bits = NUM_FLUSH_BITS;
+        }
+    }
+    p_aec->i_bits_to_follow = 0;
+}
+
 /* ---------------------------------------------------------------------------
  * жCGǷΪȫ顣
  * 򷵻1򷵻0
@@ -271,6 +310,8 @@ void aec_init_coding_state   (aec_t *p_aec);
  */
 #define aec_start FPFX(aec_start)
 void aec_start(xavs2_t *h, aec_t *p_aec, uint8_t *p_bs_start, uint8_t *p_bs_end, int b_writing);
+#define aec_move_buffer FPFX(aec_move_buffer)
+void aec_move_buffer(aec_t *p_aec, uint8_t *p_bs_old, uint8_t *p_bs_new, uint8_t *p_bs_end);
 #define aec_done FPFX(aec_done)
 void aec_done(aec_t *p_aec);
 
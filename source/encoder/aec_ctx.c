@@ -80,108 +80,23 @@ void bitstr_end_stream(aec_t *p_aec)
         return;
     }
 
-    switch (NUM_FLUSH_BITS - p_aec->num_left_flush_bits) {
-    case 24:
-        p_aec->p[0] = (uint8_t)(p_aec->reg_flush_bits >> (NUM_FLUSH_BITS - 8));
-        p_aec->p[1] = (uint8_t)(p_aec->reg_flush_bits >> (NUM_FLUSH_BITS - 16));
-        p_aec->p[2] = (uint8_t)(p_aec->reg_flush_bits >> (NUM_FLUSH_BITS - 24));
-        p_aec->p += 3;
-        break;
-    case 16:
-        p_aec->p[0] = (uint8_t)(p_aec->reg_flush_bits >> (NUM_FLUSH_BITS - 8));
-        p_aec->p[1] = (uint8_t)(p_aec->reg_flush_bits >> (NUM_FLUSH_BITS - 16));
-        p_aec->p += 2;
-        break;
-    case 8:
-        p_aec->p[0] = (uint8_t)(p_aec->reg_flush_bits >> (NUM_FLUSH_BITS - 8));
-        p_aec->p += 1;
-        break;
-    default:
-        fprintf(stderr, "Un-aligned tail bits %d\n", p_aec->num_left_flush_bits);
-        assert(0);
-        break;
-    }
+    /* the number of bits left is a multiple of 8 here, the whole register
+     * is stored and only the bytes holding valid bits are counted */
+    assert(((NUM_FLUSH_BITS - p_aec->num_left_flush_bits) & 7) == 0);
+    M64(p_aec->p) = xavs2_endian_fix64(p_aec->reg_flush_bits);
+    p_aec->p += (NUM_FLUSH_BITS - p_aec->num_left_flush_bits) >> 3;
+    p_aec->reg_flush_bits = 0;
 
     p_aec->num_left_flush_bits = NUM_FLUSH_BITS;
 }
 
 
-
-
-/* ---------------------------------------------------------------------------
- * ļone bitʣλ
- */
-static INLINE
-void bitstt_put_one_bit_and_remainder(aec_t *p_aec, const int b)
-{
-    uint32_t N = 1 + p_aec->i_bits_to_follow;   // ܹı
-
-    if (N > p_aec->num_left_flush_bits) {   /* ıǰֽʣı */
-        int header_bits = p_aec->num_left_flush_bits;   // ǰһֽʣλ
-        uint32_t header_byte = (1 << (header_bits - 1)) - (!b);  // ʣλֵ
-        int num_left_bytes = (N - header_bits) >> 3;            // ǰֽ⣬ʣӦֽ
-        int num_left_bits = N - header_bits - (num_left_bytes << 3);   // ı
-
-        p_aec->reg_flush_bits |= header_byte;
-        bitstr_flush_bits(p_aec);
-        p_aec->num_left_flush_bits = NUM_FLUSH_BITS - num_left_bits;
-
-        if (b == 0) {
-            /* b Ϊʱмbitsȫ 1 */
-            while (num_left_bytes != 0) {
-                *(p_aec->p) = 0xff;
-                p_aec->p++;
-                num_left_bytes--;
-            }
-            /*  num_left_bits λ reg_flush_bits λ */
-            p_aec->reg_flush_bits = 0xffu >> (8 - num_left_bits) << p_aec->num_left_flush_bits;
-        } else {
-            p_aec->p += num_left_bytes;
-        }
-    } else  {  /* ǰҪbitСдֽʣbit */
-        uint32_t bits = (1 << p_aec->i_bits_to_follow) - (!b);  // ıɵĶֵ
-
-        p_aec->reg_flush_bits |= bits << (p_aec->num_left_flush_bits - N);
-        p_aec->num_left_flush_bits -= N;
-        if (p_aec->num_left_flush_bits == 0) {
-            bitstr_flush_bits(p_aec);
-            p_aec->reg_flush_bits      = 0;
-            p_aec->num_left_flush_bits = NUM_FLUSH_BITS;
-        }
-    }
-    p_aec->i_bits_to_follow = 0;
-
-}
-
-
 /**
  * ===========================================================================
  * binary
  * ===========================================================================
  */
 
-/* ---------------------------------------------------------------------------
- */
-static ALWAYS_INLINE int aec_get_shift(uint32_t v)
-{
-#if SYS_WINDOWS && !ARCH_X86_64
-    __asm {
-        bsr     eax, v
-        mov     v, eax
-    }
-
-    return 8 - v;
-#else
-    int i;
-
-    for (i = 0; !(v & 0x100); i++) {
-        v <<= 1;
-    }
-
-    return i;
-#endif
-}
-
 /* ---------------------------------------------------------------------------
  */
 static ALWAYS_INLINE void aec_set_function_handles(xavs2_t *h, binary_t *fh, int b_writing)
@@ -226,11 +141,20 @@ void init_contexts(aec_t *p_aec)
  */
 void init_aec_context_tab(void)
 {
+    /* the tables are shared by all encoders in the process, build them once */
+    static xavs2_thread_mutex_t tab_mutex = XAVS2_PTHREAD_MUTEX_INITIALIZER;
+    static int b_tab_ready = 0;
     context_t ctx_i;
     context_t ctx_o;
     int cycno;
     int mps;
 
+    xavs2_thread_mutex_lock(&tab_mutex);
+    if (b_tab_ready) {
+        xavs2_thread_mutex_unlock(&tab_mutex);
+        return;
+    }
+
     /* init context table */
     ctx_i.v = 0;
     ctx_o.v = 0;
@@ -273,6 +197,9 @@ void init_aec_context_tab(void)
             }
         }
     }
+
+    b_tab_ready = 1;
+    xavs2_thread_mutex_unlock(&tab_mutex);
 }
 #endif
 
@@ -302,6 +229,17 @@ void aec_start(xavs2_t *h, aec_t *p_aec, uint8_t *p_bs_start, uint8_t *p_bs_end,
     init_contexts(p_aec);
 }
 
+/* ---------------------------------------------------------------------------
+ * moves the arithmetic coder to a reallocated bitstream buffer, which holds a
+ * copy of all bytes written so far and is zeroed beyond them
+ */
+void aec_move_buffer(aec_t *p_aec, uint8_t *p_bs_old, uint8_t *p_bs_new, uint8_t *p_bs_end)
+{
+    p_aec->p_start = p_bs_new + (p_aec->p_start - p_bs_old);
+    p_aec->p       = p_bs_new + (p_aec->p       - p_bs_old);
+    p_aec->p_end   = p_bs_end;
+}
+
 /* ---------------------------------------------------------------------------
  * terminates the arithmetic codeword, writes stop bit and stuffing bytes (if any)
  */
@@ -46,28 +46,6 @@
  * ===========================================================================
  */
 
-/* ---------------------------------------------------------------------------
- */
-static ALWAYS_INLINE int aec_get_shift(uint32_t v)
-{
-#if SYS_WINDOWS && !ARCH_X86_64
-    __asm {
-        bsr     eax, v
-        mov     v, eax
-    }
-
-    return 8 - v;
-#else
-    int i;
-
-    for (i = 0; !(v & 0x100); i++) {
-        v <<= 1;
-    }
-
-    return i;
-#endif
-}
-
 /* ---------------------------------------------------------------------------
  */
 static INLINE
@@ -66,6 +66,17 @@ static ALWAYS_INLINE void xavs2_bs_init(bs_t *bs, void *p_data, int i_data)
     bs->i_left  = 8;
 }
 
+/* ---------------------------------------------------------------------------
+ * moves the bitstream writer to a reallocated buffer, which holds a copy of
+ * all bytes written so far
+ */
+static ALWAYS_INLINE void xavs2_bs_move(bs_t *bs, void *p_data, int i_data)
+{
+    bs->p       = (uint8_t *)p_data + (bs->p - bs->p_start);
+    bs->p_start = (uint8_t *)p_data;
+    bs->p_end   = bs->p_start + i_data;
+}
+
 /* ---------------------------------------------------------------------------
  */
 static ALWAYS_INLINE int xavs2_bs_pos(bs_t *bs)
@@ -74,13 +85,14 @@ static ALWAYS_INLINE int xavs2_bs_pos(bs_t *bs)
 }
 
 /* ---------------------------------------------------------------------------
- * writes UVLC code to the bitstream buffer
+ * writes UVLC code to the bitstream buffer, bits beyond the end of the
+ * buffer are dropped
  */
 static ALWAYS_INLINE void xavs2_bs_write(bs_t *bs, uint32_t code, int len)
 {
     assert(bs->p < bs->p_end);
 
-    while (len > 0) {
+    while (len > 0 && bs->p < bs->p_end) {
         if (len < 32) {
             code &= (1 << len) - 1;
         }
@@ -44,6 +44,7 @@
 #include "nal.h"
 #include "ratecontrol.h"
 #include "tdrdo.h"
+#include "ladder.h"
 #include "me.h"
 #include "cpu.h"
 #include "rdo.h"
@@ -109,16 +110,19 @@ void qsfd_calculate_threshold_of_a_frame(xavs2_t *h)
 static void release_one_frame(xavs2_t *h, xavs2_frame_t *frame)
 {
     xavs2_handler_t *h_mgr = h->h_top;
+    int b_idle;
 
     xavs2_thread_mutex_lock(&frame->mutex);      /* lock */
 
     assert(frame->cnt_refered > 0);
     frame->cnt_refered--;
+    b_idle = frame->cnt_refered == 0;
 
     xavs2_thread_mutex_unlock(&frame->mutex);    /* unlock */
 
-    if (frame->cnt_refered == 0) {
-        /* signal to the h_mgr */
+    if (b_idle) {
+        /* join the idle pictures of the DPB and signal to the h_mgr */
+        frame_buffer_set_idle(&h_mgr->dpb, frame);
         xavs2_thread_cond_signal(&h_mgr->cond[SIG_FRM_BUFFER_RELEASED]);
     }
 }
@@ -142,7 +146,9 @@ void encoder_fill_packet_data(xavs2_handler_t *h_mgr, xavs2_outpacket_t *packet,
         packet->pts      = h_mgr->max_out_pts;
         packet->dts      = h_mgr->max_out_dts;
         if (h_mgr->b_seq_end == 0) {
-            packet->len = len_end_code;
+            /* only the last segment ends the sequence */
+            const xavs2_param_t *param = h_mgr->p_coder->param;
+            packet->len = (param->b_segment && !param->b_segment_last) ? 0 : len_end_code;
             h_mgr->b_seq_end = 1;
         }
     } else {
@@ -205,6 +211,9 @@ void encoder_fetch_one_encoded_frame(xavs2_handler_t *h_mgr, xavs2_outpacket_t *
         if (frame != NULL) {
             encoder_fill_packet_data(h_mgr, packet, frame);
             h_mgr->num_output++;
+            if (frame->frm_complex.b_valid) {
+                lookahead_remove_output_frame(h_mgr, frame);
+            }
             assert(frame->i_bs_len > 0);
         }
     }
@@ -353,6 +362,49 @@ static int Advance2NextFrame(xavs2_handler_t *h_mgr, int frame)
     return (frame + 1) % h_mgr->i_frm_threads;
 }
 
+/* ---------------------------------------------------------------------------
+ * decide the intra refresh band of current frame and the refreshed rows that
+ * the LCUs above the band can refer to in each reference frame
+ */
+static void encoder_decide_intra_refresh(xavs2_t *h, xavs2_handler_t *h_mgr)
+{
+    const int num_frames = h->param->intra_refresh;
+    const int margin     = 16;    /* luma rows changed by deblocking, SAO and ALF across the band border */
+    int i;
+
+    h->i_refresh_row_start = 0;
+    h->i_refresh_row_end   = 0;
+    if (num_frames <= 0) {
+        return;
+    }
+
+    if (h->fenc->i_frm_type == XAVS2_TYPE_I) {
+        h_mgr->i_refresh_frame = h->fenc->i_frame;
+        h->fdec->i_refresh_cycle = -1;
+        h->fdec->i_refresh_rows  = h->i_height;
+    } else {
+        int k   = h->fenc->i_frame - h_mgr->i_refresh_frame - 1;
+        int pos = k % num_frames;
+
+        h->i_refresh_row_start = (pos       * h->i_height_in_lcu) / num_frames;
+        h->i_refresh_row_end   = ((pos + 1) * h->i_height_in_lcu) / num_frames;
+        h->fdec->i_refresh_cycle = k / num_frames;
+        h->fdec->i_refresh_rows  = XAVS2_MIN(h->i_refresh_row_end << h->i_lcu_level, h->i_height);
+    }
+
+    for (i = 0; i < h->i_ref; i++) {
+        xavs2_frame_t *p_ref = h->fref[i];
+
+        if (p_ref->i_refresh_cycle < 0) {
+            h->refresh_ref_bottom[i] = 1 << 20;     /* I frame, no limit */
+        } else if (p_ref->i_refresh_cycle != h->fdec->i_refresh_cycle) {
+            h->refresh_ref_bottom[i] = 0;
+        } else {
+            h->refresh_ref_bottom[i] = p_ref->i_refresh_rows - margin;
+        }
+    }
+}
+
 /* ---------------------------------------------------------------------------
  * get a frame encoder handle
  */
@@ -368,6 +420,15 @@ static xavs2_t *encoder_alloc_frame_task(xavs2_handler_t *h_mgr, xavs2_frame_t *
         for (i = 0; i < h_mgr->i_frm_threads; i++) {
             /* alloc a frame task */
             xavs2_t *h = h_mgr->frm_contexts[i];
+
+            if (h == NULL) {
+                /* all contexts before are busy, open a new one on first use */
+                if ((h = encoder_contexts_open_frame(h_mgr, i)) == NULL) {
+                    xavs2_log(h_mgr, XAVS2_LOG_ERROR, "open frame context %d fail\n", i);
+                    refs_unavailable = 1;
+                    break;
+                }
+            }
             assert(h->task_type == XAVS2_TASK_FRAME);
 
             if (h->task_status == XAVS2_TASK_FREE) {
@@ -387,9 +448,10 @@ static xavs2_t *encoder_alloc_frame_task(xavs2_handler_t *h_mgr, xavs2_frame_t *
                 for (j = 0; j < h->i_height_in_lcu; j++) {
                     row_info_t *row = &h->frameinfo->rows[j];
 
-                    row->h     = 0;
-                    row->row   = j;
-                    row->coded = -1;
+                    row->h        = 0;
+                    row->row      = j;
+                    row->coded    = -1;
+                    row->filtered = -1;
                 }
 
                 /* init caches */
@@ -428,6 +490,7 @@ static xavs2_t *encoder_alloc_frame_task(xavs2_handler_t *h_mgr, xavs2_frame_t *
                 h->i_ref = h->fenc->rps.num_of_ref;
                 h->i_layer = h->fenc->rps.temporal_id;
                 assert(h->i_ref <= XAVS2_MAX_REFS);
+                encoder_decide_intra_refresh(h, h_mgr);
 
                 xavs2_thread_mutex_unlock(&h_mgr->mutex); /* unlock */
                 /* signal to the aec thread */
@@ -526,7 +589,7 @@ void encoder_encode_frame_header(xavs2_t *h)
     /* create sequence header if need ------------------------------
      */
     if (h->fenc->b_keyframe) {
-        if (h->fenc->i_frm_coi == 0 || h->param->intra_period > 1) {
+        if ((h->fenc->i_frm_coi == h->param->segment_start_frame && !h->param->b_gop_continued) || h->param->intra_period > 1) {
             /* generate sequence parameters */
             nal_start(h, NAL_SPS, NAL_PRIORITY_HIGHEST);
             xavs2_sequence_write(h, p_bs);
@@ -558,31 +621,63 @@ void encoder_encode_frame_header(xavs2_t *h)
 
 
 /* ---------------------------------------------------------------------------
- * the aec encoding
+ * make sure that at least num_bytes are left in the bitstream buffer of the
+ * slice, the buffer is enlarged (and the writers are moved) if necessary
  */
-static void *encoder_aec_encode_one_frame(xavs2_t *h)
+static int slice_bs_reserve(xavs2_t *h, slice_t *slice, aec_t *p_aec, int num_bytes)
 {
+    uint8_t *p_old   = slice->p_slice_bs_buf;
+    int      len_old = slice->len_slice_bs_buf;
+    int      len_used;
+    int      len_new;
+    uint8_t *p_new;
+
+    if (p_aec->p_end - p_aec->p >= num_bytes) {
+        return 0;
+    }
+
+    len_used = (int)(p_aec->p - p_old);
+    len_new  = XAVS2_MAX(len_old * 2, len_used + num_bytes);
+    len_new  = (len_new + 255) >> 8 << 8;
+    p_new    = (uint8_t *)xavs2_malloc_mode(len_new, h->param->mem_alloc_mode);
+    if (p_new == NULL) {
+        xavs2_log(h, XAVS2_LOG_ERROR, "failed to enlarge the slice bitstream buffer to %d bytes\n", len_new);
+        return -1;
+    }
+
+    /* bytes behind the writing position are zero, as the arithmetic coder
+     * skips the bytes which need not to be changed */
+    memcpy(p_new, p_old, len_used);
+    memset(p_new + len_used, 0, len_new - len_used);
+
+    xavs2_bs_move(&slice->bs, p_new, len_new);
+    aec_move_buffer(p_aec, p_old, p_new, p_new + len_new);
+    encoder_mem_update(h->h_top, XAVS2_MEMCAT_BITSTREAM, len_new - len_old, len_old);
+    xavs2_free(p_old);
+
+    slice->p_slice_bs_buf   = p_new;
+    slice->len_slice_bs_buf = len_new;
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * the aec encoding of one slice (the bitstream is merged into NALs later)
+ */
+static void *encoder_aec_encode_slice(void *arg)
+{
+    slice_t         *slice = (slice_t *)arg;
+    xavs2_t         *h     = slice->h;
     aec_t            aec;
     frame_info_t    *frame = h->frameinfo;
     xavs2_frame_t   *fdec  = h->fdec;
-    row_info_t      *row   = NULL;
-    lcu_info_t      *lcu   = NULL;
-    slice_t         *slice = NULL;
     aec_t           *p_aec = &aec;
-    outputframe_t    output_frame;
-#if XAVS2_STAT
-    frame_stat_t *frm_stat = &frame->frame_stat;
-    int i = 0;
-#endif
-    int lcu_xy = 0;
-    int lcu_x = 0, lcu_y = 0;
-
-    /* encode frame header */
-    encoder_encode_frame_header(h);
+    int lcu_x, lcu_y;
 
     /* encode all LCUs */
-    for (lcu_y = 0; lcu_y < h->i_height_in_lcu; lcu_y++) {
-        row = &frame->rows[lcu_y];
+    for (lcu_y = slice->i_first_lcu_y; lcu_y <= slice->i_last_lcu_y; lcu_y++) {
+        row_info_t *row = &frame->rows[lcu_y];
+        int lcu_xy = lcu_y * h->i_width_in_lcu;
+        int row_start_bits;
 
         /* wait until the row finishes RDO */
         xavs2_thread_mutex_lock(&fdec->mutex);   /* lock */
@@ -591,19 +686,20 @@ static void *encoder_aec_encode_one_frame(xavs2_t *h)
         }
         xavs2_thread_mutex_unlock(&fdec->mutex); /* unlock */
 
+        if (lcu_y == slice->i_first_lcu_y) {
+            /* slice start : initialize the aec engine */
+            aec_start(h, p_aec, slice->bs.p_start + PSEUDO_CODE_SIZE, slice->bs.p_end, 1);
+            p_aec->b_writting = 1;
+        }
+
         /* row is clear: start aec for every LCU */
+        row_start_bits = arienco_bits_written(p_aec);
         for (lcu_x = 0; lcu_x < h->i_width_in_lcu; lcu_x++, lcu_xy++) {
-            lcu   = &row->lcus[lcu_x];
-            slice = h->slices[lcu->slice_index];
-
-            // while (fdec->num_lcu_coded_in_row[lcu_y] <= lcu_x) {
-            //     xavs2_sleep_ms(1);
-            // }
+            lcu_info_t *lcu = &row->lcus[lcu_x];
 
-            if (lcu_xy == slice->i_first_lcu_xy) {
-                /* slice start : initialize the aec engine */
-                aec_start(h, p_aec, slice->bs.p_start + PSEUDO_CODE_SIZE, slice->bs.p_end, 1);
-                p_aec->b_writting = 1;
+            if (slice_bs_reserve(h, slice, p_aec, LCU_BS_RESERVE(h->i_lcu_level)) < 0) {
+                /* out of memory: skip the LCU rather than writing out of the buffer */
+                continue;
             }
 
             if (h->param->enable_sao) {
@@ -624,22 +720,75 @@ static void *encoder_aec_encode_one_frame(xavs2_t *h)
             /* for the last LCU in SLice, write 1, otherwise write 0 */
             xavs2_lcu_terminat_bit_write(p_aec, lcu_xy == slice->i_last_lcu_xy);
         }
+        row->i_aec_bits = arienco_bits_written(p_aec) - row_start_bits;
+    }
 
-        /* LCUмSliceַʽ */
-        if (lcu_xy >= slice->i_last_lcu_xy) {
-            int bs_len;
-            /* slice done */
-            aec_done(p_aec);
+    /* slice done */
+    aec_done(p_aec);
 
-            /* check pseudo start code, and store bit stream length */
-            check_pseudo_code_and_merge_slice_data(&slice->bs, p_aec);
-            bs_len = xavs2_bs_pos(&slice->bs) / 8;
+    /* check pseudo start code, and store bit stream length */
+    check_pseudo_code_and_merge_slice_data(&slice->bs, p_aec);
 
-            nal_merge_slice(h, slice->p_slice_bs_buf, bs_len, h->i_nal_type, h->i_nal_ref_idc);
+    return NULL;
+}
+
+/* ---------------------------------------------------------------------------
+ * the aec encoding
+ */
+static void *encoder_aec_encode_one_frame(xavs2_t *h)
+{
+    xavs2_threadpool_t *pool = h->h_top->threadpool_aec;
+    outputframe_t    output_frame;
+#if XAVS2_STAT
+    frame_stat_t *frm_stat = &h->frameinfo->frame_stat;
+#endif
+    int size_bs_ext;
+    int i;
+
+    /* encode frame header */
+    encoder_encode_frame_header(h);
+
+    /* encode all slices, the slices are entropy coded in parallel when the
+     * AEC thread pool is used */
+    if (pool != NULL && h->i_slice_num > 1) {
+        for (i = 1; i < h->i_slice_num; i++) {
+            xavs2_threadpool_run(pool, encoder_aec_encode_slice, h->slices[i], 1);
         }
+        encoder_aec_encode_slice(h->slices[0]);
+        for (i = 1; i < h->i_slice_num; i++) {
+            xavs2_threadpool_wait(pool, h->slices[i]);
+        }
+    } else {
+        for (i = 0; i < h->i_slice_num; i++) {
+            encoder_aec_encode_slice(h->slices[i]);
+        }
+    }
+
+    /* merge the bitstreams of all slices */
+    for (i = 0; i < h->i_slice_num; i++) {
+        slice_t *slice = h->slices[i];
+        int bs_len = xavs2_bs_pos(&slice->bs) / 8;
+
+        nal_merge_slice(h, slice->p_slice_bs_buf, bs_len, h->i_nal_type, h->i_nal_ref_idc);
     }
 
+    /* size of the slice bitstream buffers, which may have been enlarged */
+    h->i_bs_buf_slice = 0;
+    for (i = 0; i < h->param->slice_num; i++) {
+        h->i_bs_buf_slice += h->slices[i]->len_slice_bs_buf;
+    }
+
+    size_bs_ext = h->fenc->p_bs_buf_ext != NULL ? h->fenc->i_bs_buf : 0;
     h->fenc->i_bs_len = (int)encoder_encapsulate_nals(h, h->fenc, 0);
+    if (h->fenc->p_bs_buf_ext != NULL && h->fenc->i_bs_buf != size_bs_ext) {
+        /* the frame bitstream buffer has been enlarged */
+        encoder_mem_update(h->h_top, XAVS2_MEMCAT_BITSTREAM, h->fenc->i_bs_buf - size_bs_ext, size_bs_ext);
+    }
+
+    if (h->param->b_slice_auto) {
+        xavs2_slices_update_stat(h);
+    }
+    xavs2_slices_update_row_time(h);
 
 #if XAVS2_STAT
     /* collect frame properties */
@@ -890,8 +1039,9 @@ static void encoder_decide_level_id(xavs2_param_t *param)
  */
 int encoder_check_parameters(xavs2_param_t *param)
 {
-    int num_max_slice = ((param->org_height + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level) >> 1;
-    num_max_slice = XAVS2_MAX(2, num_max_slice);
+    int num_lcu_rows  = (param->org_height + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level;
+    int num_max_slice = XAVS2_MAX(2, num_lcu_rows >> 1);
+    int i;
 
     /* check number of threaded frames */
     if (param->i_frame_threads > MAX_PARALLEL_FRAMES) {
@@ -900,8 +1050,12 @@ int encoder_check_parameters(xavs2_param_t *param)
         return -1;
     }
 
-    /* check slice number */
-    if (param->slice_num > MAX_SLICES || param->slice_num > num_max_slice) {
+    /* check slice number, 0: decided for each frame, at most LcuRows/2 slices */
+    if (param->slice_num == 0 || param->b_slice_auto) {
+        param->b_slice_auto = 1;
+        param->slice_num    = XAVS2_MAX(1, XAVS2_MIN(MAX_SLICES, num_lcu_rows >> 1));
+    }
+    if (param->slice_num < 1 || param->slice_num > MAX_SLICES || param->slice_num > num_max_slice) {
         xavs2_log(NULL, XAVS2_LOG_ERROR, "too many slices : %d. exceeds MAX_SLICES (%d) or LcuRows/2 (%d).\n", 
             param->slice_num, MAX_SLICES, num_max_slice);
         return -1;
@@ -980,13 +1134,84 @@ int encoder_check_parameters(xavs2_param_t *param)
         xavs2_log(NULL, XAVS2_LOG_ERROR, "Error found in RPS configuration!\n");
         return -1;
     }
+    /* gradual intra refresh */
+    if (param->intra_refresh < 0) {
+        param->intra_refresh = 0;
+    } else if (param->intra_refresh > 0 && param->successive_Bframe != 0) {
+        xavs2_log(NULL, XAVS2_LOG_WARNING, "Gradual intra refresh disabled since it is for low delay coding only\n");
+        param->intra_refresh = 0;
+    } else if (param->intra_refresh > 0 && param->InterlaceCodingOption == FIELD_CODING) {
+        xavs2_log(NULL, XAVS2_LOG_WARNING, "Gradual intra refresh disabled since field coding is enabled\n");
+        param->intra_refresh = 0;
+    } else if (param->intra_refresh > 0) {
+        if (param->intra_period != 0) {
+            xavs2_log(NULL, XAVS2_LOG_WARNING, "Intra period is disabled by gradual intra refresh\n");
+            param->intra_period = 0;
+        }
+        param->intra_refresh = XAVS2_MAX(param->intra_refresh, 2);
+        param->enable_intra  = 1;
+    }
     /* GOP parallel encoding */
     if (param->num_parallel_gop < 1) {
         param->num_parallel_gop = 1;
+    } else if (param->num_parallel_gop > 1 && param->intra_period < 1) {
+        xavs2_log(NULL, XAVS2_LOG_WARNING, "GOP parallel encoding disabled since there is no intra period\n");
+        param->num_parallel_gop = 1;
     } else if (param->num_parallel_gop > 1 && param->b_open_gop) {
         xavs2_log(NULL, XAVS2_LOG_WARNING, "Only ClosedGOP can be utilized with GOP parallel encoding\n");
         param->b_open_gop = FALSE;
     }
+    param->num_parallel_gop = XAVS2_MIN(param->num_parallel_gop, MAX_PARALLEL_GOPS);
+
+    /* in-loop filter stage */
+    param->i_lf_threads = XAVS2_CLIP3(0, XAVS2_THREAD_MAX, param->i_lf_threads);
+
+    /* thread affinity */
+    if (param->thread_affinity < 0 || param->thread_affinity > 2) {
+        xavs2_log(NULL, XAVS2_LOG_WARNING, "Invalid ThreadAffinity %d, pinning disabled\n", param->thread_affinity);
+        param->thread_affinity = 0;
+    }
+
+    /* segment encoding */
+    if (param->b_segment) {
+        if (param->b_open_gop) {
+            xavs2_log(NULL, XAVS2_LOG_WARNING, "Only ClosedGOP can be utilized with segment encoding\n");
+            param->b_open_gop = FALSE;
+        }
+        if (param->segment_start_frame < 0) {
+            xavs2_log(NULL, XAVS2_LOG_ERROR, "Error input parameter SegmentStartFrame %d\n", param->segment_start_frame);
+            return -1;
+        }
+    } else {
+        param->segment_start_frame = 0;
+        param->segment_rc_qp       = 0;
+        param->segment_rc_buffer   = 0;
+        param->segment_refs        = 0;
+    }
+
+    /* ladder encoding */
+    if (param->num_ladder > 0) {
+        if (param->num_ladder >= MAX_LADDER_RENDITIONS) {
+            xavs2_log(NULL, XAVS2_LOG_ERROR, "Error input parameter LadderNum %d, should be less than %d\n",
+                      param->num_ladder, MAX_LADDER_RENDITIONS);
+            return -1;
+        }
+        if (param->num_parallel_gop > 1) {
+            xavs2_log(NULL, XAVS2_LOG_WARNING, "GOP parallel encoding disabled since ladder encoding is enabled\n");
+            param->num_parallel_gop = 1;
+        }
+        param->ladder_width [0] = param->org_width;
+        param->ladder_height[0] = param->org_height;
+        for (i = 1; i <= param->num_ladder; i++) {
+            if (param->ladder_width[i] <= 0 || param->ladder_width[i] > param->org_width ||
+                param->ladder_height[i] <= 0 || param->ladder_height[i] > param->org_height ||
+                (param->ladder_width[i] & 1) || (param->ladder_height[i] & 1)) {
+                xavs2_log(NULL, XAVS2_LOG_ERROR, "Error input parameters of rendition %d: %dx%d\n",
+                          i, param->ladder_width[i], param->ladder_height[i]);
+                return -1;
+            }
+        }
+    }
 
     /* check preset level */
     if (param->preset_level < 0 || param->preset_level > 9) {
@@ -1034,6 +1259,12 @@ int encoder_check_parameters(xavs2_param_t *param)
         return -1;
     }
 
+    /* check memory allocation backend */
+    if (param->mem_alloc_mode < XAVS2_MEM_SYSTEM || param->mem_alloc_mode > XAVS2_MEM_HUGETLB) {
+        xavs2_log(NULL, XAVS2_LOG_WARNING, "Invalid MemAllocMode %d, system malloc is used\n", param->mem_alloc_mode);
+        param->mem_alloc_mode = XAVS2_MEM_SYSTEM;
+    }
+
     /* check ALF configuration */
     if (param->i_frame_threads != 1 && param->enable_alf != 0) {
         param->enable_alf = 0;
@@ -1076,8 +1307,8 @@ int encoder_check_parameters(xavs2_param_t *param)
         param->num_max_ref = 1;
     }
 
-    /* enable TDRDO? TDRDO is only just for low delay */
-    if (param->successive_Bframe != 0 || param->intra_period > 0) {
+    /* enable TDRDO? there is no temporal dependency in all intra coding */
+    if (param->intra_period == 1) {
         param->enable_tdrdo = 0;
     }
 
@@ -1095,6 +1326,149 @@ int encoder_check_parameters(xavs2_param_t *param)
     return 0;
 }
 
+/* ---------------------------------------------------------------------------
+ * apply the rate control, GOP parameters and frame size of an encoder reset to
+ * the checked parameters in use, the others decide the allocated buffers and are kept
+ */
+int encoder_reset_parameters(xavs2_param_t *param, const xavs2_param_t *p_new)
+{
+    xavs2_param_t *p_tmp;
+    int intra_period = p_new->intra_period;
+    int org_height   = p_new->org_height;
+    int max_qp       = 63 + (param->sample_bit_depth - 8) * 8;
+    int num_lcu_rows;
+
+    if (param->intra_refresh > 0) {
+        intra_period = 0;             /* key frames are replaced by the gradual intra refresh */
+    }
+    if (param->InterlaceCodingOption == FIELD_CODING) {
+        intra_period = intra_period << 1;
+        org_height   = org_height   >> 1;
+    }
+    num_lcu_rows = (org_height + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level;
+
+    /* check frame size, the limit of buffers is checked by the caller */
+    if (p_new->org_width != param->org_width || org_height != param->org_height) {
+        if (param->num_ladder > 0) {
+            xavs2_log(NULL, XAVS2_LOG_ERROR, "Can not change the frame size of ladder encoding on reset\n");
+            return -1;
+        }
+        if (p_new->org_width <= 0 || org_height <= 0 || (p_new->org_width & 1) || (p_new->org_height & 1)) {
+            xavs2_log(NULL, XAVS2_LOG_ERROR, "Error frame size for reset: %dx%d\n", p_new->org_width, p_new->org_height);
+            return -1;
+        }
+        if (!param->b_slice_auto && param->slice_num > XAVS2_MAX(2, num_lcu_rows >> 1)) {
+            xavs2_log(NULL, XAVS2_LOG_ERROR, "too many slices : %d. exceeds LcuRows/2 (%d) of the new frame size.\n",
+                      param->slice_num, XAVS2_MAX(2, num_lcu_rows >> 1));
+            return -1;
+        }
+    }
+
+    /* check QP */
+    if (p_new->i_initial_qp > MAX_QP || p_new->i_initial_qp < MIN_QP) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Error input parameter quant_0 for reset\n");
+        return -1;
+    }
+
+    /* check GOP structure */
+    if ((intra_period == 1) != (param->intra_period == 1)) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Can not switch between all intra and inter coding on reset\n");
+        return -1;
+    }
+    if (param->num_parallel_gop > 1 && intra_period < 1) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "An intra period is required by GOP parallel encoding\n");
+        return -1;
+    }
+
+    /* check LevelID of the new bitrate */
+    if ((p_tmp = (xavs2_param_t *)xavs2_malloc(sizeof(xavs2_param_t))) == NULL) {
+        return -1;
+    }
+    memcpy(p_tmp, param, sizeof(xavs2_param_t));
+    p_tmp->org_width        = p_new->org_width;
+    p_tmp->org_height       = org_height;
+    p_tmp->i_rc_method      = p_new->i_rc_method;
+    p_tmp->i_target_bitrate = p_new->i_target_bitrate;
+    p_tmp->bitrate_upper    = (p_new->i_target_bitrate / 400) >> 18;
+    encoder_decide_level_id(p_tmp);
+    if (p_tmp->level_id <= 0 || p_tmp->level_id > 0x6A) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Not Supported LevelID: %dx%d, %.3f fps, %d bps!\n",
+                  p_tmp->org_width, p_tmp->org_height, param->frame_rate, p_new->i_target_bitrate);
+        xavs2_free(p_tmp);
+        return -1;
+    }
+    /* MV range of the frame contexts is decided by the LevelID on creation,
+     * it is still conforming to a higher level. the contexts are created
+     * again when the frame size changes */
+    if (p_tmp->org_width != param->org_width || p_tmp->org_height != param->org_height) {
+        param->level_id = p_tmp->level_id;
+    } else {
+        param->level_id = XAVS2_MAX(param->level_id, p_tmp->level_id);
+    }
+    xavs2_free(p_tmp);
+
+    /* apply */
+    param->org_width        = p_new->org_width;
+    param->org_height       = org_height;
+    if (param->b_slice_auto) {
+        param->slice_num    = XAVS2_MAX(1, XAVS2_MIN(MAX_SLICES, num_lcu_rows >> 1));
+    }
+    param->intra_period     = intra_period;
+    param->i_rc_method      = p_new->i_rc_method;
+    param->i_target_bitrate = p_new->i_target_bitrate;
+    param->i_max_qp         = XAVS2_MIN(p_new->i_max_qp, max_qp);
+    param->i_min_qp         = XAVS2_MAX(p_new->i_min_qp, 0);
+    param->i_initial_qp     = XAVS2_CLIP3(param->i_min_qp, param->i_max_qp, p_new->i_initial_qp);
+    param->bitrate_lower    = (param->i_target_bitrate / 400) & 0x3FFFF;   /* lower 18 bits */
+    param->bitrate_upper    = (param->i_target_bitrate / 400) >> 18;       /* upper 12 bits */
+
+#if !ENABLE_RATE_CONTROL_CU
+    if (param->i_rc_method == XAVS2_RC_CBR_SCU) {
+        param->i_rc_method = XAVS2_RC_CBR_FRM;
+    }
+#endif
+    param->fixed_picture_qp = (param->i_rc_method == XAVS2_RC_CBR_SCU) ? FALSE : TRUE;
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * check a target bitrate set at runtime, the LevelID of the sequence headers
+ * can not be raised within a sequence
+ */
+int encoder_check_bitrate(const xavs2_param_t *param, int bitrate)
+{
+    xavs2_param_t *p_tmp;
+    int level_id;
+
+    if (param->i_rc_method == XAVS2_RC_CQP) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Bitrate can not be changed without rate control\n");
+        return -1;
+    }
+    if (bitrate <= 0) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Error target bitrate: %d bps\n", bitrate);
+        return -1;
+    }
+
+    if ((p_tmp = (xavs2_param_t *)xavs2_malloc(sizeof(xavs2_param_t))) == NULL) {
+        return -1;
+    }
+    memcpy(p_tmp, param, sizeof(xavs2_param_t));
+    p_tmp->i_target_bitrate = bitrate;
+    p_tmp->bitrate_upper    = (bitrate / 400) >> 18;
+    encoder_decide_level_id(p_tmp);
+    level_id = p_tmp->level_id;
+    xavs2_free(p_tmp);
+
+    if (level_id <= 0 || level_id > param->level_id) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Bitrate %d bps exceeds LevelID 0x%02X, reset the encoder for it\n",
+                  bitrate, param->level_id);
+        return -1;
+    }
+
+    return 0;
+}
+
 /* ---------------------------------------------------------------------------
  * assign pointers for all coding tree units (till 4x4 CU)
  */
@@ -1132,12 +1506,125 @@ static void build_coding_tree(xavs2_t *h, cu_t *p_cu, int idx_zorder, int i_leve
 }
 
 /* ---------------------------------------------------------------------------
+ * get the memory size of the LCU scratch buffers of one encoding context:
+ * the buffers of each CU layer are sized for the CU size of that layer and
+ * the intra prediction buffers for the LCU size
  */
 static
-xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_encoder)
+size_t encoder_get_lcu_buffer_size(const xavs2_param_t *param)
+{
+    size_t size_lcu = (size_t)1 << (param->lcu_bit_level << 1);    /* number of luma pixels in a LCU */
+    size_t mem_size = 0;
+    int level;
+
+    for (level = param->scu_bit_level; level <= param->lcu_bit_level; level++) {
+        size_t size_cu = (size_t)1 << (level << 1);                 /* number of luma pixels in a CU */
+
+        mem_size += (size_cu * 3 + (size_cu >> 2) * 6) * sizeof(pel_t)   + /* reconstruction buffers */
+                    (size_cu * 3 + (size_cu >> 2) * 6) * sizeof(coeff_t) + /* coefficient buffers */
+                    (size_cu * 2) * sizeof(pel_t)                        + /* inter prediction buffers */
+                    CACHE_LINE_SIZE * 20;
+    }
+
+    mem_size += (size_lcu     ) * NUM_INTRA_MODE        * sizeof(pel_t) +  /* luma   intra prediction buffers */
+                (size_lcu >> 1) * NUM_INTRA_MODE_CHROMA * sizeof(pel_t) +  /* chroma intra prediction buffers */
+                CACHE_LINE_SIZE * (NUM_INTRA_MODE + NUM_INTRA_MODE_CHROMA + 1);
+
+    return mem_size;
+}
+
+/* ---------------------------------------------------------------------------
+ * assign the LCU scratch buffers of one encoding context
+ */
+static
+void encoder_init_lcu_buffers(xavs2_t *h, uint8_t **mem_base)
+{
+    cu_parallel_t *p_enc = &h->lcu.cu_enc[0];
+    uint8_t *mem_ptr = *mem_base;
+    int size_lcu = 1 << (h->i_lcu_level << 1);
+    int level, i, k;
+
+    ALIGN_POINTER(mem_ptr);
+
+    /* CU layers, no buffer for the levels that will never be coded */
+    memset(h->lcu.cu_layer, 0, sizeof(h->lcu.cu_layer));
+    for (level = h->i_scu_level; level <= h->i_lcu_level; level++) {
+        cu_layer_t *p_layer = cu_get_layer(h, level);
+        int size_cu = 1 << (level << 1);
+
+        for (i = 0; i < 3; i++) {
+            p_layer->rec_buf_y[i]  = (pel_t *)mem_ptr;
+            mem_ptr += size_cu * sizeof(pel_t);
+            ALIGN_POINTER(mem_ptr);
+            p_layer->coef_buf_y[i] = (coeff_t *)mem_ptr;
+            mem_ptr += size_cu * sizeof(coeff_t);
+            ALIGN_POINTER(mem_ptr);
+
+            for (k = 0; k < 2; k++) {
+                p_layer->rec_buf_uv[k][i]  = (pel_t *)mem_ptr;
+                mem_ptr += (size_cu >> 2) * sizeof(pel_t);
+                ALIGN_POINTER(mem_ptr);
+                p_layer->coef_buf_uv[k][i] = (coeff_t *)mem_ptr;
+                mem_ptr += (size_cu >> 2) * sizeof(coeff_t);
+                ALIGN_POINTER(mem_ptr);
+            }
+        }
+
+        for (i = 0; i < 2; i++) {
+            p_layer->buf_pred_inter_luma[i] = (pel_t *)mem_ptr;
+            mem_ptr += size_cu * sizeof(pel_t);
+            ALIGN_POINTER(mem_ptr);
+        }
+    }
+
+    /* intra prediction buffers */
+    for (i = 0; i < NUM_INTRA_MODE; i++) {
+        p_enc->intra_pred[i] = (pel_t *)mem_ptr;
+        mem_ptr += size_lcu * sizeof(pel_t);
+        ALIGN_POINTER(mem_ptr);
+    }
+    for (i = 0; i < NUM_INTRA_MODE_CHROMA; i++) {
+        p_enc->intra_pred_c[i] = (pel_t *)mem_ptr;
+        mem_ptr += (size_lcu >> 1) * sizeof(pel_t);
+        ALIGN_POINTER(mem_ptr);
+    }
+
+    *mem_base = mem_ptr;
+}
+
+/* ---------------------------------------------------------------------------
+ * get the memory size of one row context (including its LCU scratch buffers)
+ */
+size_t encoder_get_row_context_size(const xavs2_param_t *param)
+{
+    return sizeof(xavs2_t) + encoder_get_lcu_buffer_size(param);
+}
+
+/* ---------------------------------------------------------------------------
+ * get the initial size of the bitstream buffer of one slice: about one bit
+ * per pixel plus the room reserved for one LCU, the buffer is enlarged on
+ * demand while writing the LCUs (see slice_bs_reserve)
+ */
+static int encoder_get_slice_bs_size(const xavs2_param_t *param)
+{
+    int frame_w  = ((param->org_width  + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int frame_h  = ((param->org_height + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int size_lcu = 1 << param->lcu_bit_level;
+    int h_in_lcu = (frame_h + size_lcu - 1) >> param->lcu_bit_level;
+    int num_rows = (h_in_lcu + param->slice_num - 1) / param->slice_num;
+    int bs_size  = ((frame_w * size_lcu * num_rows) >> 3) + PSEUDO_CODE_SIZE + LCU_BS_RESERVE(param->lcu_bit_level);
+
+    return (bs_size + 255) >> 8 << 8;
+}
+
+/* ---------------------------------------------------------------------------
+ * get the memory size of one frame context,
+ * the initial size of its slice bitstream buffers (allocated separately) is
+ * returned by size_bs
+ */
+size_t encoder_get_frame_context_size(const xavs2_param_t *param, size_t *size_bs)
 {
     const int num_slices = param->slice_num;
-    xavs2_t *h = NULL;
     int frame_w  = ((param->org_width  + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
     int frame_h  = ((param->org_height + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
     int size_lcu = 1 << param->lcu_bit_level;       /* size of a LCU (largest coding unit) */
@@ -1147,7 +1634,6 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
     int h_in_scu = frame_h >> MIN_CU_SIZE_IN_BIT;
     int w_in_4x4 = frame_w >> MIN_PU_SIZE_IN_BIT;
     int h_in_4x4 = frame_h >> MIN_PU_SIZE_IN_BIT;
-    int bs_size  = frame_w * frame_h * 2;
     int ipm_size = (w_in_4x4 + 16) * ((size_lcu >> MIN_PU_SIZE_IN_BIT) + 1);
     int size_4x4 = w_in_4x4 * h_in_4x4;
     int qpel_frame_size = (frame_w + 2 * XAVS2_PAD) * (frame_h + 2 * XAVS2_PAD);
@@ -1157,25 +1643,22 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
     int size_sao_param = w_in_lcu * h_in_lcu * sizeof(SAOBlkParam[NUM_SAO_COMPONENTS]);
     int size_sao_onoff = h_in_lcu * sizeof(int[NUM_SAO_COMPONENTS]);
 
-    size_t size_alf = alf_get_buffer_size(param);
+    size_t size_alf = param->enable_alf ? alf_get_buffer_size(param) : 0;
     int frame_size_in_scu = w_in_scu * h_in_scu;
     int num_me_bytes = (w_in_4x4 * h_in_4x4)* sizeof(dist_t[MAX_INTER_MODES][MAX_REFS]);
     size_t size_extra_frame_buffer = 0;
-    int i, j;
-    int scu_xy = 0;
-    cu_info_t *p_cu_info;
     size_t mem_size = 0;
-    uint8_t *mem_base;
 
     num_me_bytes = (num_me_bytes + 255) >> 8 << 8;    /* align number of bytes to 256 */
     qpel_frame_size = (qpel_frame_size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
-    size_extra_frame_buffer = (param->enable_tdrdo + param->enable_sao + param->enable_alf) * xavs2_frame_buffer_size(param, FT_TEMP);
+    size_extra_frame_buffer = (param->enable_sao + param->enable_alf) * xavs2_frame_buffer_size(param, FT_TEMP);
 
-    /* compute the space size and alloc buffer */
+    /* compute the space size */
     mem_size = sizeof(xavs2_t)                       +  /* xavs2_t */
+               encoder_get_lcu_buffer_size(param)    +  /* LCU scratch buffers */
                sizeof(nal_t)   * (MAX_SLICES + 6)    +  /* all nal units */
                sizeof(uint8_t) * XAVS2_BS_HEAD_LEN   +  /* bitstream buffer (frame header only) */
-               sizeof(uint8_t) * bs_size             +  /* bitstream buffer for all slices */
+               sizeof(slice_row_index_t) * h_in_lcu  +  /* coding order of LCU rows */
                sizeof(slice_t) * MAX_SLICES          +  /* slice array */
                sizeof(pel_t)   * (frame_w * 2) * num_slices + /* buffer for intra_border */
                sizeof(uint8_t) * w_in_scu * 32 * num_slices + /* buffer for edge filter flag (of one LCU row) */
@@ -1189,6 +1672,7 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
                xavs2_me_get_buf_size(param)          +  /* buffers in me module */
                info_size                             +  /* the frame info structure */
                frame_size_in_scu * sizeof(cu_info_t) +  /* CU data */
+               frame_size_in_scu * sizeof(int8_t) * 5 + CACHE_LINE_SIZE * 5 + /* per-SCU planes of CU data */
                num_me_bytes                          +  /* Motion Estimation */
                w_in_lcu * h_in_lcu * sizeof(int8_t)  +  /* CTU slice index */
                size_extra_frame_buffer               +  /* extra frame buffer: TDRDO, SAO, ALF */
@@ -1200,9 +1684,55 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
                size_alf + CACHE_LINE_SIZE            +  /* ALF encoder contexts */
                CACHE_LINE_SIZE * 30;                    /* used for align buffer */
 
-    /* alloc memory space */
     mem_size = ((mem_size + CACHE_LINE_SIZE - 1) / CACHE_LINE_SIZE) * CACHE_LINE_SIZE;
-    CHECKED_MALLOC(mem_base, uint8_t *, mem_size);
+
+    if (size_bs != NULL) {
+        *size_bs = sizeof(uint8_t) * encoder_get_slice_bs_size(param) * num_slices;
+    }
+
+    return mem_size;
+}
+
+/* ---------------------------------------------------------------------------
+ */
+static
+xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_encoder)
+{
+    const int num_slices = param->slice_num;
+    xavs2_t *h = NULL;
+    int frame_w  = ((param->org_width  + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int frame_h  = ((param->org_height + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int size_lcu = 1 << param->lcu_bit_level;       /* size of a LCU (largest coding unit) */
+    int w_in_lcu = (frame_w + size_lcu - 1) >> param->lcu_bit_level;
+    int h_in_lcu = (frame_h + size_lcu - 1) >> param->lcu_bit_level;
+    int w_in_scu = frame_w >> MIN_CU_SIZE_IN_BIT;
+    int h_in_scu = frame_h >> MIN_CU_SIZE_IN_BIT;
+    int w_in_4x4 = frame_w >> MIN_PU_SIZE_IN_BIT;
+    int h_in_4x4 = frame_h >> MIN_PU_SIZE_IN_BIT;
+    int bs_size  = encoder_get_slice_bs_size(param);
+    int ipm_size = (w_in_4x4 + 16) * ((size_lcu >> MIN_PU_SIZE_IN_BIT) + 1);
+    int size_4x4 = w_in_4x4 * h_in_4x4;
+    int qpel_frame_size = (frame_w + 2 * XAVS2_PAD) * (frame_h + 2 * XAVS2_PAD);
+
+    int size_sao_stats = w_in_lcu * h_in_lcu * sizeof(SAOStatData[NUM_SAO_COMPONENTS][NUM_SAO_NEW_TYPES]);
+    int size_sao_param = w_in_lcu * h_in_lcu * sizeof(SAOBlkParam[NUM_SAO_COMPONENTS]);
+    int size_sao_onoff = h_in_lcu * sizeof(int[NUM_SAO_COMPONENTS]);
+
+    size_t size_alf = param->enable_alf ? alf_get_buffer_size(param) : 0;
+    int frame_size_in_scu = w_in_scu * h_in_scu;
+    int num_me_bytes = (w_in_4x4 * h_in_4x4)* sizeof(dist_t[MAX_INTER_MODES][MAX_REFS]);
+    int i, j;
+    int scu_xy = 0;
+    cu_info_t *p_cu_info;
+    size_t mem_size = 0;
+    uint8_t *mem_base;
+
+    num_me_bytes = (num_me_bytes + 255) >> 8 << 8;    /* align number of bytes to 256 */
+    qpel_frame_size = (qpel_frame_size + CACHE_LINE_SIZE - 1) & ~(CACHE_LINE_SIZE - 1);
+
+    /* alloc memory space */
+    mem_size = encoder_get_frame_context_size(param, NULL);
+    CHECKED_MALLOC_MODE(mem_base, uint8_t *, mem_size, param->mem_alloc_mode);
 
     /* assign handle pointer of the xavs2 encoder */
     h = (xavs2_t *)mem_base;
@@ -1257,18 +1787,19 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
     mem_base          += sizeof(uint8_t) * XAVS2_BS_HEAD_LEN;
     ALIGN_POINTER(mem_base);    /* align pointer */
 
-    /* bitstream buffer for all slices */
-    h->p_bs_buf_slice = mem_base;
-    h->i_bs_buf_slice = sizeof(uint8_t) * bs_size;
-    mem_base         += sizeof(uint8_t) * bs_size;
+    /* coding order of LCU rows */
+    h->lcu_row_order = (slice_row_index_t *)mem_base;
+    mem_base        += sizeof(slice_row_index_t) * h_in_lcu;
     ALIGN_POINTER(mem_base);    /* align pointer */
 
+
     /* slice array */
     for (i = 0; i < num_slices; i++) {
         slice_t *p_slice = (slice_t *)mem_base;
         h->slices[i] = p_slice;
         mem_base    += sizeof(slice_t);
         ALIGN_POINTER(mem_base);    /* align pointer */
+        p_slice->h   = h;
 
         /* intra prediction mode buffer */
         p_slice->slice_ipredmode  = (int8_t *)mem_base;
@@ -1293,6 +1824,18 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
         p_slice->slice_deblock_flag[1] = (uint8_t *)mem_base;
         mem_base            += h->i_width_in_mincu * (MAX_CU_SIZE / MIN_PU_SIZE) * sizeof(uint8_t);
         ALIGN_POINTER(mem_base);
+
+        /* bitstream buffer of the slice */
+        p_slice->p_slice_bs_buf   = NULL;
+        p_slice->len_slice_bs_buf = 0;
+    }
+
+    /* bitstream buffers are allocated separately, so that they can be enlarged */
+    for (i = 0; i < num_slices; i++) {
+        slice_t *p_slice = h->slices[i];
+        CHECKED_MALLOC(p_slice->p_slice_bs_buf, uint8_t *, sizeof(uint8_t) * bs_size);
+        p_slice->len_slice_bs_buf = bs_size;
+        h->i_bs_buf_slice        += bs_size;
     }
 
     slice_init_bufer(h, h->slices[0]);
@@ -1317,6 +1860,9 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
     h->lcu.p_fdec[1] = h->lcu.fdec_buf + FDEC_STRIDE * MAX_CU_SIZE;
     h->lcu.p_fdec[2] = h->lcu.fdec_buf + FDEC_STRIDE * MAX_CU_SIZE + (FDEC_STRIDE / 2);
 
+    /* LCU scratch buffers */
+    encoder_init_lcu_buffers(h, &mem_base);
+
     /* slice index of CTUs */
     h->lcu_slice_idx = (int8_t *)mem_base;
     mem_base += w_in_lcu * h_in_lcu * sizeof(int8_t);
@@ -1392,9 +1938,10 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
     for (i = 0; i < h_in_lcu; i++) {
         row_info_t *row = &h->frameinfo->rows[i];
 
-        row->h     = 0;
-        row->row   = i;
-        row->coded = -1;
+        row->h        = 0;
+        row->row      = i;
+        row->coded    = -1;
+        row->filtered = -1;
         row->lcus  = (lcu_info_t *)mem_base;
         mem_base  += sizeof(lcu_info_t) * w_in_lcu;
 
@@ -1428,19 +1975,30 @@ xavs2_t *encoder_create_frame_context(const xavs2_param_t *param, int idx_frm_en
         }
     }
 
+    /* per-SCU planes of CU data */
+    h->scu_level    = (int8_t *)mem_base;
+    mem_base       += frame_size_in_scu * sizeof(int8_t);
+    ALIGN_POINTER(mem_base);
+    h->scu_mode     = (int8_t *)mem_base;
+    mem_base       += frame_size_in_scu * sizeof(int8_t);
+    ALIGN_POINTER(mem_base);
+    h->scu_cbp      = (int8_t *)mem_base;
+    mem_base       += frame_size_in_scu * sizeof(int8_t);
+    ALIGN_POINTER(mem_base);
+    h->scu_tu_split = (int8_t *)mem_base;
+    mem_base       += frame_size_in_scu * sizeof(int8_t);
+    ALIGN_POINTER(mem_base);
+#if ENABLE_RATE_CONTROL_CU
+    h->scu_qp       = (int8_t *)mem_base;
+    mem_base       += frame_size_in_scu * sizeof(int8_t);
+    ALIGN_POINTER(mem_base);
+#endif
+
     /* motion estimation buffer */
     h->all_mincost = (dist_t(*)[MAX_INTER_MODES][MAX_REFS])mem_base;
     mem_base += num_me_bytes;
     ALIGN_POINTER(mem_base);
     
-    // allocate memory for current frame
-    if (h->param->enable_tdrdo) {
-        h->img_luma_pre = xavs2_frame_new(h, &mem_base, FT_TEMP);
-        ALIGN_POINTER(mem_base);
-    } else {
-        h->img_luma_pre = NULL;
-    }
-
     if (h->param->enable_sao) {
         h->img_sao = xavs2_frame_new(h, &mem_base, FT_TEMP);
         ALIGN_POINTER(mem_base);
@@ -1492,7 +2050,6 @@ static void encoder_destroy_frame_context(xavs2_t *h)
     assert(h != NULL);
     assert(h->task_type == XAVS2_TASK_FRAME);
 
-    h->img_luma_pre = NULL;
     h->img_sao      = NULL;
     h->img_alf = NULL;
     h->enc_alf = NULL;
@@ -1509,6 +2066,12 @@ static void encoder_destroy_frame_context(xavs2_t *h)
         }
     }
 
+    /* free bitstream buffers of slices */
+    for (i = 0; i < h->param->slice_num; i++) {
+        xavs2_free(h->slices[i]->p_slice_bs_buf);
+        h->slices[i]->p_slice_bs_buf = NULL;
+    }
+
     xavs2_free(h);
 }
 
@@ -1522,10 +2085,18 @@ int encoder_contexts_init(xavs2_t *h, xavs2_handler_t *h_mgr)
     /* -------------------------------------------------------------
      * build lcu row encoding contexts */
     if (h_mgr->num_row_contexts > 1) {
-        CHECKED_MALLOC(h_mgr->row_contexts, xavs2_t *, h_mgr->num_row_contexts * sizeof(xavs2_t));
+        size_t size_lcu_buf = encoder_get_row_context_size(h->param) - sizeof(xavs2_t);
+        uint8_t *mem_ptr;
+
+        /* contexts first, followed by their LCU scratch buffers */
+        CHECKED_MALLOC_MODE(mem_ptr, uint8_t *, h_mgr->num_row_contexts * (sizeof(xavs2_t) + size_lcu_buf),
+                            h->param->mem_alloc_mode);
+        h_mgr->row_contexts = (xavs2_t *)mem_ptr;
+        mem_ptr += h_mgr->num_row_contexts * sizeof(xavs2_t);
 
         for (i = 0; i < h_mgr->num_row_contexts; i++) {
             xavs2_t *h_row_coder = &h_mgr->row_contexts[i];
+            uint8_t *mem_lcu_buf = mem_ptr + i * size_lcu_buf;
 
             memcpy(&h_row_coder->communal_vars_1, &h->communal_vars_1,
                    (uint8_t *)&h->communal_vars_2 - (uint8_t *)&h->communal_vars_1);
@@ -1551,27 +2122,93 @@ int encoder_contexts_init(xavs2_t *h, xavs2_handler_t *h_mgr)
             h_row_coder->lcu.p_fdec[0] = h_row_coder->lcu.fdec_buf;
             h_row_coder->lcu.p_fdec[1] = h_row_coder->lcu.fdec_buf + FDEC_STRIDE * MAX_CU_SIZE;
             h_row_coder->lcu.p_fdec[2] = h_row_coder->lcu.fdec_buf + FDEC_STRIDE * MAX_CU_SIZE + FDEC_STRIDE / 2;
+
+            /* LCU scratch buffers */
+            encoder_init_lcu_buffers(h_row_coder, &mem_lcu_buf);
         }
     }
 
     /* -------------------------------------------------------------
-     * build frame encoding contexts */
-    h_mgr->frm_contexts[0] = h; /* context 0 is the main encoder handle */
-    for (i = 1; i < h_mgr->i_frm_threads; i++) {
-        if ((h_mgr->frm_contexts[i] = encoder_create_frame_context(h->param, i)) == 0) {
-            goto fail;
-        }
+     * build in-loop filter contexts, no LCU buffer is needed for filtering */
+    if (h_mgr->num_lf_contexts > 0) {
+        CHECKED_MALLOCZERO(h_mgr->lf_contexts, xavs2_t *, h_mgr->num_lf_contexts * sizeof(xavs2_t));
 
-        memcpy(&h_mgr->frm_contexts[i]->communal_vars_1, &h->communal_vars_1,
-               (uint8_t *)&h->communal_vars_2 - (uint8_t *)&h->communal_vars_1);
+        for (i = 0; i < h_mgr->num_lf_contexts; i++) {
+            xavs2_t *h_lf = &h_mgr->lf_contexts[i];
+
+            memcpy(&h_lf->communal_vars_1, &h->communal_vars_1,
+                   (uint8_t *)&h->communal_vars_2 - (uint8_t *)&h->communal_vars_1);
+
+            h_lf->task_type   = XAVS2_TASK_ROW;
+            h_lf->task_status = XAVS2_TASK_FREE;
+            h_lf->i_aec_frm   = -1;
+            h_lf->lcu.p_ctu   = &h_lf->lcu.all_cu[0];
+        }
     }
 
+    /* -------------------------------------------------------------
+     * frame encoding contexts: the others are opened on first use,
+     * see encoder_contexts_open_frame() */
+    h_mgr->frm_contexts[0] = h; /* context 0 is the main encoder handle */
+
     return 0;
 
 fail:
     return -1;
 }
 
+/* ---------------------------------------------------------------------------
+ * open a frame encoding context once all the opened ones are busy, so that
+ * encoders with many frame threads start without waiting for all of them
+ */
+xavs2_t *encoder_contexts_open_frame(xavs2_handler_t *h_mgr, int idx_frm_encoder)
+{
+    xavs2_t *h_main = h_mgr->frm_contexts[0];
+    xavs2_t *h;
+
+    /* the main context is opened on creation, it is the template of the others */
+    if (h_main == NULL || idx_frm_encoder <= 0) {
+        return NULL;
+    }
+
+    if ((h = encoder_create_frame_context(h_main->param, idx_frm_encoder)) == NULL) {
+        return NULL;
+    }
+
+    /* copy the shared variables, delimited by communal_vars_1 and communal_vars_2 */
+    memcpy(&h->communal_vars_1, &h_main->communal_vars_1,
+           (uint8_t *)&h_main->communal_vars_2 - (uint8_t *)&h_main->communal_vars_1);
+
+    /* the main context may be busy, the new one is free */
+    h->task_type   = XAVS2_TASK_FRAME;
+    h->task_status = XAVS2_TASK_FREE;
+    h->i_aec_frm   = -1;
+    h->b_all_row_ctx_released = 0;
+
+    h_mgr->frm_contexts[idx_frm_encoder] = h;
+
+    encoder_mem_update(h_mgr, XAVS2_MEMCAT_FRAME_CTX, encoder_get_frame_context_size(h->param, NULL), 0);
+    encoder_mem_update(h_mgr, XAVS2_MEMCAT_BITSTREAM, h->i_bs_buf_slice, 0);
+
+    return h;
+}
+
+/* ---------------------------------------------------------------------------
+ * account the bytes allocated (size_add > 0) or released (size_add < 0) by an
+ * encoder after its creation. size_held bytes are held besides them for a
+ * moment, e.g. the old buffer while a buffer is enlarged
+ */
+void encoder_mem_update(xavs2_handler_t *h_mgr, int category, int64_t size_add, int64_t size_held)
+{
+    xavs2_mem_stat_t *stat = &h_mgr->mem_stat;
+
+    xavs2_thread_mutex_lock(&h_mgr->mutex_mem);
+    stat->size[category] += size_add;
+    stat->total          += size_add;
+    stat->peak            = XAVS2_MAX(stat->peak, stat->total + size_held);
+    xavs2_thread_mutex_unlock(&h_mgr->mutex_mem);
+}
+
 /* ---------------------------------------------------------------------------
  * free all contexts except for the main context : xavs2_handler_t::contexts[0]
  */
@@ -1585,6 +2222,12 @@ static void encoder_contexts_free(xavs2_handler_t *h_mgr)
         h_mgr->row_contexts = NULL;
     }
 
+    /* free all in-loop filter contexts */
+    if (h_mgr->lf_contexts != NULL) {
+        xavs2_free(h_mgr->lf_contexts);
+        h_mgr->lf_contexts = NULL;
+    }
+
     /* free frame contexts */
     for (i = 0; i < h_mgr->i_frm_threads; i++) {
         /* free the xavs2 encoder */
@@ -1615,10 +2258,16 @@ void encoder_task_manager_free(xavs2_handler_t *h_mgr)
         xavs2_threadpool_delete(h_mgr->threadpool_aec);
     }
 
+    /* destroy the thread pool of the in-loop filter stage */
+    if (h_mgr->threadpool_lf != NULL) {
+        xavs2_threadpool_delete(h_mgr->threadpool_lf);
+    }
+
     /* wait until the output thread finish its job */
     xavs2_thread_cond_signal(&h_mgr->cond[SIG_FRM_AEC_COMPLETED]);
 
     xavs2_thread_mutex_destroy(&h_mgr->mutex);
+    xavs2_thread_mutex_destroy(&h_mgr->mutex_mem);
         
     for (i = 0; i < SIG_COUNT; i++) {
         xavs2_thread_cond_destroy(&h_mgr->cond[i]);
@@ -1741,31 +2390,17 @@ static void encoder_init_func_handles(xavs2_t *h)
  * ===========================================================================
  */
 
-/**
- * ---------------------------------------------------------------------------
- * Function   : create and initialize a xavs2 video encoder
- * Parameters :
- *      [in ] : param   - pointer to struct xavs2_param_t
- *            : h_mgr   - pointer to top handler
- *      [out] : none
- * Return     : handle of xavs2 encoder, none zero for success, otherwise false
- * ---------------------------------------------------------------------------
+/* ---------------------------------------------------------------------------
+ * create and initialize the main encoding context for the frame size of param
  */
-xavs2_t *encoder_open(xavs2_param_t *param, xavs2_handler_t *h_mgr)
+static xavs2_t *encoder_open_context(xavs2_param_t *param, xavs2_handler_t *h_mgr)
 {
     xavs2_t *h = NULL;
 
-#if XAVS2_STAT
-    /* show header info */
-    encoder_show_head_info(param);
-#endif
-    /* decide ultimaete coding parameters by preset level */
-    decide_ultimate_paramters(param);
-    
     /* init frame context */
     if ((h = encoder_create_frame_context(param, 0)) == NULL) {
         xavs2_log(NULL, XAVS2_LOG_ERROR, "create frame context fail\n");
-        goto fail;
+        return NULL;
     }
 
     /* set fast algorithms according to the input preset level */
@@ -1779,17 +2414,10 @@ xavs2_t *encoder_open(xavs2_param_t *param, xavs2_handler_t *h_mgr)
     h->task_status = XAVS2_TASK_FREE;       /* ready for encoding */
     h->i_aec_frm   = -1;                    /* ready to be allocated */
 
-    h_mgr->frm_contexts[0] = h;   /* point to the xavs2_t handle */
-
-#if XAVS2_TRACE
-    xavs2_trace_init(h->param);    /* init trace */
-#endif
-
-
-
     if (encoder_decide_mv_range(h) < 0) {
         xavs2_log(NULL, XAVS2_LOG_ERROR, "check mv range fail\n");
-        goto fail;
+        encoder_destroy_frame_context(h);
+        return NULL;
     }
 
     encoder_init_func_handles(h);     /* init function handles */
@@ -1805,12 +2433,43 @@ xavs2_t *encoder_open(xavs2_param_t *param, xavs2_handler_t *h_mgr)
     /* parse RPS */
     rps_set_picture_reorder_delay(h);
 
+    return h;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : create and initialize a xavs2 video encoder
+ * Parameters :
+ *      [in ] : param   - pointer to struct xavs2_param_t
+ *            : h_mgr   - pointer to top handler
+ *      [out] : none
+ * Return     : handle of xavs2 encoder, none zero for success, otherwise false
+ * ---------------------------------------------------------------------------
+ */
+xavs2_t *encoder_open(xavs2_param_t *param, xavs2_handler_t *h_mgr)
+{
+    xavs2_t *h = NULL;
+
 #if XAVS2_STAT
-    encoder_show_frame_info_tab(h, h_mgr);
+    /* show header info */
+    encoder_show_head_info(param);
 #endif
+    /* decide ultimaete coding parameters by preset level */
+    decide_ultimate_paramters(param);
+
+    if ((h = encoder_open_context(param, h_mgr)) == NULL) {
+        goto fail;
+    }
+
+    h_mgr->frm_contexts[0] = h;   /* point to the xavs2_t handle */
 
-    /* init LCU row order */
-    slice_lcu_row_order_init(h);
+#if XAVS2_TRACE
+    xavs2_trace_init(h->param);    /* init trace */
+#endif
+
+#if XAVS2_STAT
+    encoder_show_frame_info_tab(h, h_mgr);
+#endif
 
     return h;
 
@@ -1820,6 +2479,31 @@ fail:
     return 0;
 }
 
+/* ---------------------------------------------------------------------------
+ * create all encoding contexts again for the parameters in use, as on creation
+ * (frame contexts other than the main one are opened on first use), no thread
+ * is working on them. the old contexts are kept on failure
+ */
+int encoder_contexts_reopen(xavs2_handler_t *h_mgr)
+{
+    xavs2_t *h = encoder_open_context((xavs2_param_t *)h_mgr->p_coder->param, h_mgr);
+
+    if (h == NULL) {
+        return -1;
+    }
+
+    encoder_contexts_free(h_mgr);
+    h_mgr->p_coder         = h;
+    h_mgr->frm_contexts[0] = h;
+
+    /* create encoder handlers for multi-thread */
+    if (h_mgr->i_frm_threads > 1 || h_mgr->i_row_threads > 1 || h_mgr->num_lf_contexts > 0) {
+        return encoder_contexts_init(h, h_mgr);
+    }
+
+    return 0;
+}
+
 /**
  * ---------------------------------------------------------------------------
  * Function   : init frame coding (init bitstream and picture header)
@@ -1856,11 +2540,6 @@ void xavs2e_frame_coding_init(xavs2_t *h)
     /* get QP to encode --------------------------------------------
      */
 
-    /* enable TD-RDO? */
-    if (h->td_rdo != NULL) {
-        tdrdo_frame_start(h);
-    }
-
     /* get frame level qp */
     if (h->param->i_rc_method != XAVS2_RC_CQP) {
         int new_qp = h->i_qp;
@@ -1913,6 +2592,10 @@ void *xavs2e_encode_one_frame(void *arg)
      */
     xavs2e_frame_coding_init(h);
 
+    if (h->h_top->ladder != NULL) {
+        ladder_frame_start(h);
+    }
+
     h->pic_alf_on[0] = h->param->enable_alf;
     h->pic_alf_on[1] = h->param->enable_alf;
     h->pic_alf_on[2] = h->param->enable_alf;
@@ -1924,6 +2607,13 @@ void *xavs2e_encode_one_frame(void *arg)
         }
     }
 
+    /* (2) decide the slices of current frame */
+    if (h->param->b_slice_auto) {
+        xavs2_slices_decide(h);
+    } else if (h->i_slice_num > 1 && h->param->i_lcurow_threads > 1) {
+        xavs2_slices_order_rows(h);
+    }
+
     /* start AEC frame coding */
     if (h->h_top->threadpool_aec != NULL && !h->param->enable_alf) {
         xavs2_threadpool_run(h->h_top->threadpool_aec, encoder_aec_encode_one_frame, h, 0);
@@ -1932,12 +2622,12 @@ void *xavs2e_encode_one_frame(void *arg)
     /* (3) encode all LCU rows in current frame ---------------------------
      */
     for (i = 0; i < h->i_height_in_lcu; i++) {
-        int lcu_y       = g_slice_lcu_row_order[i].lcu_y;
-        int row_type    = g_slice_lcu_row_order[i].row_type;
+        int lcu_y       = h->lcu_row_order[i].lcu_y;
+        int row_type    = h->lcu_row_order[i].row_type;
         row_info_t *row = &rows[lcu_y];
         row_info_t *last_row;
 
-        h->i_slice_index = g_slice_lcu_row_order[i].slice_idx;
+        h->i_slice_index = h->lcu_row_order[i].slice_idx;
 
         /* ǷҪ⴦Slice߽ */
         row->b_top_slice_border  = 0;
@@ -1956,6 +2646,12 @@ void *xavs2e_encode_one_frame(void *arg)
         /* ȴο֡б */
         xavs2e_inter_sync(h, lcu_y, 0);
 
+        /* the in-loop filter of the row runs behind its encoding */
+        if (h->h_top->threadpool_lf != NULL) {
+            row->h_frame = h;
+            xavs2_threadpool_run(h->h_top->threadpool_lf, xavs2_lcu_row_filter, row, 0);
+        }
+
         /* encode one lcu row */
         if (enable_wpp && i != h->i_height_in_lcu - 1) {
             /* 1, һм߳̽б */
@@ -1983,7 +2679,7 @@ void *xavs2e_encode_one_frame(void *arg)
     }   // for all LCU rows
 
     /* (4) Make sure that all LCU row are finished */
-    if (h->param->slice_num > 1) {
+    if (h->param->slice_num > 1 || h->h_top->threadpool_lf != NULL) {
         xavs2_frame_t *p_fdec = h->fdec;
 
         for (i = 0; i < h->i_height_in_lcu; i++) {
@@ -2043,8 +2739,8 @@ void *xavs2e_encode_one_frame(void *arg)
     /* (7) after encoding ... ------------------------------------------
      */
 
-    if (h->td_rdo != NULL) {
-        tdrdo_frame_done(h);
+    if (h->h_top->ladder != NULL) {
+        ladder_frame_done(h);
     }
 
     encoder_write_rec_frame(h->h_top);
@@ -2074,7 +2770,7 @@ void *xavs2e_encode_one_frame(void *arg)
  */
 int encoder_encode(xavs2_handler_t *h_mgr, xavs2_frame_t *frame)
 {
-    if (frame->i_state != XAVS2_FLUSH) {
+    if (frame->i_state != XAVS2_FLUSH && frame->i_state != XAVS2_RESET) {
         xavs2_t *p_coder;
 
 #if XAVS2_STAT
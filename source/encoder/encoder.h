@@ -44,6 +44,9 @@
  */
 
 int      send_frame_to_enc_queue(xavs2_handler_t *h_mgr, xavs2_frame_t *frm);
+size_t   lookahead_get_buffer_size(const xavs2_param_t *param);
+void     lookahead_init_lowres(xavs2_handler_t *h_mgr, const xavs2_param_t *param, uint8_t *mem_ptr);
+void     lookahead_remove_output_frame(xavs2_handler_t *h_mgr, xavs2_frame_t *frm);
 
 void     xavs2e_get_frame_lambda(xavs2_t *h, xavs2_frame_t *cur_frm, int i_qp);
 
@@ -54,12 +57,19 @@ void     xavs2e_get_frame_lambda(xavs2_t *h, xavs2_frame_t *cur_frm, int i_qp);
  */
 
 int      encoder_check_parameters(xavs2_param_t *param);
+int      encoder_reset_parameters(xavs2_param_t *param, const xavs2_param_t *p_new);
+int      encoder_check_bitrate(const xavs2_param_t *param, int bitrate);
 
 xavs2_t *encoder_open  (xavs2_param_t *param, xavs2_handler_t *h_mgr);
 int      encoder_encode(xavs2_handler_t *h_mgr, xavs2_frame_t *frame);
 void     encoder_close (xavs2_handler_t *h_mgr);
 
 int      encoder_contexts_init(xavs2_t *h, xavs2_handler_t *h_mgr);
+int      encoder_contexts_reopen(xavs2_handler_t *h_mgr);
+xavs2_t *encoder_contexts_open_frame(xavs2_handler_t *h_mgr, int idx_frm_encoder);
+void     encoder_mem_update(xavs2_handler_t *h_mgr, int category, int64_t size_add, int64_t size_held);
+size_t   encoder_get_frame_context_size(const xavs2_param_t *param, size_t *size_bs);
+size_t   encoder_get_row_context_size(const xavs2_param_t *param);
 void     encoder_write_rec_frame(xavs2_handler_t *h_mgr);
 void     encoder_fetch_one_encoded_frame(xavs2_handler_t *h_mgr, xavs2_outpacket_t *packet, int is_flush);
 
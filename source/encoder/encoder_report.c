@@ -252,6 +252,14 @@ void encoder_report_stat_info(xavs2_t *h)
               p_stat->stat_b_frame.i_frame_size * 8,
               p_stat->stat_p_frame.i_frame_size * 8);
 
+    // AUTOMATIC SLICES: headers of the additional slices are the direct coding loss
+    if (h->param->b_slice_auto && h->h_top->slice_auto.num_frames > 0) {
+        slice_auto_t *p_auto = &h->h_top->slice_auto;
+        xavs2_log(h, XAVS2_LOG_INFO, "     AUTO SLICES: %.2f slices/frame, extra slice headers %lld bits (%.3f%%)\n",
+                  (double)p_auto->num_slices / p_auto->num_frames, p_auto->num_extra_bits,
+                  p_auto->num_extra_bits * 100.0 / XAVS2_MAX(p_auto->num_bits, 1));
+    }
+
     // TOTAL TIME
     xavs2_log(h, XAVS2_LOG_DEBUG, "      TOTAL TIME: %8.3f sec, total %d frames, speed: %5.2f fps \n",
               (double)(p_stat->i_end_time - p_stat->i_start_time) / 1000000.0,
@@ -431,7 +439,8 @@ void encoder_show_frame_info_tab(xavs2_t *h, xavs2_handler_t *mgr)
 
     xavs2_log(NULL, XAVS2_LOG_INFO, " Threads (Allocated)  : %d / %d, threadpool %d, RowContexts %d \n",
               mgr->i_row_threads, mgr->i_frm_threads, mgr->num_pool_threads, mgr->num_row_contexts);
-    xavs2_log(NULL, XAVS2_LOG_INFO, " Memory  (Allocated)  : %d MB \n", (int)(space_alloc));
+    xavs2_log(NULL, XAVS2_LOG_INFO, " Memory  (Allocated)  : %d MB, AllocMode %d, FramePool %d \n",
+              (int)(space_alloc), h->param->mem_alloc_mode, h->param->enable_frame_pool);
     xavs2_log(NULL, XAVS2_LOG_INFO, " Enabled Tools        : 2NxN/Nx2N:%d, AMP:%d, IntraInInter:%d, SDIP:%d,\n"\
                                         "                        DHP:%d, DMH:%d, MHP:%d, WSM:%d,\n"\
                                         "                        NSQT:%d, Fast2LevelTu:%d, 2ndTrans:%d,\n"\
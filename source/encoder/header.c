@@ -62,11 +62,8 @@ static ALWAYS_INLINE int is_valid_qp(xavs2_t *h, int i_qp)
 static ALWAYS_INLINE
 int get_frame_coi_to_write(xavs2_t *h, xavs2_frame_t *frm)
 {
-    if (h->param->num_parallel_gop > 1) {
-        return (frm->i_frm_coi - frm->i_gop_idr_coi) & 255;
-    } else {
-        return frm->i_frm_coi & 255;
-    }
+    UNUSED_PARAMETER(h);
+    return frm->i_frm_coi & 255;
 }
 
 /* ---------------------------------------------------------------------------
@@ -0,0 +1,409 @@
+/*
+ * ladder.c
+ *
+ * Description of this file:
+ *    Ladder encoding functions definition of the xavs2 library
+ *
+ * --------------------------------------------------------------------------
+ *
+ *    xavs2 - video encoder of AVS2/IEEE1857.4 video coding standard
+ *    Copyright (C) 2018~ VCL, NELVT, Peking University
+ *
+ *    Authors: Falei LUO <falei.luo@gmail.com>
+ *             etc.
+ *
+ *    Homepage1: http://vcl.idm.pku.edu.cn/xavs2
+ *    Homepage2: https://github.com/pkuvcl/xavs2
+ *    Homepage3: https://gitee.com/pkuvcl/xavs2
+ *
+ *    This program is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *    This program is also available under a commercial proprietary license.
+ *    For more information, contact us at sswang @ pku.edu.cn.
+ */
+
+#include "common.h"
+#include "wrapper.h"
+#include "ladder.h"
+
+
+/* number of frames whose analysis can be kept at the same time, much more than
+ * the frames being encoded by the top rendition and not yet by a lower one */
+#define LADDER_HINT_FRAMES    64
+
+
+/**
+ * ===========================================================================
+ * type defines
+ * ===========================================================================
+ */
+
+/* ---------------------------------------------------------------------------
+ * analysis of the top rendition shared by all renditions of ladder encoding
+ */
+struct ladder_t {
+    xavs2_thread_mutex_t mutex;
+    xavs2_thread_cond_t  cond;        /* signaled when a hint is stored or released */
+    int         b_exit;               /* stop waiting for the hints */
+    int         num_lower;            /* number of lower renditions */
+
+    int         i_width_in_mincu;     /* frame width  in 8x8-block of the top rendition */
+    int         i_height_in_mincu;    /* frame height in 8x8-block of the top rendition */
+    int         scale_pos[MAX_LADDER_RENDITIONS][2];  /* top / lower (Q16), [rendition][x, y] */
+    int         scale_mv [MAX_LADDER_RENDITIONS][2];  /* lower / top (Q16), [rendition][x, y] */
+    int         level_shift[MAX_LADDER_RENDITIONS];   /* CU level of top rendition minus the one of lower rendition */
+
+    uint32_t   *scale_buf;            /* one row of vertically filtered samples for picture scaling */
+    ladder_hint_t hints[LADDER_HINT_FRAMES];
+};
+
+
+/**
+ * ===========================================================================
+ * local function defines
+ * ===========================================================================
+ */
+
+/* ---------------------------------------------------------------------------
+ * scale one plane by area averaging, the destination is not larger than the source
+ */
+static
+void ladder_scale_plane(uint32_t *tmp, const pel_t *src, int i_src, int src_w, int src_h,
+                        pel_t *dst, int i_dst, int dst_w, int dst_h)
+{
+    const int64_t step_x = ((int64_t)src_w << 16) / dst_w;   /* source samples of one destination sample (Q16) */
+    const int64_t step_y = ((int64_t)src_h << 16) / dst_h;
+    int x, y, k;
+
+    for (y = 0; y < dst_h; y++) {
+        int64_t y0 = y * step_y;
+        int64_t y1 = y0 + step_y;
+        int     k0 = (int)(y0 >> 16);
+        int     k1 = XAVS2_MIN((int)((y1 + 0xFFFF) >> 16), src_h);
+
+        /* vertical, Q8 */
+        for (x = 0; x < src_w; x++) {
+            int64_t sum = 0;
+            for (k = k0; k < k1; k++) {
+                int64_t w = XAVS2_MIN(y1, (int64_t)(k + 1) << 16) - XAVS2_MAX(y0, (int64_t)k << 16);
+                sum += w * src[k * i_src + x];
+            }
+            tmp[x] = (uint32_t)(((sum << 8) + (step_y >> 1)) / step_y);
+        }
+
+        /* horizontal */
+        for (x = 0; x < dst_w; x++) {
+            int64_t x0  = x * step_x;
+            int64_t x1  = x0 + step_x;
+            int64_t sum = 0;
+            int     j1  = XAVS2_MIN((int)((x1 + 0xFFFF) >> 16), src_w);
+
+            for (k = (int)(x0 >> 16); k < j1; k++) {
+                int64_t w = XAVS2_MIN(x1, (int64_t)(k + 1) << 16) - XAVS2_MAX(x0, (int64_t)k << 16);
+                sum += w * tmp[k];
+            }
+            dst[x] = (pel_t)XAVS2_CLIP3(0, PIXEL_MAX, (int)((sum / step_x + 128) >> 8));
+        }
+
+        dst += i_dst;
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * store the analysis of the frame finished by the top rendition
+ */
+static
+void ladder_store_hint(ladder_t *ladder, xavs2_t *h)
+{
+    ladder_hint_t *hint = &ladder->hints[h->fenc->i_frame % LADDER_HINT_FRAMES];
+    const int w_in_scu  = h->i_width_in_mincu;
+    const int h_in_scu  = h->i_height_in_mincu;
+    const int w_in_4x4  = h->i_width_in_minpu;
+    int i, j;
+
+    xavs2_thread_mutex_lock(&ladder->mutex);          /* lock */
+    /* wait until the lower renditions finish the frame in this slot */
+    while (hint->num_users > 0 && !ladder->b_exit) {
+        xavs2_thread_cond_wait(&ladder->cond, &ladder->mutex);
+    }
+    hint->i_frame = -1;
+    xavs2_thread_mutex_unlock(&ladder->mutex);        /* unlock */
+
+    memcpy(hint->scu_level, h->scu_level, w_in_scu * h_in_scu * sizeof(int8_t));
+
+    if (h->i_type == SLICE_TYPE_I) {
+        memset(hint->ref[0], INVALID_REF, w_in_scu * h_in_scu * sizeof(int8_t));
+        memset(hint->ref[1], INVALID_REF, w_in_scu * h_in_scu * sizeof(int8_t));
+    } else {
+        /* motion of the top-left 4x4 block of each SCU */
+        for (j = 0; j < h_in_scu; j++) {
+            const int offset_4x4 = (j << 1) * w_in_4x4;
+            const int offset_scu = j * w_in_scu;
+            for (i = 0; i < w_in_scu; i++) {
+                hint->ref[0][offset_scu + i] = h->fwd_1st_ref[offset_4x4 + (i << 1)];
+                hint->ref[1][offset_scu + i] = h->bwd_2nd_ref[offset_4x4 + (i << 1)];
+                hint->mv [0][offset_scu + i] = h->fwd_1st_mv [offset_4x4 + (i << 1)];
+                hint->mv [1][offset_scu + i] = h->bwd_2nd_mv [offset_4x4 + (i << 1)];
+            }
+        }
+    }
+
+    xavs2_thread_mutex_lock(&ladder->mutex);          /* lock */
+    hint->i_frame   = h->fenc->i_frame;
+    hint->num_users = ladder->num_lower;
+    xavs2_thread_mutex_unlock(&ladder->mutex);        /* unlock */
+
+    xavs2_thread_cond_broadcast(&ladder->cond);
+}
+
+
+/**
+ * ===========================================================================
+ * interface function defines
+ * ===========================================================================
+ */
+
+/* ---------------------------------------------------------------------------
+ * create the analysis buffers shared by all renditions,
+ * param is the one of the top rendition
+ */
+ladder_t *ladder_create(const xavs2_param_t *param)
+{
+    const int w_in_scu = (param->org_width  + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT;
+    const int h_in_scu = (param->org_height + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT;
+    const int size_scu = w_in_scu * h_in_scu;
+    size_t size_hint   = (size_scu * 3 * sizeof(int8_t) + size_scu * 2 * sizeof(mv_t) + CACHE_LINE_SIZE * 5);
+    size_t mem_size    = sizeof(ladder_t) + size_hint * LADDER_HINT_FRAMES +
+                         param->org_width * sizeof(uint32_t) + CACHE_LINE_SIZE * 2;
+    ladder_t *ladder   = NULL;
+    uint8_t  *mem_ptr  = NULL;
+    int i;
+
+    CHECKED_MALLOC_MODE(mem_ptr, uint8_t *, mem_size, param->mem_alloc_mode);
+    ladder = (ladder_t *)mem_ptr;
+    memset(ladder, 0, sizeof(ladder_t));
+    mem_ptr += sizeof(ladder_t);
+    ALIGN_POINTER(mem_ptr);
+
+    ladder->num_lower         = param->num_ladder;
+    ladder->i_width_in_mincu  = w_in_scu;
+    ladder->i_height_in_mincu = h_in_scu;
+
+    for (i = 1; i <= param->num_ladder; i++) {
+        double ratio = (double)param->org_width / param->ladder_width[i];
+
+        ladder->scale_pos[i][0] = (int)(((int64_t)param->org_width  << 16) / param->ladder_width[i]);
+        ladder->scale_pos[i][1] = (int)(((int64_t)param->org_height << 16) / param->ladder_height[i]);
+        ladder->scale_mv [i][0] = (int)(((int64_t)param->ladder_width[i]  << 16) / param->org_width);
+        ladder->scale_mv [i][1] = (int)(((int64_t)param->ladder_height[i] << 16) / param->org_height);
+        ladder->level_shift[i]  = (int)(log(ratio) / log(2.0) + 0.5);
+    }
+
+    ladder->scale_buf = (uint32_t *)mem_ptr;
+    mem_ptr += param->org_width * sizeof(uint32_t);
+    ALIGN_POINTER(mem_ptr);
+
+    for (i = 0; i < LADDER_HINT_FRAMES; i++) {
+        ladder_hint_t *hint = &ladder->hints[i];
+
+        hint->i_frame   = -1;
+        hint->scu_level = (int8_t *)mem_ptr;
+        mem_ptr        += size_scu * sizeof(int8_t);
+        ALIGN_POINTER(mem_ptr);
+        hint->ref[0]    = (int8_t *)mem_ptr;
+        mem_ptr        += size_scu * sizeof(int8_t);
+        ALIGN_POINTER(mem_ptr);
+        hint->ref[1]    = (int8_t *)mem_ptr;
+        mem_ptr        += size_scu * sizeof(int8_t);
+        ALIGN_POINTER(mem_ptr);
+        hint->mv[0]     = (mv_t *)mem_ptr;
+        mem_ptr        += size_scu * sizeof(mv_t);
+        ALIGN_POINTER(mem_ptr);
+        hint->mv[1]     = (mv_t *)mem_ptr;
+        mem_ptr        += size_scu * sizeof(mv_t);
+        ALIGN_POINTER(mem_ptr);
+    }
+
+    if ((uintptr_t)(ladder) + mem_size < (uintptr_t)mem_ptr) {
+        /* malloc size allocation error: no enough memory */
+        goto fail;
+    }
+
+    xavs2_thread_mutex_init(&ladder->mutex, NULL);
+    xavs2_thread_cond_init(&ladder->cond, NULL);
+
+    return ladder;
+
+fail:
+    xavs2_free(ladder);
+    return NULL;
+}
+
+/* ---------------------------------------------------------------------------
+ * stop all waiting for the analysis, called before the encoders are destroyed
+ */
+void ladder_exit(ladder_t *ladder)
+{
+    xavs2_thread_mutex_lock(&ladder->mutex);          /* lock */
+    ladder->b_exit = 1;
+    xavs2_thread_mutex_unlock(&ladder->mutex);        /* unlock */
+
+    xavs2_thread_cond_broadcast(&ladder->cond);
+}
+
+/* ---------------------------------------------------------------------------
+ * drop the analysis of the previous sequence, called after all encoders are
+ * flushed, since the POCs of a new sequence start again
+ */
+void ladder_reset(ladder_t *ladder)
+{
+    int i;
+
+    xavs2_thread_mutex_lock(&ladder->mutex);          /* lock */
+    for (i = 0; i < LADDER_HINT_FRAMES; i++) {
+        ladder->hints[i].i_frame   = -1;
+        ladder->hints[i].num_users = 0;
+    }
+    xavs2_thread_mutex_unlock(&ladder->mutex);        /* unlock */
+}
+
+/* ---------------------------------------------------------------------------
+ */
+void ladder_destroy(ladder_t *ladder)
+{
+    xavs2_thread_mutex_destroy(&ladder->mutex);
+    xavs2_thread_cond_destroy(&ladder->cond);
+    xavs2_free(ladder);
+}
+
+/* ---------------------------------------------------------------------------
+ * scale the source picture of the top rendition to a lower rendition
+ */
+void ladder_scale_picture(ladder_t *ladder, const xavs2_image_t *src, xavs2_image_t *dst)
+{
+    int k;
+
+    for (k = 0; k < dst->i_plane; k++) {
+        ladder_scale_plane(ladder->scale_buf,
+                           (const pel_t *)src->img_planes[k], src->i_stride[k] / (int)sizeof(pel_t),
+                           src->i_width[k], src->i_lines[k],
+                           (pel_t *)dst->img_planes[k], dst->i_stride[k] / (int)sizeof(pel_t),
+                           dst->i_width[k], dst->i_lines[k]);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * a lower rendition gets the analysis of the top rendition for current frame
+ */
+void ladder_frame_start(xavs2_t *h)
+{
+    ladder_t      *ladder = h->h_top->ladder;
+    ladder_hint_t *hint   = &ladder->hints[h->fenc->i_frame % LADDER_HINT_FRAMES];
+
+    h->ladder_hint = NULL;
+    if (h->param->i_rendition == 0) {
+        return;
+    }
+
+    xavs2_thread_mutex_lock(&ladder->mutex);          /* lock */
+    while (hint->i_frame != h->fenc->i_frame && !ladder->b_exit) {
+        xavs2_thread_cond_wait(&ladder->cond, &ladder->mutex);
+    }
+    if (hint->i_frame == h->fenc->i_frame) {
+        h->ladder_hint = hint;
+    }
+    xavs2_thread_mutex_unlock(&ladder->mutex);        /* unlock */
+}
+
+/* ---------------------------------------------------------------------------
+ * the top rendition stores its analysis of current frame,
+ * and a lower rendition releases the one it used
+ */
+void ladder_frame_done(xavs2_t *h)
+{
+    ladder_t *ladder = h->h_top->ladder;
+
+    if (h->param->i_rendition == 0) {
+        ladder_store_hint(ladder, h);
+    } else if (h->ladder_hint != NULL) {
+        xavs2_thread_mutex_lock(&ladder->mutex);      /* lock */
+        ((ladder_hint_t *)h->ladder_hint)->num_users--;
+        xavs2_thread_mutex_unlock(&ladder->mutex);    /* unlock */
+        h->ladder_hint = NULL;
+
+        xavs2_thread_cond_broadcast(&ladder->cond);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * range of the CU levels of the top rendition in the area of a CU, mapped to
+ * the CU levels of current rendition
+ */
+void ladder_hint_cu_levels(xavs2_t *h, int pix_x, int pix_y, int size, int *min_level, int *max_level)
+{
+    const ladder_t      *ladder = h->h_top->ladder;
+    const ladder_hint_t *hint   = h->ladder_hint;
+    const int r        = h->param->i_rendition;
+    const int w_in_scu = ladder->i_width_in_mincu;
+    int x0 = (int)(((int64_t)pix_x * ladder->scale_pos[r][0]) >> (16 + MIN_CU_SIZE_IN_BIT));
+    int y0 = (int)(((int64_t)pix_y * ladder->scale_pos[r][1]) >> (16 + MIN_CU_SIZE_IN_BIT));
+    int x1 = (int)(((int64_t)(pix_x + size) * ladder->scale_pos[r][0] - 1) >> (16 + MIN_CU_SIZE_IN_BIT));
+    int y1 = (int)(((int64_t)(pix_y + size) * ladder->scale_pos[r][1] - 1) >> (16 + MIN_CU_SIZE_IN_BIT));
+    int level_min = MAX_CU_SIZE_IN_BIT;
+    int level_max = MIN_CU_SIZE_IN_BIT;
+    int i, j;
+
+    x1 = XAVS2_MIN(x1, w_in_scu - 1);
+    y1 = XAVS2_MIN(y1, ladder->i_height_in_mincu - 1);
+
+    for (j = y0; j <= y1; j++) {
+        const int8_t *p_level = hint->scu_level + j * w_in_scu;
+        for (i = x0; i <= x1; i++) {
+            level_min = XAVS2_MIN(level_min, p_level[i]);
+            level_max = XAVS2_MAX(level_max, p_level[i]);
+        }
+    }
+
+    *min_level = level_min - ladder->level_shift[r];
+    *max_level = level_max - ladder->level_shift[r];
+}
+
+/* ---------------------------------------------------------------------------
+ * MV of the top rendition at a position, scaled to current rendition,
+ * returns 0 if there is no MV to the reference frame
+ */
+int ladder_hint_mv(xavs2_t *h, int pix_x, int pix_y, int ref_idx, mv_t *mv)
+{
+    const ladder_t      *ladder = h->h_top->ladder;
+    const ladder_hint_t *hint   = h->ladder_hint;
+    const int r = h->param->i_rendition;
+    int x = (int)(((int64_t)pix_x * ladder->scale_pos[r][0]) >> (16 + MIN_CU_SIZE_IN_BIT));
+    int y = (int)(((int64_t)pix_y * ladder->scale_pos[r][1]) >> (16 + MIN_CU_SIZE_IN_BIT));
+    int pos, k;
+
+    x   = XAVS2_MIN(x, ladder->i_width_in_mincu  - 1);
+    y   = XAVS2_MIN(y, ladder->i_height_in_mincu - 1);
+    pos = y * ladder->i_width_in_mincu + x;
+
+    for (k = 0; k < 2; k++) {
+        if (hint->ref[k][pos] == ref_idx) {
+            mv->x = (int16_t)((hint->mv[k][pos].x * ladder->scale_mv[r][0] + 32768) >> 16);
+            mv->y = (int16_t)((hint->mv[k][pos].y * ladder->scale_mv[r][1] + 32768) >> 16);
+            return 1;
+        }
+    }
+
+    return 0;
+}
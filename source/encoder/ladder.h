@@ -0,0 +1,87 @@
+/*
+ * ladder.h
+ *
+ * Description of this file:
+ *    Ladder encoding functions definition of the xavs2 library
+ *
+ * --------------------------------------------------------------------------
+ *
+ *    xavs2 - video encoder of AVS2/IEEE1857.4 video coding standard
+ *    Copyright (C) 2018~ VCL, NELVT, Peking University
+ *
+ *    Authors: Falei LUO <falei.luo@gmail.com>
+ *             etc.
+ *
+ *    Homepage1: http://vcl.idm.pku.edu.cn/xavs2
+ *    Homepage2: https://github.com/pkuvcl/xavs2
+ *    Homepage3: https://gitee.com/pkuvcl/xavs2
+ *
+ *    This program is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *    This program is also available under a commercial proprietary license.
+ *    For more information, contact us at sswang @ pku.edu.cn.
+ */
+
+
+#ifndef XAVS2_LADDER_H
+#define XAVS2_LADDER_H
+
+
+/**
+ * ===========================================================================
+ * type defines
+ * ===========================================================================
+ */
+
+/* ---------------------------------------------------------------------------
+ * analysis of one frame of the top rendition, in the SCU grid of the top rendition
+ */
+struct ladder_hint_t {
+    int         i_frame;              /* POC of the frame, -1 if the slot is empty or being written */
+    int         num_users;            /* number of lower renditions which have not finished the frame */
+    int8_t     *scu_level;            /* [i_height_in_mincu][i_width_in_mincu], CU level */
+    int8_t     *ref[2];               /* [i_height_in_mincu][i_width_in_mincu], reference index of the 1st and 2nd MV */
+    mv_t       *mv [2];               /* [i_height_in_mincu][i_width_in_mincu], the 1st and 2nd MV */
+};
+
+
+/**
+ * ===========================================================================
+ * function declares
+ * ===========================================================================
+ */
+#define ladder_create FPFX(ladder_create)
+ladder_t *ladder_create(const xavs2_param_t *param);
+#define ladder_exit FPFX(ladder_exit)
+void ladder_exit(ladder_t *ladder);
+#define ladder_reset FPFX(ladder_reset)
+void ladder_reset(ladder_t *ladder);
+#define ladder_destroy FPFX(ladder_destroy)
+void ladder_destroy(ladder_t *ladder);
+
+#define ladder_scale_picture FPFX(ladder_scale_picture)
+void ladder_scale_picture(ladder_t *ladder, const xavs2_image_t *src, xavs2_image_t *dst);
+
+#define ladder_frame_start FPFX(ladder_frame_start)
+void ladder_frame_start(xavs2_t *h);
+#define ladder_frame_done FPFX(ladder_frame_done)
+void ladder_frame_done(xavs2_t *h);
+
+#define ladder_hint_cu_levels FPFX(ladder_hint_cu_levels)
+void ladder_hint_cu_levels(xavs2_t *h, int pix_x, int pix_y, int size, int *min_level, int *max_level);
+#define ladder_hint_mv FPFX(ladder_hint_mv)
+int  ladder_hint_mv(xavs2_t *h, int pix_x, int pix_y, int ref_idx, mv_t *mv);
+
+#endif  // XAVS2_LADDER_H
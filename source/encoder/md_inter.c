@@ -39,6 +39,7 @@
 #include "block_info.h"
 #include "cudata.h"
 #include "me.h"
+#include "ladder.h"
 
 
 /**
@@ -60,21 +61,6 @@ static const double tab_umh_alpha_3rd[MAX_INTER_MODES] = {
  * ===========================================================================
  */
 
-/* ---------------------------------------------------------------------------
- * determine the MVD value (1/4 pixel) is legal or not
- * Return: 0: out of the legal mv range; 1: in the legal mv range
- */
-static ALWAYS_INLINE
-int check_mvd(xavs2_t *h, int mvd_x, int mvd_y)
-{
-    if (h->param->i_frame_threads > 1) {
-        return (mvd_x < 4096 && mvd_x >= -4096 &&
-                mvd_y < ((1 << h->i_lcu_level) << 2) && mvd_y >= -((1 << h->i_lcu_level) << 2));
-    }
-
-    return (mvd_x < 4096 && mvd_x >= -4096 && mvd_y < 4096 && mvd_y >= -4096);
-}
-
 /* ---------------------------------------------------------------------------
  * determine the forward and backward mv value (1/4 pixel) is legal or not
  * return: 0: out of the legal mv range; 1: in the legal mv range
@@ -888,6 +874,7 @@ int pred_inter_search_single(xavs2_t *h, cu_t *p_cu, cb_t *p_cb, xavs2_me_t *p_m
     int bsx = p_cb->w;
     int bsy = p_cb->h;
     int i, j, m, n, k;
+    int mv_max_y;
     cu_mv_mode_t *p_mode_mvs = cu_get_layer_mode(h, p_cu->cu_info.i_level)->mvs[mode];
     neighbor_inter_t *p_neighbors = cu_get_layer(h, p_cu->cu_info.i_level)->neighbor_inter;
     dist_t(*all_min_costs)[MAX_INTER_MODES][MAX_REFS];
@@ -924,12 +911,22 @@ int pred_inter_search_single(xavs2_t *h, cu_t *p_cu, cb_t *p_cb, xavs2_me_t *p_m
     p_me->mv_max[1] = XAVS2_CLIP3(h->min_mv_range[1], h->max_mv_range[1], j);
     p_me->mv_min_fpel[1] = (p_me->mv_min[1] >> 2) + m;
     p_me->mv_max_fpel[1] = (p_me->mv_max[1] >> 2) - m;
+    mv_max_y = p_me->mv_max[1];
 
     // loop over all reference frames
     for (ref_idx = 0; ref_idx < max_ref; ref_idx++) {
         int bwd_2nd = h->i_type == SLICE_TYPE_B && ref_idx == B_BWD;
         xavs2_frame_t *p_ref_frm = h->fref[ref_idx];
         mv_t *pred_mv = &p_mode_mvs[pu_idx].all_mvp[ref_idx];
+        int b_refresh_valid = 1;
+
+        /* PU above the intra refresh band: search in the refreshed rows of the reference only */
+        if (pix_y < (h->i_refresh_row_start << h->i_lcu_level)) {
+            j = ((h->refresh_ref_bottom[ref_idx] - pix_y - bsy - 4) << 2) + 3;
+            p_me->mv_max[1] = XAVS2_MIN(mv_max_y, j);
+            p_me->mv_max_fpel[1] = (p_me->mv_max[1] >> 2) - 6;
+            b_refresh_valid = h->refresh_ref_bottom[ref_idx] > 0 && p_me->mv_max_fpel[1] >= p_me->mv_min_fpel[1];
+        }
 
         /* get MVP (motion vector predictor) */
         if (h->param->me_method == XAVS2_ME_UMH) {
@@ -952,11 +949,16 @@ int pred_inter_search_single(xavs2_t *h, cu_t *p_cu, cb_t *p_cb, xavs2_me_t *p_m
         /* MVPȡֵMVPֵME */
         b_mv_valid = check_mv_range(h, pred_mv, ref_idx, pix_x, pix_y, bsx, bsy);
         b_mv_valid &= check_mvd(h, pred_mv->x, pred_mv->y);
+        b_mv_valid &= b_refresh_valid;
 
         /* Ĭϱĵλ */
         i_mvc = 0;
         i_mvc = add_one_mv_candidate(p_me, mvc, i_mvc, p_me->mvp.x, p_me->mvp.y);
         i_mvc = add_one_mv_candidate(p_me, mvc, i_mvc, 0, 0);
+        if (h->ladder_hint != NULL && ladder_hint_mv(h, pix_x + (bsx >> 1), pix_y + (bsy >> 1), ref_idx, &mv)) {
+            /* scaled MV of the top rendition (ladder encoding) */
+            i_mvc = add_one_mv_candidate(p_me, mvc, i_mvc, mv.x, mv.y);
+        }
 
         if (b_mv_valid) {
             cost = xavs2_me_search(h, p_me, mvc, i_mvc);
@@ -1003,6 +1005,7 @@ int pred_inter_search_single(xavs2_t *h, cu_t *p_cu, cb_t *p_cb, xavs2_me_t *p_m
 
         b_mv_valid &= check_mv_range(h, &mv, ref_idx, pix_x, pix_y, bsx, bsy);
         b_mv_valid &= check_mvd(h, (mv.x - pred_mv->x), (mv.y - pred_mv->y));
+        b_mv_valid &= check_mv_refresh(h, &mv, ref_idx, pix_y, bsy);
         if (!b_mv_valid) {
             cost = MAX_DISTORTION;
         }
@@ -1027,6 +1030,10 @@ int pred_inter_search_single(xavs2_t *h, cu_t *p_cu, cb_t *p_cb, xavs2_me_t *p_m
         }
     }
 
+    /* restore the vertical MV range limited by the intra refresh */
+    p_me->mv_max[1] = mv_max_y;
+    p_me->mv_max_fpel[1] = (mv_max_y >> 2) - 6;
+
     return best_ref_idx;
 }
 
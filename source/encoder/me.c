@@ -170,6 +170,16 @@ static const int i_org = FENC_STRIDE;
         goto umh_step_2;\
     }
 
+/* ---------------------------------------------------------------------------
+ * hash-based search */
+#define HASH_ME_LINE_KEY    0x2F0B3A49u   /* multiplier of the hash of 8 pixels in a line */
+#define HASH_ME_BLOCK_KEY   0x01000193u   /* multiplier of the hash of the 8 line hashes of a block */
+#define HASH_ME_CHUNK       64            /* number of positions in a line hashed at a time */
+#define HASH_ME_MAX_VISITS  64            /* max number of positions visited in one bucket */
+#define HASH_ME_BUCKET(key) ((((key) ^ ((key) >> 15)) * 0x9E3779B1u) >> (32 - HASH_ME_TABLE_BITS))
+#define HASH_ME_LINE_ONES   0x44B6F9E8u   /* hash of 8 pixels of value 1, sum of HASH_ME_LINE_KEY^i (i = 0..7) */
+#define hash_me_line_flat(v) ((uint32_t)(v) * HASH_ME_LINE_ONES)
+
 
 /**
  * ===========================================================================
@@ -575,6 +585,142 @@ me_subpel_refine(xavs2_t *h, xavs2_me_t *p_me)
     return bcost;
 }
 
+/* ---------------------------------------------------------------------------
+ * hash of 8 pixels in a line
+ */
+static ALWAYS_INLINE
+uint32_t hash_me_line(const pel_t *p)
+{
+    uint32_t key = 0;
+    int i;
+
+    for (i = 0; i < HASH_ME_BLOCK; i++) {
+        key = key * HASH_ME_LINE_KEY + p[i];
+    }
+
+    return key;
+}
+
+/* ---------------------------------------------------------------------------
+ * hash of a 8x8 block, b_flat is set for blocks of only one pixel value
+ */
+static ALWAYS_INLINE
+uint32_t hash_me_block(const pel_t *p, int i_stride, int *b_flat)
+{
+    uint32_t key_line0 = hash_me_line(p);
+    uint32_t key = key_line0;
+    int flat = (key_line0 == hash_me_line_flat(p[0]));
+    int i;
+
+    for (i = 1; i < HASH_ME_BLOCK; i++) {
+        uint32_t key_line = hash_me_line(p + i * i_stride);
+        flat &= key_line == key_line0;
+        key   = key * HASH_ME_BLOCK_KEY + key_line;
+    }
+    *b_flat = flat;
+
+    return key;
+}
+
+/* ---------------------------------------------------------------------------
+ * search the positions of the reference frame whose source 8x8 block has the same
+ * hash as the top-left 8x8 block of the PU (see xavs2_me_hash_build_row()).
+ * return 1 if the best position found is an exact match of the whole PU, that is,
+ * all the 8x8 blocks of the PU match the source of the reference frame
+ */
+static int me_hash_search(xavs2_t *h, xavs2_me_t *p_me, int *p_bmx, int *p_bmy, dist_t *p_bcost)
+{
+    uint32_t keys_org[(MAX_CU_SIZE / HASH_ME_BLOCK) * (MAX_CU_SIZE / HASH_ME_BLOCK)];
+    xavs2_frame_t *p_ref = p_me->p_fref_1st;
+    pel_t *p_org    = p_me->p_fenc;
+    pel_t *p_fref   = p_ref->planes[IMG_Y] + p_me->i_bias;
+    int i_fref      = p_ref->i_stride[IMG_Y];
+    int i_pixel     = p_me->i_pixel;
+    int i_width     = h->i_width;
+    int pix_x       = p_me->i_pix_x;
+    int pix_y       = p_me->i_pix_y;
+    int num_blk_x   = p_me->i_block_w / HASH_ME_BLOCK;
+    int num_blk_y   = p_me->i_block_h / HASH_ME_BLOCK;
+    int b_tiled     = !((p_me->i_block_w | p_me->i_block_h) & (HASH_ME_BLOCK - 1));
+    int num_keys    = 1;        /* number of the keys of the PU computed */
+    int lambda      = h->i_lambda_factor;
+    const uint32_t mv_min = pack16to32_mask2(-p_me->mv_min_fpel[0], -p_me->mv_min_fpel[1]);
+    const uint32_t mv_max = pack16to32_mask2(p_me->mv_max_fpel[0], p_me->mv_max_fpel[1]) | 0x8000;
+    const uint16_t *p_cost_mvx = h->mvbits - p_me->mvp.x;
+    const uint16_t *p_cost_mvy = h->mvbits - p_me->mvp.y;
+    dist_t bcost = *p_bcost;
+    int bmx = *p_bmx;
+    int bmy = *p_bmy;
+    int b_exact = 0;
+    int b_flat;
+    int lcu_y_min, lcu_y_max, lcu_y;
+    int idx, i, j;
+
+    if (p_ref->hash_head == NULL || num_blk_x == 0 || num_blk_y == 0) {
+        return 0;
+    }
+
+    /* PUs with a flat top-left block are left to the regular search */
+    keys_org[0] = hash_me_block(p_org, i_org, &b_flat);
+    if (b_flat) {
+        return 0;
+    }
+    idx = HASH_ME_BUCKET(keys_org[0]);
+
+    /* LCU rows of the positions in the MV range. With frame parallel coding,
+     * the vertical MV range keeps them inside the rows synchronized by
+     * xavs2e_inter_sync() */
+    lcu_y_min = (pix_y + p_me->mv_min_fpel[1]) >> h->i_lcu_level;
+    lcu_y_max = (pix_y + p_me->mv_max_fpel[1]) >> h->i_lcu_level;
+    lcu_y_min = XAVS2_MAX(lcu_y_min, 0);
+    lcu_y_max = XAVS2_MIN(lcu_y_max, h->i_height_in_lcu - 1);
+
+    for (lcu_y = lcu_y_min; lcu_y <= lcu_y_max; lcu_y++) {
+        int pos = p_ref->hash_head[(lcu_y << HASH_ME_TABLE_BITS) + idx];
+
+        for (i = 0; pos >= 0 && i < HASH_ME_MAX_VISITS; pos = p_ref->hash_next[pos], i++) {
+            int ref_x = pos % i_width;
+            int ref_y = pos / i_width;
+            int mx    = ref_x - pix_x;
+            int my    = ref_y - pix_y;
+            int b_match;
+            dist_t cost;
+
+            if (p_ref->hash_key[pos] != keys_org[0] || !CHECK_MV_RANGE(mx, my) ||
+                !check_mvd(h, FPEL(mx) - p_me->mvp.x, FPEL(my) - p_me->mvp.y)) {
+                continue;
+            }
+
+            /* compare the other 8x8 blocks of the PU */
+            b_match = b_tiled && ref_x + p_me->i_block_w <= i_width && ref_y + p_me->i_block_h <= h->i_height;
+            for (j = 1; b_match && j < num_blk_x * num_blk_y; j++) {
+                int blk_x = (j % num_blk_x) * HASH_ME_BLOCK;
+                int blk_y = (j / num_blk_x) * HASH_ME_BLOCK;
+
+                if (j >= num_keys) {
+                    keys_org[j] = hash_me_block(p_org + blk_y * i_org + blk_x, i_org, &b_flat);
+                    num_keys    = j + 1;
+                }
+                b_match = p_ref->hash_key[pos + blk_y * i_width + blk_x] == keys_org[j];
+            }
+
+            cost = g_funcs.pixf.sad[i_pixel](p_org, i_org, p_fref + my * i_fref + mx, i_fref) + MV_COST_IPEL(mx, my);
+            if (cost < bcost) {
+                bcost   = cost;
+                bmx     = mx;
+                bmy     = my;
+                b_exact = b_match;
+            }
+        }
+    }
+
+    *p_bcost = bcost;
+    *p_bmx   = bmx;
+    *p_bmy   = bmy;
+
+    return b_exact;
+}
+
 
 /**
  * ===========================================================================
@@ -868,6 +1014,83 @@ static void tz_pattern_search(xavs2_t* h,
     }
 }
 
+/* ---------------------------------------------------------------------------
+ * build the hash table of the 8x8 luma blocks whose top-left positions are in the
+ * LCU row i_lcu_y of frame frm. the blocks are hashed on the source frame p_org,
+ * on which the PUs are hashed too, because the lossy reconstruction hardly ever
+ * matches exactly. every LCU row has its own table, which is built before the
+ * row is set finished and is never changed while it can be referenced
+ */
+void xavs2_me_hash_build_row(xavs2_t *h, xavs2_frame_t *frm, xavs2_frame_t *p_org, int i_lcu_y)
+{
+    pel_t    *p_plane  = p_org->planes[IMG_Y];
+    int32_t  *p_head   = frm->hash_head + (i_lcu_y << HASH_ME_TABLE_BITS);
+    int       i_stride = p_org->i_stride[IMG_Y];
+    int       i_width  = h->i_width;
+    uint32_t  key_lines[HASH_ME_BLOCK][HASH_ME_CHUNK];   /* line hashes of the last 8 lines */
+    uint32_t  key_pow7 = 1;           /* multiplier of the 1st pixel in a line hash */
+    int y_start, y_end;
+    int x0, x, y, i;
+
+    /* positions [y_start, y_end), lines [y_start, y_end + 7) */
+    y_start = i_lcu_y << h->i_lcu_level;
+    y_end   = XAVS2_MIN((i_lcu_y + 1) << h->i_lcu_level, h->i_height - HASH_ME_BLOCK + 1);
+
+    for (i = 1; i < HASH_ME_BLOCK; i++) {
+        key_pow7 *= HASH_ME_LINE_KEY;
+    }
+    for (i = 0; i < (1 << HASH_ME_TABLE_BITS); i++) {
+        p_head[i] = -1;
+    }
+
+    for (x0 = 0; x0 <= i_width - HASH_ME_BLOCK; x0 += HASH_ME_CHUNK) {
+        int num_pos = XAVS2_MIN(HASH_ME_CHUNK, i_width - HASH_ME_BLOCK + 1 - x0);
+
+        for (y = y_start; y < y_end + HASH_ME_BLOCK - 1; y++) {
+            const pel_t *p = p_plane + y * i_stride + x0;
+            uint32_t *p_key = key_lines[y & (HASH_ME_BLOCK - 1)];
+            uint32_t key = hash_me_line(p);
+            int by, pos;
+
+            /* line hashes, rolling along the line */
+            p_key[0] = key;
+            for (x = 1; x < num_pos; x++) {
+                key = (key - p[x - 1] * key_pow7) * HASH_ME_LINE_KEY + p[x + HASH_ME_BLOCK - 1];
+                p_key[x] = key;
+            }
+
+            /* blocks whose last line is y */
+            by = y - (HASH_ME_BLOCK - 1);
+            if (by < y_start) {
+                continue;
+            }
+            p  -= (HASH_ME_BLOCK - 1) * i_stride;
+            pos = by * i_width + x0;
+            for (x = 0; x < num_pos; x++, pos++) {
+                uint32_t key_line0 = key_lines[by & (HASH_ME_BLOCK - 1)][x];
+                int b_flat = (key_line0 == hash_me_line_flat(p[x]));
+                int idx;
+
+                key = key_line0;
+                for (i = 1; i < HASH_ME_BLOCK; i++) {
+                    uint32_t key_line = key_lines[(by + i) & (HASH_ME_BLOCK - 1)][x];
+                    b_flat &= key_line == key_line0;
+                    key     = key * HASH_ME_BLOCK_KEY + key_line;
+                }
+
+                /* keys of all positions are kept to compare the PUs, but
+                 * flat blocks are never looked up */
+                frm->hash_key[pos] = key;
+                if (!b_flat) {
+                    idx = HASH_ME_BUCKET(key);
+                    frm->hash_next[pos] = p_head[idx];
+                    p_head[idx] = pos;
+                }
+            }
+        }
+    }
+}
+
 // int g_me_time[4] = { 0 };
 
 /* ---------------------------------------------------------------------------
@@ -917,6 +1140,13 @@ dist_t xavs2_me_search(xavs2_t *h, xavs2_me_t *p_me, int16_t(*mvc)[2], int i_mvc
         goto _me_error;         /* me failed */
     }
 
+    /* -------------------------------------------------------------
+     * try the blocks of the reference frame with the same hash, an
+     * exact match terminates the integer pixel search */
+    if (h->param->enable_hash_me && me_hash_search(h, p_me, &bmx, &bmy, &bcost)) {
+        goto _me_hash_matched;
+    }
+
     /* -------------------------------------------------------------
      * search using different method */
     switch (h->param->me_method) {
@@ -1162,6 +1392,7 @@ umh_step_3:                   /* UMH 5. the third step with a small search patte
         break;
     }
 
+_me_hash_matched:
     /* -------------------------------------------------------------
      * store the results of fullpel search */
     p_me->bmv.v  = MAKEDWORD(FPEL(bmx), FPEL(bmy));
@@ -116,6 +116,8 @@ int  xavs2_me_get_buf_size(const xavs2_param_t *param);
 void xavs2_me_init(xavs2_t *h, uint8_t **mem_base);
 #define xavs2_me_init_umh_threshold FPFX(me_init_umh_threshold)
 void xavs2_me_init_umh_threshold(xavs2_t *h, double *bsize, int i_qp);
+#define xavs2_me_hash_build_row FPFX(me_hash_build_row)
+void xavs2_me_hash_build_row(xavs2_t *h, xavs2_frame_t *frm, xavs2_frame_t *p_org, int i_lcu_y);
 
 #define xavs2_me_search FPFX(me_search)
 dist_t xavs2_me_search(xavs2_t *h, xavs2_me_t *p_me, int16_t(*mvc)[2], int i_mvc);
@@ -174,12 +174,14 @@ mapping_default(xavs2_param_map_t *p_map_tab, xavs2_param_t *p)
     MAP("LevelID",                      &p->level_id,                   MAP_NUM, "Level ID   (16: 2.0;  32: 4.0;  34: 4.2;  64: 6.0;  66: 6.2)");
     MAP("SampleBitDepth",               &p->sample_bit_depth,           MAP_NUM, "Encoding bit-depth");
     MAP("IntraPeriod",                  &p->intra_period,               MAP_NUM, "Period of I-Frames (0=only first)");
+    MAP("IntraRefresh",                 &p->intra_refresh,              MAP_NUM, "Number of frames of one gradual intra refresh cycle (0=disabled, low delay only)");
     MAP("OpenGOP",                      &p->b_open_gop,                 MAP_NUM, "Open GOP");
     MAP("FramesToBeEncoded",            &p->num_frames,                 MAP_NUM, "Number of frames to be coded");
     MAP("frames",                       &p->num_frames,                 MAP_NUM, "Number of frames to be coded");
     MAP("UseHadamard",                  &p->enable_hadamard,            MAP_NUM, "Hadamard transform (0=not used, 1=used)");
     MAP("FME",                          &p->me_method,                  MAP_NUM, "Fast Motion Estimation method (0: Full Search, 1: DIA, 2: HEX 3: UMH, 4: TZ)");
     MAP("SearchRange",                  &p->search_range,               MAP_NUM, "Max search range");
+    MAP("HashME",                       &p->enable_hash_me,             MAP_NUM, "Search exact block matches in hash tables of the reference frames before the regular ME (screen content)");
     MAP("NumberReferenceFrames",        &p->num_max_ref,                MAP_NUM, "Number of previous frames used for inter motion search (1-5)");
 
 #if XAVS2_TRACE
@@ -242,7 +244,7 @@ mapping_default(xavs2_param_map_t *p_map_tab, xavs2_param_t *p)
     MAP("NSQT",                         &p->enable_nsqt,                MAP_NUM, "NSQT");
     MAP("SDIP",                         &p->enable_sdip,                MAP_NUM, "SDIP");
     MAP("SECTEnable",                   &p->enable_secT,                MAP_NUM, "Secondary Transform");
-    MAP("TDRDOEnable",                  &p->enable_tdrdo,               MAP_NUM, "TDRDO, only for LDP configuration (without B frames)");
+    MAP("TDRDOEnable",                  &p->enable_tdrdo,               MAP_NUM, "TDRDO, temporal dependency modeled in lookahead, recommended for RA configuration only");
     MAP("RefineQP",                     &p->enable_refine_qp,           MAP_NUM, "Refined QP, only for RA configuration (with B frames)");
 
     MAP("RateControl",                  &p->i_rc_method,                MAP_NUM, "0: CQP, 1: CBR (frame level), 2: CBR (SCU level), 3: VBR");
@@ -252,18 +254,50 @@ mapping_default(xavs2_param_map_t *p_map_tab, xavs2_param_t *p)
     MAP("QPIFrame",                     &p->i_initial_qp,               MAP_NUM, "initial qp for first frame (0-63)");
     MAP("min_qp",                       &p->i_min_qp,                   MAP_NUM, "min qp for rate control    (0-63)");
     MAP("max_qp",                       &p->i_max_qp,                   MAP_NUM, "max qp for rate control    (0-63)");
+    MAP("LookaheadStats",               &p->enable_lookahead_stats,     MAP_NUM, "Estimate the complexity of frames in lookahead for encoder_lookahead_stats() (0: disabled)");
 
     MAP("cfg_type",                     &p->i_cfg_type,                 MAP_NUM, "coding configuration type (1 - LDP, 2 - RA, 3 - RAP, 4 - AI)");
     MAP("gop_size",                     &p->i_gop_size,                 MAP_NUM, "sub GOP size (negative numbers indicating an employ of default settings, which will invliadate the following settings.)");
     MAP("preset_level",                 &p->preset_level,               MAP_NUM, "preset level for the tradeoff between speed and performance, ordered from fastest to slowest (0, ..., 9)");
     MAP("preset",                       &p->preset_level,               MAP_NUM, "preset level for the tradeoff between speed and performance, ordered from fastest to slowest (0, ..., 9)");
 
-    MAP("slice_num",                    &p->slice_num,                  MAP_NUM, "Number of slices for each frame");
+    MAP("slice_num",                    &p->slice_num,                  MAP_NUM, "Number of slices for each frame, 0: decided for each frame by the AEC threads and the bitrate");
 
     MAP("num_parallel_gop",             &p->num_parallel_gop,           MAP_NUM, "number of parallel GOPs (0,1: no GOP parallelization)");
     MAP("thread_frames",                &p->i_frame_threads,            MAP_NUM, "number of parallel threads for frames ( 0: auto )");
     MAP("thread_rows",                  &p->i_lcurow_threads,           MAP_NUM, "number of parallel threads for rows   ( 0: auto )");
     MAP("EnableAecThread",              &p->enable_aec_thread,          MAP_NUM, "Enable AEC thread or not (default: enabled)");
+    MAP("thread_filter",                &p->i_lf_threads,               MAP_NUM, "number of threads for the in-loop filter stage behind row encoding (0: filtered by row encoders)");
+    MAP("ThreadAffinity",               &p->thread_affinity,            MAP_NUM, "Pin worker threads to CPUs (0: none, 1: compact, fill the hardware threads of a core then the next core, 2: scatter over packages and cores)");
+    MAP("AffinityCpus",                 &p->psz_affinity_cpus,          MAP_STR, "CPUs worker threads are pinned to in turn, e.g. 0-7,16-23 (default: by ThreadAffinity)");
+
+    MAP("SegmentMode",                  &p->b_segment,                  MAP_NUM, "Segment encoding, bitstreams of consecutive segments can be concatenated (default: disabled)");
+    MAP("SegmentStartFrame",            &p->segment_start_frame,        MAP_NUM, "Index of the first frame of this segment in the whole video");
+    MAP("SegmentLast",                  &p->b_segment_last,             MAP_NUM, "Is this the last segment, the sequence end code is only written for the last segment");
+    MAP("SegmentRcQp",                  &p->segment_rc_qp,              MAP_NUM, "Base QP of the rate control handed over from the previous segment (0: none)");
+    MAP("SegmentRcBuffer",              &p->segment_rc_buffer,          MAP_NUM, "Buffer error (bits) of the rate control handed over from the previous segment");
+    MAP("SegmentRefs",                  &p->segment_refs,               MAP_NUM, "Frames of the previous segment still referenced, bit (k-1) for the frame SegmentStartFrame-k");
+
+    MAP("LadderNum",                    &p->num_ladder,                 MAP_NUM, "Number of lower renditions encoded along with the input resolution in one pass (0: no ladder)");
+    MAP("Ladder1Width",                 &p->ladder_width[1],            MAP_NUM, "Width of lower rendition 1");
+    MAP("Ladder1Height",                &p->ladder_height[1],           MAP_NUM, "Height of lower rendition 1");
+    MAP("Ladder1BitRate",               &p->ladder_bitrate[1],          MAP_NUM, "Target bitrate of lower rendition 1 (0: scaled from TargetBitRate by area)");
+    MAP("Ladder2Width",                 &p->ladder_width[2],            MAP_NUM, "Width of lower rendition 2");
+    MAP("Ladder2Height",                &p->ladder_height[2],           MAP_NUM, "Height of lower rendition 2");
+    MAP("Ladder2BitRate",               &p->ladder_bitrate[2],          MAP_NUM, "Target bitrate of lower rendition 2 (0: scaled from TargetBitRate by area)");
+    MAP("Ladder3Width",                 &p->ladder_width[3],            MAP_NUM, "Width of lower rendition 3");
+    MAP("Ladder3Height",                &p->ladder_height[3],           MAP_NUM, "Height of lower rendition 3");
+    MAP("Ladder3BitRate",               &p->ladder_bitrate[3],          MAP_NUM, "Target bitrate of lower rendition 3 (0: scaled from TargetBitRate by area)");
+    MAP("Ladder4Width",                 &p->ladder_width[4],            MAP_NUM, "Width of lower rendition 4");
+    MAP("Ladder4Height",                &p->ladder_height[4],           MAP_NUM, "Height of lower rendition 4");
+    MAP("Ladder4BitRate",               &p->ladder_bitrate[4],          MAP_NUM, "Target bitrate of lower rendition 4 (0: scaled from TargetBitRate by area)");
+    MAP("Ladder5Width",                 &p->ladder_width[5],            MAP_NUM, "Width of lower rendition 5");
+    MAP("Ladder5Height",                &p->ladder_height[5],           MAP_NUM, "Height of lower rendition 5");
+    MAP("Ladder5BitRate",               &p->ladder_bitrate[5],          MAP_NUM, "Target bitrate of lower rendition 5 (0: scaled from TargetBitRate by area)");
+
+    MAP("MemAllocMode",                 &p->mem_alloc_mode,             MAP_NUM, "Memory allocation backend (0: system malloc, 1: transparent huge pages, 2: hugetlb pages with THP fallback)");
+    MAP("EnableFramePool",              &p->enable_frame_pool,          MAP_NUM, "Allocate all reference frames from one pooled arena (default: disabled)");
+    MAP("MemoryBudget",                 &p->mem_budget,                 MAP_NUM, "Memory budget in MB, fewer frame/row threads are used to stay within it (0: unlimited)");
 
     MAP("log_level",                    &p->i_log_level,                MAP_NUM, "log level: -1: none, 0: error, 1: warning, 2: info, 3: debug");
     MAP("log",                          &p->i_log_level,                MAP_NUM, "log level: -1: none, 0: error, 1: warning, 2: info, 3: debug");
@@ -815,6 +849,21 @@ xavs2_encoder_opt_get(xavs2_param_t *param, const char *name)
     } else if (!strcmp(name, "SampleShift")) {
         sprintf(buf, "%d", param->sample_bit_depth - param->input_sample_bit_depth);
         return buf;
+    } else if (!strcmp(name, "SegmentMode")) {
+        sprintf(buf, "%d", param->b_segment);
+        return buf;
+    } else if (!strcmp(name, "LadderNum")) {
+        sprintf(buf, "%d", param->num_ladder);
+        return buf;
+    } else if (!strcmp(name, "LookaheadStats")) {
+        sprintf(buf, "%d", param->enable_lookahead_stats);
+        return buf;
+    } else if (!strcmp(name, "thread_frames")) {
+        sprintf(buf, "%d", param->i_frame_threads);
+        return buf;
+    } else if (!strcmp(name, "num_parallel_gop")) {
+        sprintf(buf, "%d", param->num_parallel_gop);
+        return buf;
     }
 
     return NULL;
@@ -45,6 +45,181 @@
 #include "presets.h"
 #include "rps.h"
 
+/* ---------------------------------------------------------------------------
+ * lowres complexity estimation
+ */
+#define LOWRES_BLK_SIZE     8         /* block size on the lowres frame (16x16 on the input frame) */
+#define LOWRES_ME_RANGE     16        /* lowres search range of the motion estimation */
+#define LOWRES_ME_ITERS     8         /* max iterations of the diamond search */
+
+static const int tab_frm_type_to_slice_type[] = {
+    0, 0, 0, 1, 3, 2, 0, 0, 0
+};
+
+/* ---------------------------------------------------------------------------
+ * intra cost of a lowres block, min SATD of DC, horizontal and vertical prediction
+ * from the neighboring original samples
+ */
+static
+int lowres_intra_cost(frm_lowres_t *lowres, int x, int y)
+{
+    ALIGN32(pel_t pred[LOWRES_BLK_SIZE * LOWRES_BLK_SIZE]);
+    pel_t *p_src  = lowres->filtered + y * lowres->i_stride + x;
+    pel_t *p_top  = p_src - lowres->i_stride;
+    pel_t *p_left = p_src - 1;
+    int cost;
+    int dc   = 0;
+    int i, j;
+
+    /* DC */
+    if (x > 0 && y > 0) {
+        for (i = 0; i < LOWRES_BLK_SIZE; i++) {
+            dc += p_top[i] + p_left[i * lowres->i_stride];
+        }
+        dc = (dc + LOWRES_BLK_SIZE) / (2 * LOWRES_BLK_SIZE);
+    } else if (y > 0) {
+        for (i = 0; i < LOWRES_BLK_SIZE; i++) {
+            dc += p_top[i];
+        }
+        dc = (dc + (LOWRES_BLK_SIZE >> 1)) / LOWRES_BLK_SIZE;
+    } else if (x > 0) {
+        for (i = 0; i < LOWRES_BLK_SIZE; i++) {
+            dc += p_left[i * lowres->i_stride];
+        }
+        dc = (dc + (LOWRES_BLK_SIZE >> 1)) / LOWRES_BLK_SIZE;
+    } else {
+        dc = 1 << (g_bit_depth - 1);
+    }
+    for (i = 0; i < LOWRES_BLK_SIZE * LOWRES_BLK_SIZE; i++) {
+        pred[i] = (pel_t)dc;
+    }
+    cost = (int)g_funcs.pixf.satd[LUMA_8x8](p_src, lowres->i_stride, pred, LOWRES_BLK_SIZE);
+
+    /* vertical */
+    if (y > 0) {
+        for (j = 0; j < LOWRES_BLK_SIZE; j++) {
+            memcpy(pred + j * LOWRES_BLK_SIZE, p_top, LOWRES_BLK_SIZE * sizeof(pel_t));
+        }
+        cost = XAVS2_MIN(cost, (int)g_funcs.pixf.satd[LUMA_8x8](p_src, lowres->i_stride, pred, LOWRES_BLK_SIZE));
+    }
+
+    /* horizontal */
+    if (x > 0) {
+        for (j = 0; j < LOWRES_BLK_SIZE; j++) {
+            for (i = 0; i < LOWRES_BLK_SIZE; i++) {
+                pred[j * LOWRES_BLK_SIZE + i] = p_left[j * lowres->i_stride];
+            }
+        }
+        cost = XAVS2_MIN(cost, (int)g_funcs.pixf.satd[LUMA_8x8](p_src, lowres->i_stride, pred, LOWRES_BLK_SIZE));
+    }
+
+    return cost;
+}
+
+/* ---------------------------------------------------------------------------
+ * inter cost of a lowres block, SATD of the best full pel match in the previous
+ * lowres frame, found by a diamond search from the zero MV and the MV predictor
+ */
+static
+int lowres_inter_cost(frm_lowres_t *cur, frm_lowres_t *ref, int x, int y, mv_t *pmv)
+{
+    static const int8_t tab_dia[4][2] = { { 0, -1 }, { -1, 0 }, { 1, 0 }, { 0, 1 } };
+    pel_t *p_src = cur->filtered + y * cur->i_stride + x;
+    int min_x = XAVS2_MAX(-x, -LOWRES_ME_RANGE);
+    int min_y = XAVS2_MAX(-y, -LOWRES_ME_RANGE);
+    int max_x = XAVS2_MIN(ref->i_width - LOWRES_BLK_SIZE - x, LOWRES_ME_RANGE);
+    int max_y = XAVS2_MIN(ref->i_lines - LOWRES_BLK_SIZE - y, LOWRES_ME_RANGE);
+    int bmx = 0, bmy = 0;
+    int best, cost;
+    int mx, my;
+    int i, k;
+
+#define LOWRES_SAD(mx, my) \
+    (int)g_funcs.pixf.sad[LUMA_8x8](p_src, cur->i_stride, ref->filtered + ((y) + (my)) * ref->i_stride + (x) + (mx), ref->i_stride)
+
+    best = LOWRES_SAD(0, 0);
+    mx = XAVS2_CLIP3(min_x, max_x, pmv->x);
+    my = XAVS2_CLIP3(min_y, max_y, pmv->y);
+    if ((mx | my) != 0 && (cost = LOWRES_SAD(mx, my)) < best) {
+        best = cost;
+        bmx  = mx;
+        bmy  = my;
+    }
+
+    for (k = 0; k < LOWRES_ME_ITERS; k++) {
+        int cx = bmx;
+        int cy = bmy;
+        for (i = 0; i < 4; i++) {
+            mx = cx + tab_dia[i][0];
+            my = cy + tab_dia[i][1];
+            if (mx >= min_x && mx <= max_x && my >= min_y && my <= max_y && (cost = LOWRES_SAD(mx, my)) < best) {
+                best = cost;
+                bmx  = mx;
+                bmy  = my;
+            }
+        }
+        if (bmx == cx && bmy == cy) {
+            break;
+        }
+    }
+
+#undef LOWRES_SAD
+
+    pmv->x = (int16_t)bmx;
+    pmv->y = (int16_t)bmy;
+
+    return (int)g_funcs.pixf.satd[LUMA_8x8](p_src, cur->i_stride,
+                                             ref->filtered + (y + bmy) * ref->i_stride + x + bmx, ref->i_stride);
+}
+
+/* ---------------------------------------------------------------------------
+ * estimate the complexity of an input frame on its lowres copy, the inter
+ * costs refer to the previous input frame
+ */
+static
+void lookahead_estimate_complexity(lookahead_t *lookahead, xavs2_frame_t *frm)
+{
+    complex_t    *p_cplx  = &frm->frm_complex;
+    int           i_cur   = lookahead->i_lowres_prev == 0 ? 1 : 0;
+    frm_lowres_t *cur     = &lookahead->lowres[i_cur];
+    frm_lowres_t *ref     = lookahead->i_lowres_prev >= 0 ? &lookahead->lowres[lookahead->i_lowres_prev] : NULL;
+    int           blk_w, blk_h;
+    int           x, y;
+
+    cur->i_width = frm->i_width[IMG_Y] >> 1;
+    cur->i_lines = frm->i_lines[IMG_Y] >> 1;
+    g_funcs.lowres_filter(frm->planes[IMG_Y], frm->i_stride[IMG_Y], cur->filtered, cur->i_stride,
+                          cur->i_width, cur->i_lines);
+    if (ref != NULL && (ref->i_width != cur->i_width || ref->i_lines != cur->i_lines)) {
+        ref = NULL;
+    }
+
+    memset(p_cplx, 0, sizeof(complex_t));
+    blk_w = cur->i_width / LOWRES_BLK_SIZE;
+    blk_h = cur->i_lines / LOWRES_BLK_SIZE;
+    for (y = 0; y < blk_h; y++) {
+        mv_t pmv;
+        pmv.v = 0;
+        for (x = 0; x < blk_w; x++) {
+            int intra_cost = lowres_intra_cost(cur, x * LOWRES_BLK_SIZE, y * LOWRES_BLK_SIZE);
+            int inter_cost = intra_cost;
+
+            if (ref != NULL) {
+                inter_cost = lowres_inter_cost(cur, ref, x * LOWRES_BLK_SIZE, y * LOWRES_BLK_SIZE, &pmv);
+            }
+            p_cplx->i_intra_cost += intra_cost;
+            p_cplx->i_inter_cost += inter_cost;
+            p_cplx->i_best_cost  += XAVS2_MIN(intra_cost, inter_cost);
+            p_cplx->i_sum_intras += intra_cost <= inter_cost;
+        }
+    }
+    p_cplx->i_sum_blocks = blk_w * blk_h;
+    p_cplx->i_slice_type = -1;
+    p_cplx->b_valid      = 1;
+
+    lookahead->i_lowres_prev = i_cur;
+}
+
 /* ---------------------------------------------------------------------------
  */
 static
@@ -195,6 +370,9 @@ int lookahead_append_rest_frames(xavs2_handler_t *h_mgr, xlist_t *list_out, xavs
             frm_set[i] = NULL;
             /* change frame type to none B-picture and set DTS */
             rest_frm->i_frm_type = i_lowdelay_frame;
+            if (rest_frm->frm_complex.b_valid) {
+                rest_frm->frm_complex.i_slice_type = tab_frm_type_to_slice_type[i_lowdelay_frame];
+            }
             rest_frm->i_reordered_pts = rest_frm->i_pts; /* DTS is same as PTS */
 
             /* append to output list to be encoded */
@@ -247,8 +425,22 @@ int send_frame_to_enc_queue(xavs2_handler_t *h_mgr, xavs2_frame_t *frm)
 
     /* process... */
     if (frm->i_state != XAVS2_FLUSH) {
+        frm->b_tdrdo_ratio = 0;
+
+        int b_delayed;
+
+        /* estimate the complexity of current frame, kept until it is output */
+        frm->frm_complex.b_valid = 0;
+        if (param->enable_lookahead_stats && h_mgr->lookahead.num_queued < XAVS2_INPUT_NUM) {
+            lookahead_estimate_complexity(&h_mgr->lookahead, frm);
+            h_mgr->lookahead.queued[h_mgr->lookahead.num_queued++] = frm;
+        }
+
         /* decide the slice type of current frame */
-        int b_delayed = slice_type_analyse(h_mgr, frm);          // is frame delayed to be encoded (B frame) ?
+        b_delayed = slice_type_analyse(h_mgr, frm);          // is frame delayed to be encoded (B frame) ?
+        if (frm->frm_complex.b_valid) {
+            frm->frm_complex.i_slice_type = tab_frm_type_to_slice_type[frm->i_frm_type];
+        }
 
         if (b_delayed) {
             /* block a whole GOP until the last frame(I/P/F) of current GOP
@@ -263,6 +455,11 @@ int send_frame_to_enc_queue(xavs2_handler_t *h_mgr, xavs2_frame_t *frm)
 
             /* is the last frame(I/P/F) of current GOP? */
             if (frm->i_frm_type != XAVS2_TYPE_B) {
+                /* temporal dependency of the whole GOP for TDRDO */
+                if (h_mgr->td_rdo != NULL) {
+                    tdrdo_analyse_gop(h_mgr->td_rdo, param, blocked_frm_set);
+                }
+
                 /* append all frames one by one to output list */
                 for (i = 0; i < gop_size; i++) {
                     k = param->cfg_ref_all[i].poc;
@@ -298,6 +495,10 @@ int send_frame_to_enc_queue(xavs2_handler_t *h_mgr, xavs2_frame_t *frm)
             assert(h_mgr->index_in_gop == 0);
             frm->i_reordered_pts = frm->i_pts;     /* DTS is same as PTS */
 
+            if (h_mgr->td_rdo != NULL) {
+                tdrdo_analyse_frame(h_mgr->td_rdo, frm);
+            }
+
             lookahead_append_frame(h_mgr, list_out, frm, param->successive_Bframe, h_mgr->index_in_gop);
             h_mgr->num_encode++;
         }
@@ -314,3 +515,75 @@ int send_frame_to_enc_queue(xavs2_handler_t *h_mgr, xavs2_frame_t *frm)
     return 0;
 }
 
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get the buffer size for the lowres frames of lookahead
+ * Parameters :
+ *      [in ] : param - pointer to struct xavs2_param_t
+ * Return     : size of the buffer, zero when the complexity is not estimated
+ * ---------------------------------------------------------------------------
+ */
+size_t lookahead_get_buffer_size(const xavs2_param_t *param)
+{
+    size_t size_lowres;
+
+    if (!param->enable_lookahead_stats) {
+        return 0;
+    }
+
+    size_lowres = (size_t)XAVS2_ALIGN((param->org_width  + MAX_CU_SIZE) >> 1, CACHE_LINE_SIZE) *
+                                     ((param->org_height + MAX_CU_SIZE) >> 1) * sizeof(pel_t);
+    return 2 * (size_lowres + CACHE_LINE_SIZE);
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : init the lowres frames of lookahead
+ * Parameters :
+ *      [in ] : h_mgr   - pointer to xavs2_handler_t
+ *            : param   - pointer to struct xavs2_param_t
+ *            : mem_ptr - buffer of lookahead_get_buffer_size() bytes
+ * Return     : none
+ * ---------------------------------------------------------------------------
+ */
+void lookahead_init_lowres(xavs2_handler_t *h_mgr, const xavs2_param_t *param, uint8_t *mem_ptr)
+{
+    lookahead_t *lookahead = &h_mgr->lookahead;
+    int i_stride = XAVS2_ALIGN((param->org_width + MAX_CU_SIZE) >> 1, CACHE_LINE_SIZE);
+    int i;
+
+    for (i = 0; i < 2; i++) {
+        ALIGN_POINTER(mem_ptr);
+        lookahead->lowres[i].i_width  = 0;
+        lookahead->lowres[i].i_lines  = 0;
+        lookahead->lowres[i].i_stride = i_stride;
+        lookahead->lowres[i].filtered = (pel_t *)mem_ptr;
+        mem_ptr += (size_t)i_stride * ((param->org_height + MAX_CU_SIZE) >> 1) * sizeof(pel_t);
+    }
+    lookahead->i_lowres_prev = -1;
+    lookahead->num_queued    = 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : remove an output frame from the queued frames of lookahead
+ * Parameters :
+ *      [in ] : h_mgr - pointer to xavs2_handler_t
+ *            : frm   - frame output
+ * Return     : none
+ * ---------------------------------------------------------------------------
+ */
+void lookahead_remove_output_frame(xavs2_handler_t *h_mgr, xavs2_frame_t *frm)
+{
+    lookahead_t *lookahead = &h_mgr->lookahead;
+    int i;
+
+    for (i = 0; i < lookahead->num_queued; i++) {
+        if (lookahead->queued[i] == frm) {
+            lookahead->num_queued--;
+            memmove(&lookahead->queued[i], &lookahead->queued[i + 1],
+                    (lookahead->num_queued - i) * sizeof(xavs2_frame_t *));
+            break;
+        }
+    }
+}
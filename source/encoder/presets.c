@@ -257,6 +257,7 @@ uint64_t get_fast_algorithms(xavs2_t *h, int i_preset_level)
         SWITCH_ON(OPT_BYPASS_INTRA_BPIC);
     case 1:     // super fast
         SWITCH_ON(OPT_ECU);
+        SWITCH_ON(OPT_ET_SAO);
     case 2:     // very fast
         SWITCH_ON(OPT_FAST_ZBLOCK);
         SWITCH_ON(OPT_FAST_RDO_INTRA_C);
@@ -95,6 +95,7 @@ struct ratectrl_t {    //EKIN_MARK
     int         i_intra_period;       // period of I-frames (=0, only first)
     int         i_frame_size;         // frame size in pixel
     int         b_open_gop;           // open GOP? 1: open, 0: close
+    int         b_seeded;             // state handed over from the previous segment
 
     /* qp */
     double      f_delta_qp;           // delta qp
@@ -125,6 +126,9 @@ struct ratectrl_t {    //EKIN_MARK
     double      f_buf_error_diff;     // different buffer error
     double      f_buf_error_prev;     // previous  buffer error
 
+    /* reconfiguration */
+    double      f_new_target_bpp;     // target BPP set at runtime, applied before the next KEY frame (0: none)
+
 #if RC_AUTO_ADJUST
     /* level */
     double      f_first_buf_level;    // first buffer size level
@@ -296,6 +300,43 @@ static double rc_calculate_gop_delta_qp(ratectrl_t *rc, int frm_type, int gop_le
     return fuzzy_get_delta_qp(rc->f_buf_error, rc->f_buf_error_diff, buf_range, -buf_range, buf_range_delta, -buf_range_delta);
 }
 
+/* ---------------------------------------------------------------------------
+ * apply the target BPP set at runtime. the base QP jumps by the change predicted
+ * by the rate model (bits halve every 8 QP), so that the fuzzy controller only
+ * settles the rest. the states in BPP are scaled to the new target, and half of
+ * the buffer error is forgiven, since it was accumulated against the old target
+ */
+static void rc_apply_target_bpp(ratectrl_t *rc)
+{
+    double ratio = rc->f_new_target_bpp / rc->f_target_bpp;
+
+    rc->f_target_bpp     = rc->f_new_target_bpp;
+    rc->f_new_target_bpp = 0.0;
+
+    rc->f_buf_curr       *= 0.5 * ratio;
+    rc->f_buf_error      *= 0.5 * ratio;
+    rc->f_buf_error_prev  = rc->f_buf_error;
+    rc->f_buf_error_diff  = 0.0;
+    rc->f_win_bpp        *= ratio;
+    rc->f_gop_bpp        *= ratio;
+    rc->f_intra_bpp      *= ratio;
+    rc->f_inter_bpp      *= ratio;
+    rc->f_delta_qp        = 0.0;
+
+    if (rc->i_coded_frames > 0 || rc->b_seeded) {
+        double delta_qp = -8.0 * log(ratio) / log(2.0);
+        int    i_delta;
+
+        delta_qp = XAVS2_CLIP3F(-2 * RC_MAX_DELTA_QP, 2 * RC_MAX_DELTA_QP, delta_qp);
+        i_delta  = (int)floor(delta_qp + 0.5);
+        rc->i_base_qp  = XAVS2_MAX(rc->i_min_qp, rc->i_base_qp + i_delta);
+        rc->i_last_qp += i_delta;     /* KEY frame QP is limited around the last one */
+    }
+
+    /* the last WIN strengthens the controller, see rc_calculate_frame_qp() */
+    init_fuzzy_controller(rc->i_intra_period == 1 ? 0.85 : 0.75);
+}
+
 /**
 * ---------------------------------------------------------------------------
 * Function   : calculate the key frame QP
@@ -339,7 +380,7 @@ static int rc_calculate_frame_qp(xavs2_t *h, int frm_idx, int frm_type, int forc
 
 #if ENABLE_AUTO_INIT_QP
     /* compute the initial qp */
-    if (frm_idx == 0) {
+    if (frm_idx == h->param->segment_start_frame && !rc->b_seeded) {
         double bit = log(1000 * rc->f_target_bpp);
         double gpp = log(cal_frame_gradient(h->fenc));
         int    idx = XAVS2_MIN(2, rc->i_intra_period);
@@ -416,7 +457,7 @@ static int rc_calculate_frame_qp(xavs2_t *h, int frm_idx, int frm_type, int forc
     }
 
     // check the QP
-    if (rc->i_coded_frames > 0 && frm_type != XAVS2_TYPE_B) {
+    if ((rc->i_coded_frames > 0 || rc->b_seeded) && frm_type != XAVS2_TYPE_B) {
         qp = XAVS2_CLIP3F(rc->i_last_qp - RC_MAX_DELTA_QP, rc->i_last_qp + RC_MAX_DELTA_QP, qp);
     }
 
@@ -488,7 +529,7 @@ static void UpdataLCURateControl(ratectrl_t *rc, int qp, double lambda, int bits
  * Return     : return > 0 on success, 0/-1 on failure
  * ---------------------------------------------------------------------------
  */
-int xavs2_rc_get_buffer_size(xavs2_param_t *param)
+int xavs2_rc_get_buffer_size(const xavs2_param_t *param)
 {
     UNUSED_PARAMETER(param);
     return sizeof(ratectrl_t);
@@ -550,6 +591,14 @@ int xavs2_rc_init(ratectrl_t *rc, xavs2_param_t *param)
     rc->f_delta_buf_level = 0.0;
 #endif
 
+    // continue from the state of the previous segment
+    if (param->b_segment && param->segment_rc_qp > 0) {
+        rc->b_seeded   = 1;
+        rc->i_base_qp  = XAVS2_CLIP3(rc->i_min_qp, rc->i_max_qp, param->segment_rc_qp);
+        rc->i_last_qp  = rc->i_base_qp;
+        rc->f_buf_curr = (double)param->segment_rc_buffer / rc->i_frame_size;
+    }
+
     // set size of WIN (intra period)
     rc->i_win_size = param->i_gop_size * (rc->i_intra_period - 1) + 1;
 
@@ -596,6 +645,9 @@ int xavs2_rc_get_frame_qp(xavs2_t *h, int frm_idx, int frm_type, int force_qp)
     if (h->param->i_rc_method != XAVS2_RC_CQP && frm_type != XAVS2_TYPE_B) {
         int i_qp;
         xavs2_thread_mutex_lock(&h->rc->rc_mutex);
+        if (h->rc->f_new_target_bpp > 0) {
+            rc_apply_target_bpp(h->rc);
+        }
         i_qp = rc_calculate_frame_qp(h, frm_idx, frm_type, force_qp);
         xavs2_thread_mutex_unlock(&h->rc->rc_mutex);
         return i_qp;
@@ -821,6 +873,42 @@ void xavs2_rc_update_after_frame_coded(xavs2_t *h, int frm_bits, int frm_qp, int
     xavs2_thread_mutex_unlock(&rc->rc_mutex);  // unlock
 }
 
+/**
+* ---------------------------------------------------------------------------
+* Function   : set a new target bitrate at runtime, which is applied before
+*              the QP of the next KEY frame is decided
+* Parameters :
+*      [in ] : rc      - handle of the ratecontrol handler
+*            : param   - parameters of the encoder
+*            : bitrate - new target bitrate, in bps
+* Return     : none
+* ---------------------------------------------------------------------------
+*/
+void xavs2_rc_set_bitrate(ratectrl_t *rc, const xavs2_param_t *param, int bitrate)
+{
+    xavs2_thread_mutex_lock(&rc->rc_mutex);
+    rc->f_new_target_bpp = bitrate / (param->frame_rate * rc->i_frame_size);
+    xavs2_thread_mutex_unlock(&rc->rc_mutex);
+}
+
+/**
+* ---------------------------------------------------------------------------
+* Function   : get the state to be handed over to the next segment
+* Parameters :
+*      [in ] : rc          - handle of the ratecontrol handler
+*      [out] : base_qp     - base QP
+*            : buffer_bits - buffer error in bits
+* Return     : none
+* ---------------------------------------------------------------------------
+*/
+void xavs2_rc_get_segment_state(ratectrl_t *rc, int *base_qp, int *buffer_bits)
+{
+    xavs2_thread_mutex_lock(&rc->rc_mutex);
+    *base_qp     = rc->i_base_qp;
+    *buffer_bits = (int)(rc->f_buf_curr * rc->i_frame_size);
+    xavs2_thread_mutex_unlock(&rc->rc_mutex);
+}
+
 /**
 * ---------------------------------------------------------------------------
 * Function   : destroy the rate control
@@ -39,7 +39,7 @@
 #define XAVS2_RATECONTRAL_H
 
 #define xavs2_rc_get_buffer_size FPFX(rc_get_buffer_size)
-int  xavs2_rc_get_buffer_size(xavs2_param_t *h);
+int  xavs2_rc_get_buffer_size(const xavs2_param_t *h);
 #define xavs2_rc_init FPFX(rc_init)
 int  xavs2_rc_init(ratectrl_t *rc, xavs2_param_t *param);
 
@@ -60,6 +60,12 @@ int  xavs2_rc_get_lcu_qp(xavs2_t *h, int frm_idx, int qp);
 void xavs2_rc_update_after_lcu_coded(xavs2_t *h, int frm_idx, int qp);
 #endif  // ENABLE_RATE_CONTROL_CU
 
+#define xavs2_rc_set_bitrate FPFX(rc_set_bitrate)
+void xavs2_rc_set_bitrate(ratectrl_t *rc, const xavs2_param_t *param, int bitrate);
+
+#define xavs2_rc_get_segment_state FPFX(rc_get_segment_state)
+void xavs2_rc_get_segment_state(ratectrl_t *rc, int *base_qp, int *buffer_bits);
+
 #define xavs2_rc_destroy FPFX(rc_destroy)
 void xavs2_rc_destroy(ratectrl_t *rc);
 
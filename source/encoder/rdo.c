@@ -47,6 +47,7 @@
 #include "predict.h"
 #include "ratecontrol.h"
 #include "rdoq.h"
+#include "ladder.h"
 
 
 /**
@@ -244,7 +245,7 @@ void cu_init(xavs2_t *h, cu_t *p_cu, cu_info_t *best, int i_level)
     if (h->param->i_rc_method == XAVS2_RC_CBR_SCU) {
         int i_left_cu_qp;
         if (p_cu->i_pix_x > 0) {
-            i_left_cu_qp = h->cu_info[p_cu->i_scu_xy - 1].i_cu_qp;
+            i_left_cu_qp = cu_get_scu_qp(h, p_cu->i_scu_xy - 1);
         } else {
             i_left_cu_qp = h->i_qp;
         }
@@ -407,10 +408,19 @@ void cu_copy_stored_parameters(xavs2_t *h, cu_t *p_cu, cu_info_t *best)
 
     //===============   cbp and mode   ===============
     for (j = 0; j < size_in_scu; j++) {
-        cu_info_t *p_cu_info = &h->cu_info[j * h->i_width_in_mincu + scu_xy];  // save data to cu_info
+        int scu_offset = j * h->i_width_in_mincu + scu_xy;
+        cu_info_t *p_cu_info = &h->cu_info[scu_offset];  // save data to cu_info
         for (i = size_in_scu; i != 0; i--) {
             cu_copy_info(p_cu_info++, best);
         }
+
+        g_funcs.fast_memset(h->scu_level    + scu_offset, best->i_level,    size_in_scu * sizeof(int8_t));
+        g_funcs.fast_memset(h->scu_mode     + scu_offset, best->i_mode,     size_in_scu * sizeof(int8_t));
+        g_funcs.fast_memset(h->scu_cbp      + scu_offset, best->i_cbp,      size_in_scu * sizeof(int8_t));
+        g_funcs.fast_memset(h->scu_tu_split + scu_offset, best->i_tu_split, size_in_scu * sizeof(int8_t));
+#if ENABLE_RATE_CONTROL_CU
+        g_funcs.fast_memset(h->scu_qp       + scu_offset, best->i_cu_qp,    size_in_scu * sizeof(int8_t));
+#endif
     }
 
     //===============   intra pred mode   ===============
@@ -1626,6 +1636,10 @@ int rdo_get_pred_inter(xavs2_t *h, cu_t *p_cu, int cal_luma_chroma)
         if (!b_mv_valid && p_cu->cu_info.i_mode != PRED_SKIP) {
             return 0;
         }
+        if (!check_mv_refresh(h, &mv_1st, ref_1st, pix_y, height) ||
+            (num_mvs > 1 && !check_mv_refresh(h, &mv_2nd, ref_2nd, pix_y, height))) {
+            return 0;           // refer to the unrefreshed rows
+        }
 
         /* y component */
         if (cal_luma_chroma & 1) {
@@ -3166,7 +3180,7 @@ rdcost_t compress_cu_inter(xavs2_t *h, aec_t *p_aec, cu_t *p_cu, cu_info_t *best
     }
 
     /* ڶTU֣ѡģʽ */
-    if (IS_ALG_ENABLE(OPT_TU_LEVEL_DEC) && best->i_cbp > 0) {
+    if (IS_ALG_ENABLE(OPT_TU_LEVEL_DEC) && best->i_cbp > 0 && min_rdcost < MAX_COST) {
         h->enable_tu_2level = 1;
         mode = best->i_mode;
         cu_copy_info(&p_cu->cu_info, best);
@@ -3212,6 +3226,12 @@ rdcost_t compress_cu_inter(xavs2_t *h, aec_t *p_aec, cu_t *p_cu, cu_info_t *best
         b_bypass_intra = 1;
     }
 
+    /* no inter mode refers to the refreshed rows only: intra is the only choice above the intra refresh band */
+    if (min_rdcost == MAX_COST && p_cu->i_pix_y < (h->i_refresh_row_start << h->i_lcu_level)) {
+        b_bypass_intra = 0;
+        avail_modes   |= 1 << PRED_I_2Nx2N;
+    }
+
     /* -------------------------------------------------------------
      * 4, get best intra mode
      */
@@ -3297,6 +3317,25 @@ int ctu_intra_depth_pred_mad(xavs2_t *h, int level, int pix_x, int pix_y)
 }
 
 
+/* ---------------------------------------------------------------------------
+ * ladder encoding: only check the CU levels around the ones of the top rendition
+ */
+static INLINE
+void ctu_ladder_limit_levels(xavs2_t *h, cu_t *p_cu, int i_level, int *b_split_ctu, int *b_check_large_cu)
+{
+    int min_level, max_level;
+
+    ladder_hint_cu_levels(h, p_cu->i_pix_x, p_cu->i_pix_y, p_cu->i_size, &min_level, &max_level);
+
+    /* refine one level around the levels of the top rendition */
+    if (i_level < min_level) {
+        *b_split_ctu = FALSE;
+    } else if (*b_split_ctu && i_level > max_level + 1) {
+        *b_check_large_cu = FALSE;
+    }
+}
+
+
 /**
  * ===========================================================================
  * interface function defines
@@ -3374,6 +3413,10 @@ rdcost_t compress_ctu_intra(xavs2_t *h, aec_t *p_aec, cu_t *p_cu, int i_level, i
      */
     cu_init(h, p_cu, best, i_level);
 
+    if (h->ladder_hint != NULL && b_inside_pic) {
+        ctu_ladder_limit_levels(h, p_cu, i_level, &b_split_ctu, &b_check_large_cu);
+    }
+
     /* coding current CU -------------------------------------------
      */
     if (b_check_large_cu) {
@@ -3451,6 +3494,10 @@ rdcost_t compress_ctu_inter(xavs2_t *h, aec_t *p_aec, cu_t *p_cu, int i_level, i
      */
     cu_init(h, p_cu, best, i_level);
 
+    if (h->ladder_hint != NULL && b_inside_pic) {
+        ctu_ladder_limit_levels(h, p_cu, i_level, &b_split_ctu, &b_check_large_cu);
+    }
+
     /* coding current CU -------------------------------------------
      */
     if (b_check_large_cu) {
@@ -217,6 +217,14 @@ int xavs2e_get_frame_rps(const xavs2_t *h, xavs2_frame_buffer_t *frm_buf,
 
             if (!h->param->b_open_gop || !h->param->successive_Bframe) {
                 // IDR refresh
+                if (h->param->b_segment && cur_frm->i_frm_coi == h->param->segment_start_frame) {
+                    /* frames of the previous segment, which are not in the DPB of this encoder */
+                    for (j = 31; j >= 1 && p_rps->num_to_rm < 7; j--) {
+                        if (((h->param->segment_refs >> (j - 1)) & 1) && j <= cur_frm->i_frm_coi) {
+                            p_rps->rm_pic[p_rps->num_to_rm++] = j;
+                        }
+                    }
+                }
                 for (j = 0; j < frm_buf->num_frames; j++) {
                     if ((frame = frm_buf->frames[j]) != NULL && cur_frm->i_frame != frame->i_frame) {
                         xavs2_thread_mutex_lock(&frame->mutex);      /* lock */
@@ -239,6 +247,16 @@ int xavs2e_get_frame_rps(const xavs2_t *h, xavs2_frame_buffer_t *frm_buf,
                         }
                     }
                 }
+                /* in the order of COI, the same in segment encoding */
+                for (j = 1; j < p_rps->num_to_rm; j++) {
+                    int rm_pic = p_rps->rm_pic[j];
+                    int k;
+
+                    for (k = j; k > 0 && p_rps->rm_pic[k - 1] < rm_pic; k--) {
+                        p_rps->rm_pic[k] = p_rps->rm_pic[k - 1];
+                    }
+                    p_rps->rm_pic[k] = rm_pic;
+                }
             } else {
                 // RA OpenGOP, I֡P/F֡λãP/F֡Ƴ֡б
                 memcpy(p_rps, &p_seq_rps[0], sizeof(xavs2_rps_t));
@@ -554,61 +572,72 @@ int frame_is_free(const xavs2_handler_t *h_mgr, int cur_poc, xavs2_frame_t *fram
 }
 
 /* ---------------------------------------------------------------------------
- * find a free frame for encoding
+ * take the first idle picture of the DPB which is free (or only writable when
+ * b_writable is set) and hold it for encoding, returns NULL if there is none.
+ * pictures that are in use again are dropped from the idle mask on the way
  */
-static INLINE
-xavs2_frame_t *frame_buffer_find_free_frame_dpb(xavs2_handler_t *h_mgr, xavs2_t *h, xavs2_frame_buffer_t *frm_buf,
-                                                xavs2_frame_t *cur_frm, xavs2_rps_t *p_rps)
+static
+xavs2_frame_t *frame_buffer_take_idle_frame(xavs2_handler_t *h_mgr, xavs2_frame_buffer_t *frm_buf,
+                                            int cur_poc, int b_writable)
 {
-    xavs2_frame_t **DPB = frm_buf->frames;
     xavs2_frame_t *fdec_frm = NULL;
-    int num_frames = frm_buf->num_frames;
-    int i;
+    uint64_t mask;
 
-    // find a free frame for the fdec
-    for (i = 0; i < num_frames; i++) {
-        xavs2_frame_t *frame = DPB[i];
-        if (frame != NULL) {
-            xavs2_thread_mutex_lock(&frame->mutex);          /* lock */
+    xavs2_thread_mutex_lock(&frm_buf->idle_mutex);       /* lock */
 
-            if (frame_is_free(h_mgr, cur_frm->i_frame, frame)) {
-                frame->cnt_refered++;  // for Encoding decision
-                frame->cnt_refered++;  // for entropy encoding
-                fdec_frm = frame;
-                xavs2_thread_mutex_unlock(&frame->mutex);    /* unlock */
-                break;
-            }
+    mask = frm_buf->idle_mask;
+    while (mask != 0) {
+        uint32_t mask_lo = (uint32_t)mask;
+        int i = mask_lo ? xavs2_ctz(mask_lo) : 32 + xavs2_ctz((uint32_t)(mask >> 32));
+        xavs2_frame_t *frame = frm_buf->frames[i];
 
-            xavs2_thread_mutex_unlock(&frame->mutex);        /* unlock */
-        }
-    }
+        mask &= mask - 1;
 
-    // fdec must exist
-    for (; fdec_frm == NULL;) {
-        for (i = 0; i < num_frames; i++) {
-            xavs2_frame_t *frame = DPB[i];
-            if (frame != NULL) {
-                xavs2_thread_mutex_lock(&frame->mutex);          /* unlock */
+        xavs2_thread_mutex_lock(&frame->mutex);          /* lock */
 
-                if (frame_is_writable(h_mgr, frame)) {
-                    p_rps->rm_pic[p_rps->num_to_rm++] = cur_frm->i_frm_coi - frame->i_frm_coi;
-                    p_rps->idx_in_gop = -1;
+        if (frame->cnt_refered != 0) {
+            /* in use again, it rejoins when its last user releases it */
+            frm_buf->idle_mask &= ~((uint64_t)1 << i);
+        } else if (b_writable ? frame_is_writable(h_mgr, frame) : frame_is_free(h_mgr, cur_poc, frame)) {
+            frame->cnt_refered++;  // for Encoding decision
+            frame->cnt_refered++;  // for entropy encoding
+            frm_buf->idle_mask &= ~((uint64_t)1 << i);
+            fdec_frm = frame;
+        }
 
-                    frame->cnt_refered++;  // for Encoding decision
-                    frame->cnt_refered++;  // for entropy encoding
+        xavs2_thread_mutex_unlock(&frame->mutex);        /* unlock */
 
-                    fdec_frm = frame;
+        if (fdec_frm != NULL) {
+            break;
+        }
+    }
 
-                    xavs2_thread_mutex_unlock(&frame->mutex);    /* unlock */
+    xavs2_thread_mutex_unlock(&frm_buf->idle_mutex);     /* unlock */
 
-                    break;
-                }
+    return fdec_frm;
+}
 
-                xavs2_thread_mutex_unlock(&frame->mutex);        /* unlock */
-            }
-        }
+/* ---------------------------------------------------------------------------
+ * find a free frame for encoding
+ */
+static INLINE
+xavs2_frame_t *frame_buffer_find_free_frame_dpb(xavs2_handler_t *h_mgr, xavs2_t *h, xavs2_frame_buffer_t *frm_buf,
+                                                xavs2_frame_t *cur_frm, xavs2_rps_t *p_rps)
+{
+    // find a free frame for the fdec among the idle pictures
+    xavs2_frame_t *fdec_frm = frame_buffer_take_idle_frame(h_mgr, frm_buf, cur_frm->i_frame, 0);
 
-        if (fdec_frm) {
+    // allocate a new frame if the DPB has not grown to its full size yet
+    if (fdec_frm == NULL && (fdec_frm = frame_buffer_alloc_frame(h_mgr, frm_buf)) != NULL) {
+        fdec_frm->cnt_refered++;  // for Encoding decision
+        fdec_frm->cnt_refered++;  // for entropy encoding
+    }
+
+    // fdec must exist
+    for (; fdec_frm == NULL;) {
+        if ((fdec_frm = frame_buffer_take_idle_frame(h_mgr, frm_buf, cur_frm->i_frame, 1)) != NULL) {
+            p_rps->rm_pic[p_rps->num_to_rm++] = cur_frm->i_frm_coi - fdec_frm->i_frm_coi;
+            p_rps->idx_in_gop = -1;
             break;
         }
 
@@ -632,7 +661,8 @@ xavs2_frame_t *frame_buffer_find_free_frame_dpb(xavs2_handler_t *h_mgr, xavs2_t
  * find a free frame for encoding
  */
 static INLINE
-void rps_determine_remove_frames(xavs2_frame_buffer_t *frm_buf, xavs2_frame_t *cur_frm)
+void rps_determine_remove_frames(xavs2_frame_buffer_t *frm_buf, xavs2_frame_t *cur_frm,
+                                 int coi_prev_segment, int refs_prev_segment, int coi_idr)
 {
     int i, k;
 
@@ -645,6 +675,20 @@ void rps_determine_remove_frames(xavs2_frame_buffer_t *frm_buf, xavs2_frame_t *c
             continue;
         }
 
+        if (coi < coi_idr && cur_frm->i_frm_coi != coi_idr) {
+            /* frames of the previous closed GOP have been removed by the IDR frame */
+            continue;
+        }
+
+        if (coi < coi_prev_segment) {
+            /* frames of the previous segment are not in the DPB of this encoder,
+             * only the ones still referenced (SegmentRefs) can be removed */
+            if (coi_prev_segment - coi <= 32 && ((refs_prev_segment >> (coi_prev_segment - coi - 1)) & 1)) {
+                cur_frm->rps.rm_pic[k++] = cur_frm->rps.rm_pic[i];
+            }
+            continue;
+        }
+
         frame = find_frame_by_coi(frm_buf, coi);
 
         if (frame != NULL) {
@@ -700,12 +744,12 @@ void frame_buffer_remove_frames(xavs2_frame_buffer_t *frm_buf)
         if (frame != NULL) {
             xavs2_thread_mutex_lock(&frame->mutex);          /* lock */
 
+            /* all frames in the list are removed, the removed ones are
+             * not listed again by following frames */
             if (frame->i_frm_coi == coi_frame_to_remove && frame->removed == 0) {
                 frame->removed = 1;
                 // xavs2_log(NULL, XAVS2_LOG_DEBUG, "remove frame COI: %3d, POC %3d\n",
                 //           frame->i_frm_coi, frame->i_frame);
-                xavs2_thread_mutex_unlock(&frame->mutex);    /* unlock */
-                break;
             }
 
             xavs2_thread_mutex_unlock(&frame->mutex);        /* unlock */
@@ -739,6 +783,8 @@ int rps_build(const xavs2_t *h, xavs2_frame_buffer_t *frm_buf,
               xavs2_frame_t *cur_frm,
               xavs2_rps_t *p_rps, xavs2_frame_t *frefs[XAVS2_MAX_REFS])
 {
+    int b_segment_start;
+
     // initialize current RPS
     cur_frm->rps_index_in_gop = xavs2e_get_frame_rps(h, frm_buf, cur_frm, p_rps);
 
@@ -768,7 +814,11 @@ int rps_build(const xavs2_t *h, xavs2_frame_buffer_t *frm_buf,
         p_rps->num_of_ref = rps_fix_reference_list_pf(h, frm_buf, cur_frm, p_rps, frefs);
     }
 
-    rps_determine_remove_frames(frm_buf, cur_frm);
+    b_segment_start = h->param->b_segment && cur_frm->i_frm_coi == h->param->segment_start_frame;
+    rps_determine_remove_frames(frm_buf, cur_frm,
+                                b_segment_start ? h->param->segment_start_frame : 0,
+                                b_segment_start ? h->param->segment_refs : 0,
+                                (h->param->intra_period != 0 && (!h->param->b_open_gop || !h->param->successive_Bframe)) ? frm_buf->COI_IDR : 0);
 
     return 0;
 }
@@ -828,6 +878,72 @@ void rps_set_picture_reorder_delay(xavs2_t *h)
 }
 
 
+/* ---------------------------------------------------------------------------
+ * get the number of frames needed in DPB: the coding of several GOPs is
+ * simulated with the RPS configuration to find the max number of frames that
+ * are still referenced or waiting for output when a new frame is allocated,
+ * then the frames held by other parallel frame encoders are added
+ */
+int rps_get_dpb_size(const xavs2_param_t *param, int num_frm_threads)
+{
+#define RPS_SIM_FRAMES  (XAVS2_MAX_GOPS * 4)
+    int8_t b_refered[RPS_SIM_FRAMES + 1];               /* referenced and not removed, indexed by COI */
+    int8_t b_coded[RPS_SIM_FRAMES + XAVS2_MAX_GOPS + 1];/* reconstructed, indexed by POC */
+    int    poc[RPS_SIM_FRAMES + 1];                     /* POC of each frame, indexed by COI */
+    int    coi_rm[8];                                   /* frames to be removed by the last frame */
+    int    gop_size = XAVS2_MAX(1, param->i_gop_size);
+    int    num_rm   = 0;
+    int    max_rm   = 1;
+    int    num_need = 1;
+    int    poc_out  = 0;                                /* next POC to be output */
+    int    coi, i, n;
+
+    if (param->intra_period != 1) {
+        memset(b_refered, 0, sizeof(b_refered));
+        memset(b_coded,   0, sizeof(b_coded));
+
+        /* the first I frame */
+        b_refered[0] = 1;
+        b_coded[0]   = 1;
+        poc[0]       = 0;
+        poc_out      = 1;
+
+        for (coi = 1; coi <= RPS_SIM_FRAMES; coi++) {
+            const xavs2_rps_t *p_rps = &param->cfg_ref_all[(coi - 1) % gop_size];
+
+            /* remove frames before the encoding of current frame */
+            for (i = 0; i < num_rm; i++) {
+                b_refered[coi_rm[i]] = 0;
+            }
+
+            /* frames occupied when current frame looks for a free frame */
+            for (i = 0, n = 0; i < coi; i++) {
+                n += (b_refered[i] || poc[i] >= poc_out);
+            }
+            num_need = XAVS2_MAX(num_need, n + 1);
+
+            /* encode current frame */
+            poc[coi]       = ((coi - 1) / gop_size) * gop_size + p_rps->poc;
+            b_refered[coi] = (int8_t)(p_rps->referd_by_others != 0);
+            b_coded[poc[coi]] = 1;
+            while (poc_out <= RPS_SIM_FRAMES && b_coded[poc_out]) {
+                poc_out++;
+            }
+
+            for (i = 0, num_rm = 0; i < p_rps->num_to_rm; i++) {
+                if (coi - p_rps->rm_pic[i] >= 0) {
+                    coi_rm[num_rm++] = coi - p_rps->rm_pic[i];
+                }
+            }
+            max_rm = XAVS2_MAX(max_rm, p_rps->num_to_rm);
+        }
+    }
+#undef RPS_SIM_FRAMES
+
+    /* each other frame encoder holds its own frame and the removed frames it still refers to */
+    return num_need + (num_frm_threads - 1) * (1 + max_rm);
+}
+
 /* ---------------------------------------------------------------------------
  * check RPS config
  */
@@ -69,4 +69,7 @@ int rps_check_config(xavs2_param_t *param);
 #define rps_set_picture_reorder_delay FPFX(rps_set_picture_reorder_delay)
 void rps_set_picture_reorder_delay(xavs2_t *h);
 
+#define rps_get_dpb_size FPFX(rps_get_dpb_size)
+int rps_get_dpb_size(const xavs2_param_t *param, int num_frm_threads);
+
 #endif  // XAVS2_RPS_H
@@ -49,6 +49,12 @@ static const int tab_sao_check_mode_fast[3][5] = {
     0, 0, 0, 0, 1
 };
 
+/* least bits counted for a SAO mode other than off which reduces the distortion,
+ * from its bins coded with equal probability: one of the mode, and then one for
+ * each of the 4 EO offsets, or two for one non-zero BO offset (the bits of the
+ * EO class and BO bands are not counted, see write_sao_type()) */
+#define SAO_ET_MIN_BITS     XAVS2_MIN(1 + 4, 1 + 2)
+
 /**
  * ===========================================================================
  * local function defines
@@ -359,6 +365,155 @@ void sao_get_stat_block_BO(xavs2_frame_t *frm_rec, xavs2_frame_t *frm_org,
     }          
 }
 
+/* ---------------------------------------------------------------------------
+ * statistics of all EO classes and BO in one pass over the region, same as
+ * calling the five functions above one by one but the reconstructed and the
+ * original pixels are read only once
+ */
+static
+void sao_get_stat_block_all(xavs2_frame_t *frm_rec, xavs2_frame_t *frm_org,
+                            SAOStatData p_stats[NUM_SAO_NEW_TYPES], sao_region_t *p_region, int compIdx)
+{
+    SAOStatData *p_stat_0   = &p_stats[SAO_TYPE_EO_0];
+    SAOStatData *p_stat_90  = &p_stats[SAO_TYPE_EO_90];
+    SAOStatData *p_stat_135 = &p_stats[SAO_TYPE_EO_135];
+    SAOStatData *p_stat_45  = &p_stats[SAO_TYPE_EO_45];
+    SAOStatData *p_stat_bo  = &p_stats[SAO_TYPE_BO];
+    /* signs to the upper neighbors of pixels in current row:
+     * sign_up[x] = sign(rec[x] - rec[x - i_rec])  and so on */
+    int8_t sign_up[MAX_CU_SIZE << 1];
+    int8_t sign_ul_buf[2][MAX_CU_SIZE << 1];
+    int8_t sign_ur_buf[(MAX_CU_SIZE << 1) + 1];
+    int8_t *sign_ur = sign_ur_buf + 1;  /* sign_ur[-1] is written but never read */
+    int8_t *sign_ul = sign_ul_buf[0];
+    int8_t *sign_ul_next = sign_ul_buf[1];
+    int band_shift = (g_bit_depth - NUM_SAO_BO_CLASSES_IN_BIT);
+    int x, y;
+
+    int pix_x = p_region->pix_x[compIdx];
+    int pix_y = p_region->pix_y[compIdx];
+    int width = p_region->width[compIdx];
+    int height = p_region->height[compIdx];
+    int start_x = p_region->b_left  ? 0 : 1;
+    int end_x   = p_region->b_right ? width  : (width - 1);
+    int start_y = p_region->b_top   ? 0 : 1;
+    int end_y   = p_region->b_down  ? height : (height - 1);
+
+    int i_rec = frm_rec->i_stride[compIdx];
+    int i_org = frm_org->i_stride[compIdx];
+    const pel_t *p_rec = frm_rec->planes[compIdx] + pix_y * i_rec + pix_x;
+    const pel_t *p_org = frm_org->planes[compIdx] + pix_y * i_org + pix_x;
+
+    for (x = 0; x < NUM_SAO_NEW_TYPES; x++) {
+        sao_init_stat_data(&p_stats[x]);
+    }
+
+    for (y = 0; y < height; y++) {
+        const pel_t *r = p_rec + y * i_rec;
+        const pel_t *o = p_org + y * i_org;
+        int leftsign, rightsign, edgetype;
+        int diff;
+
+        if (y < start_y || y >= end_y) {
+            /* no vertical or diagonal neighbors: EO_0 and BO only */
+            leftsign = xavs2_sign3(r[start_x] - r[start_x - 1]);
+            for (x = start_x; x < end_x; x++) {
+                diff = o[x] - r[x];
+                rightsign = xavs2_sign3(r[x] - r[x + 1]);
+                edgetype  = leftsign + rightsign;
+                leftsign  = -rightsign;
+                p_stat_0->diff[edgetype + 2] += diff;
+                p_stat_0->count[edgetype + 2]++;
+            }
+            for (x = 0; x < width; x++) {
+                int bandtype = r[x] >> band_shift;
+                p_stat_bo->diff[bandtype] += (o[x] - r[x]);
+                p_stat_bo->count[bandtype]++;
+            }
+            continue;
+        }
+
+        if (y == start_y) {
+            /* signs to the row above the first row */
+            for (x = 0; x < width; x++) {
+                sign_up[x] = (int8_t)xavs2_sign3(r[x] - r[x - i_rec]);
+            }
+            for (x = start_x; x < end_x; x++) {
+                sign_ul[x] = (int8_t)xavs2_sign3(r[x] - r[x - 1 - i_rec]);
+                sign_ur[x] = (int8_t)xavs2_sign3(r[x] - r[x + 1 - i_rec]);
+            }
+        } else {
+            /* signs to the pixels out of the columns of the row above */
+            sign_ul[start_x]   = (int8_t)xavs2_sign3(r[start_x]   - r[start_x - 1 - i_rec]);
+            sign_ur[end_x - 1] = (int8_t)xavs2_sign3(r[end_x - 1] - r[end_x - i_rec]);
+        }
+
+        /* the left and right columns not covered by EO_0 and diagonal EOs */
+        if (start_x > 0) {
+            int downsign = xavs2_sign3(r[0] - r[i_rec]);
+            diff = o[0] - r[0];
+            edgetype = sign_up[0] + downsign;
+            sign_up[0] = (int8_t)(-downsign);
+            p_stat_90->diff[edgetype + 2] += diff;
+            p_stat_90->count[edgetype + 2]++;
+            p_stat_bo->diff[r[0] >> band_shift] += diff;
+            p_stat_bo->count[r[0] >> band_shift]++;
+        }
+        if (end_x < width) {
+            int downsign = xavs2_sign3(r[end_x] - r[end_x + i_rec]);
+            diff = o[end_x] - r[end_x];
+            edgetype = sign_up[end_x] + downsign;
+            sign_up[end_x] = (int8_t)(-downsign);
+            p_stat_90->diff[edgetype + 2] += diff;
+            p_stat_90->count[edgetype + 2]++;
+            p_stat_bo->diff[r[end_x] >> band_shift] += diff;
+            p_stat_bo->count[r[end_x] >> band_shift]++;
+        }
+
+        leftsign = xavs2_sign3(r[start_x] - r[start_x - 1]);
+        for (x = start_x; x < end_x; x++) {
+            int bandtype = r[x] >> band_shift;
+            int downsign;
+
+            diff = o[x] - r[x];
+
+            /* EO_0 */
+            rightsign = xavs2_sign3(r[x] - r[x + 1]);
+            edgetype  = leftsign + rightsign;
+            leftsign  = -rightsign;
+            p_stat_0->diff[edgetype + 2] += diff;
+            p_stat_0->count[edgetype + 2]++;
+
+            /* EO_90 */
+            downsign = xavs2_sign3(r[x] - r[x + i_rec]);
+            edgetype = sign_up[x] + downsign;
+            sign_up[x] = (int8_t)(-downsign);
+            p_stat_90->diff[edgetype + 2] += diff;
+            p_stat_90->count[edgetype + 2]++;
+
+            /* EO_135 */
+            downsign = xavs2_sign3(r[x] - r[x + 1 + i_rec]);
+            edgetype = sign_ul[x] + downsign;
+            sign_ul_next[x + 1] = (int8_t)(-downsign);
+            p_stat_135->diff[edgetype + 2] += diff;
+            p_stat_135->count[edgetype + 2]++;
+
+            /* EO_45 */
+            downsign = xavs2_sign3(r[x] - r[x - 1 + i_rec]);
+            edgetype = sign_ur[x] + downsign;
+            sign_ur[x - 1] = (int8_t)(-downsign);
+            p_stat_45->diff[edgetype + 2] += diff;
+            p_stat_45->count[edgetype + 2]++;
+
+            /* BO */
+            p_stat_bo->diff[bandtype] += diff;
+            p_stat_bo->count[bandtype]++;
+        }
+
+        XAVS2_SWAP_PTR(sign_ul, sign_ul_next);
+    }
+}
+
 /* ---------------------------------------------------------------------------
 */
 typedef void(*sao_pf)(xavs2_frame_t *frm_rec, xavs2_frame_t *frm_org, 
@@ -584,11 +739,95 @@ static ALWAYS_INLINE void copy_sao_param_one_comp(SAOBlkParam *saopara_dst, SAOB
     memcpy(saopara_dst, saopara_src, sizeof(SAOBlkParam));
 }
 
+/* ---------------------------------------------------------------------------
+ * upper bound of the distortion reduction of one SAO mode, the offset of a
+ * class reduces the distortion by diff^2/count at most (see distortion_cal())
+ */
+static rdcost_t sao_max_gain(int type, SAOStatData *p_stat)
+{
+    rdcost_t gain = 0;
+    int i;
+
+    if (type == SAO_TYPE_BO) {
+        /* offsets are coded for 4 bands only */
+        rdcost_t top[4] = { 0, 0, 0, 0 };
+        for (i = 0; i < NUM_SAO_BO_CLASSES; i++) {
+            rdcost_t g;
+            int k = 4;
+            if (p_stat->count[i] == 0) {
+                continue;
+            }
+            g = (rdcost_t)p_stat->diff[i] * p_stat->diff[i] / p_stat->count[i];
+            while (k > 0 && g > top[k - 1]) {
+                if (k < 4) {
+                    top[k] = top[k - 1];
+                }
+                k--;
+            }
+            if (k < 4) {
+                top[k] = g;
+            }
+        }
+        gain = top[0] + top[1] + top[2] + top[3];
+    } else {
+        for (i = 0; i < NUM_SAO_EO_CLASSES; i++) {
+            if (i != SAO_CLASS_EO_PLAIN && p_stat->count[i] != 0) {
+                gain += (rdcost_t)p_stat->diff[i] * p_stat->diff[i] / p_stat->count[i];
+            }
+        }
+    }
+
+    return gain;
+}
+
+/* ---------------------------------------------------------------------------
+ * SAO modes (other than off) to be checked for one component in checking order,
+ * returns the number of modes
+ */
+static int sao_get_candidate_modes(xavs2_t *h, int compIdx, SAOStatData stat_data[NUM_SAO_NEW_TYPES],
+                                   int mode_col, int *modes, rdcost_t *max_gain)
+{
+    int num_modes = 0;
+    int type, i, k;
+
+    if (IS_ALG_ENABLE(OPT_FAST_SAO) && !h->fdec->rps.referd_by_others && h->i_type == SLICE_TYPE_B) {
+        return 0;
+    }
+
+    for (type = 0; type < NUM_SAO_NEW_TYPES; type++) {
+        if (!h->param->b_fast_sao || tab_sao_check_mode_fast[compIdx][type]) {
+            modes[num_modes] = type;
+            max_gain[num_modes] = 0;
+            num_modes++;
+        }
+    }
+
+    if (IS_ALG_ENABLE(OPT_ET_SAO)) {
+        /* the co-located mode first, then the others in descending order of
+         * their bound of distortion reduction */
+        for (i = 0; i < num_modes; i++) {
+            rdcost_t gain = sao_max_gain(modes[i], &stat_data[modes[i]]);
+            int      mode = modes[i];
+            int      b_col = (mode == mode_col);
+
+            for (k = i; k > 0 && (b_col || (modes[k - 1] != mode_col && gain > max_gain[k - 1])); k--) {
+                modes[k]    = modes[k - 1];
+                max_gain[k] = max_gain[k - 1];
+            }
+            modes[k]    = mode;
+            max_gain[k] = gain;
+        }
+    }
+
+    return num_modes;
+}
+
 /* ---------------------------------------------------------------------------
  */
 static 
 rdcost_t sao_rdo_new_params(xavs2_t *h, aec_t *p_aec, int avail_left, int avail_up, bool_t *slice_sao_on, rdcost_t sao_lambda,
-                            SAOStatData stat_data[NUM_SAO_COMPONENTS][NUM_SAO_NEW_TYPES], SAOBlkParam *sao_cur_param)
+                            SAOStatData stat_data[NUM_SAO_COMPONENTS][NUM_SAO_NEW_TYPES], SAOBlkParam *sao_cur_param,
+                            const int8_t *mode_col)
 {
     ALIGN16(SAOBlkParam temp_sao_param[NUM_SAO_COMPONENTS]);
     rdcost_t total_rdcost = 0;
@@ -602,6 +841,9 @@ rdcost_t sao_rdo_new_params(xavs2_t *h, aec_t *p_aec, int avail_left, int avail_
     }
     for (compIdx = 0; compIdx < 3; compIdx++){
         if (slice_sao_on[compIdx]) {
+            int      modes[NUM_SAO_NEW_TYPES];
+            rdcost_t max_gain[NUM_SAO_NEW_TYPES];
+            int      num_modes, i;
             rdcost_t mincost;
             rdcost_t curcost;
             aec_copy_coding_state_sao(&h->cs_data.cs_sao_start, p_aec);
@@ -612,27 +854,28 @@ rdcost_t sao_rdo_new_params(xavs2_t *h, aec_t *p_aec, int avail_left, int avail_
             mincost = sao_lambda * bits;
             aec_copy_coding_state_sao(&h->cs_data.cs_sao_temp, p_aec);
             // for other normal mode
-            for (type = 0; type < 5; type++) {
-                if (!h->param->b_fast_sao || tab_sao_check_mode_fast[compIdx][type]) {
-                    if (((!IS_ALG_ENABLE(OPT_FAST_SAO)) || (!(!h->fdec->rps.referd_by_others && h->i_type == SLICE_TYPE_B)))) {
-                        aec_copy_coding_state_sao(p_aec, &h->cs_data.cs_sao_start);
-                        temp_sao_param[compIdx].mergeIdx = SAO_MERGE_NONE;
-                        temp_sao_param[compIdx].typeIdc = type;
-                        find_offset(type, stat_data[compIdx], &temp_sao_param[compIdx], sao_lambda);
-                        curcost = get_distortion(compIdx, type, stat_data, temp_sao_param);
-
-                        bits = p_aec->binary.write_sao_mode(p_aec, &(temp_sao_param[compIdx]));
-                        bits += p_aec->binary.write_sao_offset(p_aec, &(temp_sao_param[compIdx]));
-                        bits += p_aec->binary.write_sao_type(p_aec, &(temp_sao_param[compIdx]));
-
-                        curcost += sao_lambda * bits;
-
-                        if (curcost < mincost) {
-                            mincost = curcost;
-                            copy_sao_param_one_comp(&sao_cur_param[compIdx], &temp_sao_param[compIdx]);
-                            aec_copy_coding_state_sao(&h->cs_data.cs_sao_temp, p_aec);
-                        }
-                    }
+            num_modes = sao_get_candidate_modes(h, compIdx, stat_data[compIdx], mode_col ? mode_col[compIdx] : SAO_TYPE_OFF, modes, max_gain);
+            for (i = 0; i < num_modes; i++) {
+                type = modes[i];
+                if (IS_ALG_ENABLE(OPT_ET_SAO) && sao_lambda * SAO_ET_MIN_BITS - max_gain[i] >= mincost) {
+                    continue;   /* can not be better than the best one */
+                }
+                aec_copy_coding_state_sao(p_aec, &h->cs_data.cs_sao_start);
+                temp_sao_param[compIdx].mergeIdx = SAO_MERGE_NONE;
+                temp_sao_param[compIdx].typeIdc = type;
+                find_offset(type, stat_data[compIdx], &temp_sao_param[compIdx], sao_lambda);
+                curcost = get_distortion(compIdx, type, stat_data, temp_sao_param);
+
+                bits = p_aec->binary.write_sao_mode(p_aec, &(temp_sao_param[compIdx]));
+                bits += p_aec->binary.write_sao_offset(p_aec, &(temp_sao_param[compIdx]));
+                bits += p_aec->binary.write_sao_type(p_aec, &(temp_sao_param[compIdx]));
+
+                curcost += sao_lambda * bits;
+
+                if (curcost < mincost) {
+                    mincost = curcost;
+                    copy_sao_param_one_comp(&sao_cur_param[compIdx], &temp_sao_param[compIdx]);
+                    aec_copy_coding_state_sao(&h->cs_data.cs_sao_temp, p_aec);
                 }
             }
             aec_copy_coding_state_sao(p_aec, &h->cs_data.cs_sao_temp);
@@ -997,6 +1240,11 @@ void sao_get_param_lcu(xavs2_t *h, aec_t *p_aec, int lcu_x, int lcu_y, bool_t *s
         int merge_avail[NUM_SAO_MERGE_TYPES];
         rdcost_t mcost;
         rdcost_t mincost = MAX_COST;
+        const int8_t *mode_col = NULL;
+
+        if (IS_ALG_ENABLE(OPT_ET_SAO) && h->i_type != SLICE_TYPE_I && h->fref[0] != NULL && h->fref[0]->sao_mode != NULL) {
+            mode_col = &h->fref[0]->sao_mode[(lcu_y * h->i_width_in_lcu + lcu_x) * NUM_SAO_COMPONENTS];
+        }
 
         getMergeNeighbor(h, lcu_x, lcu_y, blk_param, merge_avail, merge_candidate);
 
@@ -1022,7 +1270,7 @@ void sao_get_param_lcu(xavs2_t *h, aec_t *p_aec, int lcu_x, int lcu_y, bool_t *s
 
         // NEW MODE
         mcost = sao_rdo_new_params(h, p_aec, merge_avail[SAO_MERGE_LEFT], merge_avail[SAO_MERGE_ABOVE],
-                                   slice_sao_on, sao_labmda, stat_data, sao_cur_param);
+                                   slice_sao_on, sao_labmda, stat_data, sao_cur_param, mode_col);
         if (mcost < mincost) {
             mincost = mcost;
             copy_sao_param_lcu(blk_param[0], sao_cur_param);
@@ -1132,6 +1380,44 @@ void sao_copy_lcu(xavs2_t *h, xavs2_frame_t *frm_dst, xavs2_frame_t *frm_src, in
     g_funcs.plane_copy(p_dst2, i_dst, p_src2, i_src, lcu_width, lcu_height);
 }
 
+/* ---------------------------------------------------------------------------
+ * is the LCU coded in skip mode without any residual?
+ */
+static int sao_is_lcu_skipped(xavs2_t *h, int lcu_x, int lcu_y)
+{
+    int lcu_size_in_scu = 1 << (h->i_lcu_level - MIN_CU_SIZE_IN_BIT);
+    int scu_x = lcu_x * lcu_size_in_scu;
+    int scu_y = lcu_y * lcu_size_in_scu;
+    int w_in_scu = XAVS2_MIN(lcu_size_in_scu, h->i_width_in_mincu  - scu_x);
+    int h_in_scu = XAVS2_MIN(lcu_size_in_scu, h->i_height_in_mincu - scu_y);
+    int x, y;
+
+    for (y = 0; y < h_in_scu; y++) {
+        int scu_xy = (scu_y + y) * h->i_width_in_mincu + scu_x;
+        for (x = 0; x < w_in_scu; x++, scu_xy++) {
+            if (cu_get_scu_mode(h, scu_xy) != PRED_SKIP || cu_get_scu_cbp(h, scu_xy) != 0) {
+                return 0;
+            }
+        }
+    }
+
+    return 1;
+}
+
+/* ---------------------------------------------------------------------------
+ * keep the SAO modes of one LCU in the reconstructed frame for the frames
+ * referring to it
+ */
+static ALWAYS_INLINE void sao_store_lcu_modes(xavs2_t *h, int i_lcu_xy)
+{
+    int8_t *p_mode = &h->fdec->sao_mode[i_lcu_xy * NUM_SAO_COMPONENTS];
+    int compIdx;
+
+    for (compIdx = 0; compIdx < NUM_SAO_COMPONENTS; compIdx++) {
+        p_mode[compIdx] = (int8_t)(h->slice_sao_on[compIdx] ? h->sao_blk_params[i_lcu_xy][compIdx].typeIdc : SAO_TYPE_OFF);
+    }
+}
+
 /* ---------------------------------------------------------------------------
  */
 void sao_get_lcu_param_after_deblock(xavs2_t *h, aec_t *p_aec, int i_lcu_x, int i_lcu_y)
@@ -1141,23 +1427,29 @@ void sao_get_lcu_param_after_deblock(xavs2_t *h, aec_t *p_aec, int i_lcu_x, int
     int compIdx, type;
 
     sao_copy_lcu(h, h->img_sao, h->fdec, i_lcu_x, i_lcu_y);
+
+    if (IS_ALG_ENABLE(OPT_ET_SAO) && h->i_type != SLICE_TYPE_I && sao_is_lcu_skipped(h, i_lcu_x, i_lcu_y)) {
+        /* only the prediction from the filtered reference, SAO is off */
+        off_sao(h->sao_blk_params[i_lcu_xy]);
+        sao_store_lcu_modes(h, i_lcu_xy);
+        return;
+    }
+
     sao_get_neighbor_avail(h, &region, i_lcu_x, i_lcu_y);
 
     for (compIdx = 0; compIdx < 3; compIdx++) {
         if (h->slice_sao_on[compIdx]) {
+            if (IS_ALG_ENABLE(OPT_FAST_SAO) && !h->fdec->rps.referd_by_others && h->i_type == SLICE_TYPE_B) {
+                continue;
+            }
+            if (!h->param->b_fast_sao) {
+                /* all the modes are checked, get their statistics in one pass */
+                sao_get_stat_block_all(h->img_sao, h->fenc, h->sao_stat_datas[i_lcu_xy][compIdx], &region, compIdx);
+                continue;
+            }
             for (type = 0; type < 5; type++) {
-                if (!h->param->b_fast_sao || tab_sao_check_mode_fast[compIdx][type]) {
-                    if (((!IS_ALG_ENABLE(OPT_FAST_SAO)) || (!(!h->fdec->rps.referd_by_others && h->i_type == SLICE_TYPE_B)))) {
-                        gf_sao_stat[type](h->img_sao, h->fenc, &h->sao_stat_datas[i_lcu_xy][compIdx][type], &region, compIdx);
-                    }
-                    // SAOStatData tmp;
-                    // memset(&tmp, 0, sizeof(tmp));
-                    // gf_sao_stat[type](h->fdec, h->fenc, &tmp, &region, compIdx);
-                    // if (memcmp(&tmp, &h->sao_stat_datas[i_lcu_xy][compIdx][type], sizeof(tmp)) != 0) {
-                    //     xavs2_log(h, XAVS2_LOG_ERROR, "SAO mismatch!\n");
-                    //     gf_sao_stat[type](h->img_sao, h->fenc, &h->sao_stat_datas[i_lcu_xy][compIdx][type], &region, compIdx);
-                    //     gf_sao_stat[type](h->fdec, h->fenc, &tmp, &region, compIdx);
-                    // }
+                if (tab_sao_check_mode_fast[compIdx][type]) {
+                    gf_sao_stat[type](h->img_sao, h->fenc, &h->sao_stat_datas[i_lcu_xy][compIdx][type], &region, compIdx);
                 }
             }
         }
@@ -1166,6 +1458,7 @@ void sao_get_lcu_param_after_deblock(xavs2_t *h, aec_t *p_aec, int i_lcu_x, int
     sao_get_param_lcu(h, p_aec, i_lcu_x, i_lcu_y, h->slice_sao_on, 
                       h->sao_stat_datas[i_lcu_xy],
                       &h->sao_blk_params[i_lcu_xy], h->f_lambda_mode);
+    sao_store_lcu_modes(h, i_lcu_xy);
 }
 
 /* ---------------------------------------------------------------------------
@@ -49,13 +49,15 @@
 #include "frame.h"
 #include "alf.h"
 #include "sao.h"
+#include "me.h"
 
 /**
  * ===========================================================================
- * global variables
+ * local definitions
  * ===========================================================================
  */
-slice_row_index_t g_slice_lcu_row_order[1024];
+#define SLICE_AUTO_MIN_BITS   (32 << 10)  /* min bits of one slice in the automatic slice partitioning */
+#define LF_LCU_DELAY          1           /* LCUs the filter stage lags behind the row encoder (>= 1) */
 
 
 #if XAVS2_TRACE
@@ -67,39 +69,57 @@ extern int g_bit_count;         /* global bit    count for trace */
 /* ---------------------------------------------------------------------------
  * ʼLCUеı˳
  */
-void slice_lcu_row_order_init(xavs2_t *h)
+static void slice_lcu_row_order_init(xavs2_t *h, const int64_t *row_time)
 {
-    slice_row_index_t *lcurow = g_slice_lcu_row_order;
+    slice_row_index_t *lcurow = h->lcu_row_order;
     int num_lcu_row = h->i_height_in_lcu;
     int idx_slice = 0;
     int i;
 
-    if (h->param->i_lcurow_threads > 1 && h->param->slice_num > 1) {
-        int slice_num = h->param->slice_num;
-        int set_new_lcu_row = 1;
-        int k;
+    if (h->param->i_lcurow_threads > 1 && h->i_slice_num > 1) {
+        int64_t slice_time[MAX_SLICES];   /* coding time of the rows left in each slice */
+        int     next_row[MAX_SLICES];     /* next LCU row of each slice */
+        int     order[MAX_SLICES];        /* slices in the order of priority */
+        int     slice_num = h->i_slice_num;
+        int     k, n;
+
+        for (idx_slice = 0; idx_slice < slice_num; idx_slice++) {
+            slice_t *p_slice = h->slices[idx_slice];
+
+            next_row[idx_slice]   = p_slice->i_first_lcu_y;
+            slice_time[idx_slice] = 0;
+            for (k = p_slice->i_first_lcu_y; row_time != NULL && k <= p_slice->i_last_lcu_y; k++) {
+                slice_time[idx_slice] += row_time[k];
+            }
+        }
 
         /* set task table. the order of encoding task priority:
          * 1) first LCU row in each slice;
-         * 2) other LCU rows. */
-        for (i = 0, idx_slice = 0; idx_slice < slice_num; idx_slice++) {
-            lcurow[i].lcu_y     = (int16_t)(h->slices[idx_slice]->i_first_lcu_y);
-            lcurow[i].row_type  = 0;
-            lcurow[i].slice_idx = (int8_t)idx_slice;
-            i++;
-        }
+         * 2) other LCU rows, one row of each slice in turn.
+         * in each turn, the slices with more coding time left (measured in the
+         * last frame of the same type) go first, so that the expensive rows
+         * start earliest and the frame does not wait for them at the end */
+        for (i = 0; i < num_lcu_row;) {
+            /* sort the slices by the time left, keep the slice order for equal time */
+            for (n = 0; n < slice_num; n++) {
+                for (k = n; k > 0 && slice_time[order[k - 1]] < slice_time[n]; k--) {
+                    order[k] = order[k - 1];
+                }
+                order[k] = n;
+            }
 
-        for (k = 0; set_new_lcu_row; k++) {
-            set_new_lcu_row = 0;
-            for (idx_slice = 0; idx_slice < slice_num && i < num_lcu_row; idx_slice++) {
-                slice_t *p_slice = h->slices[idx_slice];
-                int bottom_row_y = p_slice->i_first_lcu_y + p_slice->i_lcu_row_num - 1;
-                int new_row = lcurow[k * slice_num + idx_slice].lcu_y + 1;  /* next LCU row in same slice */
-                if (new_row > p_slice->i_first_lcu_y && new_row <= bottom_row_y) {
-                    lcurow[i].lcu_y     = (int16_t)(new_row);
-                    lcurow[i].row_type  = 1 + (new_row == bottom_row_y);
-                    lcurow[i].slice_idx = (int8_t)(idx_slice);
-                    set_new_lcu_row = 1;    /* set a new LCU row */
+            for (n = 0; n < slice_num; n++) {
+                slice_t *p_slice = h->slices[order[n]];
+                int lcu_y = next_row[order[n]];
+
+                if (lcu_y <= p_slice->i_last_lcu_y) {
+                    lcurow[i].lcu_y     = (int16_t)(lcu_y);
+                    lcurow[i].row_type  = (int8_t)(lcu_y == p_slice->i_first_lcu_y ? 0 : 1 + (lcu_y == p_slice->i_last_lcu_y));
+                    lcurow[i].slice_idx = (int8_t)(order[n]);
+                    if (row_time != NULL) {
+                        slice_time[order[n]] -= row_time[lcu_y];
+                    }
+                    next_row[order[n]]++;
                     i++;
                 }
             }
@@ -108,13 +128,15 @@ void slice_lcu_row_order_init(xavs2_t *h)
         slice_t *p_slice = h->slices[idx_slice];
 
         for (i = 0; i < num_lcu_row; i++) {
-            int row_type = (i != p_slice->i_first_lcu_y) + (i == p_slice->i_first_lcu_y + p_slice->i_lcu_row_num - 1);
+            int b_first_row = (i == p_slice->i_first_lcu_y);
+            int b_last_row  = (i == p_slice->i_first_lcu_y + p_slice->i_lcu_row_num - 1);
 
+            /* a frame of only one LCU row is a slice starting with its first row */
             lcurow[i].lcu_y     = (int16_t)(i);
-            lcurow[i].row_type  = (int8_t)row_type;
+            lcurow[i].row_type  = (int8_t)(b_first_row ? 0 : 1 + b_last_row);
             lcurow[i].slice_idx = (int8_t)idx_slice;
 
-            if (row_type == 2) {
+            if (b_last_row) {
                 idx_slice++;                       /* a new slice appear */
                 p_slice = h->slices[idx_slice];
             }
@@ -123,68 +145,170 @@ void slice_lcu_row_order_init(xavs2_t *h)
 }
 
 /* ---------------------------------------------------------------------------
- * initializes the parameters for all slices
+ * set the properties of all slices, slice i starts from LCU row first_row[i]
  */
-void xavs2_slices_init(xavs2_t *h)
+static void slices_set_rows(xavs2_t *h, int i_slice_num, const int *first_row)
 {
-    slice_t *p_slice;
+    int i_scus_in_lcu = 1 << (h->i_lcu_level - MIN_CU_SIZE_IN_BIT);
+    int i;
+
+    for (i = 0; i < i_slice_num; i++) {
+        slice_t *p_slice = h->slices[i];
+        int i_first_row_id = first_row[i];
+        int i_end_row_id   = (i + 1 < i_slice_num) ? first_row[i + 1] : h->i_height_in_lcu;
 
-    if (h->param->slice_num < 2) {
-        /* single slice per frame */
-        p_slice = h->slices[0];
+        assert(i_end_row_id > i_first_row_id && i_end_row_id <= h->i_height_in_lcu);
 
         /* set slice properties */
-        p_slice->i_first_lcu_xy = 0;
-        p_slice->i_last_lcu_xy  = h->i_height_in_lcu * h->i_width_in_lcu - 1;
-        p_slice->i_first_scu_y  = 0;
-        p_slice->i_first_lcu_y  = 0;
-        p_slice->i_lcu_row_num  = h->i_height_in_lcu;
+        p_slice->i_first_lcu_xy = i_first_row_id * h->i_width_in_lcu;
+        p_slice->i_first_scu_y  = i_first_row_id * i_scus_in_lcu;
+        p_slice->i_first_lcu_y  = i_first_row_id;
+        p_slice->i_lcu_row_num  = i_end_row_id - i_first_row_id;
+        p_slice->i_last_lcu_xy  = p_slice->i_first_lcu_xy + (p_slice->i_lcu_row_num * h->i_width_in_lcu - 1);
         p_slice->i_last_lcu_y   = p_slice->i_first_lcu_y + p_slice->i_lcu_row_num - 1;
-        p_slice->p_slice_bs_buf = h->p_bs_buf_slice;
-        p_slice->len_slice_bs_buf = h->i_bs_buf_slice;
-    } else {
-        /* multi-slice per frame */
-        uint8_t *p_bs_start   = h->p_bs_buf_slice;
-        const int i_slice_num = h->param->slice_num;
-        int i_rest_rows       = h->i_height_in_lcu;
-        int i_len_per_row     = (h->i_bs_buf_slice - i_slice_num * CACHE_LINE_256B) / i_rest_rows;
-        int i_first_row_id    = 0;
-        int i_left_slice_num  = i_slice_num;
-        int i_scus_in_lcu     = 1 << (h->i_lcu_level - MIN_CU_SIZE_IN_BIT);
-        int i_avg_rows;
-        int i_bs_len;
-        int i;
-
-        /* set properties for each slice */
-        for (i = 0; i < i_slice_num; i++) {
-            p_slice = h->slices[i];
-
-            /* compute lcu-row number in a slice */
-            i_avg_rows = (i_rest_rows + i_left_slice_num - 1) / i_left_slice_num;
-            i_rest_rows -= i_avg_rows;/* left lcu rows */
-            i_left_slice_num--;       /* left slice number */
-
-            /* set slice properties */
-            p_slice->i_first_lcu_xy = i_first_row_id * h->i_width_in_lcu;
-            p_slice->i_first_scu_y  = i_first_row_id * i_scus_in_lcu;
-            p_slice->i_first_lcu_y  = i_first_row_id;
-            p_slice->i_lcu_row_num  = i_avg_rows;
-            p_slice->i_last_lcu_xy  = p_slice->i_first_lcu_xy + (p_slice->i_lcu_row_num * h->i_width_in_lcu - 1);
-            p_slice->i_last_lcu_y   = p_slice->i_first_lcu_y + p_slice->i_lcu_row_num - 1;
-
-            /* init slice bs, start at align 128-byte */
-            ALIGN_256_PTR(p_bs_start);/* align 256B */
-            i_bs_len = i_len_per_row * p_slice->i_lcu_row_num;
-            i_bs_len = (i_bs_len >> 8) << 8;   /* the length is a multiple of 256 */
-            p_slice->p_slice_bs_buf   = p_bs_start;
-            p_slice->len_slice_bs_buf = i_bs_len;
-            p_bs_start += i_bs_len;
-
-            /* update row id for next slice */
-            i_first_row_id += i_avg_rows;
-            assert(i_first_row_id <= h->i_height_in_lcu);
+    }
+
+    h->i_slice_num = i_slice_num;
+}
+
+/* ---------------------------------------------------------------------------
+ * split the LCU rows evenly into slices
+ */
+static void slices_split_uniform(int i_rows, int i_slice_num, int *first_row)
+{
+    int i_first_row_id   = 0;
+    int i_left_slice_num = i_slice_num;
+    int i;
+
+    for (i = 0; i < i_slice_num; i++) {
+        /* compute lcu-row number in a slice */
+        int i_avg_rows = (i_rows + i_left_slice_num - 1) / i_left_slice_num;
+
+        first_row[i]    = i_first_row_id;
+        i_first_row_id += i_avg_rows;
+        i_rows         -= i_avg_rows;   /* left lcu rows */
+        i_left_slice_num--;             /* left slice number */
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * initializes the parameters for all slices
+ */
+void xavs2_slices_init(xavs2_t *h)
+{
+    int first_row[MAX_SLICES];
+
+    slices_split_uniform(h->i_height_in_lcu, h->param->slice_num, first_row);
+    slices_set_rows(h, h->param->slice_num, first_row);
+    slice_lcu_row_order_init(h, NULL);
+}
+
+/* ---------------------------------------------------------------------------
+ * decide the coding order of the LCU rows in current frame from the coding
+ * time of the rows in the last frame of the same type
+ */
+void xavs2_slices_order_rows(xavs2_t *h)
+{
+    row_sched_t *p_sched = &h->h_top->row_sched;
+
+    xavs2_thread_mutex_lock(&h->h_top->mutex);   /* lock */
+    slice_lcu_row_order_init(h, p_sched->b_row_time[h->i_type] ? p_sched->row_time[h->i_type] : NULL);
+    xavs2_thread_mutex_unlock(&h->h_top->mutex); /* unlock */
+}
+
+/* ---------------------------------------------------------------------------
+ * decide the slices of current frame when slice_num is 0: the number of slices
+ * grows with the bits of the last frame of the same type and is limited by the
+ * AEC threads; the LCU rows are then split so that the slices carry about the
+ * same number of bits, which balances the time spent on entropy coding them
+ */
+void xavs2_slices_decide(xavs2_t *h)
+{
+    xavs2_handler_t *h_mgr  = h->h_top;
+    slice_auto_t    *p_auto = &h_mgr->slice_auto;
+    const int i_rows = h->i_height_in_lcu;
+    int first_row[MAX_SLICES];
+    int i_slice_num = h_mgr->num_max_slices;
+
+    xavs2_thread_mutex_lock(&h_mgr->mutex);      /* lock */
+    if (p_auto->b_row_bits[h->i_type]) {
+        const int *row_bits = p_auto->row_bits[h->i_type];
+        int64_t total_bits = 0;
+        int64_t sum_bits   = 0;
+        int i, k;
+
+        for (i = 0; i < i_rows; i++) {
+            total_bits += row_bits[i];
         }
+        i_slice_num = (int)XAVS2_MIN(i_slice_num, total_bits / SLICE_AUTO_MIN_BITS);
+        i_slice_num = XAVS2_MAX(i_slice_num, 1);
+
+        /* slice k starts after the row where the bits reach k shares of the frame,
+         * every slice holds two LCU rows at least */
+        first_row[0] = 0;
+        for (i = 0, k = 1; i < i_rows && k < i_slice_num; i++) {
+            int i_left_rows = i_rows - i - 1;
+
+            sum_bits += row_bits[i];
+            if (i + 1 - first_row[k - 1] < 2 || i_left_rows < 2 * (i_slice_num - k)) {
+                continue;
+            }
+            if (sum_bits * i_slice_num >= total_bits * k || i_left_rows == 2 * (i_slice_num - k)) {
+                first_row[k++] = i + 1;
+            }
+        }
+        assert(k == i_slice_num);
+    } else {
+        slices_split_uniform(i_rows, i_slice_num, first_row);
+    }
+    xavs2_thread_mutex_unlock(&h_mgr->mutex);    /* unlock */
+
+    slices_set_rows(h, i_slice_num, first_row);
+    xavs2_slices_order_rows(h);
+}
+
+/* ---------------------------------------------------------------------------
+ * record the coding time of the LCU rows after the frame has been encoded,
+ * which decides the order of the rows in the next frame of the same type
+ */
+void xavs2_slices_update_row_time(xavs2_t *h)
+{
+    row_sched_t *p_sched  = &h->h_top->row_sched;
+    int64_t     *row_time = p_sched->row_time[h->i_type];
+    int i;
+
+    xavs2_thread_mutex_lock(&h->h_top->mutex);   /* lock */
+    for (i = 0; i < h->i_height_in_lcu; i++) {
+        row_time[i] = h->frameinfo->rows[i].i_time_cost;
+    }
+    p_sched->b_row_time[h->i_type] = 1;
+    xavs2_thread_mutex_unlock(&h->h_top->mutex); /* unlock */
+}
+
+/* ---------------------------------------------------------------------------
+ * update the statistics of the automatic slice partitioning after the frame
+ * has been entropy coded
+ */
+void xavs2_slices_update_stat(xavs2_t *h)
+{
+    slice_auto_t *p_auto   = &h->h_top->slice_auto;
+    int          *row_bits = p_auto->row_bits[h->i_type];
+    int i;
+
+    xavs2_thread_mutex_lock(&h->h_top->mutex);   /* lock */
+    for (i = 0; i < h->i_height_in_lcu; i++) {
+        row_bits[i] = h->frameinfo->rows[i].i_aec_bits;
     }
+    p_auto->b_row_bits[h->i_type] = 1;
+
+    /* slice headers are the direct cost of splitting the frame */
+    p_auto->num_frames++;
+    p_auto->num_slices += h->i_slice_num;
+    p_auto->num_bits   += h->fenc->i_bs_len * 8;
+    for (i = 1; i < h->i_slice_num; i++) {
+        p_auto->num_extra_bits += h->slices[i]->i_header_bits;
+    }
+    xavs2_thread_mutex_unlock(&h->h_top->mutex); /* unlock */
 }
 
 /* ---------------------------------------------------------------------------
@@ -215,16 +339,16 @@ static void est_cu_depth_range(xavs2_t *h, int *min_level, int *max_level)
         // check left CTU's max depth
         int i_left_cu_y = h->lcu.i_scu_y;
         int i_top_cu_x = h->lcu.i_scu_x;
-        cu_info_t *p_left = &h->cu_info[h->lcu.i_scu_xy - 1];
-        cu_info_t *p_top  = &h->cu_info[h->lcu.i_scu_xy - h->i_width_in_mincu];
+        const int8_t *p_left = &h->scu_level[h->lcu.i_scu_xy - 1];
+        const int8_t *p_top  = &h->scu_level[h->lcu.i_scu_xy - h->i_width_in_mincu];
         for (i = cu_with_of_lcu; i != 0; i--) {
             if (i_left_cu_y++ < h->i_height_in_mincu) {
-                min_left_level = XAVS2_MIN(min_left_level, p_left->i_level);
+                min_left_level = XAVS2_MIN(min_left_level, *p_left);
                 p_left += h->i_width_in_mincu;
             }
 
             if (i_top_cu_x++ < h->i_width_in_mincu) {
-                min_top_level = XAVS2_MIN(min_top_level, p_top->i_level);
+                min_top_level = XAVS2_MIN(min_top_level, *p_top);
                 p_top++;
             }
         }
@@ -243,10 +367,10 @@ static void est_cu_depth_range(xavs2_t *h, int *min_level, int *max_level)
 
     if (b_left_cu && b_top_cu && b_col_cu) {
 #if SAVE_CU_INFO
-        int level_T  = h->i_lcu_level - h->cu_info[h->lcu.i_scu_xy - h->i_width_in_mincu].i_level;       // top
-        int level_L  = h->i_lcu_level - h->cu_info[h->lcu.i_scu_xy - 1].i_level;                         // left
-        int level_TL = h->i_lcu_level - h->cu_info[h->lcu.i_scu_xy - 1 - h->i_width_in_mincu].i_level;   // top-left
-        int level_TR = h->i_lcu_level - h->cu_info[h->lcu.i_scu_xy + 1 - h->i_width_in_mincu].i_level;   // top-right
+        int level_T  = h->i_lcu_level - cu_get_scu_level(h, h->lcu.i_scu_xy - h->i_width_in_mincu);      // top
+        int level_L  = h->i_lcu_level - cu_get_scu_level(h, h->lcu.i_scu_xy - 1);                        // left
+        int level_TL = h->i_lcu_level - cu_get_scu_level(h, h->lcu.i_scu_xy - 1 - h->i_width_in_mincu);  // top-left
+        int level_TR = h->i_lcu_level - cu_get_scu_level(h, h->lcu.i_scu_xy + 1 - h->i_width_in_mincu);  // top-right
         int level_C  = h->i_lcu_level - h->fref[0]->cu_level[h->lcu.i_scu_xy];                           // col-located
         int weight = L_WEIGHT[0] * level_L + L_WEIGHT[1] * level_T+L_WEIGHT[2] * level_TL + L_WEIGHT[3] * level_TR+L_WEIGHT[4] * level_C;
 
@@ -280,10 +404,9 @@ static void est_cu_depth_range(xavs2_t *h, int *min_level, int *max_level)
 /* ---------------------------------------------------------------------------
  * store cu info for one LCU row
  */
-static void store_cu_info_row(row_info_t *row)
+static void store_cu_info_row(xavs2_t *h)
 {
     int i, j, k, l;
-    xavs2_t *h = row->h;
 
     int lcu_height_in_scu = 1 << (h->i_lcu_level - MIN_CU_SIZE_IN_BIT);
     int last_lcu_row = ((h->lcu.i_scu_y + lcu_height_in_scu) < h->i_height_in_mincu ? 0 : 1);
@@ -291,17 +414,13 @@ static void store_cu_info_row(row_info_t *row)
 
 #if SAVE_CU_INFO
     /* store cu info (one lcu row) of reference frame */
-    for (i = 0; i < num_scu_y; i++) {
-        int scu_offset = (h->lcu.i_scu_y + i) * h->i_width_in_mincu;
-        cu_info_t *p_cu_info = &h->cu_info[scu_offset];
-
-        for (j = 0; j < h->i_width_in_mincu; j++) {
-            h->fdec->cu_level[scu_offset + j] = (int8_t)p_cu_info->i_level;
-            h->fdec->cu_mode[scu_offset + j] = (int8_t)p_cu_info->i_mode;
-            h->fdec->cu_cbp[scu_offset + j] = (int8_t)p_cu_info->i_cbp;
+    {
+        int scu_offset = h->lcu.i_scu_y * h->i_width_in_mincu;
+        int num_scus   = num_scu_y * h->i_width_in_mincu;
 
-            p_cu_info++;
-        }
+        memcpy(h->fdec->cu_level + scu_offset, h->scu_level + scu_offset, num_scus * sizeof(int8_t));
+        memcpy(h->fdec->cu_mode  + scu_offset, h->scu_mode  + scu_offset, num_scus * sizeof(int8_t));
+        memcpy(h->fdec->cu_cbp   + scu_offset, h->scu_cbp   + scu_offset, num_scus * sizeof(int8_t));
     }
 #endif
 
@@ -366,6 +485,138 @@ static void store_cu_info_row(row_info_t *row)
 
 
 
+/* ---------------------------------------------------------------------------
+ * set the position of a LCU to be filtered, nothing of the coded LCU
+ * (e.g. QPs of CUs) is touched unlike lcu_start_init_pos()
+ */
+static void lcu_filter_init_pos(xavs2_t *h, int i_lcu_x, int i_lcu_y)
+{
+    const int scu_x = i_lcu_x << (h->i_lcu_level - MIN_CU_SIZE_IN_BIT);
+    const int scu_y = i_lcu_y << (h->i_lcu_level - MIN_CU_SIZE_IN_BIT);
+    const int pix_x = scu_x << MIN_CU_SIZE_IN_BIT;
+    const int pix_y = scu_y << MIN_CU_SIZE_IN_BIT;
+
+    h->lcu.i_lcu_xy     = i_lcu_y * h->i_width_in_lcu + i_lcu_x;
+    h->lcu.i_scu_xy     = scu_y * h->i_width_in_mincu + scu_x;
+    h->lcu.i_scu_x      = scu_x;
+    h->lcu.i_scu_y      = scu_y;
+    h->lcu.i_pix_x      = pix_x;
+    h->lcu.i_pix_y      = pix_y;
+    h->lcu.i_pix_width  = (int16_t)XAVS2_MIN(1 << h->i_lcu_level, h->i_width  - pix_x);
+    h->lcu.i_pix_height = (int16_t)XAVS2_MIN(1 << h->i_lcu_level, h->i_height - pix_y);
+}
+
+/* ---------------------------------------------------------------------------
+ * in-loop filter of one LCU: deblocking, then SAO of the left LCU whose right
+ * neighbor is deblocked now (and of current LCU at the end of the row)
+ */
+static void lcu_loop_filter(xavs2_t *h, aec_t *p_aec, int i_lcu_x, int i_lcu_y)
+{
+    /* deblock on lcu */
+#if XAVS2_DUMP_REC
+    if (!h->param->loop_filter_disable) {
+        xavs2_lcu_deblock(h, h->fdec);
+    }
+#else
+    /* no need to do loop-filter without dumping, but at this time,
+     * the PSNR is computed not correctly if XAVS2_STAT is on. */
+    if (!h->param->loop_filter_disable && h->fdec->rps.referd_by_others) {
+        xavs2_lcu_deblock(h, h->fdec);
+    }
+#endif
+
+    /* copy reconstruction pixels when the last LCU is reconstructed */
+    if (h->param->enable_sao) {
+        if (i_lcu_x > 0) {
+            sao_get_lcu_param_after_deblock(h, p_aec, i_lcu_x - 1, i_lcu_y);
+            sao_filter_lcu(h, h->sao_blk_params[i_lcu_y * h->i_width_in_lcu + i_lcu_x - 1], i_lcu_x - 1, i_lcu_y);
+        }
+        if (i_lcu_x == h->i_width_in_lcu - 1) {
+            sao_get_lcu_param_after_deblock(h, p_aec, i_lcu_x, i_lcu_y);
+            sao_filter_lcu(h, h->sao_blk_params[i_lcu_y * h->i_width_in_lcu + i_lcu_x], i_lcu_x, i_lcu_y);
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * post-processing of one lcu row after all its LCUs are filtered
+ */
+static void lcu_row_loop_filter_end(xavs2_t *h, row_info_t *last_row, int i_lcu_y)
+{
+    int i_lcu_x;
+
+    if (h->param->enable_sao && (h->slice_sao_on[0] || h->slice_sao_on[1] || h->slice_sao_on[2])) {
+        int sao_off_num_y = 0;
+        int sao_off_num_u = 0;
+        int sao_off_num_v = 0;
+        int idx_lcu = i_lcu_y * h->i_width_in_lcu;
+        for (i_lcu_x = 0; i_lcu_x < h->i_width_in_lcu; i_lcu_x++, idx_lcu++) {
+            if (h->sao_blk_params[idx_lcu][0].typeIdc == SAO_TYPE_OFF) {
+                sao_off_num_y++;
+            }
+            if (h->sao_blk_params[idx_lcu][1].typeIdc == SAO_TYPE_OFF) {
+                sao_off_num_u++;
+            }
+            if (h->sao_blk_params[idx_lcu][2].typeIdc == SAO_TYPE_OFF) {
+                sao_off_num_v++;
+            }
+        }
+        h->num_sao_lcu_off[i_lcu_y][0] = sao_off_num_y;
+        h->num_sao_lcu_off[i_lcu_y][1] = sao_off_num_u;
+        h->num_sao_lcu_off[i_lcu_y][2] = sao_off_num_v;
+    } else {
+        int num_lcu = h->i_width_in_lcu;
+        h->num_sao_lcu_off[i_lcu_y][0] = num_lcu;
+        h->num_sao_lcu_off[i_lcu_y][1] = num_lcu;
+        h->num_sao_lcu_off[i_lcu_y][2] = num_lcu;
+    }
+
+    if (h->param->enable_alf && (h->pic_alf_on[0] || h->pic_alf_on[1] || h->pic_alf_on[2])) {
+        if (h->i_type == SLICE_TYPE_B && IS_ALG_ENABLE(OPT_FAST_ALF)) {
+            i_lcu_x = ((i_lcu_y + h->fenc->i_frm_coi) & 1);
+            for (; i_lcu_x < h->i_width_in_lcu; i_lcu_x += 2) {
+                alf_get_statistics_lcu(h, i_lcu_x, i_lcu_y, h->fenc, h->fdec);
+            }
+        } else {
+            for (i_lcu_x = 0; i_lcu_x < h->i_width_in_lcu; i_lcu_x++) {
+                alf_get_statistics_lcu(h, i_lcu_x, i_lcu_y, h->fenc, h->fdec);
+            }
+        }
+    }
+
+    /* reference frame */
+    if (h->fdec->rps.referd_by_others) {
+        /* store cu info */
+        store_cu_info_row(h);
+
+        /* expand border */
+        xavs2_frame_expand_border_lcurow(h, h->fdec, i_lcu_y);
+
+        /* interpolate (after finished expanding border) */
+#if ENABLE_FRAME_SUBPEL_INTPL
+        if (h->use_fractional_me != 0) {
+            interpolate_lcu_row(h, h->fdec, i_lcu_y);
+        }
+#endif
+
+        /* hash table of the source blocks for the hash-based ME */
+        if (h->param->enable_hash_me) {
+            xavs2_me_hash_build_row(h, h->fdec, h->fenc, i_lcu_y);
+        }
+
+        if (last_row) {
+            /* make sure the top row have finished interpolation and padding */
+            xavs2_frame_t *fdec = h->fdec;
+
+            xavs2_thread_mutex_lock(&fdec->mutex);   /* lock */
+            while (fdec->num_lcu_coded_in_row[last_row->row] < h->i_width_in_lcu) {
+                xavs2_thread_cond_wait(&fdec->cond, &fdec->mutex);
+            }
+            xavs2_thread_mutex_unlock(&fdec->mutex); /* unlock */
+        }
+    }
+}
+
 /* ---------------------------------------------------------------------------
  * encode one lcu row
  */
@@ -379,17 +630,23 @@ void *xavs2_lcu_row_write(void *arg)
     row_info_t  *last_row = (i_lcu_y > slice->i_first_lcu_y) ? &h->frameinfo->rows[i_lcu_y - 1] : 0;
     lcu_analyse_t lcu_analyse = g_funcs.compress_ctu[h->i_type];
     const bool_t b_enable_wpp = h->param->i_lcurow_threads > 1;
+    const bool_t b_lf_stage   = h->h_top->threadpool_lf != NULL;
     int min_level = h->i_scu_level;
     int max_level = h->i_lcu_level;
+    int64_t i_time_start;
     int i_lcu_x;
 #if ENABLE_RATE_CONTROL_CU
     int temp_dquant;
 #endif
 
     h->lcu.get_skip_mvs = g_funcs.get_skip_mv_predictors[h->i_type];
+    if (i_lcu_y >= h->i_refresh_row_start && i_lcu_y < h->i_refresh_row_end) {
+        lcu_analyse = g_funcs.compress_ctu[SLICE_TYPE_I];   /* the intra refresh band */
+    }
     if (h->param->slice_num > 1) {
         slice_init_bufer(h, slice);
     }
+    row->i_time_cost = 0;
 
     /* loop over all LCUs in current lcu row ------------------------
      */
@@ -416,6 +673,7 @@ void *xavs2_lcu_row_write(void *arg)
         if (b_enable_wpp && last_row != NULL && i_lcu_x == 0) {
             aec_copy_aec_state(p_aec, &last_row->aec_set);
         }
+        i_time_start = xavs2_mdate();
 
         /* 3, start */
         lcu_start_init_pixels(h, i_lcu_x, i_lcu_y);
@@ -435,10 +693,6 @@ void *xavs2_lcu_row_write(void *arg)
 
         lcu_analyse(h, p_aec, h->lcu.p_ctu, h->i_lcu_level, min_level, max_level, MAX_COST);
 
-        if (h->td_rdo != NULL) {
-            tdrdo_lcu_update(h);
-        }
-
 #if ENABLE_RATE_CONTROL_CU
         *h->last_dquant = temp_dquant;
 #endif
@@ -446,117 +700,94 @@ void *xavs2_lcu_row_write(void *arg)
         /* 5, lcu end */
         lcu_end(h, i_lcu_x, i_lcu_y);
 
-        if (b_enable_wpp && i_lcu_x == 1) {
-            /* backup aec contexts for the next row */
+        if ((b_enable_wpp || b_lf_stage) && i_lcu_x == XAVS2_MIN(1, h->i_width_in_lcu - 1)) {
+            /* backup aec contexts for the next row (and the filter stage of this row) */
             aec_copy_aec_state(&row->aec_set, p_aec);
         }
 
-        /* 4, deblock on lcu */
-#if XAVS2_DUMP_REC
-        if (!h->param->loop_filter_disable) {
-            xavs2_lcu_deblock(h, h->fdec);
-        }
-#else
-        /* no need to do loop-filter without dumping, but at this time,
-         * the PSNR is computed not correctly if XAVS2_STAT is on. */
-        if (!h->param->loop_filter_disable && h->fdec->rps.referd_by_others) {
-            xavs2_lcu_deblock(h, h->fdec);
+        /* 4, in-loop filter, unless it is left to the filter stage */
+        if (!b_lf_stage) {
+            lcu_loop_filter(h, p_aec, i_lcu_x, i_lcu_y);
         }
-#endif
 
-        /* copy reconstruction pixels when the last LCU is reconstructed */
-        if (h->param->enable_sao) {
-            if (i_lcu_x > 0) {
-                sao_get_lcu_param_after_deblock(h, p_aec, i_lcu_x - 1, i_lcu_y);
-                sao_filter_lcu(h, h->sao_blk_params[i_lcu_y * h->i_width_in_lcu + i_lcu_x - 1], i_lcu_x - 1, i_lcu_y);
-            }
-            if (i_lcu_x == h->i_width_in_lcu - 1) {
-                sao_get_lcu_param_after_deblock(h, p_aec, i_lcu_x, i_lcu_y);
-                sao_filter_lcu(h, h->sao_blk_params[i_lcu_y * h->i_width_in_lcu + i_lcu_x], i_lcu_x, i_lcu_y);
-            }
-        }
+        row->i_time_cost += xavs2_mdate() - i_time_start;
 
         xavs2_thread_mutex_lock(&row->mutex);    /* lock */
         row->coded = i_lcu_x;
         // h->fdec->num_lcu_coded_in_row[row->row]++;
         xavs2_thread_mutex_unlock(&row->mutex);  /* unlock */
 
-        /* signal to the next row */
-        if (i_lcu_x >= 1) {
+        /* signal to the next row (and the filter stage of this row) */
+        if (b_lf_stage) {
+            xavs2_thread_cond_broadcast(&row->cond);
+        } else if (i_lcu_x >= 1) {
             xavs2_thread_cond_signal(&row->cond);
         }
     }
 
     /* post-processing for current lcu row -------------------------
      */
-    if (h->param->enable_sao && (h->slice_sao_on[0] || h->slice_sao_on[1] || h->slice_sao_on[2])) {
-        int sao_off_num_y = 0;
-        int sao_off_num_u = 0;
-        int sao_off_num_v = 0;
-        int idx_lcu = i_lcu_y * h->i_width_in_lcu;
-        for (i_lcu_x = 0; i_lcu_x < h->i_width_in_lcu; i_lcu_x++, idx_lcu++) {
-            if (h->sao_blk_params[idx_lcu][0].typeIdc == SAO_TYPE_OFF) {
-                sao_off_num_y++;
-            }
-            if (h->sao_blk_params[idx_lcu][1].typeIdc == SAO_TYPE_OFF) {
-                sao_off_num_u++;
-            }
-            if (h->sao_blk_params[idx_lcu][2].typeIdc == SAO_TYPE_OFF) {
-                sao_off_num_v++;
-            }
-        }
-        h->num_sao_lcu_off[i_lcu_y][0] = sao_off_num_y;
-        h->num_sao_lcu_off[i_lcu_y][1] = sao_off_num_u;
-        h->num_sao_lcu_off[i_lcu_y][2] = sao_off_num_v;
-    } else {
-        int num_lcu = h->i_width_in_lcu;
-        h->num_sao_lcu_off[i_lcu_y][0] = num_lcu;
-        h->num_sao_lcu_off[i_lcu_y][1] = num_lcu;
-        h->num_sao_lcu_off[i_lcu_y][2] = num_lcu;
+    if (b_lf_stage) {
+        /* the row is finished by the filter stage, the encoder moves on */
+        xavs2e_release_row_context(h);
+        return 0;
     }
 
-    if (h->param->enable_alf && (h->pic_alf_on[0] || h->pic_alf_on[1] || h->pic_alf_on[2])) {
-        if (h->i_type == SLICE_TYPE_B && IS_ALG_ENABLE(OPT_FAST_ALF)) {
-            i_lcu_x = ((i_lcu_y + h->fenc->i_frm_coi) & 1);
-            for (; i_lcu_x < h->i_width_in_lcu; i_lcu_x += 2) {
-                alf_get_statistics_lcu(h, i_lcu_x, i_lcu_y, h->fenc, h->fdec);
-            }
-        } else {
-            for (i_lcu_x = 0; i_lcu_x < h->i_width_in_lcu; i_lcu_x++) {
-                alf_get_statistics_lcu(h, i_lcu_x, i_lcu_y, h->fenc, h->fdec);
-            }
-        }
-    }
+    lcu_row_loop_filter_end(h, last_row, i_lcu_y);
 
-    /* reference frame */
-    if (h->fdec->rps.referd_by_others) {
-        /* store cu info */
-        store_cu_info_row(row);
+    /* release task */
+    xavs2e_release_row_task(row);
 
-        /* expand border */
-        xavs2_frame_expand_border_lcurow(h, h->fdec, i_lcu_y);
+    return 0;
+}
 
-        /* interpolate (after finished expanding border) */
-#if ENABLE_FRAME_SUBPEL_INTPL
-        if (h->use_fractional_me != 0) {
-            interpolate_lcu_row(h, h->fdec, i_lcu_y);
-        }
-#endif
+/* ---------------------------------------------------------------------------
+ * in-loop filter of one lcu row, run by the filter stage LF_LCU_DELAY LCUs
+ * behind the encoder of the row and one LCU behind the filter of the row above
+ */
+void *xavs2_lcu_row_filter(void *arg)
+{
+    row_info_t  *row      = (row_info_t *)arg;
+    xavs2_t     *h        = xavs2e_alloc_filter_task(row->h_frame);
+    const int    i_lcu_y  = row->row;
+    const int    i_last_x = h->i_width_in_lcu - 1;
+    slice_t     *slice;
+    row_info_t  *last_row;
+    int i_lcu_x;
 
-        if (last_row) {
-            /* make sure the top row have finished interpolation and padding */
-            xavs2_frame_t *fdec = h->fdec;
+    /* the slice of the row and the aec contexts for the SAO decision are
+     * known once the first LCUs are coded */
+    wait_lcu_row_coded(row, XAVS2_MIN(i_last_x, LF_LCU_DELAY));
+    h->i_slice_index = row->lcus[0].slice_index;
+    slice    = h->slices[h->i_slice_index];
+    last_row = (i_lcu_y > slice->i_first_lcu_y) ? &h->frameinfo->rows[i_lcu_y - 1] : 0;
+    slice_init_bufer(h, slice);
+    aec_copy_aec_state(&h->aec, &row->aec_set);
 
-            xavs2_thread_mutex_lock(&fdec->mutex);   /* lock */
-            while (fdec->num_lcu_coded_in_row[last_row->row] < h->i_width_in_lcu) {
-                xavs2_thread_cond_wait(&fdec->cond, &fdec->mutex);
-            }
-            xavs2_thread_mutex_unlock(&fdec->mutex); /* unlock */
+    for (i_lcu_x = 0; i_lcu_x <= i_last_x; i_lcu_x++) {
+        /* sync: same order of filtering as the one in the row encoders */
+        wait_lcu_row_coded(row, XAVS2_MIN(i_last_x, i_lcu_x + LF_LCU_DELAY));
+        wait_lcu_row_filtered(last_row, XAVS2_MIN(i_last_x, i_lcu_x + 1));
+
+        lcu_filter_init_pos(h, i_lcu_x, i_lcu_y);
+        if (h->td_rdo != NULL) {
+            tdrdo_lcu_adjust_lambda(h, &h->f_lambda_mode);
         }
+
+        lcu_loop_filter(h, &h->aec, i_lcu_x, i_lcu_y);
+
+        xavs2_thread_mutex_lock(&row->mutex);    /* lock */
+        row->filtered = i_lcu_x;
+        xavs2_thread_mutex_unlock(&row->mutex);  /* unlock */
+
+        /* signal to the filter of the next row */
+        xavs2_thread_cond_broadcast(&row->cond);
     }
 
-    /* release task */
-    xavs2e_release_row_task(row);
+    lcu_row_loop_filter_end(h, last_row, i_lcu_y);
+
+    xavs2e_set_row_finished(h, row);
+    xavs2e_release_filter_task(h);
 
     return 0;
 }
@@ -583,6 +814,7 @@ void xavs2_slice_write_start(xavs2_t *h)
     /* write slice header */
     xavs2_slice_header_write(h, slice);
     bs_byte_align(&slice->bs);
+    slice->i_header_bits = xavs2_bs_pos(&slice->bs);
 
     /* init AEC */
     aec_start(h, p_aec, slice->bs.p_start + PSEUDO_CODE_SIZE, slice->bs.p_end, 0);
@@ -43,13 +43,11 @@
  * structures
  * ===========================================================================
  */
-typedef struct slice_row_index_t {
+struct slice_row_index_t {
     int16_t lcu_y;       /* б */
     int8_t  slice_idx;   /* ڵSlice */
     int8_t  row_type;    /* 0: SliceʼλõУ1:ͨ2: Sliceλõ */
-} slice_row_index_t;
-
-extern slice_row_index_t g_slice_lcu_row_order[1024];
+};
 
 /* ---------------------------------------------------------------------------
  * ʼSlicebufferָ
@@ -83,6 +81,22 @@ void wait_lcu_row_coded(row_info_t *last_row, int wait_lcu_coded)
 }
 
 
+/* ---------------------------------------------------------------------------
+ * wait until the in-loop filter of a LCU row reaches the specified LCU
+ */
+static ALWAYS_INLINE
+void wait_lcu_row_filtered(row_info_t *last_row, int wait_lcu_filtered)
+{
+    if (last_row != NULL && last_row->filtered < wait_lcu_filtered) {
+        xavs2_thread_mutex_lock(&last_row->mutex);   /* lock */
+        while (last_row->filtered < wait_lcu_filtered) {
+            xavs2_thread_cond_wait(&last_row->cond, &last_row->mutex);
+        }
+        xavs2_thread_mutex_unlock(&last_row->mutex); /* unlock */
+    }
+}
+
+
 /* ---------------------------------------------------------------------------
  * ѯһLCUǷѱ
  */
@@ -103,74 +117,93 @@ void set_lcu_row_finished(xavs2_t *h, xavs2_frame_t *frm, int lcu_row)
 
 
 /* ---------------------------------------------------------------------------
- * release a row task
+ * mark a row as finished (reconstructed, filtered and interpolated)
  */
 static INLINE
-void xavs2e_release_row_task(row_info_t *row)
+void xavs2e_set_row_finished(xavs2_t *h, row_info_t *row)
 {
-    if (row) {
-        xavs2_t         *h     = row->h;
-        xavs2_frame_t   *fdec  = h->fdec;
-        xavs2_handler_t *h_mgr = h->h_top;
-        int b_slice_boundary_done = FALSE;
-
-        /* ʱSlice߽Ѵֱ꣬ӽвֵҪ
-         * Ҫд */
-        if (h->param->b_cross_slice_loop_filter == FALSE) {
-            if (row->b_top_slice_border && row->row > 0) {
-                if (is_lcu_row_finished(h, fdec, row->row - 1)) {
-                    int y_start = (row->row << h->i_lcu_level) - 4;
-                    interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
-                    b_slice_boundary_done = TRUE;
-                }
-            } else if (row->b_down_slice_border && row->row < h->i_height_in_lcu - 1) {
-                if (is_lcu_row_finished(h, fdec, row->row + 1)) {
-                    int y_start = ((row->row + 1) << h->i_lcu_level) - 4;
-                    interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
-                    b_slice_boundary_done = TRUE;
-                }
+    xavs2_frame_t   *fdec  = h->fdec;
+    int b_slice_boundary_done = FALSE;
+
+    /* ʱSlice߽Ѵֱ꣬ӽвֵҪ
+     * Ҫд */
+    if (h->param->b_cross_slice_loop_filter == FALSE) {
+        if (row->b_top_slice_border && row->row > 0) {
+            if (is_lcu_row_finished(h, fdec, row->row - 1)) {
+                int y_start = (row->row << h->i_lcu_level) - 4;
+                interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
+                b_slice_boundary_done = TRUE;
             }
-        } else {
-            /* TODO: SliceʱSlice߽Ĵ */
-            if (h->param->slice_num > 1) {
-                xavs2_log(NULL, XAVS2_LOG_ERROR, "CrossSliceLoopFilter not supported now!\n");
-                assert(0);
+        } else if (row->b_down_slice_border && row->row < h->i_height_in_lcu - 1) {
+            if (is_lcu_row_finished(h, fdec, row->row + 1)) {
+                int y_start = ((row->row + 1) << h->i_lcu_level) - 4;
+                interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
+                b_slice_boundary_done = TRUE;
             }
         }
+    } else {
+        /* TODO: SliceʱSlice߽Ĵ */
+        if (h->param->slice_num > 1) {
+            xavs2_log(NULL, XAVS2_LOG_ERROR, "CrossSliceLoopFilter not supported now!\n");
+            assert(0);
+        }
+    }
 
-        xavs2_thread_mutex_lock(&fdec->mutex);           /* lock */
-        if (h->param->b_cross_slice_loop_filter == FALSE) {
-            if (b_slice_boundary_done == FALSE && row->b_top_slice_border && row->row > 0) {
-                if (is_lcu_row_finished(h, fdec, row->row - 1)) {
-                    int y_start = (row->row << h->i_lcu_level) - 4;
-                    interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
-                    // xavs2_log(NULL, XAVS2_LOG_DEBUG, "Intp2 POC [%3d], Slice %2d, Row %2d, [%3d, %3d)\n",
-                    //           h->fenc->i_frame, h->i_slice_index, row->row, y_start, y_start + 8);
-                }
-            } else if (b_slice_boundary_done == FALSE && row->b_down_slice_border && row->row < h->i_height_in_lcu - 1) {
-                if (is_lcu_row_finished(h, fdec, row->row + 1)) {
-                    int y_start = ((row->row + 1) << h->i_lcu_level) - 4;
-                    interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
-                    // xavs2_log(NULL, XAVS2_LOG_DEBUG, "Intp3 POC [%3d], Slice %2d, Row %2d, [%3d, %3d)\n",
-                    //           h->fenc->i_frame, h->i_slice_index, row->row, y_start, y_start + 8);
-                }
+    xavs2_thread_mutex_lock(&fdec->mutex);           /* lock */
+    if (h->param->b_cross_slice_loop_filter == FALSE) {
+        if (b_slice_boundary_done == FALSE && row->b_top_slice_border && row->row > 0) {
+            if (is_lcu_row_finished(h, fdec, row->row - 1)) {
+                int y_start = (row->row << h->i_lcu_level) - 4;
+                interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
+                // xavs2_log(NULL, XAVS2_LOG_DEBUG, "Intp2 POC [%3d], Slice %2d, Row %2d, [%3d, %3d)\n",
+                //           h->fenc->i_frame, h->i_slice_index, row->row, y_start, y_start + 8);
+            }
+        } else if (b_slice_boundary_done == FALSE && row->b_down_slice_border && row->row < h->i_height_in_lcu - 1) {
+            if (is_lcu_row_finished(h, fdec, row->row + 1)) {
+                int y_start = ((row->row + 1) << h->i_lcu_level) - 4;
+                interpolate_sample_rows(h, h->fdec, y_start, 8, 0, 0);
+                // xavs2_log(NULL, XAVS2_LOG_DEBUG, "Intp3 POC [%3d], Slice %2d, Row %2d, [%3d, %3d)\n",
+                //           h->fenc->i_frame, h->i_slice_index, row->row, y_start, y_start + 8);
             }
-        } else {
-            /* TODO: SliceʱSlice߽Ĵ */
-        }
-        set_lcu_row_finished(h, fdec, row->row);
-        xavs2_thread_mutex_unlock(&fdec->mutex);         /* unlock */
-
-        /* broadcast to the aec thread and all waiting contexts */
-        xavs2_thread_cond_broadcast(&fdec->cond);
-
-        if (h->task_type == XAVS2_TASK_ROW) {
-            xavs2_thread_mutex_lock(&h_mgr->mutex);   /* lock */
-            h->task_status = XAVS2_TASK_FREE;
-            xavs2_thread_mutex_unlock(&h_mgr->mutex); /* unlock */
-            /* signal a free row context available */
-            xavs2_thread_cond_signal(&h_mgr->cond[SIG_ROW_CONTEXT_RELEASED]);
         }
+    } else {
+        /* TODO: SliceʱSlice߽Ĵ */
+    }
+    set_lcu_row_finished(h, fdec, row->row);
+    xavs2_thread_mutex_unlock(&fdec->mutex);         /* unlock */
+
+    /* broadcast to the aec thread and all waiting contexts */
+    xavs2_thread_cond_broadcast(&fdec->cond);
+}
+
+/* ---------------------------------------------------------------------------
+ * release the context of a row encoder
+ */
+static INLINE
+void xavs2e_release_row_context(xavs2_t *h)
+{
+    xavs2_handler_t *h_mgr = h->h_top;
+
+    if (h->task_type == XAVS2_TASK_ROW) {
+        xavs2_thread_mutex_lock(&h_mgr->mutex);   /* lock */
+        h->task_status = XAVS2_TASK_FREE;
+        xavs2_thread_mutex_unlock(&h_mgr->mutex); /* unlock */
+        /* signal a free row context available */
+        xavs2_thread_cond_signal(&h_mgr->cond[SIG_ROW_CONTEXT_RELEASED]);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * release a row task
+ */
+static INLINE
+void xavs2e_release_row_task(row_info_t *row)
+{
+    if (row) {
+        xavs2_t *h = row->h;    /* the row may be reused once it is finished */
+
+        xavs2e_set_row_finished(h, row);
+        xavs2e_release_row_context(h);
     }
 }
 
@@ -246,17 +279,69 @@ xavs2_t *xavs2e_alloc_row_task(xavs2_t *h)
     return NULL;
 }
 
+/* ---------------------------------------------------------------------------
+ * get an in-loop filter handle. there are as many filter contexts as threads
+ * of the filter stage, so one of them is always free for a running task
+ */
+static INLINE
+xavs2_t *xavs2e_alloc_filter_task(xavs2_t *h)
+{
+    xavs2_handler_t *h_mgr = h->h_top;
+    xavs2_t *h_filter = NULL;
+    int i;
+
+    xavs2_thread_mutex_lock(&h_mgr->mutex);   /* lock */
+    for (i = 0; i < h_mgr->num_lf_contexts; i++) {
+        if (h_mgr->lf_contexts[i].task_status == XAVS2_TASK_FREE) {
+            h_filter = &h_mgr->lf_contexts[i];
+            h_filter->task_status = XAVS2_TASK_BUSY;
+            break;
+        }
+    }
+    xavs2_thread_mutex_unlock(&h_mgr->mutex); /* unlock */
+
+    assert(h_filter != NULL);
+
+    /* sync row contexts */
+    memcpy(&h_filter->row_vars_1, &h->row_vars_1, (uint8_t *)&h->row_vars_2 - (uint8_t *)&h->row_vars_1);
+
+    return h_filter;
+}
+
+/* ---------------------------------------------------------------------------
+ * release an in-loop filter handle
+ */
+static INLINE
+void xavs2e_release_filter_task(xavs2_t *h)
+{
+    xavs2_handler_t *h_mgr = h->h_top;
+
+    xavs2_thread_mutex_lock(&h_mgr->mutex);   /* lock */
+    h->task_status = XAVS2_TASK_FREE;
+    xavs2_thread_mutex_unlock(&h_mgr->mutex); /* unlock */
+}
+
 #define xavs2_slices_init FPFX(slices_init)
 void  xavs2_slices_init(xavs2_t *h);
 
+#define xavs2_slices_decide FPFX(slices_decide)
+void  xavs2_slices_decide(xavs2_t *h);
+
+#define xavs2_slices_update_stat FPFX(slices_update_stat)
+void  xavs2_slices_update_stat(xavs2_t *h);
+#define xavs2_slices_order_rows FPFX(slices_order_rows)
+void  xavs2_slices_order_rows(xavs2_t *h);
+#define xavs2_slices_update_row_time FPFX(slices_update_row_time)
+void  xavs2_slices_update_row_time(xavs2_t *h);
+
 #define xavs2_slice_write_start FPFX(slice_write_start)
 void  xavs2_slice_write_start(xavs2_t *h);
 
 #define xavs2_lcu_row_write FPFX(lcu_row_write)
 void *xavs2_lcu_row_write(void *arg);
+#define xavs2_lcu_row_filter FPFX(lcu_row_filter)
+void *xavs2_lcu_row_filter(void *arg);
 
-#define slice_lcu_row_order_init FPFX(slice_lcu_row_order_init)
-void  slice_lcu_row_order_init(xavs2_t *h);
 
 #define xavs2e_encode_one_frame FPFX(xavs2e_encode_one_frame)
 void *xavs2e_encode_one_frame(void *arg);
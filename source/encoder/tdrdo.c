@@ -34,14 +34,18 @@
  *    For more information, contact us at sswang @ pku.edu.cn.
  */
 
+
 #include "common.h"
 #include "tdrdo.h"
 #include "wrapper.h"
 #include "frame.h"
 
 
-#define WORKBLOCKSIZE 64
-#define SEARCHRANGE   64
+#define WORKBLOCKSIZE     64
+#define SEARCHRANGE       64
+#define TDRDO_ALPHA       0.94      /* part of the reference distortion kept in the prediction error */
+#define TDRDO_PROJ_FRAMES 2         /* number of following frames projected for low delay coding */
+#define TDRDO_MAX_FRAMES  (XAVS2_MAX_GOP_SIZE + 1)  /* the anchor and the frames of one GOP */
 
 
 /**
@@ -66,54 +70,34 @@ typedef struct BlockDistortion {
     uint16_t    OriginX;
     uint16_t    OriginY;
     uint16_t    SearchRange;
-    short       MVx;
-    short       MVy;
     double      MSE;
-    double      MVL;
-    short       BlockQP;
-    double      BlockLambda;
-    short       BlockType;
 } BlockDistortion, BD;
 
 typedef struct FrameDistortion {
-    uint32_t    FrameNumber;
     uint32_t    BlockSize;
-    uint32_t    CUSize;
     uint32_t    TotalNumOfBlocks;
     uint32_t    TotalBlockNumInHeight;
     uint32_t    TotalBlockNumInWidth;
     BD         *BlockDistortionArray;
-    struct FrameDistortion *subFrameDistortionArray;
 } FrameDistortion, FD;
 
-typedef struct DistortionList {
-    uint32_t    TotalFrameNumber;
-    uint32_t    FrameWidth;
-    uint32_t    FrameHeight;
-    uint32_t    BlockSize;
-    FD         *FrameDistortionArray;
-} DistortionList, DL;
-
+/* the distortion propagation is modeled on the original frames in the lookahead,
+ * no reconstructed frame is waited for and the frames can be encoded in parallel.
+ * the frames of a GOP are indexed in coding order from 1, the index 0 is the
+ * anchor: the last reference frame of the previous GOP (or the previous frame) */
 struct td_rdo_t {
-    Frame       porgF;
-    Frame       ppreF;
-    Frame       precF;
-    DL          OMCPDList;
-    DL          RealDList;
-    FD         *pOMCPFD, *pRealFD;
-
-    int         StepLength;
-    double     *KappaTable;
-    double      GlobeLambdaRatio;
-    int         GlobeFrameNumber;
-    int         CurMBQP;
-    int         QpOffset[32];
-    int         globenumber;
-
-    double     *D;
+    Frame       anchorF;              /* luma copy of the anchor frame */
+    int         b_anchor;             /* is the anchor available? */
+    FD          OMCPFD;               /* motion compensated distortion between two original frames */
+
+    int         BaseQP;
+    int         GopSize;
+    int         QpOffset[XAVS2_MAX_GOP_SIZE];
+
+    double     *D[TDRDO_MAX_FRAMES];          /* modeled coding distortion of the blocks */
+    double     *BetaTable[TDRDO_MAX_FRAMES];  /* ratio of the reference distortion propagated */
+    double     *KappaTable[TDRDO_MAX_FRAMES]; /* distortion propagated to the following frames */
     double     *DMCP;
-    double     *BetaTable;
-    double     *MultiplyBetas;
 };
 
 typedef struct Block {
@@ -132,34 +116,23 @@ typedef struct Block {
 
 /* ---------------------------------------------------------------------------
  */
-static DL *CreatDistortionList(DL *NewDL, uint32_t totalframenumber, uint32_t width, uint32_t height, uint32_t blocksize, uint32_t cusize)
+static ALWAYS_INLINE void SetFrame(Frame *F, xavs2_frame_t *frm)
 {
-    int tBlockNumInHeight, tBlockNumInWidth, tBlockNumber;
-    uint32_t i;
-
-    NewDL->TotalFrameNumber = totalframenumber;
-    NewDL->FrameWidth = width;
-    NewDL->FrameHeight = height;
-    blocksize = blocksize < 4 ? 4 : (blocksize > 64 ? 64 : blocksize);
-    NewDL->BlockSize = blocksize;
-
-    tBlockNumInHeight = (int)ceil(1.0 * height / blocksize);
-    tBlockNumInWidth = (int)ceil(1.0 * width / blocksize);
-    tBlockNumber = tBlockNumInHeight * tBlockNumInWidth;
-    for (i = 0; i < totalframenumber; i++) {
-        NewDL->FrameDistortionArray[i].FrameNumber = i;
-        NewDL->FrameDistortionArray[i].BlockSize = blocksize;
-        NewDL->FrameDistortionArray[i].CUSize = cusize;
-        NewDL->FrameDistortionArray[i].TotalNumOfBlocks = tBlockNumber;
-        NewDL->FrameDistortionArray[i].TotalBlockNumInHeight = tBlockNumInHeight;
-        NewDL->FrameDistortionArray[i].TotalBlockNumInWidth = tBlockNumInWidth;
-        NewDL->FrameDistortionArray[i].BlockDistortionArray = NULL;
-        NewDL->FrameDistortionArray[i].subFrameDistortionArray = NULL;
-    }
-
-    return NewDL;
+    F->FrameWidth  = frm->i_width [IMG_Y];
+    F->FrameHeight = frm->i_lines [IMG_Y];
+    F->nStrideY    = frm->i_stride[IMG_Y];
+    F->Y_base      = frm->planes  [IMG_Y];
 }
 
+/* ---------------------------------------------------------------------------
+ */
+static void SetBlockNumber(FD *pFD, uint32_t width, uint32_t height, uint32_t blocksize)
+{
+    pFD->BlockSize             = blocksize;
+    pFD->TotalBlockNumInHeight = (height + blocksize - 1) / blocksize;
+    pFD->TotalBlockNumInWidth  = (width  + blocksize - 1) / blocksize;
+    pFD->TotalNumOfBlocks      = pFD->TotalBlockNumInHeight * pFD->TotalBlockNumInWidth;
+}
 
 /* ---------------------------------------------------------------------------
  */
@@ -183,6 +156,29 @@ static double CalculateBlockMSE(Frame *FA, Frame *FB, Block *A, Block *B)
     return dSSE / blockpixel;
 }
 
+/* ---------------------------------------------------------------------------
+ */
+static double CalculateBlockVariance(Frame *FA, Block *A)
+{
+    uint16_t x, y;
+    int blockpixel = A->BlockHeight * A->BlockWidth;
+    pel_t *YA;
+    double dSum = 0;
+    double dSSum = 0;
+    double dMean;
+
+    YA = FA->Y_base + A->OriginY * FA->nStrideY + A->OriginX;
+    for (y = 0; y < A->BlockHeight; y++) {
+        for (x = 0; x < A->BlockWidth; x++) {
+            dSum  += YA[x];
+            dSSum += YA[x] * YA[x];
+        }
+        YA = YA + FA->nStrideY;
+    }
+    dMean = dSum / blockpixel;
+    return dSSum / blockpixel - dMean * dMean;
+}
+
 /* ---------------------------------------------------------------------------
  */
 static void MotionDistortion(FD *currentFD, Frame *FA, Frame *FB, uint32_t searchrange)
@@ -288,34 +284,6 @@ static void MotionDistortion(FD *currentFD, Frame *FA, Frame *FB, uint32_t searc
     }
 }
 
-/* ---------------------------------------------------------------------------
- */
-static void StoreLCUInf(FD *curRealFD, int LeaderBlockNumber, int cuinwidth, int iqp, rdcost_t lambda, int curtype)
-{
-    BD *workBD;
-    int LeaderNumber = ((LeaderBlockNumber % cuinwidth) / 8 + LeaderBlockNumber / cuinwidth / 8 * curRealFD->TotalBlockNumInWidth) * (curRealFD->CUSize / curRealFD->BlockSize);
-    int workBlockNum;
-    uint32_t x, y, top, left, bottom, right;
-
-    top    = LeaderNumber / curRealFD->TotalBlockNumInWidth;
-    left   = LeaderNumber % curRealFD->TotalBlockNumInWidth;
-    bottom = top + curRealFD->CUSize / curRealFD->BlockSize;
-    bottom = bottom <= curRealFD->TotalBlockNumInHeight ? bottom : curRealFD->TotalBlockNumInHeight;
-    right  = left + curRealFD->CUSize / curRealFD->BlockSize;
-    right  = right <= curRealFD->TotalBlockNumInWidth ? right : curRealFD->TotalBlockNumInWidth;
-
-    workBlockNum = LeaderNumber;
-    for (y = top; y < bottom; y++) {
-        for (x = left; x < right; x++) {
-            workBD = &curRealFD->BlockDistortionArray[workBlockNum + x - left];
-            workBD->BlockQP     = (short)iqp;
-            workBD->BlockLambda = (double)lambda;
-            workBD->BlockType   = (short)curtype;
-        }
-        workBlockNum = workBlockNum + curRealFD->TotalBlockNumInWidth;
-    }
-}
-
 /* ---------------------------------------------------------------------------
  */
 static ALWAYS_INLINE double F(double invalue)
@@ -337,169 +305,130 @@ static ALWAYS_INLINE double F(double invalue)
 
 /* ---------------------------------------------------------------------------
  */
-static void CaculateKappaTableLDP(xavs2_t *h, DL *omcplist, DL *realDlist, int framenum, int FrameQP)
+static ALWAYS_INLINE double QStep(int qp)
 {
-    td_rdo_t *td_rdo = h->td_rdo;
-    BD *p1stBD, *pcurBD;
-    const double tdrdoAlpha = 0.94F;
-    double fxvalue;
-    double *D, *DMCP;
-    double *BetaTable, *MultiplyBetas;
-    double DsxKappa, Ds;
-    int TotalBlocksInAframe = realDlist->FrameDistortionArray[0].TotalNumOfBlocks;
-    int BetaLength;
-    int PreFrameQP;
-    int t, b;
-
-    BetaLength = realDlist->TotalFrameNumber - 1  - framenum - 1;
-    BetaLength = XAVS2_MIN(2, BetaLength);
-
-    memset(td_rdo->KappaTable, 0, TotalBlocksInAframe * sizeof(double));
-    if (framenum <= 0) {
-      return;
-    }
-
-    D             = td_rdo->D;
-    DMCP          = td_rdo->DMCP;
-    BetaTable     = td_rdo->BetaTable;
-    MultiplyBetas = td_rdo->MultiplyBetas;
-    memset(D,             0, TotalBlocksInAframe * sizeof(double));
-    memset(DMCP,          0, TotalBlocksInAframe * sizeof(double));
-    memset(BetaTable,     0, TotalBlocksInAframe * sizeof(double));
-    memset(MultiplyBetas, 0, TotalBlocksInAframe * sizeof(double));
-
-    p1stBD = realDlist->FrameDistortionArray[framenum - 1].BlockDistortionArray;
-    for (b = 0; b < TotalBlocksInAframe; b++) {
-        D[b] = p1stBD[b].MSE;
-        BetaTable[b] = 1.0F;
-    }
+    return sqrt(2.0) * pow(2.0, qp / 8.0);
+}
 
-    for (b = 0; b < TotalBlocksInAframe; b++) {
-        MultiplyBetas[b] = 1.0;
-    }
+/* ---------------------------------------------------------------------------
+ * coding distortion of a block with the prediction error DMCP, and the ratio
+ * of the reference distortion propagated into the block
+ */
+static ALWAYS_INLINE double ModelDistortion(double DMCP, double qstep, double *beta)
+{
+    double fxvalue = DMCP > 0 ? qstep / sqrt(DMCP) : 8.0;
+    double f = F(fxvalue);
 
-    pcurBD = omcplist->FrameDistortionArray[framenum - 1].BlockDistortionArray;
-    for (t = 0; t <= BetaLength; t++) {
-        PreFrameQP = FrameQP - td_rdo->QpOffset[framenum % h->i_gop_size] + td_rdo->QpOffset[(framenum + t) % h->i_gop_size];
+    *beta = TDRDO_ALPHA * f;
+    return DMCP * f;
+}
 
-        for (b = 0; b < TotalBlocksInAframe; b++) {
-            DMCP[b] = tdrdoAlpha * (D[b] + pcurBD[b].MSE);
-        }
-        for (b = 0; b < TotalBlocksInAframe; b++) {
-            fxvalue = (sqrt(2.0) * pow(2.0, (PreFrameQP) / 8.0)) / sqrt(DMCP[b]);
-            D[b] = DMCP[b] * F(fxvalue);
-            BetaTable[b] = tdrdoAlpha * F(fxvalue);
-            if (t > 0) {
-                MultiplyBetas[b] *= BetaTable[b];
-                td_rdo->KappaTable[b] += MultiplyBetas[b];
+/* ---------------------------------------------------------------------------
+ * model the coding distortion of one frame in the GOP window, the variance of
+ * a block is taken as the prediction error of intra coding
+ */
+static void AnalyseFrame(td_rdo_t *td_rdo, Frame *curF, Frame **refF, const int *refs, int num_refs, int qp, int idx)
+{
+    FD *pFD = &td_rdo->OMCPFD;
+    int num_blocks = pFD->TotalNumOfBlocks;
+    double *D    = td_rdo->D[idx];
+    double *Beta = td_rdo->BetaTable[idx];
+    double *DMCP = td_rdo->DMCP;
+    double qstep = QStep(qp);
+    int i, b;
+
+    memset(td_rdo->KappaTable[idx], 0, num_blocks * sizeof(double));
+
+    if (num_refs == 0) {
+        uint32_t blocksize = pFD->BlockSize;
+        uint32_t nBH, nBW;
+        Block BA;
+
+        b = 0;
+        for (nBH = 0; nBH < pFD->TotalBlockNumInHeight; nBH++) {
+            for (nBW = 0; nBW < pFD->TotalBlockNumInWidth; nBW++) {
+                BA.OriginX = blocksize * nBW;
+                BA.OriginY = blocksize * nBH;
+                BA.BlockHeight = blocksize * (nBH + 1) < curF->FrameHeight ? blocksize : curF->FrameHeight - blocksize * nBH;
+                BA.BlockWidth  = blocksize * (nBW + 1) < curF->FrameWidth  ? blocksize : curF->FrameWidth  - blocksize * nBW;
+                D[b] = ModelDistortion(CalculateBlockVariance(curF, &BA), qstep, &Beta[b]);
+                Beta[b] = 0;
+                b++;
             }
         }
+        return;
     }
 
-    DsxKappa = Ds = 0.0F;
-
-    for (b = 0; b < TotalBlocksInAframe; b++) {
-        t = framenum - 1;
-        Ds += realDlist->FrameDistortionArray[t].BlockDistortionArray[b].MSE;
-        DsxKappa += realDlist->FrameDistortionArray[t].BlockDistortionArray[b].MSE * (1.0F + td_rdo->KappaTable[b]);
+    memset(DMCP, 0, num_blocks * sizeof(double));
+    for (i = 0; i < num_refs; i++) {
+        double *DRef = td_rdo->D[refs[i]];
+        MotionDistortion(pFD, curF, refF[i], SEARCHRANGE);
+        for (b = 0; b < num_blocks; b++) {
+            DMCP[b] += TDRDO_ALPHA * (DRef[b] + pFD->BlockDistortionArray[b].MSE) / num_refs;
+        }
+    }
+    for (b = 0; b < num_blocks; b++) {
+        D[b] = ModelDistortion(DMCP[b], qstep, &Beta[b]);
     }
-
-    td_rdo->GlobeLambdaRatio = DsxKappa / Ds;
 }
 
 /* ---------------------------------------------------------------------------
+ * the lambda of a block is scaled by the distortion it propagates to the
+ * following frames, the lambda of the frame is kept in average
  */
-static void AdjustLcuQPLambdaLDP(xavs2_t *h, FD *curOMCPFD, int LeaderBlockNumber, int cuinwidth, rdcost_t *plambda)
+static void StoreLambdaRatio(td_rdo_t *td_rdo, xavs2_frame_t *frm, int idx)
 {
-    td_rdo_t *td_rdo = h->td_rdo;
-    double ArithmeticMean, HarmonicMean, GeometricMean;
-    double SumOfMSE;
-    double Kappa, LambdaRatio, dDeltaQP;
-    uint32_t x, y, top, left, bottom, right;
-    int LeaderNumber;
-    int workBlockNum;
-    int counter, iDeltaQP;
-
-    if (curOMCPFD == NULL) {
-        return;
+    const double *D     = td_rdo->D[idx];
+    const double *Kappa = td_rdo->KappaTable[idx];
+    int num_blocks = td_rdo->OMCPFD.TotalNumOfBlocks;
+    double DsxKappa = 0.0F;
+    double Ds = 0.0F;
+    double GlobeLambdaRatio, LambdaRatio;
+    int b;
+
+    for (b = 0; b < num_blocks; b++) {
+        Ds       += D[b];
+        DsxKappa += D[b] * (1.0F + Kappa[b]);
     }
+    GlobeLambdaRatio = Ds > 0 ? DsxKappa / Ds : 1.0;
 
-    if (td_rdo->KappaTable == NULL) {
-        dDeltaQP = 0.0F;
-        iDeltaQP = dDeltaQP > 0 ? (int)(dDeltaQP + 0.5) : -(int)(-dDeltaQP + 0.5);
-        iDeltaQP = XAVS2_CLIP3F(-2, 2, iDeltaQP);
-        return;
-    }
-
-    LeaderNumber = ((LeaderBlockNumber % cuinwidth) / 8 + LeaderBlockNumber / cuinwidth / 8 * curOMCPFD->TotalBlockNumInWidth) * (curOMCPFD->CUSize / curOMCPFD->BlockSize);
-    top    = LeaderNumber / curOMCPFD->TotalBlockNumInWidth;
-    left   = LeaderNumber % curOMCPFD->TotalBlockNumInWidth;
-    bottom = top + curOMCPFD->CUSize / curOMCPFD->BlockSize;
-    bottom = bottom <= curOMCPFD->TotalBlockNumInHeight ? bottom : curOMCPFD->TotalBlockNumInHeight;
-    right  = left + curOMCPFD->CUSize / curOMCPFD->BlockSize;
-    right  = right <= curOMCPFD->TotalBlockNumInWidth ? right : curOMCPFD->TotalBlockNumInWidth;
-
-    ArithmeticMean = 0.0;
-    HarmonicMean   = 0.0;
-    GeometricMean  = 1.0;
-    SumOfMSE       = 0.0;
-    counter        = 0;
-    workBlockNum   = LeaderNumber;
-    for (y = top; y < bottom; y++) {
-        for (x = left; x < right; x++) {
-            SumOfMSE += curOMCPFD->BlockDistortionArray[workBlockNum + x - left].MSE;
-            Kappa = td_rdo->KappaTable[workBlockNum + x - left];
-            ArithmeticMean += Kappa;
-            HarmonicMean += 1.0 / Kappa;
-            GeometricMean *= Kappa;
-            counter++;
-        }
-        workBlockNum = workBlockNum + curOMCPFD->TotalBlockNumInWidth;
+    for (b = 0; b < num_blocks; b++) {
+        LambdaRatio = GlobeLambdaRatio / (1.0F + Kappa[b]);
+        LambdaRatio = XAVS2_CLIP3F(pow(2.0, -3.0 / 4.0), pow(2.0, 3.0 / 4.0), LambdaRatio);
+        frm->tdrdo_ratio[b] = (float)LambdaRatio;
     }
+    frm->b_tdrdo_ratio = 1;
+}
 
-    if (counter == 0) {
-        return;
+/* ---------------------------------------------------------------------------
+ * keep a frame as the anchor referenced by the next frames
+ */
+static void UpdateAnchor(td_rdo_t *td_rdo, Frame *F, int idx)
+{
+    pel_t *src = F->Y_base;
+    pel_t *dst = td_rdo->anchorF.Y_base;
+    uint32_t y;
+
+    for (y = 0; y < F->FrameHeight; y++) {
+        memcpy(dst, src, F->FrameWidth * sizeof(pel_t));
+        src += F->nStrideY;
+        dst += td_rdo->anchorF.nStrideY;
     }
-
-    Kappa = ArithmeticMean / counter;
-    SumOfMSE = SumOfMSE / counter;
-
-    LambdaRatio = td_rdo->GlobeLambdaRatio / (1.0F + Kappa);
-    LambdaRatio = XAVS2_CLIP3F(pow(2.0, -3.0 / 4.0), pow(2.0, 3.0 / 4.0), LambdaRatio);
-    dDeltaQP    = (4.0 / log(2.0F)) * log(LambdaRatio);
-    iDeltaQP    = dDeltaQP > 0.0 ? (int)(dDeltaQP + 0.5) : -(int)(-dDeltaQP - 0.5);
-    iDeltaQP    = XAVS2_CLIP3F(-3, 3, iDeltaQP);
-    *plambda    = (rdcost_t)((*plambda) * LambdaRatio);
+    td_rdo->anchorF.FrameWidth  = F->FrameWidth;
+    td_rdo->anchorF.FrameHeight = F->FrameHeight;
+    memcpy(td_rdo->D[0], td_rdo->D[idx], td_rdo->OMCPFD.TotalNumOfBlocks * sizeof(double));
+    td_rdo->b_anchor = 1;
 }
 
 /* ---------------------------------------------------------------------------
- * i_frame_index: frame number in file
  */
-static FD *SearchFrameDistortionArray(DL *omcplist, int i_frame_index, int StepLength, int IntraPeriod)
+static ALWAYS_INLINE int CheckFrameSize(td_rdo_t *td_rdo, Frame *F)
 {
-    FD *NewFD = NULL;
-    int keyframenum = i_frame_index / StepLength;
-    int subframenumIndex = i_frame_index % StepLength;
-    int subframenum;
-    int i;
+    FD *pFD = &td_rdo->OMCPFD;
 
-    if (subframenumIndex == 0) {
-        NewFD = &omcplist->FrameDistortionArray[keyframenum - 1];
-    }
-    if (subframenumIndex != 0 && IntraPeriod == 0) {
-        NewFD = &omcplist->FrameDistortionArray[keyframenum].subFrameDistortionArray[subframenumIndex - 1];
-    }
-    if (subframenumIndex != 0 && IntraPeriod != 0) {
-        for (i = 0; i < StepLength - 1; i++) {
-            subframenum = omcplist->FrameDistortionArray[keyframenum].subFrameDistortionArray[i].FrameNumber;
-            if (subframenum == i_frame_index) {
-                NewFD = &omcplist->FrameDistortionArray[keyframenum].subFrameDistortionArray[i];
-                break;
-            }
-        }
-    }
-
-    return NewFD;
+    return F->FrameWidth  <= pFD->TotalBlockNumInWidth  * pFD->BlockSize &&
+           F->FrameHeight <= pFD->TotalBlockNumInHeight * pFD->BlockSize &&
+           F->FrameWidth  <= td_rdo->anchorF.nStrideY;
 }
 
 
@@ -511,25 +440,20 @@ static FD *SearchFrameDistortionArray(DL *omcplist, int i_frame_index, int StepL
 
 /* ---------------------------------------------------------------------------
  */
-int tdrdo_get_buffer_size(xavs2_param_t *param)
+int tdrdo_get_buffer_size(const xavs2_param_t *param)
 {
-    int StepLength = param->successive_Bframe == 0 ? 1 : param->i_gop_size;
-    int num_frames = 0;
-    int size_blocks;
-
-    if (param->enable_tdrdo) {
-        if (!param->successive_Bframe) {
-            num_frames += (param->num_frames / StepLength + 1);
-            num_frames += (param->num_frames / StepLength + 1);
-        } else {
-            num_frames += (param->num_frames - 1) / StepLength + 1;
-            num_frames += param->num_frames + 1;
-        }
-    }
+    int img_w_l = ((param->org_width  + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int img_h_l = ((param->org_height + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int num_blocks = ((img_w_l + WORKBLOCKSIZE - 1) / WORKBLOCKSIZE) * ((img_h_l + WORKBLOCKSIZE - 1) / WORKBLOCKSIZE);
 
-    size_blocks = 5 * sizeof(double) * (int)ceil(1.0 * param->org_width / WORKBLOCKSIZE) * (int)ceil(1.0 * param->org_height / WORKBLOCKSIZE);
+    if (!param->enable_tdrdo) {
+        return 0;
+    }
 
-    return sizeof(td_rdo_t) + num_frames * sizeof(FD) + size_blocks;
+    return sizeof(td_rdo_t) +
+           num_blocks * sizeof(BD) +                                  /* OMCP distortions */
+           num_blocks * sizeof(double) * (3 * TDRDO_MAX_FRAMES + 1) + /* D, Beta and Kappa of the GOP */
+           img_w_l * img_h_l * sizeof(pel_t);                         /* luma of the anchor frame */
 }
 
 /* ---------------------------------------------------------------------------
@@ -539,57 +463,44 @@ int tdrdo_init(td_rdo_t *td_rdo, xavs2_param_t *param)
     uint8_t *mem_ptr = (uint8_t *)td_rdo;
     uint8_t *mem_start = mem_ptr;
     int size_buffer = tdrdo_get_buffer_size(param);
-    int num_blocks = (int)ceil(1.0 * param->org_width / WORKBLOCKSIZE) * (int)ceil(1.0 * param->org_height / WORKBLOCKSIZE);
+    int img_w_l = ((param->org_width  + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int img_h_l = ((param->org_height + MIN_CU_SIZE - 1) >> MIN_CU_SIZE_IN_BIT) << MIN_CU_SIZE_IN_BIT;
+    int num_blocks;
     int i;
 
-    if (param->successive_Bframe != 0) {
-        xavs2_log(NULL, XAVS2_LOG_ERROR, "TDRDO cannot be used in RA configuration.\n");
-        return -1;
-    }
-
     /* memory alloc */
     memset(td_rdo, 0, size_buffer);
     mem_ptr += sizeof(td_rdo_t);
 
-    td_rdo->KappaTable = (double *)mem_ptr;
-    mem_ptr += sizeof(double) * num_blocks;
-    td_rdo->StepLength = param->successive_Bframe == 0 ? 1 : param->i_gop_size;
-
-    if (!param->successive_Bframe) {
-        td_rdo->OMCPDList.FrameDistortionArray = (FD *)mem_ptr;
-        mem_ptr += (param->num_frames / td_rdo->StepLength + 1) * sizeof(FD);
-        CreatDistortionList(&td_rdo->OMCPDList, param->num_frames / td_rdo->StepLength + 1, param->org_width, param->org_height, WORKBLOCKSIZE, 1 << param->lcu_bit_level);
-        td_rdo->RealDList.FrameDistortionArray = (FD *)mem_ptr;
-        mem_ptr += (param->num_frames / td_rdo->StepLength + 1) * sizeof(FD);
-        CreatDistortionList(&td_rdo->RealDList, param->num_frames / td_rdo->StepLength + 1, param->org_width, param->org_height, WORKBLOCKSIZE, 1 << param->lcu_bit_level);
-    } else {
-        td_rdo->OMCPDList.FrameDistortionArray = (FD *)mem_ptr;
-        mem_ptr += ((param->num_frames - 1) / td_rdo->StepLength + 1) * sizeof(FD);
-        CreatDistortionList(&td_rdo->OMCPDList, (param->num_frames - 1) / td_rdo->StepLength + 1, param->org_width, param->org_height, WORKBLOCKSIZE, 1 << param->lcu_bit_level);
-        td_rdo->RealDList.FrameDistortionArray = (FD *)mem_ptr;
-        mem_ptr += (param->num_frames + 1) * sizeof(FD);
-        CreatDistortionList(&td_rdo->RealDList, param->num_frames + 1, param->org_width, param->org_height, WORKBLOCKSIZE, 1 << param->lcu_bit_level);
+    SetBlockNumber(&td_rdo->OMCPFD, img_w_l, img_h_l, WORKBLOCKSIZE);
+    num_blocks = td_rdo->OMCPFD.TotalNumOfBlocks;
+
+    td_rdo->OMCPFD.BlockDistortionArray = (BD *)mem_ptr;
+    mem_ptr += num_blocks * sizeof(BD);
+    for (i = 0; i < TDRDO_MAX_FRAMES; i++) {
+        td_rdo->D[i] = (double *)mem_ptr;
+        mem_ptr     += num_blocks * sizeof(double);
+        td_rdo->BetaTable[i] = (double *)mem_ptr;
+        mem_ptr     += num_blocks * sizeof(double);
+        td_rdo->KappaTable[i] = (double *)mem_ptr;
+        mem_ptr     += num_blocks * sizeof(double);
     }
+    td_rdo->DMCP = (double *)mem_ptr;
+    mem_ptr     += num_blocks * sizeof(double);
 
-
-    td_rdo->porgF.FrameWidth  = param->org_width;
-    td_rdo->porgF.FrameHeight = param->org_height;
-    memcpy(&td_rdo->ppreF, &td_rdo->porgF, sizeof(Frame));
-    memcpy(&td_rdo->precF, &td_rdo->porgF, sizeof(Frame));
+    td_rdo->anchorF.FrameWidth  = img_w_l;
+    td_rdo->anchorF.FrameHeight = img_h_l;
+    td_rdo->anchorF.nStrideY    = img_w_l;
+    td_rdo->anchorF.Y_base      = (pel_t *)mem_ptr;
+    mem_ptr += img_w_l * img_h_l * sizeof(pel_t);
+    td_rdo->b_anchor = 0;
 
     /* copy of QP offset */
+    td_rdo->BaseQP  = param->i_initial_qp;
+    td_rdo->GopSize = XAVS2_MAX(1, param->i_gop_size);
     for (i = 0; i < param->i_gop_size; i++) {
         td_rdo->QpOffset[i] = param->cfg_ref_all[i].qp_offset;
     }
-    
-    td_rdo->D  = (double *)mem_ptr;
-    mem_ptr   += num_blocks * sizeof(double);
-    td_rdo->DMCP = (double *)mem_ptr;
-    mem_ptr   += num_blocks * sizeof(double);
-    td_rdo->BetaTable = (double *)mem_ptr;
-    mem_ptr   += num_blocks * sizeof(double);
-    td_rdo->MultiplyBetas = (double *)mem_ptr;
-    mem_ptr   += num_blocks * sizeof(double);
 
     if (mem_ptr - mem_start <= size_buffer) {
         return 0;
@@ -603,122 +514,171 @@ int tdrdo_init(td_rdo_t *td_rdo, xavs2_param_t *param)
  */
 void tdrdo_destroy(td_rdo_t *td_rdo)
 {
-    UNUSED_PARAMETER(td_rdo);
+    /* all buffers are in the memory of the encoder handler,
+     * only the anchor is dropped */
+    if (td_rdo != NULL) {
+        td_rdo->b_anchor = 0;
+    }
 }
 
 /* ---------------------------------------------------------------------------
+ * drop the anchor of the previous sequence, and init for a new one
  */
-void tdrdo_frame_start(xavs2_t *h)
+int tdrdo_reset(td_rdo_t *td_rdo, xavs2_param_t *param)
 {
-    td_rdo_t *td_rdo = h->td_rdo;
-    assert(td_rdo != NULL);
+    tdrdo_destroy(td_rdo);
+    return tdrdo_init(td_rdo, param);
+}
 
-    td_rdo->GlobeFrameNumber = h->ip_pic_idx;
-    if (h->param->successive_Bframe) {
-        td_rdo->pRealFD = &td_rdo->RealDList.FrameDistortionArray[td_rdo->GlobeFrameNumber];
-    } else {
-        td_rdo->pRealFD = &td_rdo->RealDList.FrameDistortionArray[td_rdo->globenumber];
+/* ---------------------------------------------------------------------------
+ * analyse a frame sent to encode in display order (low delay coding and key
+ * frames), the following frames are projected with the same prediction error
+ */
+void tdrdo_analyse_frame(td_rdo_t *td_rdo, xavs2_frame_t *frm)
+{
+    Frame curF;
+    Frame *refF[1];
+    int refs[1] = { 0 };
+    double *D, *Kappa, *MultiplyBetas;
+    double beta;
+    int num_blocks = td_rdo->OMCPFD.TotalNumOfBlocks;
+    int qp, t, b;
+
+    frm->b_tdrdo_ratio = 0;
+    SetFrame(&curF, frm);
+    if (!CheckFrameSize(td_rdo, &curF)) {
+        td_rdo->b_anchor = 0;
+        return;
     }
-    td_rdo->pRealFD->BlockDistortionArray = (BD *)xavs2_calloc(td_rdo->pRealFD->TotalNumOfBlocks, sizeof(BD));
-    if (td_rdo->GlobeFrameNumber % td_rdo->StepLength == 0) {
-        if (h->fenc->i_frame == 0) {
-            td_rdo->porgF.Y_base   = h->fenc->planes[IMG_Y];
-            td_rdo->porgF.nStrideY = h->fenc->i_stride[IMG_Y];
-            td_rdo->ppreF.Y_base   = h->img_luma_pre->planes[IMG_Y];
-            td_rdo->ppreF.nStrideY = h->img_luma_pre->i_stride[IMG_Y];
-            xavs2_frame_copy_planes(h, h->img_luma_pre, h->fenc);
-        } else  if ((int)h->fenc->i_frame < h->param->num_frames) {
-            td_rdo->pOMCPFD = &td_rdo->OMCPDList.FrameDistortionArray[td_rdo->GlobeFrameNumber - 1];
-            td_rdo->pOMCPFD->BlockDistortionArray = (BD *)xavs2_calloc(td_rdo->pOMCPFD->TotalNumOfBlocks, sizeof(BD));
-            td_rdo->porgF.Y_base = h->fenc->planes[IMG_Y];
-            td_rdo->porgF.nStrideY = h->fenc->i_stride[IMG_Y];
-            MotionDistortion(td_rdo->pOMCPFD, &td_rdo->ppreF, &td_rdo->porgF, SEARCHRANGE);
-            xavs2_frame_copy_planes(h, h->img_luma_pre, h->fenc);
-        }
-        td_rdo->pOMCPFD = NULL;
+
+    if (frm->i_frm_type == XAVS2_TYPE_I || !td_rdo->b_anchor) {
+        AnalyseFrame(td_rdo, &curF, NULL, NULL, 0, td_rdo->BaseQP, 1);
+        UpdateAnchor(td_rdo, &curF, 1);
+        return;
     }
 
-    if (td_rdo->GlobeFrameNumber % td_rdo->StepLength == 0 && td_rdo->GlobeFrameNumber < h->param->num_frames - 1) {
-        CaculateKappaTableLDP(h, &td_rdo->OMCPDList, &td_rdo->RealDList, td_rdo->GlobeFrameNumber, h->i_qp);
+    refF[0] = &td_rdo->anchorF;
+    qp = td_rdo->BaseQP + td_rdo->QpOffset[(frm->i_frame + td_rdo->GopSize - 1) % td_rdo->GopSize];
+    AnalyseFrame(td_rdo, &curF, refF, refs, 1, qp, 1);
+
+    /* the OMCP distortions to the anchor are kept for the following frames */
+    D             = td_rdo->D[2];
+    MultiplyBetas = td_rdo->BetaTable[2];
+    Kappa         = td_rdo->KappaTable[1];
+    memcpy(D, td_rdo->D[1], num_blocks * sizeof(double));
+    for (b = 0; b < num_blocks; b++) {
+        MultiplyBetas[b] = 1.0;
     }
+    for (t = 1; t <= TDRDO_PROJ_FRAMES; t++) {
+        double qstep;
+
+        qp = td_rdo->BaseQP + td_rdo->QpOffset[(frm->i_frame + t + td_rdo->GopSize - 1) % td_rdo->GopSize];
+        qstep = QStep(qp);
+        for (b = 0; b < num_blocks; b++) {
+            D[b] = ModelDistortion(TDRDO_ALPHA * (D[b] + td_rdo->OMCPFD.BlockDistortionArray[b].MSE), qstep, &beta);
+            MultiplyBetas[b] *= beta;
+            Kappa[b] += MultiplyBetas[b];
+        }
+    }
+
+    StoreLambdaRatio(td_rdo, frm, 1);
+    UpdateAnchor(td_rdo, &curF, 1);
 }
 
 /* ---------------------------------------------------------------------------
+ * analyse the frames of a GOP (in display order, frm_set[1...gop_size]) before
+ * they are sent to encode. the distortion is modeled in coding order, then the
+ * propagation to the references is accumulated in the reverse order
  */
-void tdrdo_frame_done(xavs2_t *h)
+void tdrdo_analyse_gop(td_rdo_t *td_rdo, const xavs2_param_t *param, xavs2_frame_t **frm_set)
 {
-    FD *pDelFD;
-    int DelFDNumber;
-    td_rdo_t *td_rdo = h->td_rdo;
-    assert(td_rdo != NULL);
-
-    if ((h->fenc->i_frame % td_rdo->StepLength == 0 && !h->param->successive_Bframe) || h->param->successive_Bframe) {
-        td_rdo->precF.Y_base = h->fdec->planes[IMG_Y];
-        //td_rdo->precF.nStrideY = h->fdec->i_stride[IMG_Y];// fdec->stride[0] , bitrate rise ?
-        td_rdo->precF.nStrideY = h->img_luma_pre->i_stride[IMG_Y];   //to check: fdec->stride[0] ? by lutao
-        MotionDistortion(td_rdo->pRealFD, &td_rdo->porgF, &td_rdo->precF, 0);
+    xavs2_frame_t *frames[TDRDO_MAX_FRAMES];
+    Frame F[TDRDO_MAX_FRAMES];
+    Frame *refF[XAVS2_MAX_REFS];
+    int refs[TDRDO_MAX_FRAMES][XAVS2_MAX_REFS];
+    int num_refs[TDRDO_MAX_FRAMES];
+    int num_blocks = td_rdo->OMCPFD.TotalNumOfBlocks;
+    int num_frames, idx_anchor = 0;
+    int i, j, k, b;
+
+    /* frames in coding order */
+    F[0] = td_rdo->anchorF;
+    for (num_frames = 1; num_frames <= param->i_gop_size; num_frames++) {
+        k = param->cfg_ref_all[num_frames - 1].poc;
+        if (k <= 0 || k > param->i_gop_size || frm_set[k] == NULL) {
+            break;
+        }
+        frames[num_frames] = frm_set[k];
+        frames[num_frames]->b_tdrdo_ratio = 0;
+        SetFrame(&F[num_frames], frames[num_frames]);
+        if (!CheckFrameSize(td_rdo, &F[num_frames])) {
+            td_rdo->b_anchor = 0;
+            return;
+        }
+        if (k == param->i_gop_size) {
+            idx_anchor = num_frames;
+        }
     }
-    td_rdo->pRealFD->FrameNumber = h->fenc->i_frame;
-    td_rdo->globenumber++;
-
-    DelFDNumber = td_rdo->globenumber - td_rdo->StepLength - 1;
-    if (DelFDNumber >= 0) {
-        pDelFD = &td_rdo->RealDList.FrameDistortionArray[DelFDNumber];
-        if (pDelFD->BlockDistortionArray != NULL) {
-            xavs2_free(pDelFD->BlockDistortionArray);
+
+    /* modeled distortion, the references out of the window are not counted */
+    for (i = 1; i < num_frames; i++) {
+        const xavs2_rps_t *p_rps = &param->cfg_ref_all[i - 1];
+
+        num_refs[i] = 0;
+        if (frames[i]->i_frm_type != XAVS2_TYPE_I) {
+            for (j = 0; j < p_rps->num_of_ref; j++) {
+                k = i - p_rps->ref_pic[j];
+                if (p_rps->ref_pic[j] > 0 && (k > 0 || (k == 0 && td_rdo->b_anchor))) {
+                    refF[num_refs[i]]    = &F[k];
+                    refs[i][num_refs[i]] = k;
+                    num_refs[i]++;
+                }
+            }
         }
-        pDelFD->BlockDistortionArray = NULL;
+        AnalyseFrame(td_rdo, &F[i], refF, refs[i], num_refs[i], td_rdo->BaseQP + p_rps->qp_offset, i);
     }
-    if (h->fenc->i_frame % td_rdo->StepLength == 0) {
-        DelFDNumber = h->fenc->i_frame / td_rdo->StepLength - 2;
-        if (DelFDNumber >= 0) {
-            pDelFD = &td_rdo->OMCPDList.FrameDistortionArray[DelFDNumber];
-            if (pDelFD->BlockDistortionArray != NULL) {
-                xavs2_free(pDelFD->BlockDistortionArray);
+
+    /* propagation from the last coded frame */
+    for (i = num_frames - 1; i > 0; i--) {
+        const double *Beta  = td_rdo->BetaTable[i];
+        const double *Kappa = td_rdo->KappaTable[i];
+
+        for (j = 0; j < num_refs[i]; j++) {
+            double *KappaRef = td_rdo->KappaTable[refs[i][j]];
+
+            if (refs[i][j] == 0) {
+                continue;     /* the anchor is encoded already */
             }
-            pDelFD->BlockDistortionArray = NULL;
-            if (pDelFD->subFrameDistortionArray != NULL) {
-                xavs2_free(pDelFD->subFrameDistortionArray);
+            for (b = 0; b < num_blocks; b++) {
+                KappaRef[b] += Beta[b] * (1.0F + Kappa[b]) / num_refs[i];
             }
-            pDelFD->subFrameDistortionArray = NULL;
         }
     }
-}
 
-/* ---------------------------------------------------------------------------
- */
-void tdrdo_lcu_adjust_lambda(xavs2_t *h, rdcost_t *new_lambda)
-{
-    td_rdo_t *td_rdo = h->td_rdo;
-    assert(td_rdo != NULL);
-
-    td_rdo->CurMBQP = h->i_qp;
-    if (td_rdo->GlobeFrameNumber < h->param->num_frames && h->i_type != SLICE_TYPE_I) {
-        if (h->param->successive_Bframe && h->param->num_frames > 1 && td_rdo->GlobeFrameNumber <= ((int)((h->param->num_frames - 1) / td_rdo->StepLength))*td_rdo->StepLength) {
-            td_rdo->pOMCPFD = SearchFrameDistortionArray(&td_rdo->OMCPDList, td_rdo->GlobeFrameNumber, td_rdo->StepLength, h->i_type);
-        } else if (!h->param->successive_Bframe && h->param->num_frames > td_rdo->StepLength && td_rdo->GlobeFrameNumber % td_rdo->StepLength == 0) {
-            td_rdo->pOMCPFD = &td_rdo->OMCPDList.FrameDistortionArray[(td_rdo->GlobeFrameNumber - 1) / td_rdo->StepLength];
-        } else {
-            td_rdo->pOMCPFD = NULL;
-        }
+    for (i = 1; i < num_frames; i++) {
+        StoreLambdaRatio(td_rdo, frames[i], i);
     }
 
-    // Just for LDP
-    if (h->i_type != SLICE_TYPE_I && h->param->successive_Bframe == 0) {
-        AdjustLcuQPLambdaLDP(h, td_rdo->pOMCPFD, h->lcu.i_scu_xy, h->i_width_in_mincu, new_lambda);
-        td_rdo->CurMBQP = XAVS2_CLIP3F(MIN_QP, MAX_QP, td_rdo->CurMBQP);
+    if (idx_anchor > 0) {
+        UpdateAnchor(td_rdo, &F[idx_anchor], idx_anchor);
+    } else {
+        td_rdo->b_anchor = 0;
     }
 }
 
 /* ---------------------------------------------------------------------------
  */
-void tdrdo_lcu_update(xavs2_t *h)
+void tdrdo_lcu_adjust_lambda(xavs2_t *h, rdcost_t *new_lambda)
 {
-    td_rdo_t *td_rdo = h->td_rdo;
-    assert(td_rdo != NULL);
+    xavs2_frame_t *fenc = h->fenc;
+    int num_blocks_in_width;
+    int b;
 
-    if ((td_rdo->GlobeFrameNumber % td_rdo->StepLength == 0 && !h->param->successive_Bframe) || h->param->successive_Bframe) {
-        // stores for key frame
-        StoreLCUInf(td_rdo->pRealFD, h->lcu.i_scu_xy, h->param->org_width / MIN_CU_SIZE, td_rdo->CurMBQP, h->f_lambda_mode, h->i_type);
+    if (!fenc->b_tdrdo_ratio) {
+        return;
     }
+
+    num_blocks_in_width = (fenc->i_width[IMG_Y] + WORKBLOCKSIZE - 1) / WORKBLOCKSIZE;
+    b = (h->lcu.i_pix_y / WORKBLOCKSIZE) * num_blocks_in_width + h->lcu.i_pix_x / WORKBLOCKSIZE;
+    *new_lambda = (rdcost_t)(fenc->f_frm_lambda_ssd * fenc->tdrdo_ratio[b]);
 }
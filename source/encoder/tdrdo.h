@@ -45,19 +45,19 @@
  * ===========================================================================
  */
 #define tdrdo_get_buffer_size FPFX(tdrdo_get_buffer_size)
-int  tdrdo_get_buffer_size(xavs2_param_t *param);
+int  tdrdo_get_buffer_size(const xavs2_param_t *param);
 #define tdrdo_init FPFX(tdrdo_init)
 int  tdrdo_init(td_rdo_t *td_rdo, xavs2_param_t *param);
 #define tdrdo_destroy FPFX(tdrdo_destroy)
 void tdrdo_destroy(td_rdo_t *td_rdo);
+#define tdrdo_reset FPFX(tdrdo_reset)
+int  tdrdo_reset(td_rdo_t *td_rdo, xavs2_param_t *param);
 
-#define tdrdo_frame_start FPFX(tdrdo_frame_start)
-void tdrdo_frame_start(xavs2_t *h);
-#define tdrdo_frame_done FPFX(tdrdo_frame_done)
-void tdrdo_frame_done(xavs2_t *h);
+#define tdrdo_analyse_frame FPFX(tdrdo_analyse_frame)
+void tdrdo_analyse_frame(td_rdo_t *td_rdo, xavs2_frame_t *frm);
+#define tdrdo_analyse_gop FPFX(tdrdo_analyse_gop)
+void tdrdo_analyse_gop(td_rdo_t *td_rdo, const xavs2_param_t *param, xavs2_frame_t **frm_set);
 #define tdrdo_lcu_adjust_lambda FPFX(tdrdo_lcu_adjust_lambda)
 void tdrdo_lcu_adjust_lambda(xavs2_t *h, rdcost_t *new_lambda);
-#define tdrdo_lcu_update FPFX(tdrdo_lcu_update)
-void tdrdo_lcu_update(xavs2_t *h);
 
 #endif  // XAVS2_TDRDO_H
@@ -41,6 +41,8 @@
 #include "rps.h"
 
 /* ---------------------------------------------------------------------------
+ * pictures of a frame buffer without mem_base are allocated on first use by
+ * frame_buffer_alloc_frame(), only the arena of a frame pool is reserved here
  */
 void frame_buffer_init(xavs2_handler_t *h_mgr, uint8_t **mem_base, xavs2_frame_buffer_t *frm_buf, 
                        int num_frm, int frm_type)
@@ -55,15 +57,28 @@ void frame_buffer_init(xavs2_handler_t *h_mgr, uint8_t **mem_base, xavs2_frame_b
     frm_buf->num_frames = num_frm;
     frm_buf->i_frame_b  = 0;
     frm_buf->ip_pic_idx = 0;
+    frm_buf->frm_type   = frm_type;
+    frm_buf->idle_mask  = 0;
+    xavs2_thread_mutex_init(&frm_buf->idle_mutex, NULL);
 
-    if (mem_base == NULL) {
-        for (i = 0; i < num_frm; i++) {
-            frm_buf->frames[i] = xavs2_frame_new(h_mgr->p_coder, NULL, frm_type);
-        }
-    } else {
+    if (mem_base == NULL && frm_type == FT_DEC && h_mgr->p_coder->param->enable_frame_pool) {
+        /* pooled arena: the pictures needed by the RPS configuration are carved
+         * from one large block, so that they share huge pages and are released
+         * at once. pictures beyond it are allocated one by one */
+        int num_pooled = XAVS2_MIN(num_frm, rps_get_dpb_size(h_mgr->p_coder->param, h_mgr->i_frm_threads));
+
+        frm_buf->size_frame = xavs2_frame_buffer_size(h_mgr->p_coder->param, frm_type) + CACHE_LINE_SIZE;
+        frm_buf->mem_pool   = (uint8_t *)xavs2_malloc_mode(frm_buf->size_frame * num_pooled,
+                                                          h_mgr->p_coder->param->mem_alloc_mode);
+        frm_buf->num_pooled = frm_buf->mem_pool != NULL ? num_pooled : 0;
+    } else if (mem_base != NULL) {
         uint8_t *mem_ptr = *mem_base;
         for (i = 0; i < num_frm; i++) {
             frm_buf->frames[i] = xavs2_frame_new(h_mgr->p_coder, &mem_ptr, frm_type);
+            if (frm_buf->frames[i] != NULL) {
+                frm_buf->frames[i]->idx_in_buf = i;
+                frm_buf->idle_mask |= (uint64_t)1 << i;
+            }
             ALIGN_POINTER(mem_ptr);
         }
         *mem_base = mem_ptr;
@@ -78,9 +93,127 @@ void frame_buffer_destroy(xavs2_handler_t *h_mgr, xavs2_frame_buffer_t *frm_buf)
     int i;
 
     for (i = 0; i < frm_buf->num_frames; i++) {
-        xavs2_frame_delete(h_mgr, frm_buf->frames[i]);
+        if (i < frm_buf->num_pooled) {
+            xavs2_frame_destroy_objects(h_mgr, frm_buf->frames[i]);
+        } else {
+            xavs2_frame_delete(h_mgr, frm_buf->frames[i]);
+        }
         frm_buf->frames[i] = NULL;
     }
+
+    if (frm_buf->mem_pool != NULL) {
+        xavs2_free(frm_buf->mem_pool);
+        frm_buf->mem_pool   = NULL;
+        frm_buf->num_pooled = 0;
+    }
+    frm_buf->idle_mask = 0;
+    xavs2_thread_mutex_destroy(&frm_buf->idle_mutex);
+}
+
+/* ---------------------------------------------------------------------------
+ * allocate a new picture into the first empty slot of a frame buffer,
+ * return NULL if all slots are in use or out of memory
+ */
+xavs2_frame_t *frame_buffer_alloc_frame(xavs2_handler_t *h_mgr, xavs2_frame_buffer_t *frm_buf)
+{
+    xavs2_frame_t *frame;
+    int i;
+
+    for (i = 0; i < frm_buf->num_frames; i++) {
+        if (frm_buf->frames[i] == NULL) {
+            break;
+        }
+    }
+    if (i >= frm_buf->num_frames) {
+        return NULL;
+    }
+
+    if (i < frm_buf->num_pooled) {
+        uint8_t *mem_ptr = frm_buf->mem_pool + frm_buf->size_frame * i;
+        ALIGN_POINTER(mem_ptr);
+        frame = xavs2_frame_new(h_mgr->p_coder, &mem_ptr, frm_buf->frm_type);
+    } else {
+        frame = xavs2_frame_new(h_mgr->p_coder, NULL, frm_buf->frm_type);
+        if (frame != NULL) {
+            size_t size_frame = xavs2_frame_buffer_size(h_mgr->p_coder->param, frm_buf->frm_type);
+            encoder_mem_update(h_mgr, XAVS2_MEMCAT_REF_FRAMES, size_frame, 0);
+        }
+    }
+
+    if (frame == NULL) {
+        xavs2_log(h_mgr, XAVS2_LOG_ERROR, "Failed to allocate a picture for the frame buffer.\n");
+    } else {
+        frame->idx_in_buf = i;
+    }
+    frm_buf->frames[i] = frame;
+
+    return frame;
+}
+
+/* ---------------------------------------------------------------------------
+ * reset a frame buffer for a new sequence starting from the given COI,
+ * all pictures are kept and become free to use
+ */
+void frame_buffer_reset(xavs2_frame_buffer_t *frm_buf, int coi)
+{
+    int i;
+
+    frm_buf->COI        = coi;
+    frm_buf->COI_IDR    = 0;
+    frm_buf->POC_IDR    = 0;
+    frm_buf->i_frame_b  = 0;
+    frm_buf->ip_pic_idx = 0;
+    frm_buf->num_frames_to_remove = 0;
+    frm_buf->idle_mask  = 0;
+
+    for (i = 0; i < frm_buf->num_frames; i++) {
+        xavs2_frame_t *frame = frm_buf->frames[i];
+
+        if (frame != NULL) {
+            frame->i_frame   = -1;
+            frame->i_frm_coi = -1;
+            frame->removed   = 1;
+            frame->rps.referd_by_others = 0;
+            frm_buf->idle_mask |= (uint64_t)1 << i;
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * re-dimension all pictures of a frame buffer for the frame size of the main
+ * encoding context, each picture is carved again in its own memory which was
+ * sized for a frame not smaller than the current one
+ */
+int frame_buffer_resize(xavs2_handler_t *h_mgr, xavs2_frame_buffer_t *frm_buf)
+{
+    int i;
+
+    for (i = 0; i < frm_buf->num_frames; i++) {
+        xavs2_frame_t *frame = frm_buf->frames[i];
+        uint8_t *mem_ptr     = (uint8_t *)frame;
+
+        if (frame != NULL) {
+            xavs2_frame_destroy_objects(h_mgr, frame);
+            if ((frm_buf->frames[i] = xavs2_frame_new(h_mgr->p_coder, &mem_ptr, frm_buf->frm_type)) == NULL) {
+                return -1;
+            }
+            frm_buf->frames[i]->idx_in_buf = i;
+            frm_buf->idle_mask |= (uint64_t)1 << i;
+        }
+    }
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * mark a picture of the DPB idle when its last user has released it,
+ * called without holding the mutex of the picture
+ */
+void frame_buffer_set_idle(xavs2_frame_buffer_t *frm_buf, xavs2_frame_t *frame)
+{
+    xavs2_thread_mutex_lock(&frm_buf->idle_mutex);     /* lock */
+    frm_buf->idle_mask |= (uint64_t)1 << frame->idx_in_buf;
+    xavs2_thread_mutex_unlock(&frm_buf->idle_mutex);   /* unlock */
 }
 
 /* ---------------------------------------------------------------------------
@@ -144,6 +277,8 @@ void *proc_wrapper_thread(void *args)
     xlist_t         *list_in   = &h_mgr->list_frames_ready;
     xlist_t         *list_idle = &h_mgr->list_frames_free;
 
+    xavs2_affinity_pin(h_mgr->affinity);
+
     for (;;) {
         /* fetch one node from input list */
         xavs2_frame_t *frame = (xavs2_frame_t *)xl_remove_head(list_in, 1);
@@ -162,6 +297,14 @@ void *proc_wrapper_thread(void *args)
         /* throw it into idle list */
         if (state == XAVS2_FLUSH) {
             xl_append(list_idle, frame);
+        } else if (state == XAVS2_RESET) {
+            xl_append(list_idle, frame);
+
+            /* all frames are finished, the encoder can be reset now */
+            xavs2_thread_mutex_lock(&h_mgr->mutex);
+            h_mgr->b_reset_ready = 1;
+            xavs2_thread_mutex_unlock(&h_mgr->mutex);
+            xavs2_thread_cond_signal(&h_mgr->cond[SIG_ENCODER_RESET]);
         }
     }
 
@@ -50,6 +50,16 @@
 // function type
 typedef void(*vpp_ipred_t)(pel_t *p_pred, pel_t *p_top, pel_t *p_left);
 
+/* ---------------------------------------------------------------------------
+ * low resolution of frame (luma plane)
+ */
+typedef struct frm_lowres_t {
+    int         i_width;              /* width  for luma plane */
+    int         i_lines;              /* height for luma plane */
+    int         i_stride;             /* stride for luma plane */
+    pel_t      *filtered;             /* half-size copy of input frame (luma only) */
+} frm_lowres_t;
+
 /* ---------------------------------------------------------------------------
  * lookahead_t
  */
@@ -57,18 +67,100 @@ typedef struct lookahead_t {
     int         start;
     int         pframes;
     int         bpframes;
+
+    /* complexity estimation on lowres frames (enable_lookahead_stats) */
+    frm_lowres_t    lowres[2];        /* lowres of the current and the previous input frame */
+    int             i_lowres_prev;    /* index of the lowres of the previous input frame, -1 for none */
+    int             num_queued;       /* number of frames in queued[] */
+    xavs2_frame_t  *queued[XAVS2_INPUT_NUM];  /* estimated frames not output yet, in input order */
 } lookahead_t;
 
 
 /* ---------------------------------------------------------------------------
- * low resolution of frame (luma plane)
+ * statistics for the automatic slice partitioning (slice_num = 0)
  */
-typedef struct frm_lowres_t {
-    int         i_width;              /* width  for luma plane */
-    int         i_lines;              /* height for luma plane */
-    int         i_stride;             /* stride for luma plane */
-    pel_t      *filtered;             /* half-size copy of input frame (luma only) */
-} frm_lowres_t;
+typedef struct slice_auto_t {
+    int        *row_bits[SLICE_TYPE_NUM];   /* bits of each LCU row in the last coded frame of each slice type */
+    int         b_row_bits[SLICE_TYPE_NUM]; /* whether row_bits[] has been set */
+    int64_t     num_frames;           /* number of coded frames */
+    int64_t     num_slices;           /* number of coded slices */
+    int64_t     num_bits;             /* bits of all slices */
+    int64_t     num_extra_bits;       /* bits of the headers of all slices except the first one in each frame */
+} slice_auto_t;
+
+/* ---------------------------------------------------------------------------
+ * statistics for the cost-aware scheduling of LCU rows
+ */
+typedef struct row_sched_t {
+    int64_t    *row_time[SLICE_TYPE_NUM];   /* coding time (us) of each LCU row in the last coded frame of each slice type */
+    int         b_row_time[SLICE_TYPE_NUM]; /* whether row_time[] has been set */
+} row_sched_t;
+
+
+/* ---------------------------------------------------------------------------
+ * bitstream of one frame buffered by the GOP parallel or ladder encoder
+ */
+typedef struct gop_packet_t {
+    node_t      node;                 /* list node, MUST be the first member */
+    uint8_t    *data;                 /* bitstream data, stored right after this struct */
+    int         len;                  /* length of bitstream data */
+    int         type;                 /* frame type */
+    int64_t     pts;                  /* pts of the frame */
+    int64_t     dts;                  /* dts of the frame, only for ladder encoding */
+} gop_packet_t;
+
+/* ---------------------------------------------------------------------------
+ * encoders of the closed GOPs encoded in parallel (num_parallel_gop > 1),
+ * GOP g is encoded by coders[g % num_coders] as a segment, which continues
+ * the COI, POC and reference frames of GOP (g - 1) as one encoder does, and
+ * the rate control of GOP (g - num_coders) of the same encoder
+ */
+typedef struct gop_group_t {
+    xavs2_param_t    param;           /* parameters of the GOP parallel encoding */
+    xavs2_param_t    params[MAX_PARALLEL_GOPS];        /* parameters of each encoder, which encodes its GOPs as segments */
+    xavs2_handler_t *coders[MAX_PARALLEL_GOPS];        /* encoder of each GOP in parallel */
+    xlist_t          list_packets[MAX_PARALLEL_GOPS];  /* packets of each encoder, in coding order */
+    int              b_flushed[MAX_PARALLEL_GOPS];     /* has the encoder output all its frames */
+    int              num_coders;      /* number of encoders */
+    int              num_gop_frames;  /* number of frames in one closed GOP */
+    int              gop_refs  [XAVS2_MAX_GOP_SIZE];   /* frames of a GOP still referenced at its end (SegmentRefs), for each GOP phase */
+    int              b_gop_refs[XAVS2_MAX_GOP_SIZE];   /* has gop_refs of the phase been decided by an encoded GOP */
+    int64_t          num_input;       /* number of frames: input */
+    int64_t          num_output;      /* number of frames: output */
+    int64_t          i_gop_out;       /* index of the GOP being output */
+    int              num_gop_out;     /* number of frames output in the GOP being output */
+    int              b_flush;         /* is the encoder flushing */
+    int              b_seq_end;       /* has the end code been output */
+    const uint8_t   *end_code;        /* end code returned by the encoders */
+    int              len_end_code;    /* length of end code */
+
+    /* DTS of output frames, decided as if all GOPs were encoded by one encoder */
+    int64_t         *pts_input;       /* pts of input frames, in input order (ring buffer) */
+    int              size_pts_input;  /* size of the ring buffer, power of 2 */
+    int64_t          prev_reordered_pts_set[XAVS2_MAX_GOP_SIZE + 4];
+    int64_t          max_out_pts;     /* max output pts */
+    int64_t          max_out_dts;     /* max output dts */
+} gop_group_t;
+
+/* ---------------------------------------------------------------------------
+ * encoders of all renditions of ladder encoding (num_ladder > 0), the source
+ * is input once, and the lower renditions reuse the analysis of the top one
+ */
+typedef struct ladder_group_t {
+    xavs2_param_t    params[MAX_LADDER_RENDITIONS];        /* parameters of each rendition */
+    xavs2_handler_t *coders[MAX_LADDER_RENDITIONS];        /* encoder of each rendition, [0] is the top one */
+    xlist_t          list_packets[MAX_LADDER_RENDITIONS];  /* packets of each rendition, in coding order */
+    int              b_flushed[MAX_LADDER_RENDITIONS];     /* has the encoder output all its frames */
+    int              b_seq_end[MAX_LADDER_RENDITIONS];     /* has the end code been output */
+    const uint8_t   *end_code[MAX_LADDER_RENDITIONS];      /* end code returned by the encoders */
+    int              len_end_code[MAX_LADDER_RENDITIONS];  /* length of end code */
+    int64_t          max_out_pts;     /* max output pts */
+    int64_t          max_out_dts;     /* max output dts */
+    int              num_coders;      /* number of renditions */
+    int              b_flush;         /* is the encoder flushing */
+    ladder_t        *ladder;          /* analysis of the top rendition shared by all encoders */
+} ladder_group_t;
+
 
 /* ---------------------------------------------------------------------------
  * video pre-processing motion estimation 
@@ -95,6 +187,15 @@ struct xavs2_frame_buffer_t {
     int              POC_IDR;                /* POC of current IDR frame */
     int              ip_pic_idx;           /* encoded I/P/F-picture index (to be REMOVED) */
     int              i_frame_b;            /* number of encoded B-picture in a GOP */
+    uint8_t         *mem_pool;             /* arena holding the first num_pooled pictures (NULL: one block per picture) */
+    int              num_pooled;           /* number of pictures reserved in the arena */
+    int              frm_type;             /* type of managed pictures, FT_ENC or FT_DEC */
+    size_t           size_frame;           /* size of one picture in the arena */
+
+    /* bit i is set when frames[i] has been released by all its users (cnt_refered == 0),
+     * only these pictures are checked for a new reconstructed frame */
+    uint64_t             idle_mask;
+    xavs2_thread_mutex_t idle_mutex;       /* mutex of idle_mask */
 
     /* frames to be removed before next frame encoding */
     int         num_frames_to_remove; /* number of frames to be removed */
@@ -110,10 +211,13 @@ struct xavs2_handler_t {
     xavs2_t    *p_coder;                            /* point to the xavs2 video encoder */
     xavs2_t    *frm_contexts[MAX_PARALLEL_FRAMES];  /* frame task contexts */
     xavs2_t    *row_contexts;                       /* row   task contexts */
+    xavs2_t    *lf_contexts;                        /* in-loop filter task contexts */
 
     /* frame buffers */
     xavs2_frame_buffer_t ipb;         /* input picture buffer */
     xavs2_frame_buffer_t dpb;         /* decoding picture buffer */
+    int         i_max_width;          /* frame size on creation, pictures are not larger than it after a reset */
+    int         i_max_height;
 
     /* properties */
     int64_t     max_out_pts;          /* max output pts */
@@ -124,6 +228,7 @@ struct xavs2_handler_t {
     int         num_encode;           /* number of frames: sent into encoding queue */
     int         num_output;           /* number of frames: outputted */
     int         b_seq_end;            /* has all frames been output */
+    int         b_reset_ready;        /* have all frames been finished before a reset */
 
     /* output frame index, use get_next_frame_id() to get next output index */
     int         i_input;              /* index  of frames: input  already accepted, used for frame output () */
@@ -132,6 +237,7 @@ struct xavs2_handler_t {
     /* index of frames, [0, i_frm_threads), to determine frame order */
     int         i_frame_in;           /* frame order [0, i_frm_threads): next input  */
     int         i_frame_aec;          /* frame order [0, i_frm_threads): current AEC */
+    int         i_refresh_frame;      /* frame number of the last I frame, start of gradual intra refresh */
 
     /* threads & synchronization */
     volatile int          i_exit_flag;        /* app signal to exit */
@@ -139,9 +245,16 @@ struct xavs2_handler_t {
     int                   i_row_threads;      /* real number of thread in LCU-row level parallel */
     int                   num_pool_threads;   /* number of threads allocated in threadpool */
     int                   num_row_contexts;   /* number of row contexts */
+    int                   num_lf_contexts;    /* number of in-loop filter contexts */
     xavs2_threadpool_t   *threadpool_rdo;     /* the thread pool (for parallel encoding) */
     xavs2_threadpool_t   *threadpool_aec;     /* the thread pool for aec encoding */
+    xavs2_threadpool_t   *threadpool_lf;      /* the thread pool for the in-loop filter stage */
+    int                   num_max_slices;     /* max number of slices in one frame, entropy coded in parallel */
+    slice_auto_t          slice_auto;         /* statistics for the automatic slice partitioning */
+    row_sched_t           row_sched;          /* statistics for the scheduling of LCU rows */
     xavs2_thread_t       thread_wrapper;     /* thread for wrapper proceeding */
+    xavs2_affinity_t    *affinity;           /* CPUs threads are pinned to, may be the one of the top handler */
+    xavs2_affinity_t     cpu_affinity;       /* CPUs threads are pinned to, owned by this handler */
 
     xavs2_thread_cond_t  cond[SIG_COUNT];
     xavs2_thread_mutex_t mutex;              /* mutex */
@@ -169,8 +282,14 @@ struct xavs2_handler_t {
     FILE             *fp_trace;       /* for trace output */
 #endif
 
+    gop_group_t      *gop_group;      /* encoders of the parallel GOPs, only for the top handler of GOP parallel encoding */
+    ladder_group_t   *ladder_group;   /* encoders of all renditions, only for the top handler of ladder encoding */
+    ladder_t         *ladder;         /* analysis of the top rendition, for each encoder of ladder encoding */
+
     void             *user_data;      /* handle of user data */
     int64_t           create_time;    /* time of encoder creation, used for encoding speed test */
+    xavs2_mem_stat_t  mem_stat;       /* memory allocated by this encoder */
+    xavs2_thread_mutex_t mutex_mem;   /* mutex of mem_stat, which is updated by the encoding threads */
 
 #if XAVS2_DUMP_REC
     FILE             *h_rec_file;     /* file handle to output reconstructed frame data */
@@ -207,6 +326,15 @@ int get_next_frame_id(int idx_cur)
 void frame_buffer_init(xavs2_handler_t *h_mgr, uint8_t **mem_base, xavs2_frame_buffer_t *frm_buf, int num_frm, int frm_type);
 #define frame_buffer_destroy FPFX(frame_buffer_destroy)
 void frame_buffer_destroy(xavs2_handler_t *h_mgr, xavs2_frame_buffer_t *frm_buf);
+#define frame_buffer_alloc_frame FPFX(frame_buffer_alloc_frame)
+xavs2_frame_t *frame_buffer_alloc_frame(xavs2_handler_t *h_mgr, xavs2_frame_buffer_t *frm_buf);
+#define frame_buffer_reset FPFX(frame_buffer_reset)
+void frame_buffer_reset(xavs2_frame_buffer_t *frm_buf, int coi);
+#define frame_buffer_resize FPFX(frame_buffer_resize)
+int  frame_buffer_resize(xavs2_handler_t *h_mgr, xavs2_frame_buffer_t *frm_buf);
+
+#define frame_buffer_set_idle FPFX(frame_buffer_set_idle)
+void frame_buffer_set_idle(xavs2_frame_buffer_t *frm_buf, xavs2_frame_t *frame);
 
 #define frame_buffer_update FPFX(frame_buffer_update)
 void frame_buffer_update(xavs2_t *h, xavs2_frame_buffer_t *frm_buf, xavs2_frame_t *frm);
@@ -351,6 +479,76 @@ int xavs2_encoder_encode(void *coder, xavs2_picture_t *pic, xavs2_outpacket_t *p
  */
 int xavs2_encoder_packet_unref(void *coder, xavs2_outpacket_t *packet);
 
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : estimate the memory usage of an encoder before its creation
+ * Parameters :
+ *      [in ] : param - pointer to struct xavs2_param_t
+ *      [out] : stat  - projected bytes of each category
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_mem_estimate(const xavs2_param_t *param, xavs2_mem_stat_t *stat);
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get the memory allocated by an encoder
+ * Parameters :
+ *      [in ] : coder - pointer to wrapper of the xavs2 encoder
+ *      [out] : stat  - allocated bytes of each category
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_mem_usage(void *coder, xavs2_mem_stat_t *stat);
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get the state to be handed over to the next segment
+ * Parameters :
+ *      [in ] : coder   - pointer to wrapper of the xavs2 encoder
+ *      [out] : segment - parameters of the next segment
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_segment_state(void *coder, xavs2_segment_t *segment);
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : fetch a packet of a lower rendition in ladder encoding
+ * Parameters :
+ *      [in ] : coder     - pointer to wrapper of the xavs2 encoder
+ *            : rendition - index of the lower rendition, 1 ~ num_ladder
+ *      [out] : packet    - output bit-stream
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_ladder_fetch(void *coder, int rendition, xavs2_outpacket_t *packet);
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get the complexity of frames input but not output yet
+ * Parameters :
+ *      [in ] : coder   - pointer to wrapper of the xavs2 encoder
+ *            : max_num - max number of frames in stats
+ *      [out] : stats   - complexity of the frames, in input order
+ * Return     : number of frames, negative for failure
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_lookahead_stats(void *coder, xavs2_frame_stat_t *stats, int max_num);
+int xavs2_encoder_set_bitrate(void *coder, int bitrate);
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : flush the encoder and reset it to start a new sequence
+ * Parameters :
+ *      [in ] : coder - pointer to wrapper of the xavs2 encoder
+ *            : param - new rate control, GOP parameters and frame size, NULL to keep the current ones
+ *      [out] : none
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_reset(void *coder, const xavs2_param_t *param);
+
 
 /**
  * ---------------------------------------------------------------------------
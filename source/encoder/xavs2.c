@@ -44,11 +44,13 @@
 #include "tdrdo.h"
 #include "presets.h"
 #include "rps.h"
+#include "ladder.h"
+#include "me.h"
 
 /* ---------------------------------------------------------------------------
  */
 static INLINE
-int get_num_frame_threads(xavs2_param_t *param, int num_frame_threads, int num_row_threads)
+int get_num_frame_threads(const xavs2_param_t *param, int num_frame_threads, int num_row_threads)
 {
     int a = ((param->search_range + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level) + 1;
     int i;
@@ -67,6 +69,179 @@ int get_num_frame_threads(xavs2_param_t *param, int num_frame_threads, int num_r
     return i - 1;
 }
 
+/* ---------------------------------------------------------------------------
+ * get the number of DPB slots, pictures are allocated on demand so that
+ * only those needed by the RPS configuration are actually created
+ */
+static INLINE
+int encoder_get_dpb_size(int num_frm_threads)
+{
+    return XAVS2_MIN(FREF_BUF_SIZE, MAX_REFS + num_frm_threads * 4);
+}
+
+/* ---------------------------------------------------------------------------
+ * get the size of the encoder wrapper except the buffered input frames,
+ * shared by the allocation of the wrapper and the memory projection
+ */
+static
+size_t encoder_get_handler_size(const xavs2_param_t *param, size_t *p_size_row_bits, size_t *p_size_row_time)
+{
+    int h_in_lcu = (param->org_height + (1 << param->lcu_bit_level) - 1) >> param->lcu_bit_level;
+    size_t size_row_bits = param->b_slice_auto ? sizeof(int) * h_in_lcu * SLICE_TYPE_NUM : 0;
+    size_t size_row_time = sizeof(int64_t) * h_in_lcu * SLICE_TYPE_NUM;
+
+    if (p_size_row_bits != NULL) {
+        *p_size_row_bits = size_row_bits;
+    }
+    if (p_size_row_time != NULL) {
+        *p_size_row_time = size_row_time;
+    }
+
+    return sizeof(xavs2_handler_t)         +   /* M0, size of the encoder wrapper */
+           xavs2_rc_get_buffer_size(param) +   /* M5, rate control information */
+           tdrdo_get_buffer_size(param)    +   /* M6, TDRDO */
+           size_row_bits                   +   /* M7, bits of LCU rows for automatic slice partitioning */
+           size_row_time                   +   /* M8, coding time of LCU rows for row scheduling */
+           lookahead_get_buffer_size(param) +  /* M9, lowres frames of lookahead */
+           CACHE_LINE_SIZE * (XAVS2_INPUT_NUM + 6);
+}
+
+/* ---------------------------------------------------------------------------
+ * project the memory usage of an encoder with given thread numbers
+ */
+static
+void encoder_mem_project(const xavs2_param_t *param, int num_frm_threads, int num_row_threads,
+                         xavs2_mem_stat_t *stat)
+{
+    size_t size_bs;
+    size_t size_ctx        = encoder_get_frame_context_size(param, &size_bs);
+    int num_row_contexts   = 0;
+    int num_dpb_frames     = XAVS2_MIN(encoder_get_dpb_size(num_frm_threads), rps_get_dpb_size(param, num_frm_threads));
+    int i;
+
+    if (num_frm_threads > 1 || num_row_threads > 1) {
+        num_row_contexts = num_row_threads + num_frm_threads * 2;
+    }
+
+    memset(stat, 0, sizeof(xavs2_mem_stat_t));
+    stat->size[XAVS2_MEMCAT_HANDLER]      = encoder_get_handler_size(param, NULL, NULL);
+    stat->size[XAVS2_MEMCAT_INPUT_FRAMES] = xavs2_frame_buffer_size(param, FT_ENC) * XAVS2_INPUT_NUM;
+    stat->size[XAVS2_MEMCAT_REF_FRAMES]   = xavs2_frame_buffer_size(param, FT_DEC) * num_dpb_frames;
+    stat->size[XAVS2_MEMCAT_FRAME_CTX]    = size_ctx * num_frm_threads;
+    stat->size[XAVS2_MEMCAT_BITSTREAM]    = size_bs * num_frm_threads;
+    stat->size[XAVS2_MEMCAT_ROW_CTX]      = encoder_get_row_context_size(param) * num_row_contexts +
+                                            sizeof(xavs2_t) * param->i_lf_threads;
+    for (i = 0; i < XAVS2_MEMCAT_NUM; i++) {
+        stat->total += stat->size[i];
+    }
+    stat->peak          = stat->total;
+    stat->frame_threads = num_frm_threads;
+    stat->row_threads   = num_row_threads;
+}
+
+/* ---------------------------------------------------------------------------
+ * account the memory allocated by an encoder
+ */
+static
+void encoder_mem_account(xavs2_handler_t *h_mgr, size_t size_wrapper)
+{
+    const xavs2_param_t *param = h_mgr->p_coder->param;
+    xavs2_mem_stat_t *stat     = &h_mgr->mem_stat;
+    size_t size_fdec = xavs2_frame_buffer_size(param, FT_DEC);
+    size_t size_fenc = xavs2_frame_buffer_size(param, FT_ENC) * XAVS2_INPUT_NUM;
+    size_t size_ctx  = encoder_get_frame_context_size(param, NULL);
+    int i;
+
+    memset(stat, 0, sizeof(xavs2_mem_stat_t));
+    stat->size[XAVS2_MEMCAT_HANDLER]      = size_wrapper - size_fenc;
+    stat->size[XAVS2_MEMCAT_INPUT_FRAMES] = size_fenc;
+    stat->size[XAVS2_MEMCAT_REF_FRAMES] = h_mgr->dpb.size_frame * h_mgr->dpb.num_pooled;
+    for (i = h_mgr->dpb.num_pooled; i < h_mgr->dpb.num_frames; i++) {
+        stat->size[XAVS2_MEMCAT_REF_FRAMES] += h_mgr->dpb.frames[i] != NULL ? size_fdec : 0;
+    }
+    for (i = 0; i < h_mgr->i_frm_threads; i++) {
+        if (h_mgr->frm_contexts[i] != NULL) {
+            stat->size[XAVS2_MEMCAT_FRAME_CTX] += size_ctx;
+            stat->size[XAVS2_MEMCAT_BITSTREAM] += h_mgr->frm_contexts[i]->i_bs_buf_slice;
+        }
+    }
+    if (h_mgr->row_contexts != NULL) {
+        stat->size[XAVS2_MEMCAT_ROW_CTX] = encoder_get_row_context_size(param) * h_mgr->num_row_contexts;
+    }
+    stat->size[XAVS2_MEMCAT_ROW_CTX] += sizeof(xavs2_t) * h_mgr->num_lf_contexts;
+    for (i = 0; i < XAVS2_MEMCAT_NUM; i++) {
+        stat->total += stat->size[i];
+    }
+    stat->peak          = stat->total;
+    stat->frame_threads = h_mgr->i_frm_threads;
+    stat->row_threads   = h_mgr->i_row_threads;
+
+    xavs2_log(h_mgr, XAVS2_LOG_DEBUG, "Memory: %.1f MB (handler %.1f, input %.1f, dpb %.1f, frame ctx %.1f, bitstream %.1f, row ctx %.1f)\n",
+              stat->total / 1048576.0,
+              stat->size[XAVS2_MEMCAT_HANDLER] / 1048576.0, stat->size[XAVS2_MEMCAT_INPUT_FRAMES] / 1048576.0,
+              stat->size[XAVS2_MEMCAT_REF_FRAMES] / 1048576.0, stat->size[XAVS2_MEMCAT_FRAME_CTX] / 1048576.0,
+              stat->size[XAVS2_MEMCAT_BITSTREAM] / 1048576.0, stat->size[XAVS2_MEMCAT_ROW_CTX] / 1048576.0);
+}
+
+/* ---------------------------------------------------------------------------
+ * sum the memory allocated by a group of encoders, the peak is the sum of
+ * their peaks, as the encoders may reach them at the same time
+ */
+static
+void encoder_mem_sum(xavs2_handler_t *const *coders, int num_coders, xavs2_mem_stat_t *stat)
+{
+    int i, j;
+
+    memset(stat, 0, sizeof(xavs2_mem_stat_t));
+    for (j = 0; j < num_coders; j++) {
+        xavs2_handler_t *h_mgr = coders[j];
+
+        xavs2_thread_mutex_lock(&h_mgr->mutex_mem);
+        for (i = 0; i < XAVS2_MEMCAT_NUM; i++) {
+            stat->size[i] += h_mgr->mem_stat.size[i];
+        }
+        stat->total += h_mgr->mem_stat.total;
+        stat->peak  += h_mgr->mem_stat.peak;
+        xavs2_thread_mutex_unlock(&h_mgr->mutex_mem);
+    }
+    stat->frame_threads = coders[0]->mem_stat.frame_threads;
+    stat->row_threads   = coders[0]->mem_stat.row_threads;
+}
+
+/* ---------------------------------------------------------------------------
+ * decide the number of frame and row threads, fewer threads are used when
+ * the encoder would exceed the memory budget
+ */
+static
+void encoder_decide_threads(const xavs2_param_t *param, int *num_frm_threads, int *num_row_threads)
+{
+    int64_t mem_budget = (int64_t)param->mem_budget << 20;
+    xavs2_mem_stat_t stat;
+
+    *num_row_threads = param->i_lcurow_threads == 0 ? xavs2_cpu_num_processors() : param->i_lcurow_threads;
+    *num_frm_threads = get_num_frame_threads(param, param->i_frame_threads, *num_row_threads);
+
+    if (mem_budget <= 0) {
+        return;
+    }
+
+    /* a frame thread costs one frame context, 4 DPB frames and 2 row contexts */
+    for (;;) {
+        encoder_mem_project(param, *num_frm_threads, *num_row_threads, &stat);
+        if (stat.total <= mem_budget) {
+            break;
+        } else if (*num_frm_threads > 1) {
+            (*num_frm_threads)--;
+        } else if (*num_row_threads > 1) {
+            (*num_row_threads)--;
+        } else {
+            xavs2_log(NULL, XAVS2_LOG_WARNING, "MemoryBudget %d MB is too small, %d MB is needed\n",
+                      param->mem_budget, (int)((stat.total + (1 << 20) - 1) >> 20));
+            break;
+        }
+    }
+}
+
 
 /**
  * ===========================================================================
@@ -124,6 +299,7 @@ xavs2_param_t *xavs2_encoder_opt_alloc(void)
     param->i_gop_size                 = -8;
     param->successive_Bframe          = 0;
     param->intra_period               = 6;
+    param->intra_refresh              = 0;
 
     /* --- picture ---------------------------------------------- */
     param->progressive_frame          = 1;
@@ -140,6 +316,7 @@ xavs2_param_t *xavs2_encoder_opt_alloc(void)
     param->enable_hadamard            = TRUE;
     param->me_method                  = XAVS2_ME_HEX;
     param->search_range               = 64;
+    param->enable_hash_me             = FALSE;
     param->num_max_ref                = XAVS2_MAX_REFS;
     param->inter_2pu                  = TRUE;
     param->enable_amp                 = TRUE;
@@ -200,12 +377,37 @@ xavs2_param_t *xavs2_encoder_opt_alloc(void)
     param->i_min_qp                   = 20;
     param->i_max_qp                   = MAX_QP;
     param->i_target_bitrate           = 1000000;
+    param->enable_lookahead_stats     = 0;
 
     /* --- parallel --------------------------------------------- */
     param->num_parallel_gop           = 1;
+    param->b_gop_continued            = 0;
     param->i_frame_threads            = 0;
     param->i_lcurow_threads           = 0;
     param->enable_aec_thread          = 1;
+    param->i_lf_threads               = 0;
+    param->thread_affinity            = 0;
+    param->psz_affinity_cpus[0]       = '\0';
+
+    /* --- segment encoding ------------------------------------- */
+    param->b_segment                  = 0;
+    param->segment_start_frame        = 0;
+    param->b_segment_last             = 0;
+    param->segment_rc_qp              = 0;
+    param->segment_rc_buffer          = 0;
+    param->segment_refs               = 0;
+
+    /* --- ladder encoding -------------------------------------- */
+    param->num_ladder                 = 0;
+    param->i_rendition                = 0;
+    memset(param->ladder_width,   0, sizeof(param->ladder_width));
+    memset(param->ladder_height,  0, sizeof(param->ladder_height));
+    memset(param->ladder_bitrate, 0, sizeof(param->ladder_bitrate));
+
+    /* --- memory ----------------------------------------------- */
+    param->mem_alloc_mode             = XAVS2_MEM_SYSTEM;
+    param->enable_frame_pool          = FALSE;
+    param->mem_budget                 = 0;
 
     /* --- log -------------------------------------------------- */
     param->i_log_level                = 3;
@@ -237,64 +439,33 @@ void xavs2_encoder_opt_destroy(xavs2_param_t *param)
     }
 }
 
-/**
- * ---------------------------------------------------------------------------
- * Function   : create and initialize the xavs2 video encoder
- * Parameters :
- *      [in ] : param     - pointer to struct xavs2_param_t
- *      [out] : handle of xavs2 encoder wrapper
- * Return     : handle of xavs2 encoder wrapper, none zero for success, otherwise false
- * ---------------------------------------------------------------------------
+/* ---------------------------------------------------------------------------
+ * create one encoder wrapper with checked parameters
  */
-void *xavs2_encoder_create(xavs2_param_t *param)
+static
+xavs2_handler_t *encoder_create_handler(xavs2_param_t *param, xavs2_affinity_t *affinity)
 {
     xavs2_handler_t *h_mgr   = NULL;
     xavs2_frame_t   *frm     = NULL;
     uint8_t         *mem_ptr = NULL;
     size_t size_ratecontrol;      /* size for rate control module */
     size_t size_tdrdo;
+    size_t size_row_bits;         /* size for the statistics of automatic slice partitioning */
+    size_t size_row_time;         /* size for the statistics of LCU row scheduling */
+    size_t size_lowres;           /* size for the lowres frames of lookahead */
     size_t mem_size;
     int i;
 
-    if (param == NULL) {
-        xavs2_log(NULL, XAVS2_LOG_ERROR, "Null input parameters for encoder creation\n");
-        return NULL;
-    }
-
-    /* confirm the input parameters (log_level)  */
-    if (param->i_log_level < XAVS2_LOG_NONE ||
-        param->i_log_level > XAVS2_LOG_DEBUG) {
-        xavs2_log(NULL, XAVS2_LOG_ERROR, "Invalid parameter: log_level %d\n",
-                  param->i_log_level);
-        return NULL;
-    }
-    g_xavs2_default_log.i_log_level = param->i_log_level;
-
-    /* init all function handlers */
-    memset(&g_funcs, 0, sizeof(g_funcs));
-#if HAVE_MMX
-    g_funcs.cpuid = xavs2_cpu_detect();
-#endif
-    xavs2_init_all_primitives(param, &g_funcs);
-
-    /* check parameters */
-    if (encoder_check_parameters(param) < 0) {
-        xavs2_log(NULL, XAVS2_LOG_ERROR, "error encoder parameters\n");
-        goto fail;
-    }
-
     size_ratecontrol = xavs2_rc_get_buffer_size(param);      /* rate control */
     size_tdrdo       = tdrdo_get_buffer_size(param);
+    size_lowres      = lookahead_get_buffer_size(param);
 
     /* compute the memory size */
-    mem_size = sizeof(xavs2_handler_t)                           +   /* M0, size of the encoder wrapper */
-    xavs2_frame_buffer_size(param, FT_ENC) * XAVS2_INPUT_NUM     +   /* M4, size of buffered input frames */
-    size_ratecontrol                                             +   /* M5, rate control information */
-    size_tdrdo                                                   +   /* M6, TDRDO */
-    CACHE_LINE_SIZE * (XAVS2_INPUT_NUM + 4);
+    mem_size = encoder_get_handler_size(param, &size_row_bits, &size_row_time) +   /* M0, M5-M9 */
+               xavs2_frame_buffer_size(param, FT_ENC) * XAVS2_INPUT_NUM;         /* M4, size of buffered input frames */
 
     /* alloc memory for the encoder wrapper */
-    CHECKED_MALLOC(mem_ptr, uint8_t *, mem_size);
+    CHECKED_MALLOC_MODE(mem_ptr, uint8_t *, mem_size, param->mem_alloc_mode);
 
     /* M0: assign the wrapper */
     h_mgr = (xavs2_handler_t *)mem_ptr;
@@ -313,8 +484,8 @@ void *xavs2_encoder_create(xavs2_param_t *param)
     
     /* counters for encoding */
     h_mgr->i_exit_flag = 0;
-    h_mgr->i_input     = 0;
-    h_mgr->i_output    = -1;
+    h_mgr->i_input     = param->segment_start_frame;   /* POC continues from the previous segment */
+    h_mgr->i_output    = param->segment_start_frame - 1;
     h_mgr->i_frame_in  = 0;
     h_mgr->i_frame_aec = 0;
     h_mgr->b_seq_end   = 0;
@@ -332,7 +503,8 @@ void *xavs2_encoder_create(xavs2_param_t *param)
     }
 #endif
 
-    if (xavs2_thread_mutex_init(&h_mgr->mutex, NULL)) {
+    if (xavs2_thread_mutex_init(&h_mgr->mutex, NULL) ||
+        xavs2_thread_mutex_init(&h_mgr->mutex_mem, NULL)) {
         goto fail;
     }
 
@@ -342,9 +514,18 @@ void *xavs2_encoder_create(xavs2_param_t *param)
         }
     }
 
+    /* pinning of threads, the encoders of GOP parallel and ladder encoding share the one of the top handler */
+    if (affinity == NULL) {
+        h_mgr->affinity = &h_mgr->cpu_affinity;
+        if (xavs2_affinity_init(h_mgr->affinity, param->thread_affinity, param->psz_affinity_cpus) < 0) {
+            goto fail;
+        }
+    } else {
+        h_mgr->affinity = affinity;
+    }
+
     /* decide all thread numbers */
-    h_mgr->i_row_threads = param->i_lcurow_threads == 0 ? xavs2_cpu_num_processors() : param->i_lcurow_threads;
-    h_mgr->i_frm_threads = get_num_frame_threads(param, param->i_frame_threads, h_mgr->i_row_threads);
+    encoder_decide_threads(param, &h_mgr->i_frm_threads, &h_mgr->i_row_threads);
     h_mgr->num_pool_threads = 0;
     h_mgr->num_row_contexts = 0;
     param->i_lcurow_threads = h_mgr->i_row_threads;
@@ -357,17 +538,36 @@ void *xavs2_encoder_create(xavs2_param_t *param)
         h_mgr->num_row_contexts = thread_num + h_mgr->i_frm_threads;
 
         /* create the thread pool */
-        if (xavs2_threadpool_init(&h_mgr->threadpool_rdo, thread_num, NULL, NULL)) {
+        if (xavs2_threadpool_init(&h_mgr->threadpool_rdo, thread_num, (xavs2_tfunc_t)xavs2_affinity_pin, h_mgr->affinity)) {
             xavs2_log(h_mgr, XAVS2_LOG_ERROR, "Error init thread pool RDO. %d", thread_num);
             goto fail;
         }
         h_mgr->num_pool_threads = thread_num;
     }
 
-    /* create AEC thread pool */
+    /* create AEC thread pool, the slices of a frame are entropy coded in parallel.
+     * automatic slice partitioning splits a frame into at most i_row_threads
+     * slices, or keeps a single slice when no AEC thread is used */
     h_mgr->threadpool_aec = NULL;
+    h_mgr->num_max_slices = param->slice_num;
+    if (param->b_slice_auto) {
+        h_mgr->num_max_slices = param->enable_aec_thread ? XAVS2_MIN(param->slice_num, XAVS2_MAX(1, h_mgr->i_row_threads)) : 1;
+    }
     if (param->enable_aec_thread) {
-        xavs2_threadpool_init(&h_mgr->threadpool_aec, h_mgr->i_frm_threads, NULL, NULL);
+        xavs2_threadpool_init(&h_mgr->threadpool_aec, h_mgr->i_frm_threads * h_mgr->num_max_slices,
+                              (xavs2_tfunc_t)xavs2_affinity_pin, h_mgr->affinity);
+    }
+
+    /* create the thread pool of the in-loop filter stage, each thread owns a filter context */
+    h_mgr->threadpool_lf   = NULL;
+    h_mgr->num_lf_contexts = 0;
+    if (param->i_lf_threads > 0) {
+        if (xavs2_threadpool_init(&h_mgr->threadpool_lf, param->i_lf_threads,
+                                  (xavs2_tfunc_t)xavs2_affinity_pin, h_mgr->affinity)) {
+            xavs2_log(h_mgr, XAVS2_LOG_ERROR, "Error init thread pool LF. %d", param->i_lf_threads);
+            goto fail;
+        }
+        h_mgr->num_lf_contexts = param->i_lf_threads;
     }
 
     /* init all lists */
@@ -389,6 +589,30 @@ void *xavs2_encoder_create(xavs2_param_t *param)
 
     }
 
+    /* M7: statistics for automatic slice partitioning */
+    if (param->b_slice_auto) {
+        int h_in_lcu = (int)(size_row_bits / (sizeof(int) * SLICE_TYPE_NUM));
+        for (i = 0; i < SLICE_TYPE_NUM; i++) {
+            h_mgr->slice_auto.row_bits[i]   = (int *)mem_ptr;
+            h_mgr->slice_auto.b_row_bits[i] = 0;
+            mem_ptr += sizeof(int) * h_in_lcu;
+        }
+        ALIGN_POINTER(mem_ptr);
+    }
+
+    /* M8: statistics for LCU row scheduling */
+    for (i = 0; i < SLICE_TYPE_NUM; i++) {
+        h_mgr->row_sched.row_time[i]   = (int64_t *)mem_ptr;
+        h_mgr->row_sched.b_row_time[i] = 0;
+        mem_ptr += size_row_time / SLICE_TYPE_NUM;
+    }
+    ALIGN_POINTER(mem_ptr);
+
+    /* M9: lowres frames for the complexity estimation of lookahead */
+    lookahead_init_lowres(h_mgr, param, mem_ptr);
+    mem_ptr += size_lowres;
+    ALIGN_POINTER(mem_ptr);
+
     /* TD-RDO */
     if (param->enable_tdrdo) {
         h_mgr->td_rdo = (td_rdo_t *)mem_ptr;
@@ -408,15 +632,20 @@ void *xavs2_encoder_create(xavs2_param_t *param)
     }
 
     /* create encoder handlers for multi-thread */
-    if (h_mgr->i_frm_threads > 1 || h_mgr->i_row_threads > 1) {
+    if (h_mgr->i_frm_threads > 1 || h_mgr->i_row_threads > 1 || h_mgr->num_lf_contexts > 0) {
         if (encoder_contexts_init(h_mgr->p_coder, h_mgr) < 0) {
             goto fail;
         }
     }
 
+    /* frame size on creation, pictures are re-dimensioned within it on reset */
+    h_mgr->i_max_width  = param->org_width;
+    h_mgr->i_max_height = param->org_height;
+
     /* M4: alloc memory for each node and append to image idle list */
     frame_buffer_init(h_mgr, &mem_ptr, &h_mgr->ipb,
                       XAVS2_INPUT_NUM, FT_ENC);
+    h_mgr->ipb.COI = param->segment_start_frame;   /* COI continues from the previous segment as POC */
     for (i = 0; i < XAVS2_INPUT_NUM; i++) {
         frm = h_mgr->ipb.frames[i];
         if (frm) {
@@ -427,14 +656,14 @@ void *xavs2_encoder_create(xavs2_param_t *param)
     }
 
     /* allocate DPB */
-    frame_buffer_init(h_mgr, NULL, &h_mgr->dpb, 
-                      XAVS2_MIN(FREF_BUF_SIZE, MAX_REFS + h_mgr->i_frm_threads * 4), FT_DEC);
+    frame_buffer_init(h_mgr, NULL, &h_mgr->dpb, encoder_get_dpb_size(h_mgr->i_frm_threads), FT_DEC);
 
     /* memory check */
     if (mem_ptr - (uint8_t *)h_mgr > mem_size) {
         xavs2_log(NULL, XAVS2_LOG_ERROR, "Failed to create input frame buffer.\n");
         goto fail;
     }
+    encoder_mem_account(h_mgr, mem_size);
 
     /* init lookahead in the encoder wrapper */
     h_mgr->lookahead.bpframes = param->i_gop_size;
@@ -462,123 +691,1248 @@ fail:
     return NULL;
 }
 
-/**
- * ---------------------------------------------------------------------------
- * Function   : destroy the xavs2 video encoder
- * Parameters :
- *      [in ] : coder - pointer to wrapper of the xavs2 encoder
- *      [out] : none
- * Return     : none
- * ---------------------------------------------------------------------------
+/* ---------------------------------------------------------------------------
+ * flush an encoder before a reset, the bitstreams of frames not output yet
+ * are dropped. no thread of the encoder is working after that
  */
-void xavs2_encoder_destroy(void *coder)
+static
+void encoder_reset_flush(xavs2_handler_t *h_mgr)
 {
-    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
-    xavs2_frame_t frm_flush = { 0 };
-    xavs2_frame_t frm_exit  = { 0 };
+    xavs2_frame_t    *frame;
+    xavs2_outpacket_t packet;
+
+    /* 1, encode all delayed frames, their bitstreams are dropped */
+    while (!h_mgr->b_seq_end) {
+        memset(&packet, 0, sizeof(packet));
+        xavs2_encoder_encode(h_mgr, NULL, &packet);
+        xavs2_encoder_packet_unref(h_mgr, &packet);
+    }
 
-    /* destroy all threads: lookahead and wrapper threads */
-    if (h_mgr->p_coder != NULL) {
-        frm_flush.i_state = XAVS2_FLUSH;        /* signal to flush encoder */
-        frm_exit.i_state  = XAVS2_EXIT_THREAD;  /* signal to exit */
-        send_frame_to_enc_queue(h_mgr, &frm_flush);
-        send_frame_to_enc_queue(h_mgr, &frm_exit);
+    /* 2, wait until the wrapper thread finishes all frames, then no thread
+     * is working and all states can be reset here */
+    frame = frame_buffer_get_free_frame_ipb(h_mgr);
+    frame->i_state = XAVS2_RESET;
+    h_mgr->b_reset_ready = 0;
+    xl_append(&h_mgr->list_frames_ready, frame);
 
-        /* wait until the RDO process exit, then memory can be released */
-        xavs2_thread_join(h_mgr->thread_wrapper, NULL);
+    xavs2_thread_mutex_lock(&h_mgr->mutex);   /* lock */
+    while (!h_mgr->b_reset_ready) {
+        xavs2_thread_cond_wait(&h_mgr->cond[SIG_ENCODER_RESET], &h_mgr->mutex);
     }
+    xavs2_thread_mutex_unlock(&h_mgr->mutex); /* unlock */
+}
 
-    /* close the encoder */
-    encoder_close(h_mgr);
+/* ---------------------------------------------------------------------------
+ * check the frame size of new parameters on reset, the pictures are kept in
+ * the memory allocated for the frame size on creation
+ */
+static
+int encoder_reset_check_size(xavs2_handler_t *h_mgr, const xavs2_param_t *p_new)
+{
+    if (p_new->org_width > h_mgr->i_max_width || p_new->org_height > h_mgr->i_max_height) {
+        xavs2_log(h_mgr, XAVS2_LOG_ERROR, "Frame size %dx%d exceeds the one on creation %dx%d\n",
+                  p_new->org_width, p_new->org_height, h_mgr->i_max_width, h_mgr->i_max_height);
+        return -1;
+    }
 
-    xavs2_log(h_mgr, XAVS2_LOG_DEBUG, "Encoded %d frames, %.3f secs\n",
-              h_mgr->num_input, 0.000001 * (xavs2_mdate() - h_mgr->create_time));
+    return 0;
+}
 
-    if (h_mgr->fp_trace) {
-        fclose(h_mgr->fp_trace);
-    }
+/* ---------------------------------------------------------------------------
+ * re-dimension a flushed encoder for the frame size of the parameters in use,
+ * all pictures are carved again in their own memory by the encoding contexts
+ * created for the new size. threads and frame pools are kept
+ */
+static
+int encoder_reset_size(xavs2_handler_t *h_mgr)
+{
+    int i;
 
-    /* free memory of encoder wrapper */
-    memset(h_mgr, 0, sizeof(xavs2_handler_t));
-    xavs2_free(h_mgr);
+    while (xl_remove_head(&h_mgr->list_frames_free, 0) != NULL) {
+        /* the list nodes are in the pictures */
+    }
+    if (frame_buffer_resize(h_mgr, &h_mgr->ipb) < 0 ||
+        frame_buffer_resize(h_mgr, &h_mgr->dpb) < 0) {
+        return -1;
+    }
+    for (i = 0; i < XAVS2_INPUT_NUM; i++) {
+        xl_append(&h_mgr->list_frames_free, h_mgr->ipb.frames[i]);
+    }
 
+    return 0;
 }
 
-/**
- * ---------------------------------------------------------------------------
- * Function   : get buffer for the encoder caller
- * Parameters :
- *      [in ] : coder - pointer to wrapper of the xavs2 encoder
- *            : pic   - pointer to struct xavs2_picture_t
- *      [out] : pic   - memory would be allocated for the image planes
- * Return     : zero for success, otherwise failed
- * ---------------------------------------------------------------------------
+/* ---------------------------------------------------------------------------
+ * reset a flushed encoder to start a new sequence with the parameters in use,
+ * the encoder is left in the state of a created one. frame buffers and threads
+ * are kept, the pictures are carved again when the frame size changes
  */
-int xavs2_encoder_get_buffer(void *coder, xavs2_picture_t *pic)
+static
+int encoder_reset_state(xavs2_handler_t *h_mgr, int b_resize)
 {
-    xavs2_handler_t *h_mgr   = (xavs2_handler_t *)coder;
-    xavs2_t         *p_coder = h_mgr->p_coder;
-    const xavs2_param_t *param = p_coder->param;
-    xavs2_frame_t   *frame;
+    xavs2_param_t *param = (xavs2_param_t *)h_mgr->p_coder->param;
+    int64_t size_wrapper = h_mgr->mem_stat.size[XAVS2_MEMCAT_HANDLER] + h_mgr->mem_stat.size[XAVS2_MEMCAT_INPUT_FRAMES];
+    int64_t peak;
+    int i;
 
-    assert(h_mgr != NULL && pic != NULL);
-    if (h_mgr == NULL || pic == NULL) {
+    /* all input pictures should be idle before they are carved again */
+    if (b_resize && h_mgr->list_frames_free.i_node_num != XAVS2_INPUT_NUM) {
+        xavs2_log(h_mgr, XAVS2_LOG_ERROR, "All packets should be recycled before the frame size changes\n");
         return -1;
     }
 
-    memset(pic, 0, sizeof(xavs2_picture_t));
+    /* 1, encoding contexts, which keep states of the frames they encoded. they
+     *    are created again and the frame contexts are assigned from the first
+     *    one on, so that the bitstream matches a created encoder */
+    encoder_mem_update(h_mgr, XAVS2_MEMCAT_FRAME_CTX, 0, encoder_get_frame_context_size(param, NULL));
+    if (encoder_contexts_reopen(h_mgr) < 0) {
+        xavs2_log(h_mgr, XAVS2_LOG_ERROR, "create encoding contexts for %dx%d fail\n",
+                  param->org_width, param->org_height);
+        return -1;
+    }
+    if (b_resize && encoder_reset_size(h_mgr) < 0) {
+        return -1;
+    }
+    h_mgr->i_frame_in  = 0;
+    h_mgr->i_frame_aec = 0;
 
-    /* fetch an empty node from unused list */
-    frame = frame_buffer_get_free_frame_ipb(h_mgr);
+    peak = h_mgr->mem_stat.peak;
+    encoder_mem_account(h_mgr, (size_t)size_wrapper);
+    h_mgr->mem_stat.peak = XAVS2_MAX(h_mgr->mem_stat.peak, peak);
 
-    /* set properties */
-    pic->img.in_sample_size  = param->input_sample_bit_depth == 8 ? 1 : 2;
-    pic->img.enc_sample_size = sizeof(pel_t);
-    pic->img.i_width[0]      = param->org_width;
-    pic->img.i_width[1]      = param->org_width >> 1;
-    pic->img.i_width[2]      = param->org_width >> 1;
-    pic->img.i_lines[0]      = param->org_height;
-    pic->img.i_lines[1]      = param->org_height >> (param->chroma_format <= CHROMA_420 ? 1 : 0);
-    pic->img.i_lines[2]      = param->org_height >> (param->chroma_format <= CHROMA_420 ? 1 : 0);
-    pic->img.i_csp           = XAVS2_CSP_I420;
-    pic->img.i_plane         = frame->i_plane;
-    pic->img.i_stride[0]     = frame->i_stride[0] * sizeof(pel_t);
-    pic->img.i_stride[1]     = frame->i_stride[1] * sizeof(pel_t);
-    pic->img.i_stride[2]     = frame->i_stride[2] * sizeof(pel_t);
-    pic->img.img_planes[0]   = (uint8_t *)frame->planes[0];
-    pic->img.img_planes[1]   = (uint8_t *)frame->planes[1];
-    pic->img.img_planes[2]   = (uint8_t *)frame->planes[2];
-    pic->priv                = frame;   /* keep trace of this frame */
+    /* 2, counters, the POC continues from the same frame as on creation */
+    h_mgr->num_input   = 0;
+    h_mgr->num_encode  = 0;
+    h_mgr->num_output  = 0;
+    h_mgr->i_input     = param->segment_start_frame;
+    h_mgr->i_output    = param->segment_start_frame - 1;
+    h_mgr->b_seq_end   = 0;
+    h_mgr->max_out_dts = 0;
+    h_mgr->max_out_pts = 0;
+
+    /* 3, lookahead, the next frame starts a new GOP with an I frame */
+    h_mgr->lookahead.bpframes = param->i_gop_size;
+    h_mgr->lookahead.start    = 0;
+    h_mgr->lookahead.pframes  = 0;
+    memset(h_mgr->blocked_frm_set, 0, sizeof(h_mgr->blocked_frm_set));
+    memset(h_mgr->blocked_pts_set, 0, sizeof(h_mgr->blocked_pts_set));
+    memset(h_mgr->prev_reordered_pts_set, 0, sizeof(h_mgr->prev_reordered_pts_set));
+    h_mgr->num_encoded_frames_for_dts = 0;
+    h_mgr->index_in_gop = 0;
+    h_mgr->lookahead.i_lowres_prev = -1;
+    h_mgr->lookahead.num_queued    = 0;
+
+    /* 4, frame buffers, no reconstructed frame can be referenced any more */
+    frame_buffer_reset(&h_mgr->ipb, param->segment_start_frame);
+    frame_buffer_reset(&h_mgr->dpb, 0);
+
+    /* 5, rate control, TD-RDO and the statistics of the previous sequence */
+    xavs2_rc_destroy(h_mgr->rate_control);
+    if (xavs2_rc_init(h_mgr->rate_control, param) < 0) {
+        xavs2_log(h_mgr, XAVS2_LOG_ERROR, "reset rate control fail\n");
+        return -1;
+    }
+    if (param->enable_tdrdo && tdrdo_reset(h_mgr->td_rdo, param) != 0) {
+        xavs2_log(h_mgr, XAVS2_LOG_ERROR, "reset td-rdo fail\n");
+        return -1;
+    }
+    for (i = 0; i < SLICE_TYPE_NUM; i++) {
+        h_mgr->slice_auto.b_row_bits[i] = 0;
+        h_mgr->row_sched.b_row_time[i]  = 0;
+    }
 
     return 0;
 }
 
 /**
- * ---------------------------------------------------------------------------
- * Function   : label a packet to be recycled
- * Parameters :
- *      [in ] : coder    - pointer to handle of xavs2 encoder (return by `encoder_create()`)
- *            : packet   - pointer to struct xavs2_outpacket_t, whose bit-stream buffer would be recycled
- *      [out] : none
- * Return     : zero for success, otherwise failed
- * ---------------------------------------------------------------------------
+ * ===========================================================================
+ * GOP parallel encoding (num_parallel_gop > 1)
+ *   each closed GOP is encoded by one of the encoders in turn, and bitstreams
+ *   of these encoders are buffered and output in GOP order. the encoders are
+ *   reset before each GOP with the segment state of a sequential encoding,
+ *   so that the COI, POC and RPS of the output are the same as one encoder
+ * ===========================================================================
  */
-int xavs2_encoder_packet_unref(void *coder, xavs2_outpacket_t *packet)
+
+/* ---------------------------------------------------------------------------
+ * index of the encoder for the next input frame
+ */
+static ALWAYS_INLINE
+int gop_group_input_coder(gop_group_t *group)
 {
-    if (coder == NULL || packet == NULL) {
-        return 0;
-    }
+    return (int)((group->num_input / group->num_gop_frames) % group->num_coders);
+}
 
-    if (packet->private_data != NULL) {
-        xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
-        xl_append(&h_mgr->list_frames_free, packet->private_data);
+/* ---------------------------------------------------------------------------
+ * store pts of an input frame, used for DTS decision of output frames
+ */
+static
+int gop_group_push_pts(gop_group_t *group, int64_t pts)
+{
+    if (group->num_input - group->num_output >= group->size_pts_input) {
+        int      size_new = group->size_pts_input << 1;
+        int64_t *pts_new  = (int64_t *)xavs2_malloc(sizeof(int64_t) * size_new);
+        int64_t  i;
+
+        if (pts_new == NULL) {
+            return -1;
+        }
+        for (i = group->num_output; i < group->num_input; i++) {
+            pts_new[i & (size_new - 1)] = group->pts_input[i & (group->size_pts_input - 1)];
+        }
+        xavs2_free(group->pts_input);
+        group->pts_input      = pts_new;
+        group->size_pts_input = size_new;
     }
 
+    group->pts_input[group->num_input & (group->size_pts_input - 1)] = pts;
     return 0;
 }
 
-/**
- * ---------------------------------------------------------------------------
+/* ---------------------------------------------------------------------------
+ * decide DTS of the next output frame, the same as decide_frame_dts() does
+ * for one encoder, since frames are output in the coding order of one encoder
+ */
+static
+int64_t gop_group_decide_dts(gop_group_t *group)
+{
+    int     num_bframes_delay = group->coders[0]->p_coder->picture_reorder_delay;
+    int64_t reordered_pts     = group->pts_input[group->num_output & (group->size_pts_input - 1)];
+    int64_t dts;
+
+    if (num_bframes_delay) {
+        int idx = (int)(group->num_output % num_bframes_delay);
+        if (group->num_output > num_bframes_delay) {
+            dts = group->prev_reordered_pts_set[idx];
+        } else {
+            dts = reordered_pts - num_bframes_delay;
+        }
+        group->prev_reordered_pts_set[idx] = reordered_pts;
+    } else {
+        dts = reordered_pts;
+    }
+
+    return dts;
+}
+
+/* ---------------------------------------------------------------------------
+ * buffer the packet output by one encoder, then recycle its frame
+ */
+static
+int gop_group_buffer_packet(gop_group_t *group, int idx_coder, xavs2_outpacket_t *packet)
+{
+    gop_packet_t *p_packet;
+
+    if (packet->state == XAVS2_STATE_FLUSH_END) {
+        /* all frames of this encoder have been output */
+        group->b_flushed[idx_coder] = 1;
+        if (packet->len > 0) {
+            group->end_code     = packet->stream;
+            group->len_end_code = packet->len;
+        }
+        return 0;
+    }
+
+    if (packet->private_data == NULL) {
+        return 0;                     /* no frame output */
+    }
+
+    p_packet = (gop_packet_t *)xavs2_malloc(sizeof(gop_packet_t) + packet->len);
+    if (p_packet != NULL) {
+        p_packet->data = (uint8_t *)(p_packet + 1);
+        p_packet->len  = packet->len;
+        p_packet->type = packet->type;
+        p_packet->pts  = packet->pts;
+        memcpy(p_packet->data, packet->stream, packet->len);
+        xl_append(&group->list_packets[idx_coder], p_packet);
+    }
+
+    xavs2_encoder_packet_unref(group->coders[idx_coder], packet);
+    return p_packet != NULL ? 0 : -1;
+}
+
+/* ---------------------------------------------------------------------------
+ * segment parameters of each encoder, GOP i is the first segment of coders[i]
+ */
+static
+void gop_group_init_segments(gop_group_t *group)
+{
+    int i;
+
+    for (i = 0; i < group->num_coders; i++) {
+        xavs2_param_t *p = &group->params[i];
+
+        p->b_segment           = 1;
+        p->b_segment_last      = group->param.b_segment ? group->param.b_segment_last : 1;
+        p->segment_start_frame = group->param.segment_start_frame + i * group->num_gop_frames;
+        p->segment_rc_qp       = group->param.segment_rc_qp;
+        p->segment_rc_buffer   = group->param.segment_rc_buffer;
+        p->segment_refs        = group->param.segment_refs;
+        p->b_gop_continued     = i > 0;
+    }
+    memset(group->gop_refs,   0, sizeof(group->gop_refs));
+    memset(group->b_gop_refs, 0, sizeof(group->b_gop_refs));
+}
+
+/* ---------------------------------------------------------------------------
+ * phase of the GOP starting from the input frame (its COI), GOPs of the same
+ * phase use the same RPS of the configuration for each of their frames, as
+ * the RPS index is chosen in xavs2e_get_frame_rps()
+ */
+static ALWAYS_INLINE
+int gop_group_phase(gop_group_t *group, int64_t i_frame)
+{
+    if (group->param.intra_period == 1) {
+        return 0;                     /* all I frames, each with the first RPS */
+    }
+    if (!group->param.b_open_gop && group->param.successive_Bframe > 0) {
+        return 0;                     /* RPS index restarts from each I frame (COI_IDR) */
+    }
+    return (int)((group->param.segment_start_frame + i_frame) % group->param.i_gop_size);
+}
+
+/* ---------------------------------------------------------------------------
+ * encode all delayed frames of one encoder, the packets are buffered
+ */
+static
+int gop_group_flush_coder(gop_group_t *group, int idx_coder)
+{
+    xavs2_outpacket_t pkt;
+
+    while (!group->coders[idx_coder]->b_seq_end) {
+        memset(&pkt, 0, sizeof(pkt));
+        xavs2_encoder_encode(group->coders[idx_coder], NULL, &pkt);
+        if (gop_group_buffer_packet(group, idx_coder, &pkt) < 0) {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * prepare the encoder of the GOP which starts from the next input frame. the
+ * frames removed by its I frame are the ones still referenced at the end of
+ * the previous GOP, which are decided once for each GOP phase by waiting for
+ * the previous GOP, so only the first GOPs of each phase are serialized.
+ * an encoder which has encoded a GOP is flushed and reset to continue the
+ * COI and POC as the next segment, it waits for the oldest GOP in flight
+ * while the other encoders go on.
+ * the rate control is an approximation of one encoder: it continues from the
+ * state at the end of GOP (g - num_coders) encoded by the same encoder, not
+ * from GOP (g - 1), which has not been encoded yet
+ */
+static
+int gop_group_start_gop(gop_group_t *group, int idx_coder)
+{
+    xavs2_param_t  *p         = &group->params[idx_coder];
+    int64_t         i_prev    = group->num_input - group->num_gop_frames;
+    int             phase     = gop_group_phase(group, i_prev);
+    int             idx_prev  = (int)(i_prev / group->num_gop_frames % group->num_coders);
+    xavs2_segment_t segment;
+
+    if (!group->b_gop_refs[phase]) {
+        if (gop_group_flush_coder(group, idx_prev) < 0 ||
+            xavs2_encoder_segment_state(group->coders[idx_prev], &segment) < 0) {
+            return -1;
+        }
+        group->gop_refs  [phase] = segment.refs;
+        group->b_gop_refs[phase] = 1;
+    }
+
+    if (group->num_input >= (int64_t)group->num_coders * group->num_gop_frames) {
+        if (gop_group_flush_coder(group, idx_coder) < 0 ||
+            xavs2_encoder_segment_state(group->coders[idx_coder], &segment) < 0) {
+            return -1;
+        }
+        encoder_reset_flush(group->coders[idx_coder]);
+        p->segment_start_frame = group->param.segment_start_frame + (int)group->num_input;
+        p->segment_rc_qp       = segment.rc_qp;
+        p->segment_rc_buffer   = segment.rc_buffer;
+        p->segment_refs        = group->gop_refs[phase];
+        p->b_gop_continued     = 1;
+        if (encoder_reset_state(group->coders[idx_coder], 0) < 0) {
+            return -1;
+        }
+        group->b_flushed[idx_coder] = 0;
+    } else {
+        /* the first GOP of this encoder, which starts from its creation */
+        p->segment_refs = group->gop_refs[phase];
+    }
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * output the next packet in GOP order, the encoders are flushed one by one
+ * in GOP order when flushing
+ */
+static
+void gop_group_output_packet(xavs2_handler_t *h_top, xavs2_outpacket_t *packet)
+{
+    gop_group_t *group = h_top->gop_group;
+
+    packet->len          = 0;
+    packet->private_data = NULL;
+    packet->opaque       = h_top->user_data;
+
+    for (;;) {
+        int k = (int)(group->i_gop_out % group->num_coders);
+        gop_packet_t *p_packet = (gop_packet_t *)xl_remove_head(&group->list_packets[k], 0);
+        xavs2_outpacket_t pkt;
+        int i;
+
+        if (p_packet != NULL) {
+            packet->private_data = p_packet;
+            packet->stream       = p_packet->data;
+            packet->len          = p_packet->len;
+            packet->state        = XAVS2_STATE_ENCODED;
+            packet->type         = p_packet->type;
+            packet->pts          = p_packet->pts;
+            packet->dts          = gop_group_decide_dts(group);
+            group->max_out_pts   = XAVS2_MAX(group->max_out_pts, packet->pts);
+            group->max_out_dts   = XAVS2_MAX(group->max_out_dts, packet->dts);
+            group->num_output++;
+
+            /* move to the next GOP */
+            if (++group->num_gop_out == group->num_gop_frames) {
+                group->num_gop_out = 0;
+                group->i_gop_out++;
+            }
+            return;
+        }
+
+        if (!group->b_flush) {
+            return;                   /* the GOP is still being encoded */
+        }
+
+        for (i = 0; i < group->num_coders; i++) {
+            if (!group->b_flushed[i] || group->list_packets[i].i_node_num > 0) {
+                break;
+            }
+        }
+        if (i == group->num_coders) {
+            /* all frames have been output */
+            packet->stream = group->end_code;
+            packet->state  = XAVS2_STATE_FLUSH_END;
+            packet->type   = 0;
+            packet->pts    = group->max_out_pts;
+            packet->dts    = group->max_out_dts;
+            if (group->b_seq_end == 0) {
+                packet->len      = group->len_end_code;
+                group->b_seq_end = 1;
+            }
+            return;
+        }
+
+        if (group->b_flushed[k]) {
+            /* the last GOP of this encoder is shorter than others */
+            group->num_gop_out = 0;
+            group->i_gop_out++;
+            continue;
+        }
+
+        /* flush the encoder of current GOP */
+        memset(&pkt, 0, sizeof(pkt));
+        xavs2_encoder_encode(group->coders[k], NULL, &pkt);
+        gop_group_buffer_packet(group, k, &pkt);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * send one frame to the encoder of its GOP, and fetch one packet in GOP order
+ */
+static
+int gop_group_encode(xavs2_handler_t *h_top, xavs2_picture_t *pic, xavs2_outpacket_t *packet)
+{
+    gop_group_t *group = h_top->gop_group;
+
+    if (pic != NULL) {
+        int k = gop_group_input_coder(group);
+        xavs2_outpacket_t pkt;
+
+        if (pic->i_state != XAVS2_STATE_NO_DATA) {
+            if (gop_group_push_pts(group, pic->i_pts) < 0) {
+                return -1;
+            }
+            if (group->num_input > 0 && group->num_input % group->num_gop_frames == 0 &&
+                gop_group_start_gop(group, k) < 0) {
+                return -1;
+            }
+        }
+
+        memset(&pkt, 0, sizeof(pkt));
+        if (xavs2_encoder_encode(group->coders[k], pic, &pkt) < 0) {
+            return -1;
+        }
+        if (pic->i_state != XAVS2_STATE_NO_DATA) {
+            group->num_input++;
+        }
+        if (gop_group_buffer_packet(group, k, &pkt) < 0) {
+            return -1;
+        }
+    } else {
+        group->b_flush = 1;
+    }
+
+    gop_group_output_packet(h_top, packet);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * reset the encoders of GOP parallel encoding, buffered packets are dropped
+ */
+static
+int gop_group_reset(xavs2_handler_t *h_top, const xavs2_param_t *param)
+{
+    gop_group_t   *group = h_top->gop_group;
+    xavs2_param_t *p_new = NULL;
+    size_t size_params = sizeof(xavs2_param_t) * group->num_coders;
+    int b_resize = 0;
+    int i;
+
+    /* new parameters are checked before the encoders are flushed, they are
+     * applied to the parameters of each encoder, which are derived on creation,
+     * and to p_new[num_coders] of the GOP parallel encoding */
+    if (param != NULL) {
+        if ((p_new = (xavs2_param_t *)xavs2_malloc(size_params + sizeof(xavs2_param_t))) == NULL) {
+            return -1;
+        }
+        memcpy(p_new, group->params, size_params);
+        memcpy(&p_new[group->num_coders], &group->param, sizeof(xavs2_param_t));
+        for (i = 0; i <= group->num_coders; i++) {
+            if (encoder_reset_parameters(&p_new[i], param) < 0) {
+                xavs2_free(p_new);
+                return -1;
+            }
+        }
+        if (encoder_reset_check_size(group->coders[0], &p_new[group->num_coders]) < 0) {
+            xavs2_free(p_new);
+            return -1;
+        }
+        b_resize = p_new[group->num_coders].org_width  != group->param.org_width ||
+                   p_new[group->num_coders].org_height != group->param.org_height;
+    }
+
+    for (i = 0; i < group->num_coders; i++) {
+        gop_packet_t *p_packet;
+
+        encoder_reset_flush(group->coders[i]);
+        while ((p_packet = (gop_packet_t *)xl_remove_head(&group->list_packets[i], 0)) != NULL) {
+            xavs2_free(p_packet);
+        }
+        group->b_flushed[i] = 0;
+    }
+
+    if (p_new != NULL) {
+        memcpy(group->params, p_new, size_params);
+        memcpy(&group->param, &p_new[group->num_coders], sizeof(xavs2_param_t));
+        xavs2_free(p_new);
+    }
+
+    /* frames in one closed GOP, see gop_group_create() */
+    if (group->param.intra_period == 1 || group->param.successive_Bframe == 0) {
+        group->num_gop_frames = group->param.intra_period;
+    } else {
+        group->num_gop_frames = 1 + (group->param.intra_period - 1) * group->param.i_gop_size;
+    }
+
+    /* the encoders start from the first GOPs again */
+    gop_group_init_segments(group);
+    for (i = 0; i < group->num_coders; i++) {
+        if (encoder_reset_state(group->coders[i], b_resize) < 0) {
+            return -1;
+        }
+    }
+
+    group->num_input   = 0;
+    group->num_output  = 0;
+    group->i_gop_out   = 0;
+    group->num_gop_out = 0;
+    group->b_flush     = 0;
+    group->b_seq_end   = 0;
+    group->max_out_pts = 0;
+    group->max_out_dts = 0;
+    memset(group->prev_reordered_pts_set, 0, sizeof(group->prev_reordered_pts_set));
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * destroy the encoders of GOP parallel encoding
+ */
+static
+void gop_group_destroy(xavs2_handler_t *h_top)
+{
+    gop_group_t *group = h_top->gop_group;
+    int i;
+
+    for (i = 0; i < group->num_coders; i++) {
+        gop_packet_t *p_packet;
+
+        if (group->coders[i] != NULL) {
+            xavs2_encoder_destroy(group->coders[i]);
+        }
+        while ((p_packet = (gop_packet_t *)xl_remove_head(&group->list_packets[i], 0)) != NULL) {
+            xavs2_free(p_packet);
+        }
+        xl_destroy(&group->list_packets[i]);
+    }
+
+    xavs2_log(h_top, XAVS2_LOG_DEBUG, "Encoded %lld frames in %d parallel GOPs, %.3f secs\n",
+              (long long)group->num_input, group->num_coders,
+              0.000001 * (xavs2_mdate() - h_top->create_time));
+
+    xavs2_free(group->pts_input);
+    if (h_top->affinity != NULL) {
+        xavs2_affinity_destroy(h_top->affinity);
+    }
+    memset(h_top, 0, sizeof(xavs2_handler_t));
+    xavs2_free(h_top);
+}
+
+/* ---------------------------------------------------------------------------
+ * create one encoder for each of the parallel GOPs
+ */
+static
+xavs2_handler_t *gop_group_create(xavs2_param_t *param)
+{
+    xavs2_handler_t *h_top = NULL;
+    gop_group_t     *group = NULL;
+    int i;
+
+    CHECKED_MALLOC(h_top, xavs2_handler_t *, sizeof(xavs2_handler_t) + sizeof(gop_group_t));
+    memset(h_top, 0, sizeof(xavs2_handler_t) + sizeof(gop_group_t));
+    group = (gop_group_t *)(h_top + 1);
+    h_top->gop_group   = group;
+    h_top->create_time = xavs2_mdate();
+    h_top->module_log.i_log_level = param->i_log_level;
+    sprintf(h_top->module_log.module_name, "GOP Manager %06llx", (unsigned long long)(intptr_t)(h_top));
+
+    memcpy(&group->param, param, sizeof(xavs2_param_t));
+#if XAVS2_DUMP_REC
+    if (strlen(param->psz_dump_yuv) > 0) {
+        xavs2_log(h_top, XAVS2_LOG_WARNING, "Reconstruction file disabled since GOP parallel encoding is enabled\n");
+        group->param.psz_dump_yuv[0] = '\0';
+    }
+#endif
+
+    /* all threads of the encoders are pinned in turn */
+    h_top->affinity = &h_top->cpu_affinity;
+    if (xavs2_affinity_init(h_top->affinity, param->thread_affinity, param->psz_affinity_cpus) < 0) {
+        goto fail;
+    }
+
+    /* frames in one closed GOP, see slice_type_analyse() */
+    group->num_coders = param->num_parallel_gop;
+    if (param->intra_period == 1 || param->successive_Bframe == 0) {
+        group->num_gop_frames = param->intra_period;
+    } else {
+        group->num_gop_frames = 1 + (param->intra_period - 1) * param->i_gop_size;
+    }
+
+    group->size_pts_input = 64;
+    CHECKED_MALLOC(group->pts_input, int64_t *, sizeof(int64_t) * group->size_pts_input);
+
+    for (i = 0; i < group->num_coders; i++) {
+        if (xl_init(&group->list_packets[i]) != 0) {
+            goto fail;
+        }
+    }
+
+    for (i = 0; i < group->num_coders; i++) {
+        memcpy(&group->params[i], &group->param, sizeof(xavs2_param_t));
+    }
+    gop_group_init_segments(group);
+    for (i = 0; i < group->num_coders; i++) {
+        if ((group->coders[i] = encoder_create_handler(&group->params[i], h_top->affinity)) == NULL) {
+            goto fail;
+        }
+    }
+
+    xavs2_log(h_top, XAVS2_LOG_INFO, "GOP parallel encoding: %d encoders, %d frames in one GOP\n",
+              group->num_coders, group->num_gop_frames);
+
+    return h_top;
+
+fail:
+    if (h_top != NULL) {
+        gop_group_destroy(h_top);
+    }
+
+    return NULL;
+}
+
+/**
+ * ===========================================================================
+ * ladder encoding (num_ladder > 0)
+ *   the source is input once, and scaled to each lower rendition, which reuses
+ *   the analysis of the top rendition (CU levels and MVs); all renditions have
+ *   the same frame types since they share the GOP parameters
+ * ===========================================================================
+ */
+
+/* ---------------------------------------------------------------------------
+ * parameters of one rendition, derived from the ones of the top rendition
+ */
+static
+void ladder_group_rendition_param(const xavs2_param_t *param, int idx, xavs2_param_t *p)
+{
+    memcpy(p, param, sizeof(xavs2_param_t));
+    p->i_rendition = idx;
+
+    if (idx > 0) {
+        int64_t area_top = (int64_t)param->org_width * param->org_height;
+        int64_t area     = (int64_t)param->ladder_width[idx] * param->ladder_height[idx];
+
+        p->num_ladder = 0;
+        p->org_width  = param->ladder_width[idx];
+        p->org_height = param->ladder_height[idx];
+        if (param->ladder_bitrate[idx] > 0) {
+            p->i_target_bitrate = param->ladder_bitrate[idx];
+        } else {
+            p->i_target_bitrate = (int)(param->i_target_bitrate * area / area_top);
+        }
+
+        /* MVs of the top rendition are refined, a window of the scaled size is enough */
+        p->search_range = XAVS2_MAX(16, param->search_range * p->org_width / param->org_width);
+#if XAVS2_DUMP_REC
+        p->psz_dump_yuv[0] = '\0';
+#endif
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * buffer the packet output by the encoder of one rendition, then recycle its frame
+ */
+static
+int ladder_group_buffer_packet(ladder_group_t *group, int idx_coder, xavs2_outpacket_t *packet)
+{
+    gop_packet_t *p_packet;
+
+    if (packet->state == XAVS2_STATE_FLUSH_END) {
+        /* all frames of this rendition have been output */
+        group->b_flushed[idx_coder] = 1;
+        if (packet->len > 0) {
+            group->end_code[idx_coder]     = packet->stream;
+            group->len_end_code[idx_coder] = packet->len;
+        }
+        return 0;
+    }
+
+    if (packet->private_data == NULL) {
+        return 0;                     /* no frame output */
+    }
+
+    p_packet = (gop_packet_t *)xavs2_malloc(sizeof(gop_packet_t) + packet->len);
+    if (p_packet != NULL) {
+        p_packet->data = (uint8_t *)(p_packet + 1);
+        p_packet->len  = packet->len;
+        p_packet->type = packet->type;
+        p_packet->pts  = packet->pts;
+        p_packet->dts  = packet->dts;
+        memcpy(p_packet->data, packet->stream, packet->len);
+        xl_append(&group->list_packets[idx_coder], p_packet);
+    }
+
+    xavs2_encoder_packet_unref(group->coders[idx_coder], packet);
+    return p_packet != NULL ? 0 : -1;
+}
+
+/* ---------------------------------------------------------------------------
+ * output the next packet of one rendition, the stream end of the top rendition
+ * is output after all renditions are flushed
+ */
+static
+void ladder_group_output_packet(xavs2_handler_t *h_top, int idx_coder, xavs2_outpacket_t *packet)
+{
+    ladder_group_t *group = h_top->ladder_group;
+    gop_packet_t *p_packet = (gop_packet_t *)xl_remove_head(&group->list_packets[idx_coder], 0);
+    int b_end = group->b_flushed[idx_coder];
+    int i;
+
+    packet->len          = 0;
+    packet->private_data = NULL;
+    packet->opaque       = h_top->user_data;
+
+    if (p_packet != NULL) {
+        packet->private_data = p_packet;
+        packet->stream       = p_packet->data;
+        packet->len          = p_packet->len;
+        packet->state        = XAVS2_STATE_ENCODED;
+        packet->type         = p_packet->type;
+        packet->pts          = p_packet->pts;
+        packet->dts          = p_packet->dts;
+        group->max_out_pts   = XAVS2_MAX(group->max_out_pts, packet->pts);
+        group->max_out_dts   = XAVS2_MAX(group->max_out_dts, packet->dts);
+        return;
+    }
+
+    if (idx_coder == 0) {
+        for (i = 1; i < group->num_coders; i++) {
+            b_end &= group->b_flushed[i];
+        }
+    }
+
+    if (b_end) {
+        packet->stream = group->end_code[idx_coder];
+        packet->state  = XAVS2_STATE_FLUSH_END;
+        packet->type   = 0;
+        packet->pts    = group->max_out_pts;
+        packet->dts    = group->max_out_dts;
+        if (group->b_seq_end[idx_coder] == 0) {
+            packet->len = group->len_end_code[idx_coder];
+            group->b_seq_end[idx_coder] = 1;
+        }
+    } else {
+        packet->state  = XAVS2_STATE_NO_DATA;
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * return the source buffers of lower renditions [k_begin, k_end), which have
+ * not been sent to their encoders
+ */
+static
+void ladder_group_release_buffers(ladder_group_t *group, xavs2_picture_t *pic_lower, int k_begin, int k_end)
+{
+    xavs2_outpacket_t pkt;
+    int k;
+
+    for (k = k_begin; k < k_end; k++) {
+        memset(&pkt, 0, sizeof(pkt));
+        pic_lower[k].i_state = XAVS2_STATE_NO_DATA;
+        xavs2_encoder_encode(group->coders[k], &pic_lower[k], &pkt);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * encode one frame for all renditions, and output a packet of the top rendition
+ */
+static
+int ladder_group_encode(xavs2_handler_t *h_top, xavs2_picture_t *pic, xavs2_outpacket_t *packet)
+{
+    ladder_group_t *group = h_top->ladder_group;
+    xavs2_outpacket_t pkt;
+    int k;
+
+    if (pic != NULL) {
+        xavs2_picture_t pic_lower[MAX_LADDER_RENDITIONS];
+
+        /* scale the source before it can be recycled by the top rendition */
+        if (pic->i_state != XAVS2_STATE_NO_DATA) {
+            for (k = 1; k < group->num_coders; k++) {
+                if (xavs2_encoder_get_buffer(group->coders[k], &pic_lower[k]) < 0) {
+                    ladder_group_release_buffers(group, pic_lower, 1, k);
+                    return -1;
+                }
+                ladder_scale_picture(group->ladder, &pic->img, &pic_lower[k].img);
+                pic_lower[k].i_state    = pic->i_state;
+                pic_lower[k].i_type     = pic->i_type;
+                pic_lower[k].i_qpplus1  = pic->i_qpplus1;
+                pic_lower[k].b_keyframe = pic->b_keyframe;
+                pic_lower[k].i_pts      = pic->i_pts;
+            }
+        }
+
+        /* the top rendition goes first, since the others wait for its analysis */
+        memset(&pkt, 0, sizeof(pkt));
+        if (xavs2_encoder_encode(group->coders[0], pic, &pkt) < 0 ||
+            ladder_group_buffer_packet(group, 0, &pkt) < 0) {
+            if (pic->i_state != XAVS2_STATE_NO_DATA) {
+                ladder_group_release_buffers(group, pic_lower, 1, group->num_coders);
+            }
+            return -1;
+        }
+
+        if (pic->i_state != XAVS2_STATE_NO_DATA) {
+            for (k = 1; k < group->num_coders; k++) {
+                memset(&pkt, 0, sizeof(pkt));
+                if (xavs2_encoder_encode(group->coders[k], &pic_lower[k], &pkt) < 0 ||
+                    ladder_group_buffer_packet(group, k, &pkt) < 0) {
+                    ladder_group_release_buffers(group, pic_lower, k + 1, group->num_coders);
+                    return -1;
+                }
+            }
+        }
+    } else {
+        group->b_flush = 1;
+        for (k = 0; k < group->num_coders; k++) {
+            if (!group->b_flushed[k]) {
+                memset(&pkt, 0, sizeof(pkt));
+                xavs2_encoder_encode(group->coders[k], NULL, &pkt);
+                ladder_group_buffer_packet(group, k, &pkt);
+            }
+        }
+    }
+
+    ladder_group_output_packet(h_top, 0, packet);
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * reset the encoders of all renditions, buffered packets are dropped. the
+ * bitrates of lower renditions are derived from the new top one as on creation
+ */
+static
+int ladder_group_reset(xavs2_handler_t *h_top, const xavs2_param_t *param)
+{
+    ladder_group_t *group = h_top->ladder_group;
+    xavs2_param_t  *p_new = NULL;
+    size_t size_params = sizeof(xavs2_param_t) * group->num_coders;
+    int i;
+
+    /* new parameters of all renditions are checked before the encoders are flushed,
+     * p_new[num_coders] holds the parameters derived for one lower rendition */
+    if (param != NULL) {
+        if ((p_new = (xavs2_param_t *)xavs2_malloc(size_params + sizeof(xavs2_param_t))) == NULL) {
+            return -1;
+        }
+        memcpy(p_new, group->params, size_params);
+        if (encoder_reset_parameters(&p_new[0], param) < 0) {
+            xavs2_free(p_new);
+            return -1;
+        }
+        for (i = 1; i < group->num_coders; i++) {
+            xavs2_param_t *p_lower = &p_new[group->num_coders];
+
+            ladder_group_rendition_param(&p_new[0], i, p_lower);
+            p_lower->intra_period = param->intra_period;  /* not doubled for field coding yet */
+            if (encoder_reset_parameters(&p_new[i], p_lower) < 0) {
+                xavs2_log(h_top, XAVS2_LOG_ERROR, "error parameters of rendition %d\n", i);
+                xavs2_free(p_new);
+                return -1;
+            }
+        }
+    }
+
+    /* the top rendition is flushed first, since the others wait for its analysis */
+    for (i = 0; i < group->num_coders; i++) {
+        gop_packet_t *p_packet;
+
+        encoder_reset_flush(group->coders[i]);
+        while ((p_packet = (gop_packet_t *)xl_remove_head(&group->list_packets[i], 0)) != NULL) {
+            xavs2_free(p_packet);
+        }
+        group->b_flushed[i] = 0;
+        group->b_seq_end[i] = 0;
+    }
+
+    if (p_new != NULL) {
+        memcpy(group->params, p_new, size_params);
+        xavs2_free(p_new);
+    }
+
+    for (i = 0; i < group->num_coders; i++) {
+        if (encoder_reset_state(group->coders[i], 0) < 0) {
+            return -1;
+        }
+    }
+    ladder_reset(group->ladder);
+
+    group->b_flush     = 0;
+    group->max_out_pts = 0;
+    group->max_out_dts = 0;
+
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * destroy the encoders of all renditions
+ */
+static
+void ladder_group_destroy(xavs2_handler_t *h_top)
+{
+    ladder_group_t *group = h_top->ladder_group;
+    int i;
+
+    if (group->ladder != NULL) {
+        ladder_exit(group->ladder);
+    }
+
+    for (i = 0; i < group->num_coders; i++) {
+        gop_packet_t *p_packet;
+
+        if (group->coders[i] != NULL) {
+            xavs2_encoder_destroy(group->coders[i]);
+        }
+        while ((p_packet = (gop_packet_t *)xl_remove_head(&group->list_packets[i], 0)) != NULL) {
+            xavs2_free(p_packet);
+        }
+        xl_destroy(&group->list_packets[i]);
+    }
+
+    if (group->ladder != NULL) {
+        ladder_destroy(group->ladder);
+    }
+
+    xavs2_log(h_top, XAVS2_LOG_DEBUG, "Encoded %d renditions, %.3f secs\n",
+              group->num_coders, 0.000001 * (xavs2_mdate() - h_top->create_time));
+
+    if (h_top->affinity != NULL) {
+        xavs2_affinity_destroy(h_top->affinity);
+    }
+    memset(h_top, 0, sizeof(xavs2_handler_t));
+    xavs2_free(h_top);
+}
+
+/* ---------------------------------------------------------------------------
+ * create one encoder for each rendition
+ */
+static
+xavs2_handler_t *ladder_group_create(xavs2_param_t *param)
+{
+    xavs2_handler_t *h_top = NULL;
+    ladder_group_t  *group = NULL;
+    int i;
+
+    CHECKED_MALLOC(h_top, xavs2_handler_t *, sizeof(xavs2_handler_t) + sizeof(ladder_group_t));
+    memset(h_top, 0, sizeof(xavs2_handler_t) + sizeof(ladder_group_t));
+    group = (ladder_group_t *)(h_top + 1);
+    h_top->ladder_group = group;
+    h_top->create_time  = xavs2_mdate();
+    h_top->module_log.i_log_level = param->i_log_level;
+    sprintf(h_top->module_log.module_name, "Ladder %06llx", (unsigned long long)(intptr_t)(h_top));
+
+    group->num_coders = param->num_ladder + 1;
+
+    /* all threads of the encoders are pinned in turn */
+    h_top->affinity = &h_top->cpu_affinity;
+    if (xavs2_affinity_init(h_top->affinity, param->thread_affinity, param->psz_affinity_cpus) < 0) {
+        goto fail;
+    }
+
+    for (i = 0; i < group->num_coders; i++) {
+        if (xl_init(&group->list_packets[i]) != 0) {
+            goto fail;
+        }
+    }
+
+    if ((group->ladder = ladder_create(param)) == NULL) {
+        goto fail;
+    }
+
+    for (i = 0; i < group->num_coders; i++) {
+        xavs2_param_t *p = &group->params[i];
+
+        ladder_group_rendition_param(param, i, p);
+        if (i > 0 && encoder_check_parameters(p) < 0) {
+            xavs2_log(h_top, XAVS2_LOG_ERROR, "error parameters of rendition %d\n", i);
+            goto fail;
+        }
+        if ((group->coders[i] = encoder_create_handler(p, h_top->affinity)) == NULL) {
+            goto fail;
+        }
+        group->coders[i]->ladder = group->ladder;
+    }
+
+    for (i = 0; i < group->num_coders; i++) {
+        xavs2_log(h_top, XAVS2_LOG_INFO, "Ladder rendition %d: %dx%d, %d bps\n", i,
+                  group->params[i].org_width, group->params[i].org_height, group->params[i].i_target_bitrate);
+    }
+
+    return h_top;
+
+fail:
+    if (h_top != NULL) {
+        ladder_group_destroy(h_top);
+    }
+
+    return NULL;
+}
+
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : create and initialize the xavs2 video encoder
+ * Parameters :
+ *      [in ] : param     - pointer to struct xavs2_param_t
+ *      [out] : handle of xavs2 encoder wrapper
+ * Return     : handle of xavs2 encoder wrapper, none zero for success, otherwise false
+ * ---------------------------------------------------------------------------
+ */
+void *xavs2_encoder_create(xavs2_param_t *param)
+{
+    if (param == NULL) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Null input parameters for encoder creation\n");
+        return NULL;
+    }
+
+    /* confirm the input parameters (log_level)  */
+    if (param->i_log_level < XAVS2_LOG_NONE ||
+        param->i_log_level > XAVS2_LOG_DEBUG) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "Invalid parameter: log_level %d\n",
+                  param->i_log_level);
+        return NULL;
+    }
+    g_xavs2_default_log.i_log_level = param->i_log_level;
+
+    /* init all function handlers */
+    memset(&g_funcs, 0, sizeof(g_funcs));
+#if HAVE_MMX
+    g_funcs.cpuid = xavs2_cpu_detect();
+#endif
+    xavs2_init_all_primitives(param, &g_funcs);
+
+    /* check parameters */
+    if (encoder_check_parameters(param) < 0) {
+        xavs2_log(NULL, XAVS2_LOG_ERROR, "error encoder parameters\n");
+        return NULL;
+    }
+
+    if (param->num_ladder > 0) {
+        return ladder_group_create(param);
+    } else if (param->num_parallel_gop > 1) {
+        return gop_group_create(param);
+    } else {
+        return encoder_create_handler(param, NULL);
+    }
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : destroy the xavs2 video encoder
+ * Parameters :
+ *      [in ] : coder - pointer to wrapper of the xavs2 encoder
+ *      [out] : none
+ * Return     : none
+ * ---------------------------------------------------------------------------
+ */
+void xavs2_encoder_destroy(void *coder)
+{
+    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+    xavs2_frame_t frm_flush = { 0 };
+    xavs2_frame_t frm_exit  = { 0 };
+
+    if (h_mgr->gop_group != NULL) {
+        gop_group_destroy(h_mgr);
+        return;
+    }
+    if (h_mgr->ladder_group != NULL) {
+        ladder_group_destroy(h_mgr);
+        return;
+    }
+
+    /* destroy all threads: lookahead and wrapper threads */
+    if (h_mgr->p_coder != NULL) {
+        frm_flush.i_state = XAVS2_FLUSH;        /* signal to flush encoder */
+        frm_exit.i_state  = XAVS2_EXIT_THREAD;  /* signal to exit */
+        send_frame_to_enc_queue(h_mgr, &frm_flush);
+        send_frame_to_enc_queue(h_mgr, &frm_exit);
+
+        /* wait until the RDO process exit, then memory can be released */
+        xavs2_thread_join(h_mgr->thread_wrapper, NULL);
+    }
+
+    /* close the encoder */
+    encoder_close(h_mgr);
+
+    xavs2_log(h_mgr, XAVS2_LOG_DEBUG, "Encoded %d frames, %.3f secs\n",
+              h_mgr->num_input, 0.000001 * (xavs2_mdate() - h_mgr->create_time));
+
+    if (h_mgr->fp_trace) {
+        fclose(h_mgr->fp_trace);
+    }
+
+    if (h_mgr->affinity == &h_mgr->cpu_affinity) {
+        xavs2_affinity_destroy(h_mgr->affinity);
+    }
+
+    /* free memory of encoder wrapper */
+    memset(h_mgr, 0, sizeof(xavs2_handler_t));
+    xavs2_free(h_mgr);
+
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get buffer for the encoder caller
+ * Parameters :
+ *      [in ] : coder - pointer to wrapper of the xavs2 encoder
+ *            : pic   - pointer to struct xavs2_picture_t
+ *      [out] : pic   - memory would be allocated for the image planes
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_get_buffer(void *coder, xavs2_picture_t *pic)
+{
+    xavs2_handler_t *h_mgr   = (xavs2_handler_t *)coder;
+    const xavs2_param_t *param;
+    xavs2_frame_t   *frame;
+
+    assert(h_mgr != NULL && pic != NULL);
+    if (h_mgr == NULL || pic == NULL) {
+        return -1;
+    }
+
+    if (h_mgr->gop_group != NULL) {
+        /* the buffer is provided by the encoder of current input GOP */
+        gop_group_t *group = h_mgr->gop_group;
+        return xavs2_encoder_get_buffer(group->coders[gop_group_input_coder(group)], pic);
+    }
+    if (h_mgr->ladder_group != NULL) {
+        /* the source is input to the top rendition */
+        return xavs2_encoder_get_buffer(h_mgr->ladder_group->coders[0], pic);
+    }
+    param = h_mgr->p_coder->param;
+
+    memset(pic, 0, sizeof(xavs2_picture_t));
+
+    /* fetch an empty node from unused list */
+    frame = frame_buffer_get_free_frame_ipb(h_mgr);
+
+    /* set properties */
+    pic->img.in_sample_size  = param->input_sample_bit_depth == 8 ? 1 : 2;
+    pic->img.enc_sample_size = sizeof(pel_t);
+    pic->img.i_width[0]      = param->org_width;
+    pic->img.i_width[1]      = param->org_width >> 1;
+    pic->img.i_width[2]      = param->org_width >> 1;
+    pic->img.i_lines[0]      = param->org_height;
+    pic->img.i_lines[1]      = param->org_height >> (param->chroma_format <= CHROMA_420 ? 1 : 0);
+    pic->img.i_lines[2]      = param->org_height >> (param->chroma_format <= CHROMA_420 ? 1 : 0);
+    pic->img.i_csp           = XAVS2_CSP_I420;
+    pic->img.i_plane         = frame->i_plane;
+    pic->img.i_stride[0]     = frame->i_stride[0] * sizeof(pel_t);
+    pic->img.i_stride[1]     = frame->i_stride[1] * sizeof(pel_t);
+    pic->img.i_stride[2]     = frame->i_stride[2] * sizeof(pel_t);
+    pic->img.img_planes[0]   = (uint8_t *)frame->planes[0];
+    pic->img.img_planes[1]   = (uint8_t *)frame->planes[1];
+    pic->img.img_planes[2]   = (uint8_t *)frame->planes[2];
+    pic->priv                = frame;   /* keep trace of this frame */
+
+    return 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : label a packet to be recycled
+ * Parameters :
+ *      [in ] : coder    - pointer to handle of xavs2 encoder (return by `encoder_create()`)
+ *            : packet   - pointer to struct xavs2_outpacket_t, whose bit-stream buffer would be recycled
+ *      [out] : none
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_packet_unref(void *coder, xavs2_outpacket_t *packet)
+{
+    if (coder == NULL || packet == NULL) {
+        return 0;
+    }
+
+    if (packet->private_data != NULL) {
+        xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+        if (h_mgr->gop_group != NULL || h_mgr->ladder_group != NULL) {
+            xavs2_free(packet->private_data);     /* buffered packet of GOP parallel or ladder encoding */
+        } else {
+            xl_append(&h_mgr->list_frames_free, packet->private_data);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
  * Function   : write (send) data to the xavs2 encoder
  * Parameters :
  *      [in ] : coder - pointer to wrapper of the xavs2 encoder
@@ -594,6 +1948,13 @@ int xavs2_encoder_encode(void *coder, xavs2_picture_t *pic, xavs2_outpacket_t *p
 
     assert(h_mgr != NULL);
 
+    if (h_mgr->gop_group != NULL) {
+        return gop_group_encode(h_mgr, pic, packet);
+    }
+    if (h_mgr->ladder_group != NULL) {
+        return ladder_group_encode(h_mgr, pic, packet);
+    }
+
     if (pic != NULL) {
         xavs2_t *h = NULL;
 
@@ -650,3 +2011,389 @@ int xavs2_encoder_encode(void *coder, xavs2_picture_t *pic, xavs2_outpacket_t *p
 
     return 0;
 }
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : estimate the memory usage of an encoder before its creation
+ * Parameters :
+ *      [in ] : param - pointer to struct xavs2_param_t
+ *      [out] : stat  - projected bytes of each category
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_mem_estimate(const xavs2_param_t *param, xavs2_mem_stat_t *stat)
+{
+    xavs2_param_t *p_param;
+    int num_frm_threads, num_row_threads;
+
+    if (param == NULL || stat == NULL) {
+        return -1;
+    }
+
+    /* check a copy, since the parameters would be modified */
+    if ((p_param = (xavs2_param_t *)xavs2_malloc(sizeof(xavs2_param_t))) == NULL) {
+        return -1;
+    }
+    memcpy(p_param, param, sizeof(xavs2_param_t));
+
+    if (encoder_check_parameters(p_param) < 0) {
+        xavs2_free(p_param);
+        return -1;
+    }
+
+    encoder_decide_threads(p_param, &num_frm_threads, &num_row_threads);
+    encoder_mem_project(p_param, num_frm_threads, num_row_threads, stat);
+
+    /* one encoder for each of the parallel GOPs */
+    if (p_param->num_parallel_gop > 1) {
+        int i;
+        for (i = 0; i < XAVS2_MEMCAT_NUM; i++) {
+            stat->size[i] *= p_param->num_parallel_gop;
+        }
+        stat->total *= p_param->num_parallel_gop;
+    }
+
+    /* one encoder for each lower rendition */
+    if (p_param->num_ladder > 0) {
+        xavs2_param_t   *p_lower;
+        xavs2_mem_stat_t stat_lower;
+        int i, k;
+
+        if ((p_lower = (xavs2_param_t *)xavs2_malloc(sizeof(xavs2_param_t))) == NULL) {
+            xavs2_free(p_param);
+            return -1;
+        }
+        for (k = 1; k <= p_param->num_ladder; k++) {
+            ladder_group_rendition_param(p_param, k, p_lower);
+            if (encoder_check_parameters(p_lower) < 0) {
+                xavs2_free(p_lower);
+                xavs2_free(p_param);
+                return -1;
+            }
+            encoder_decide_threads(p_lower, &num_frm_threads, &num_row_threads);
+            encoder_mem_project(p_lower, num_frm_threads, num_row_threads, &stat_lower);
+            for (i = 0; i < XAVS2_MEMCAT_NUM; i++) {
+                stat->size[i] += stat_lower.size[i];
+            }
+            stat->total += stat_lower.total;
+        }
+        xavs2_free(p_lower);
+    }
+
+    xavs2_free(p_param);
+    return 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get the memory allocated by an encoder
+ * Parameters :
+ *      [in ] : coder - pointer to wrapper of the xavs2 encoder
+ *      [out] : stat  - allocated bytes of each category
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_mem_usage(void *coder, xavs2_mem_stat_t *stat)
+{
+    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+
+    if (h_mgr == NULL || stat == NULL) {
+        return -1;
+    }
+
+    if (h_mgr->gop_group != NULL) {
+        /* sum of all encoders of the parallel GOPs */
+        gop_group_t *group = h_mgr->gop_group;
+        encoder_mem_sum(group->coders, group->num_coders, stat);
+        return 0;
+    }
+
+    if (h_mgr->ladder_group != NULL) {
+        /* sum of the encoders of all renditions */
+        ladder_group_t *group = h_mgr->ladder_group;
+        encoder_mem_sum(group->coders, group->num_coders, stat);
+        return 0;
+    }
+
+    encoder_mem_sum(&h_mgr, 1, stat);
+    return 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get the state to be handed over to the next segment
+ * Parameters :
+ *      [in ] : coder   - pointer to wrapper of the xavs2 encoder
+ *      [out] : segment - parameters of the next segment
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_segment_state(void *coder, xavs2_segment_t *segment)
+{
+    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+    int i;
+
+    if (h_mgr == NULL || segment == NULL) {
+        return -1;
+    }
+
+    if (h_mgr->ladder_group != NULL) {
+        /* state of the top rendition */
+        h_mgr = h_mgr->ladder_group->coders[0];
+    }
+
+    if (h_mgr->gop_group != NULL) {
+        /* the rate control of the encoder which encoded the last GOP */
+        gop_group_t *group = h_mgr->gop_group;
+        int idx_last = (int)((XAVS2_MAX(group->num_input, 1) - 1) / group->num_gop_frames % group->num_coders);
+
+        segment->start_frame = group->param.segment_start_frame + (int)group->num_input;
+        h_mgr = group->coders[idx_last];
+    } else {
+        segment->start_frame = h_mgr->ipb.COI;
+    }
+
+    /* frames still referenced, which are removed by the first I frame of the next segment.
+     * all-intra streams use the RPS of the GOP for every frame, whose removal list
+     * refers to the previous frame although it is not referenced */
+    segment->refs = 0;
+    for (i = 0; i < h_mgr->dpb.num_frames; i++) {
+        xavs2_frame_t *frame = h_mgr->dpb.frames[i];
+        int k;
+
+        if (frame == NULL || frame->i_frm_coi < 0 || frame->removed != 0 ||
+            (frame->rps.referd_by_others != 1 && h_mgr->p_coder->param->intra_period != 1)) {
+            continue;
+        }
+        for (k = 0; k < h_mgr->dpb.num_frames_to_remove; k++) {
+            if (h_mgr->dpb.coi_remove_frame[k] == frame->i_frm_coi) {
+                break;            /* to be removed before the next frame */
+            }
+        }
+        k = (k < h_mgr->dpb.num_frames_to_remove) ? 0 : segment->start_frame - frame->i_frm_coi;
+        if (k > 0 && k < 32) {
+            segment->refs |= 1 << (k - 1);
+        }
+    }
+
+    xavs2_rc_get_segment_state(h_mgr->rate_control, &segment->rc_qp, &segment->rc_buffer);
+    if (h_mgr->p_coder->param->i_rc_method == XAVS2_RC_CQP) {
+        segment->rc_qp     = 0;       /* no rate control */
+        segment->rc_buffer = 0;
+    }
+
+    return 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : fetch a packet of a lower rendition in ladder encoding
+ * Parameters :
+ *      [in ] : coder     - pointer to wrapper of the xavs2 encoder
+ *            : rendition - index of the lower rendition, 1 ~ num_ladder
+ *      [out] : packet    - output bit-stream
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_ladder_fetch(void *coder, int rendition, xavs2_outpacket_t *packet)
+{
+    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+
+    if (h_mgr == NULL || packet == NULL || h_mgr->ladder_group == NULL ||
+        rendition < 1 || rendition >= h_mgr->ladder_group->num_coders) {
+        return -1;
+    }
+
+    ladder_group_output_packet(h_mgr, rendition, packet);
+    return 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : get the complexity of frames input but not output yet
+ * Parameters :
+ *      [in ] : coder   - pointer to wrapper of the xavs2 encoder
+ *            : max_num - max number of frames in stats
+ *      [out] : stats   - complexity of the frames, in input order
+ * Return     : number of frames, negative for failure
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_lookahead_stats(void *coder, xavs2_frame_stat_t *stats, int max_num)
+{
+    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+    xavs2_handler_t *coders[MAX_PARALLEL_GOPS];
+    int num_coders = 1;
+    int num_stats  = 0;
+    int i, k;
+
+    if (h_mgr == NULL || (stats == NULL && max_num > 0)) {
+        return -1;
+    }
+
+    if (h_mgr->ladder_group != NULL) {
+        /* lookahead of the top rendition */
+        h_mgr = h_mgr->ladder_group->coders[0];
+    }
+
+    coders[0] = h_mgr;
+    if (h_mgr->gop_group != NULL) {
+        num_coders = h_mgr->gop_group->num_coders;
+        memcpy(coders, h_mgr->gop_group->coders, num_coders * sizeof(xavs2_handler_t *));
+    }
+
+    if (!coders[0]->p_coder->param->enable_lookahead_stats) {
+        xavs2_log(h_mgr, XAVS2_LOG_ERROR, "Lookahead statistics are not enabled (LookaheadStats)\n");
+        return -1;
+    }
+
+    for (k = 0; k < num_coders; k++) {
+        lookahead_t *lookahead = &coders[k]->lookahead;
+
+        for (i = 0; i < lookahead->num_queued && num_stats < max_num; i++) {
+            xavs2_frame_t      *frm    = lookahead->queued[i];
+            const complex_t    *p_cplx = &frm->frm_complex;
+            xavs2_frame_stat_t *p_stat = &stats[num_stats++];
+            int j;
+
+            p_stat->pts          = frm->i_pts;
+            p_stat->type         = frm->i_frm_type;
+            p_stat->intra_cost   = p_cplx->i_intra_cost;
+            p_stat->inter_cost   = p_cplx->i_inter_cost;
+            p_stat->best_cost    = p_cplx->i_best_cost;
+            p_stat->intra_blocks = p_cplx->i_sum_intras;
+            p_stat->num_blocks   = p_cplx->i_sum_blocks;
+            p_stat->scene_score  = p_cplx->i_intra_cost > 0 ? XAVS2_MIN(1.0, (double)p_cplx->i_inter_cost / p_cplx->i_intra_cost) : 0;
+
+            /* the GOPs encoded in parallel are merged in input order */
+            for (j = num_stats - 1; j > 0 && stats[j - 1].pts > stats[j].pts; j--) {
+                xavs2_frame_stat_t tmp = stats[j - 1];
+                stats[j - 1] = stats[j];
+                stats[j]     = tmp;
+            }
+        }
+    }
+
+    return num_stats;
+}
+
+/* ---------------------------------------------------------------------------
+ * apply a checked target bitrate to one encoder
+ */
+static
+void encoder_apply_bitrate(xavs2_handler_t *h_mgr, int bitrate)
+{
+    xavs2_param_t *param = (xavs2_param_t *)h_mgr->p_coder->param;
+
+    param->i_target_bitrate = bitrate;
+    xavs2_rc_set_bitrate(h_mgr->rate_control, param, bitrate);
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : change the target bitrate of a running encoder
+ * Parameters :
+ *      [in ] : coder   - pointer to wrapper of the xavs2 encoder
+ *            : bitrate - new target bitrate, in bps
+ *      [out] : none
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_set_bitrate(void *coder, int bitrate)
+{
+    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+    int i;
+
+    if (h_mgr == NULL) {
+        return -1;
+    }
+
+    if (h_mgr->ladder_group != NULL) {
+        /* lower renditions follow the top one in proportion */
+        ladder_group_t *group = h_mgr->ladder_group;
+        int bitrates[MAX_LADDER_RENDITIONS];
+
+        for (i = 0; i < group->num_coders; i++) {
+            bitrates[i] = i == 0 ? bitrate : (int)((int64_t)group->params[i].i_target_bitrate * bitrate / group->params[0].i_target_bitrate);
+            if (encoder_check_bitrate(group->coders[i]->p_coder->param, bitrates[i]) < 0) {
+                return -1;
+            }
+        }
+        for (i = 0; i < group->num_coders; i++) {
+            group->params[i].i_target_bitrate = bitrates[i];
+            encoder_apply_bitrate(group->coders[i], bitrates[i]);
+        }
+    } else if (h_mgr->gop_group != NULL) {
+        /* all encoders have the same target bitrate */
+        gop_group_t *group = h_mgr->gop_group;
+
+        if (encoder_check_bitrate(group->coders[0]->p_coder->param, bitrate) < 0) {
+            return -1;
+        }
+        group->param.i_target_bitrate = bitrate;
+        for (i = 0; i < group->num_coders; i++) {
+            encoder_apply_bitrate(group->coders[i], bitrate);
+        }
+    } else {
+        if (encoder_check_bitrate(h_mgr->p_coder->param, bitrate) < 0) {
+            return -1;
+        }
+        encoder_apply_bitrate(h_mgr, bitrate);
+    }
+
+    return 0;
+}
+
+/**
+ * ---------------------------------------------------------------------------
+ * Function   : flush the encoder and reset it to start a new sequence
+ * Parameters :
+ *      [in ] : coder - pointer to wrapper of the xavs2 encoder
+ *            : param - new rate control and GOP parameters, NULL to keep the current ones
+ *      [out] : none
+ * Return     : zero for success, otherwise failed
+ * ---------------------------------------------------------------------------
+ */
+int xavs2_encoder_reset(void *coder, const xavs2_param_t *param)
+{
+    xavs2_handler_t *h_mgr = (xavs2_handler_t *)coder;
+    xavs2_param_t   *p_new = NULL;
+    int b_resize = 0;
+
+    if (h_mgr == NULL) {
+        return -1;
+    }
+
+    if (h_mgr->gop_group != NULL) {
+        return gop_group_reset(h_mgr, param);
+    }
+    if (h_mgr->ladder_group != NULL) {
+        return ladder_group_reset(h_mgr, param);
+    }
+
+    /* new parameters are checked before the encoder is flushed */
+    if (param != NULL) {
+        if (param == h_mgr->p_coder->param) {
+            xavs2_log(h_mgr, XAVS2_LOG_ERROR, "New parameters should not be the ones in use\n");
+            return -1;
+        }
+        if ((p_new = (xavs2_param_t *)xavs2_malloc(sizeof(xavs2_param_t))) == NULL) {
+            return -1;
+        }
+        memcpy(p_new, h_mgr->p_coder->param, sizeof(xavs2_param_t));
+        if (encoder_reset_parameters(p_new, param) < 0 || encoder_reset_check_size(h_mgr, p_new) < 0) {
+            xavs2_free(p_new);
+            return -1;
+        }
+        b_resize = p_new->org_width  != h_mgr->p_coder->param->org_width ||
+                   p_new->org_height != h_mgr->p_coder->param->org_height;
+    }
+
+    encoder_reset_flush(h_mgr);
+
+    if (p_new != NULL) {
+        memcpy((xavs2_param_t *)h_mgr->p_coder->param, p_new, sizeof(xavs2_param_t));
+        xavs2_free(p_new);
+    }
+
+    return encoder_reset_state(h_mgr, b_resize);
+}
@@ -69,6 +69,13 @@ static xavs2_api_t api_default = {
     xavs2_encoder_destroy,
     xavs2_encoder_encode,
     xavs2_encoder_packet_unref,
+    xavs2_encoder_mem_estimate,
+    xavs2_encoder_mem_usage,
+    xavs2_encoder_segment_state,
+    xavs2_encoder_ladder_fetch,
+    xavs2_encoder_reset,
+    xavs2_encoder_lookahead_stats,
+    xavs2_encoder_set_bitrate,
 };
 
 typedef const xavs2_api_t *(*xavs2_api_get_t)(int bit_depth);
@@ -0,0 +1,635 @@
+/*
+ * check.c
+ *
+ * Description of this file:
+ *    Checks of the encoder library, the input file is encoded several times
+ *    and the bitstreams are compared
+ *
+ * --------------------------------------------------------------------------
+ *
+ *    xavs2 - video encoder of AVS2/IEEE1857.4 video coding standard
+ *    Copyright (C) 2018~ VCL, NELVT, Peking University
+ *
+ *    Authors: Falei LUO <falei.luo@gmail.com>
+ *             etc.
+ *
+ *    Homepage1: http://vcl.idm.pku.edu.cn/xavs2
+ *    Homepage2: https://github.com/pkuvcl/xavs2
+ *    Homepage3: https://gitee.com/pkuvcl/xavs2
+ *
+ *    This program is free software; you can redistribute it and/or modify
+ *    it under the terms of the GNU General Public License as published by
+ *    the Free Software Foundation; either version 2 of the License, or
+ *    (at your option) any later version.
+ *
+ *    This program is distributed in the hope that it will be useful,
+ *    but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *    GNU General Public License for more details.
+ *
+ *    You should have received a copy of the GNU General Public License
+ *    along with this program; if not, write to the Free Software
+ *    Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02111, USA.
+ *
+ *    This program is also available under a commercial proprietary license.
+ *    For more information, contact us at sswang @ pku.edu.cn.
+ */
+
+
+/* ---------------------------------------------------------------------------
+ * disable warning C4996: functions or variables may be unsafe. */
+#if defined(_MSC_VER)
+#define _CRT_SECURE_NO_WARNINGS
+#endif
+
+/* ---------------------------------------------------------------------------
+ * include files */
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "xavs2.h"
+
+/* ---------------------------------------------------------------------------
+ */
+static FILE *g_infile = NULL;
+static const xavs2_api_t *api = NULL;
+
+/* ---------------------------------------------------------------------------
+ * read one frame data from file line by line
+ */
+static int read_one_frame(xavs2_image_t *img, int shift_in)
+{
+    int k, j;
+    if (img->in_sample_size != img->enc_sample_size) {
+        static uint8_t p_buffer[16 * 1024];
+
+        for (k = 0; k < img->i_plane; k++) {
+            int i_width  = img->i_width[k];
+            int i_stride = img->i_stride[k];
+
+            if (img->in_sample_size == 1) {
+                for (j = 0; j < img->i_lines[k]; j++) {
+                    uint16_t *p_plane = (uint16_t *)&img->img_planes[k][j * i_stride];
+                    int i;
+                    if (fread(p_buffer, i_width, 1, g_infile) != 1) {
+                        return -1;
+                    }
+                    memset(p_plane, 0, i_stride);
+                    for (i = 0; i < i_width; i++) {
+                        p_plane[i] = p_buffer[i] << shift_in;
+                    }
+                }
+            } else {
+                printf("Not supported high bit-depth for reading\n");
+                return -1;
+            }
+        }
+    } else {
+        for (k = 0; k < img->i_plane; k++) {
+            int size_line = img->i_width[k] * img->in_sample_size;
+            for (j = 0; j < img->i_lines[k]; j++) {
+                if (fread(img->img_planes[k] + img->i_stride[k] * j, size_line, 1, g_infile) != 1) {
+                    return -1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+/* ---------------------------------------------------------------------------
+ * encode frames [i_begin, i_end) of the input file, the bitstream is gathered
+ * in *p_buf. return the number of frames encoded, -1 on error
+ */
+static int encode_to_buffer(void *encoder, int i_begin, int i_end, int shift_in, uint8_t **p_buf, int *p_len)
+{
+    xavs2_outpacket_t packet = {0};
+    xavs2_picture_t pic;
+    int size_buf = 0;
+    int k = 0;
+
+    *p_buf = NULL;
+    *p_len = 0;
+    fseek(g_infile, 0, SEEK_SET);
+
+    while (k < i_end || packet.state != XAVS2_STATE_FLUSH_END) {
+        if (k < i_end) {
+            if (api->encoder_get_buffer(encoder, &pic) < 0) {
+                return -1;
+            }
+            /* frames before i_begin are skipped */
+            while (k < i_begin && read_one_frame(&pic.img, shift_in) == 0) {
+                k++;
+            }
+            if (read_one_frame(&pic.img, shift_in) < 0) {
+                pic.i_state = XAVS2_STATE_NO_DATA;
+                i_end = k > i_begin ? k : i_begin;
+                k     = i_end;
+            } else {
+                pic.i_state = 0;
+                pic.i_type  = XAVS2_TYPE_AUTO;
+                pic.i_pts   = k++;
+            }
+            api->encoder_encode(encoder, &pic, &packet);
+        } else {
+            api->encoder_encode(encoder, NULL, &packet);
+        }
+
+        if (packet.state == XAVS2_STATE_ENCODED || packet.state == XAVS2_STATE_FLUSH_END) {
+            if (*p_len + packet.len > size_buf) {
+                uint8_t *p_new;
+                size_buf = (*p_len + packet.len) * 2;
+                if ((p_new = (uint8_t *)realloc(*p_buf, size_buf)) == NULL) {
+                    api->encoder_packet_unref(encoder, &packet);
+                    return -1;
+                }
+                *p_buf = p_new;
+            }
+            memcpy(*p_buf + *p_len, packet.stream, packet.len);
+            *p_len += packet.len;
+        }
+        api->encoder_packet_unref(encoder, &packet);
+    }
+
+    return i_end - i_begin;
+}
+
+/* ---------------------------------------------------------------------------
+ * check "reset": the bitstream of an encoder after encoder_reset()
+ * is the same as that of a new encoder, frame threads included
+ */
+static int check_encoder_reset(xavs2_param_t *param, int num_frames, int shift_in)
+{
+    uint8_t *p_reset = NULL;
+    uint8_t *p_fresh = NULL;
+    int len_reset = 0;
+    int len_fresh = 0;
+    int ret = -1;
+    void *encoder;
+
+    if ((encoder = api->encoder_create(param)) != NULL) {
+        if (encode_to_buffer(encoder, 0, num_frames, shift_in, &p_reset, &len_reset) >= 0 &&
+            api->encoder_reset(encoder, NULL) == 0) {
+            free(p_reset);
+            ret = encode_to_buffer(encoder, 0, num_frames, shift_in, &p_reset, &len_reset) < 0 ? -1 : 0;
+        }
+        api->encoder_destroy(encoder);
+    }
+    if (ret == 0) {
+        ret = -1;
+        if ((encoder = api->encoder_create(param)) != NULL) {
+            ret = encode_to_buffer(encoder, 0, num_frames, shift_in, &p_fresh, &len_fresh) < 0 ? -1 : 0;
+            api->encoder_destroy(encoder);
+        }
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "reset check (thread_frames=%s): failed to encode\n", api->opt_get(param, "thread_frames"));
+    } else if (len_reset != len_fresh || memcmp(p_reset, p_fresh, len_reset) != 0) {
+        fprintf(stderr, "reset check (thread_frames=%s): %d bytes after reset, %d bytes of a new encoder, MISMATCH\n",
+                api->opt_get(param, "thread_frames"), len_reset, len_fresh);
+        ret = -1;
+    } else {
+        fprintf(stdout, "reset check (thread_frames=%s): %d bytes, same as a new encoder\n",
+                api->opt_get(param, "thread_frames"), len_reset);
+    }
+
+    free(p_reset);
+    free(p_fresh);
+    return ret;
+}
+
+/* ---------------------------------------------------------------------------
+ * bit reader of the headers parsed by the checks
+ */
+typedef struct bits_t {
+    const uint8_t *p;
+    int            len;               /* length in bytes */
+    int            pos;               /* position in bits */
+} bits_t;
+
+static uint32_t read_bits(bits_t *bs, int n)
+{
+    uint32_t val = 0;
+
+    while (n-- > 0) {
+        int bit = bs->pos < (bs->len << 3) ? (bs->p[bs->pos >> 3] >> (7 - (bs->pos & 7))) & 1 : 0;
+        val = (val << 1) | bit;
+        bs->pos++;
+    }
+    return val;
+}
+
+static int read_ue(bits_t *bs)
+{
+    int zeros = 0;
+
+    while (read_bits(bs, 1) == 0 && zeros < 31) {
+        zeros++;
+    }
+    return (int)((1u << zeros) - 1 + read_bits(bs, zeros));
+}
+
+/* ---------------------------------------------------------------------------
+ * parse the headers of a bitstream for the checks, the units are appended to
+ * info[]: every sequence header byte by byte, and the COI, POC and RPS of
+ * every picture. a sequence header same as the previous one (repeated at I
+ * frames or at the start of a segment) is skipped. return the number of
+ * integers in info[], which holds at most 4 * len + 64 of them
+ */
+static int parse_headers(const uint8_t *data, int len, int *info)
+{
+    const uint8_t *p_seq = NULL;      /* last sequence header */
+    int len_seq        = 0;
+    int low_delay      = 0;
+    int temporal_id    = 0;
+    int reorder_delay  = 0;
+    int coi_full       = -1;          /* COI of last picture, not wrapped */
+    int num = 0;
+    int i = 0;
+
+    while (i + 4 <= len) {
+        int code = data[i + 3];
+        int end  = i + 4;
+        bits_t bs;
+        int j, n;
+
+        if (data[i] != 0 || data[i + 1] != 0 || data[i + 2] != 1) {
+            i++;
+            continue;
+        }
+        while (end + 3 <= len && (data[end] != 0 || data[end + 1] != 0 || data[end + 2] != 1)) {
+            end++;
+        }
+        end = end + 3 <= len ? end : len;
+
+        bs.p   = data + i;
+        bs.len = end - i;
+        bs.pos = 32;
+
+        if (code == 0xB0 && end - i == len_seq && memcmp(data + i, p_seq, len_seq) == 0) {
+            /* repeated sequence header */
+        } else if (code == 0xB0) {
+            /* sequence header */
+            p_seq   = data + i;
+            len_seq = end - i;
+            info[num++] = code;
+            info[num++] = end - i;
+            for (j = i; j < end; j++) {
+                info[num++] = data[j];
+            }
+
+            j = (int)read_bits(&bs, 8);               /* profile_id */
+            read_bits(&bs, 8 + 1 + 1 + 14 + 14 + 2 + 3);
+            if (j == 0x22) {
+                read_bits(&bs, 3);                    /* encoding_precision of MAIN10 */
+            }
+            read_bits(&bs, 4 + 4 + 18 + 1 + 12);
+            low_delay   = read_bits(&bs, 1);
+            read_bits(&bs, 1);
+            temporal_id = read_bits(&bs, 1);
+            read_bits(&bs, 18 + 3);
+            if (read_bits(&bs, 1) && read_bits(&bs, 1)) {
+                for (j = 0; j < 16 + 64; j++) {
+                    read_ue(&bs);                     /* weight_quant_coeff */
+                }
+            }
+            read_bits(&bs, 11 + 1);
+            n = read_bits(&bs, 6);                    /* num_of_RPS */
+            for (j = 0; j < n; j++) {
+                read_bits(&bs, 1);
+                read_bits(&bs, 6 * read_bits(&bs, 3));
+                read_bits(&bs, 6 * read_bits(&bs, 3));
+                read_bits(&bs, 1);
+            }
+            reorder_delay = low_delay ? 0 : read_bits(&bs, 5);
+        } else if (code == 0xB3 || code == 0xB6) {
+            /* picture header */
+            int coi, delay;
+
+            read_bits(&bs, 32);                       /* bbv_delay */
+            if (code == 0xB3) {
+                if (read_bits(&bs, 1)) {
+                    read_bits(&bs, 24);               /* time_code */
+                }
+                info[num++] = code;
+            } else {
+                info[num++] = code | (read_bits(&bs, 2) << 8);
+            }
+            coi = read_bits(&bs, 8);
+            coi_full = coi_full + ((coi - coi_full) & 255);
+            if (temporal_id) {
+                read_bits(&bs, 3);
+            }
+            delay = low_delay ? reorder_delay : read_ue(&bs);
+            info[num++] = coi_full;
+            info[num++] = coi_full + delay - reorder_delay;   /* POC */
+
+            if (read_bits(&bs, 1)) {
+                info[num++] = read_bits(&bs, 5);      /* RPS in the sequence header */
+            } else {
+                info[num++] = -1;
+                info[num++] = read_bits(&bs, 1);      /* referenced by others */
+                info[num++] = n = read_bits(&bs, 3);
+                for (j = 0; j < n; j++) {
+                    info[num++] = read_bits(&bs, 6);  /* delta COI of reference pictures */
+                }
+                info[num++] = n = read_bits(&bs, 3);
+                for (j = 0; j < n; j++) {
+                    info[num++] = read_bits(&bs, 6);  /* delta COI of removed pictures */
+                }
+            }
+        } else if (code == 0xB1) {
+            info[num++] = code;                       /* sequence end */
+        }
+        i = end;
+    }
+
+    return num;
+}
+
+/* ---------------------------------------------------------------------------
+ * POC of the I frame nearest to the middle of a bitstream, 0 if there is only
+ * the first one, -1 on error
+ */
+static int find_split_frame(const uint8_t *data, int len, int num_frames)
+{
+    int *info = (int *)malloc(sizeof(int) * (4 * len + 64));
+    int i_split = 0;
+    int num, k;
+
+    if (info == NULL) {
+        return -1;
+    }
+
+    num = parse_headers(data, len, info);
+    for (k = 0; k < num;) {
+        int code = info[k] & 0xFF;
+
+        if (code == 0xB0) {
+            k += 2 + info[k + 1];
+        } else if (code == 0xB1) {
+            k += 1;
+        } else {
+            if (code == 0xB3 && info[k + 2] > 0 &&
+                (i_split == 0 || abs(info[k + 2] - num_frames / 2) < abs(i_split - num_frames / 2))) {
+                i_split = info[k + 2];
+            }
+            if (info[k + 3] >= 0) {
+                k += 4;
+            } else {
+                k += 6 + info[k + 5];
+                k += 1 + info[k];
+            }
+        }
+    }
+
+    free(info);
+    return i_split;
+}
+
+/* ---------------------------------------------------------------------------
+ * compare the parsed headers of two bitstreams, return the index of the first
+ * unit which differs, -1 if they are the same
+ */
+static int compare_headers(const uint8_t *data_a, int len_a, const uint8_t *data_b, int len_b, int *p_pics)
+{
+    int *info_a = (int *)malloc(sizeof(int) * (4 * len_a + 64));
+    int *info_b = (int *)malloc(sizeof(int) * (4 * len_b + 64));
+    int num_a, num_b;
+    int i, idx = -1;
+
+    *p_pics = 0;
+    if (info_a == NULL || info_b == NULL) {
+        free(info_a);
+        free(info_b);
+        return 0;
+    }
+
+    num_a = parse_headers(data_a, len_a, info_a);
+    num_b = parse_headers(data_b, len_b, info_b);
+    for (i = 0; i < num_a && i < num_b && info_a[i] == info_b[i]; i++) {
+        if ((info_a[i] & 0xFF) == 0xB3 || (info_a[i] & 0xFF) == 0xB6) {
+            (*p_pics)++;
+        }
+    }
+    if (i < num_a || i < num_b) {
+        idx = *p_pics;
+    }
+
+    free(info_a);
+    free(info_b);
+    return idx;
+}
+
+/* ---------------------------------------------------------------------------
+ * check "segments": two segments (SegmentMode) split at an I frame and
+ * concatenated have the same sequence headers, COI, POC and RPS of every
+ * picture as a single-pass encode, segments are closed GOPs
+ */
+static int check_segments(xavs2_param_t *param, int num_frames, int shift_in)
+{
+    xavs2_segment_t segment;
+    uint8_t *p_single = NULL;
+    uint8_t *p_seg[2] = { NULL, NULL };
+    uint8_t *p_concat;
+    int len_single = 0;
+    int len_seg[2] = { 0, 0 };
+    int i_split = -1;
+    int ret = -1;
+    int idx = -2;                     /* not compared yet */
+    void *encoder;
+    char buf[64];
+    int i, num_pics;
+
+    /* single-pass encode */
+    api->opt_set2(param, "SegmentMode", "0");
+    api->opt_set2(param, "OpenGOP", "0");
+    if ((encoder = api->encoder_create(param)) == NULL) {
+        goto fail;
+    }
+    num_frames = encode_to_buffer(encoder, 0, num_frames, shift_in, &p_single, &len_single);
+    api->encoder_destroy(encoder);
+    if (num_frames < 0) {
+        goto fail;
+    }
+
+    /* the segments are split at the I frame in the middle */
+    if ((i_split = find_split_frame(p_single, len_single, num_frames)) <= 0) {
+        goto fail;
+    }
+
+    /* two segments */
+    api->opt_set2(param, "SegmentMode", "1");
+    for (i = 0; i < 2; i++) {
+        sprintf(buf, "%d", i ? segment.start_frame : 0);
+        api->opt_set2(param, "SegmentStartFrame", buf);
+        sprintf(buf, "%d", i ? segment.rc_qp : 0);
+        api->opt_set2(param, "SegmentRcQp", buf);
+        sprintf(buf, "%d", i ? segment.rc_buffer : 0);
+        api->opt_set2(param, "SegmentRcBuffer", buf);
+        sprintf(buf, "%d", i ? segment.refs : 0);
+        api->opt_set2(param, "SegmentRefs", buf);
+        api->opt_set2(param, "SegmentLast", i ? "1" : "0");
+
+        if ((encoder = api->encoder_create(param)) == NULL) {
+            goto fail;
+        }
+        if (encode_to_buffer(encoder, i ? segment.start_frame : 0, i ? num_frames : i_split, shift_in, &p_seg[i], &len_seg[i]) < 0 ||
+            api->encoder_segment_state(encoder, &segment) < 0) {
+            api->encoder_destroy(encoder);
+            goto fail;
+        }
+        api->encoder_destroy(encoder);
+    }
+
+    /* concatenate the segments */
+    if ((p_concat = (uint8_t *)realloc(p_seg[0], len_seg[0] + len_seg[1] + 1)) == NULL) {
+        goto fail;
+    }
+    p_seg[0] = p_concat;
+    memcpy(p_seg[0] + len_seg[0], p_seg[1], len_seg[1]);
+
+    idx = compare_headers(p_single, len_single, p_seg[0], len_seg[0] + len_seg[1], &num_pics);
+    if (idx >= 0) {
+        fprintf(stderr, "segment check (split at frame %d): headers of picture %d differ from a single-pass encode, MISMATCH\n",
+                i_split, idx);
+    } else {
+        fprintf(stdout, "segment check (split at frame %d): %d pictures, same headers as a single-pass encode\n",
+                i_split, num_pics);
+        ret = 0;
+    }
+
+fail:
+    if (idx == -2 && i_split == 0) {
+        fprintf(stderr, "segment check: no I frame to split the %d frames at\n", num_frames);
+    } else if (idx == -2) {
+        fprintf(stderr, "segment check: failed to encode\n");
+    }
+    free(p_single);
+    free(p_seg[0]);
+    free(p_seg[1]);
+    return ret;
+}
+
+/* ---------------------------------------------------------------------------
+ * check "gops": the bitstream of GOP parallel encoding has the same
+ * sequence headers, COI, POC and RPS of every picture as one encoder
+ */
+static int check_parallel_gops(xavs2_param_t *param, int num_frames, int shift_in)
+{
+    uint8_t *p_buf[2] = { NULL, NULL };
+    int len[2] = { 0, 0 };
+    int num_gops = atoi(api->opt_get(param, "num_parallel_gop"));
+    int ret = 0;
+    int i, idx, num_pics;
+    void *encoder;
+
+    if (num_gops <= 1) {
+        fprintf(stderr, "parallel GOP check: num_parallel_gop should be more than 1\n");
+        return -1;
+    }
+
+    /* GOP parallel encoding, then one encoder */
+    for (i = 0; i < 2 && ret == 0; i++) {
+        if (i == 1) {
+            api->opt_set2(param, "num_parallel_gop", "1");
+        }
+        ret = -1;
+        if ((encoder = api->encoder_create(param)) != NULL) {
+            ret = encode_to_buffer(encoder, 0, num_frames, shift_in, &p_buf[i], &len[i]) < 0 ? -1 : 0;
+            api->encoder_destroy(encoder);
+        }
+    }
+
+    if (ret < 0) {
+        fprintf(stderr, "parallel GOP check (num_parallel_gop=%d): failed to encode\n", num_gops);
+    } else if ((idx = compare_headers(p_buf[1], len[1], p_buf[0], len[0], &num_pics)) >= 0) {
+        fprintf(stderr, "parallel GOP check (num_parallel_gop=%d): headers of picture %d differ from one encoder, MISMATCH\n",
+                num_gops, idx);
+        ret = -1;
+    } else {
+        fprintf(stdout, "parallel GOP check (num_parallel_gop=%d): %d pictures, same headers as one encoder\n",
+                num_gops, num_pics);
+    }
+
+    free(p_buf[0]);
+    free(p_buf[1]);
+    return ret;
+}
+
+/* ---------------------------------------------------------------------------
+ * usage: xavs2check <check> [parameters of the encoder, same as xavs2]
+ *   reset    : an encoder after encoder_reset() equals a new encoder
+ *   segments : two segments (SegmentMode) concatenated equal a single-pass encode
+ *   gops     : GOP parallel encoding (num_parallel_gop) equals one encoder
+ */
+int main(int argc, char **argv)
+{
+    static const char *tab_checks[] = { "reset", "segments", "gops" };
+    xavs2_param_t *param = NULL;
+    int guess_bit_depth;
+    int idx_check = -1;
+    int num_frames, shift_in;
+    int ret = -1;
+    int i;
+
+    for (i = 0; argc > 1 && i < (int)(sizeof(tab_checks) / sizeof(tab_checks[0])); i++) {
+        if (!strcmp(argv[1], tab_checks[i])) {
+            idx_check = i;
+        }
+    }
+    if (idx_check < 0 || argc < 3) {
+        fprintf(stderr, "usage: %s <reset|segments|gops> [parameters of the encoder, same as xavs2]\n", argv[0]);
+        return -1;
+    }
+
+    /* get API handler, argv[1] is skipped as the program name */
+    for (guess_bit_depth = 8; guess_bit_depth <= 10; guess_bit_depth += 2) {
+        if ((api = xavs2_api_get(guess_bit_depth)) == NULL) {
+            continue;
+        }
+        param = api->opt_alloc();
+        if (api->opt_set(param, argc - 1, argv + 1) < 0) {
+            fprintf(stderr, "parse contents error.\n");
+            api->opt_destroy(param);
+            return -1;
+        }
+        if (atoi(api->opt_get(param, "BitDepth")) == api->internal_bit_depth) {
+            break;
+        }
+        api->opt_destroy(param);
+        param = NULL;
+        api = NULL;
+    }
+    if (api == NULL) {
+        fprintf(stderr, "CAVS2Enc lib load error\n");
+        return -1;
+    }
+
+    shift_in   = atoi(api->opt_get(param, "SampleShift"));
+    num_frames = atoi(api->opt_get(param, "frames"));
+    num_frames = num_frames ? num_frames : (1 << 30);
+
+    if ((g_infile = fopen(api->opt_get(param, "input"), "rb")) == NULL) {
+        fprintf(stderr, "error opening input file: \"%s\"\n", api->opt_get(param, "input"));
+    } else {
+        switch (idx_check) {
+        case 0:
+            ret = check_encoder_reset(param, num_frames, shift_in);
+            break;
+        case 1:
+            ret = check_segments(param, num_frames, shift_in);
+            break;
+        default:
+            ret = check_parallel_gops(param, num_frames, shift_in);
+            break;
+        }
+        fclose(g_infile);
+    }
+
+    api->opt_destroy(param);
+    return ret;
+}
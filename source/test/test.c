@@ -63,6 +63,9 @@
  */
 static FILE *g_infile  = NULL;
 static FILE *g_outfile = NULL;
+static FILE *g_ladder_files[XAVS2_MAX_LADDER + 1] = { NULL };  /* lower renditions of ladder encoding */
+static int   g_num_ladder = 0;
+static int   g_lookahead_stats = 0;   /* report the lookahead complexity of input frames */
 const xavs2_api_t *api = NULL;
 
 /* ---------------------------------------------------------------------------
@@ -79,6 +82,45 @@ static void dump_encoded_data(void *coder, xavs2_outpacket_t *packet)
     }
 }
 
+/* ---------------------------------------------------------------------------
+ * write out the bitstreams of the lower renditions (ladder encoding),
+ * all pending packets are fetched, till the end when flushing
+ */
+static void dump_ladder_data(void *coder, int b_flush)
+{
+    xavs2_outpacket_t packet = {0};
+    int i;
+
+    for (i = 1; i <= g_num_ladder; i++) {
+        for (;;) {
+            if (api->encoder_ladder_fetch(coder, i, &packet) < 0) {
+                break;
+            }
+            if (packet.state == XAVS2_STATE_ENCODED || packet.state == XAVS2_STATE_FLUSH_END) {
+                fwrite(packet.stream, packet.len, 1, g_ladder_files[i]);
+            }
+            api->encoder_packet_unref(coder, &packet);
+            if (packet.state == XAVS2_STATE_FLUSH_END || (packet.state == XAVS2_STATE_NO_DATA && !b_flush)) {
+                break;
+            }
+        }
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ */
+static void close_ladder_files(void)
+{
+    int i;
+
+    for (i = 1; i <= g_num_ladder; i++) {
+        if (g_ladder_files[i] != NULL) {
+            fclose(g_ladder_files[i]);
+            g_ladder_files[i] = NULL;
+        }
+    }
+}
+
 /* ---------------------------------------------------------------------------
  * read one frame data from file line by line
  */
@@ -122,6 +164,23 @@ static int read_one_frame(xavs2_image_t *img, int shift_in)
     return 0;
 }
 
+/* ---------------------------------------------------------------------------
+ * report the lookahead complexity of the last input frame
+ */
+static void dump_lookahead_stats(void *coder)
+{
+    static const char tab_type[] = "?IIPFBIGG";
+    xavs2_frame_stat_t stats[64];
+    int num = api->encoder_lookahead_stats(coder, stats, 64);
+
+    if (num > 0) {
+        xavs2_frame_stat_t *p = &stats[num - 1];
+        fprintf(stdout, "lookahead: pts %4lld (%c) intra %10lld inter %10lld intra blocks %5d/%5d scene %.3f, %d queued\n",
+                (long long)p->pts, tab_type[p->type], (long long)p->intra_cost, (long long)p->inter_cost,
+                p->intra_blocks, p->num_blocks, p->scene_score, num);
+    }
+}
+
 int test_encoder(xavs2_param_t *param)
 {
     const char *in_file = api->opt_get(param, "input");
@@ -146,6 +205,26 @@ int test_encoder(xavs2_param_t *param)
         return -1;
     }
 
+    /* bitstreams of the lower renditions: <output>.r1, <output>.r2, ... */
+    g_num_ladder = atoi(api->opt_get(param, "LadderNum"));
+    g_num_ladder = g_num_ladder < 0 ? 0 : g_num_ladder;
+    g_num_ladder = g_num_ladder > XAVS2_MAX_LADDER ? XAVS2_MAX_LADDER : g_num_ladder;  /* checked by the encoder */
+    for (k = 1; k <= g_num_ladder; k++) {
+        char ladder_file[1024];
+
+        sprintf(ladder_file, "%.1000s.r%d", bs_file, k);
+        if ((g_ladder_files[k] = fopen(ladder_file, "wb")) == NULL) {
+            fprintf(stderr, "error opening output file: \"%s\"\n", ladder_file);
+            close_ladder_files();
+            fclose(g_infile);
+            fclose(g_outfile);
+
+            return -1;
+        }
+    }
+
+    g_lookahead_stats = atoi(api->opt_get(param, "LookaheadStats"));
+
     if (num_frames == 0) {
         num_frames = 1 << 30;
     }
@@ -155,6 +234,7 @@ int test_encoder(xavs2_param_t *param)
 
     if (encoder == NULL) {
         fprintf(stderr, "Error: Can not create encoder. Null pointer returned.\n");
+        close_ladder_files();
         fclose(g_infile);
         fclose(g_outfile);
 
@@ -175,6 +255,7 @@ int test_encoder(xavs2_param_t *param)
 
             api->encoder_encode(encoder, &pic, &packet);
             dump_encoded_data(encoder, &packet);
+            dump_ladder_data(encoder, 0);
             break;
         }
 
@@ -183,17 +264,33 @@ int test_encoder(xavs2_param_t *param)
         pic.i_pts   = k;
 
         api->encoder_encode(encoder, &pic, &packet);
+        if (g_lookahead_stats) {
+            dump_lookahead_stats(encoder);
+        }
         dump_encoded_data(encoder, &packet);
+        dump_ladder_data(encoder, 0);
     }
 
     /* flush delayed frames */
     for (; packet.state != XAVS2_STATE_FLUSH_END;) {
         api->encoder_encode(encoder, NULL, &packet);
         dump_encoded_data(encoder, &packet);
+        dump_ladder_data(encoder, 0);
+    }
+    dump_ladder_data(encoder, 1);
+
+    /* report the parameters of the next segment */
+    if (atoi(api->opt_get(param, "SegmentMode"))) {
+        xavs2_segment_t segment;
+        if (api->encoder_segment_state(encoder, &segment) == 0) {
+            fprintf(stdout, "next segment: SegmentStartFrame=%d SegmentRcQp=%d SegmentRcBuffer=%d SegmentRefs=%d\n",
+                    segment.start_frame, segment.rc_qp, segment.rc_buffer, segment.refs);
+        }
     }
 
     /* destroy the encoder */
     api->encoder_destroy(encoder);
+    close_ladder_files();
 
     return 0;
 }
@@ -43,7 +43,7 @@
 extern "C" {    // only need to export C interface if used by C++ source code
 #endif
 
-#define XAVS2_BUILD         12        /* xavs2 build version */
+#define XAVS2_BUILD         13        /* xavs2 build version */
 
 /**
  * ===========================================================================
@@ -97,6 +97,11 @@ extern "C" {    // only need to export C interface if used by C++ source code
 #define XAVS2_TYPE_G          7
 #define XAVS2_TYPE_GB         8
 
+/* ---------------------------------------------------------------------------
+ * ladder encoding
+ */
+#define XAVS2_MAX_LADDER      5     /* max number of lower renditions (LadderNum), Ladder1 ~ Ladder5 */
+
 /* ---------------------------------------------------------------------------
  * color space type
  */
@@ -120,6 +125,19 @@ enum log_level_e {
     XAVS2_LOG_DEBUG    = 3,   /* level 3 */
 };
 
+/* ---------------------------------------------------------------------------
+ * memory categories of an encoder instance
+ */
+enum mem_category_e {
+    XAVS2_MEMCAT_HANDLER      = 0,    /* encoder wrapper, rate control and TDRDO */
+    XAVS2_MEMCAT_INPUT_FRAMES = 1,    /* buffered input frames */
+    XAVS2_MEMCAT_REF_FRAMES   = 2,    /* reconstructed and reference frames (DPB) */
+    XAVS2_MEMCAT_FRAME_CTX    = 3,    /* frame encoding contexts (bitstream buffers excluded) */
+    XAVS2_MEMCAT_BITSTREAM    = 4,    /* slice bitstream buffers of all frame contexts, enlarged frame bitstreams */
+    XAVS2_MEMCAT_ROW_CTX      = 5,    /* LCU row encoding contexts */
+    XAVS2_MEMCAT_NUM          = 6     /* number of categories */
+};
+
 /* ---------------------------------------------------------------------------
  * others
  */
@@ -206,6 +224,43 @@ typedef struct xavs2_outpacket_t {
     void           *opaque;           /* pointer to user data */
 } xavs2_outpacket_t;
 
+/* ---------------------------------------------------------------------------
+ * xavs2_mem_stat_t
+ */
+typedef struct xavs2_mem_stat_t {
+    int64_t        size[XAVS2_MEMCAT_NUM]; /* bytes of each category, see mem_category_e */
+    int64_t        total;             /* bytes of all categories */
+    int64_t        peak;              /* highest number of bytes held at once, including buffers being enlarged */
+    int            frame_threads;     /* number of frame threads the sizes are based on */
+    int            row_threads;       /* number of row   threads the sizes are based on */
+} xavs2_mem_stat_t;
+
+/* ---------------------------------------------------------------------------
+ * xavs2_segment_t, state handed over to the next segment in segment encoding
+ */
+typedef struct xavs2_segment_t {
+    int            start_frame;       /* SegmentStartFrame of the next segment */
+    int            rc_qp;             /* SegmentRcQp       of the next segment */
+    int            rc_buffer;         /* SegmentRcBuffer   of the next segment */
+    int            refs;              /* SegmentRefs       of the next segment */
+} xavs2_segment_t;
+
+/* ---------------------------------------------------------------------------
+ * xavs2_frame_stat_t, complexity of a frame estimated in lookahead (LookaheadStats)
+ * on its half-size copy, in 8x8 blocks (16x16 blocks of the frame)
+ */
+typedef struct xavs2_frame_stat_t {
+    int64_t        pts;               /* pts of the frame */
+    int            type;              /* planned frame type, a B frame may be changed to P/F on flushing */
+    int64_t        intra_cost;        /* sum of the intra SATD costs of all blocks */
+    int64_t        inter_cost;        /* sum of the inter SATD costs referring to the previous input frame,
+                                       * same as intra_cost for the first frame */
+    int64_t        best_cost;         /* sum of the lower cost of each block */
+    int            intra_blocks;      /* number of blocks where intra is not costlier than inter */
+    int            num_blocks;        /* number of blocks */
+    double         scene_score;       /* inter_cost / intra_cost, 0.0 ~ 1.0, near 1.0 for a scene change */
+} xavs2_frame_stat_t;
+
 /**
  * ===========================================================================
  * interface function declares: parameters
@@ -361,6 +416,109 @@ typedef struct xavs2_api_t {
      * ---------------------------------------------------------------------------
      */
     int (*encoder_packet_unref)(void *coder, xavs2_outpacket_t *packet);
+
+    /**
+     * ---------------------------------------------------------------------------
+     * Function   : estimate the memory usage of an encoder before its creation,
+     *              the thread numbers and the memory budget are applied as in `encoder_create()`
+     * Parameters :
+     *      [in ] : param - pointer to struct xavs2_param_t
+     *      [out] : stat  - projected bytes of each category
+     * Return     : zero for success, otherwise failed
+     * ---------------------------------------------------------------------------
+     */
+    int (*encoder_mem_estimate)(const xavs2_param_t *param, xavs2_mem_stat_t *stat);
+
+    /**
+     * ---------------------------------------------------------------------------
+     * Function   : get the memory allocated by an encoder
+     * Parameters :
+     *      [in ] : coder - pointer to handle of xavs2 encoder (return by `encoder_create()`)
+     *      [out] : stat  - bytes of each category allocated at the time of the call, including
+     *                      the frame contexts and bitstream buffers opened or enlarged while encoding,
+     *                      and the peak bytes held so far
+     * Return     : zero for success, otherwise failed
+     * ---------------------------------------------------------------------------
+     */
+    int (*encoder_mem_usage)(void *coder, xavs2_mem_stat_t *stat);
+
+    /**
+     * ---------------------------------------------------------------------------
+     * Function   : get the state to be handed over to the next segment (SegmentMode),
+     *              called after all frames of this segment are flushed
+     * Parameters :
+     *      [in ] : coder   - pointer to handle of xavs2 encoder (return by `encoder_create()`)
+     *      [out] : segment - parameters of the next segment
+     * Return     : zero for success, otherwise failed
+     * ---------------------------------------------------------------------------
+     */
+    int (*encoder_segment_state)(void *coder, xavs2_segment_t *segment);
+
+    /**
+     * ---------------------------------------------------------------------------
+     * Function   : fetch a packet of a lower rendition in ladder encoding (LadderNum > 0),
+     *              `encoder_encode()` outputs the top rendition, call this for each lower
+     *              rendition after it, until the state is XAVS2_STATE_FLUSH_END when flushing
+     * Parameters :
+     *      [in ] : coder     - pointer to handle of xavs2 encoder (return by `encoder_create()`)
+     *            : rendition - index of the lower rendition, 1 ~ LadderNum
+     *      [out] : packet    - output bit-stream, recycled by `encoder_packet_unref()`
+     * Return     : zero for success, otherwise failed
+     * ---------------------------------------------------------------------------
+     */
+    int (*encoder_ladder_fetch)(void *coder, int rendition, xavs2_outpacket_t *packet);
+
+    /**
+     * ---------------------------------------------------------------------------
+     * Function   : flush the encoder and reset it to start a new sequence with an I frame,
+     *              all buffers and threads are kept. frames not output yet are encoded
+     *              and dropped, so all packets should be recycled before calling this
+     * Parameters :
+     *      [in ] : coder - pointer to handle of xavs2 encoder (return by `encoder_create()`)
+     *            : param - NULL to keep the parameters, or new parameters of which only
+     *                      RateControl, TargetBitRate, initial_qp, min_qp, max_qp,
+     *                      IntraPeriod, width and height are applied. it should not be
+     *                      the one passed to `encoder_create()`.
+     *                      the frame size can not exceed the one on creation, a new
+     *                      sequence header is emitted for it. flush the encoder with
+     *                      NULL pictures and recycle all packets before the frame size
+     *                      changes to keep all frames
+     *      [out] : none
+     * Return     : zero for success, otherwise failed
+     * ---------------------------------------------------------------------------
+     */
+    int (*encoder_reset)(void *coder, const xavs2_param_t *param);
+
+    /**
+     * ---------------------------------------------------------------------------
+     * Function   : get the complexity of the frames input but not output yet (LookaheadStats = 1),
+     *              B frames are delayed until their GOP is complete, so the frames of a whole
+     *              GOP are available before the first of them is encoded
+     * Parameters :
+     *      [in ] : coder   - pointer to handle of xavs2 encoder (return by `encoder_create()`)
+     *            : max_num - max number of frames to be filled in stats
+     *      [out] : stats   - complexity of the frames, in input order
+     * Return     : number of frames filled, negative for failure
+     * ---------------------------------------------------------------------------
+     */
+    int (*encoder_lookahead_stats)(void *coder, xavs2_frame_stat_t *stats, int max_num);
+
+    /**
+     * ---------------------------------------------------------------------------
+     * Function   : change the target bitrate of rate control while encoding, it is
+     *              applied before the QP of the next I/P/F frame is decided. the state of
+     *              rate control is scaled to the new target instead of being reset.
+     *              lower renditions of ladder encoding follow the top one in proportion.
+     *              the bitrate in the sequence headers and the LevelID are kept, a new
+     *              bitrate exceeding the LevelID needs `encoder_reset()`
+     * Parameters :
+     *      [in ] : coder   - pointer to handle of xavs2 encoder (return by `encoder_create()`)
+     *            : bitrate - new target bitrate, in bps
+     *      [out] : none
+     * Return     : zero for success, otherwise failed (no rate control or the LevelID is exceeded)
+     * ---------------------------------------------------------------------------
+     */
+    int (*encoder_set_bitrate)(void *coder, int bitrate);
 } xavs2_api_t;
 
 